@@ -506,12 +506,20 @@ main(int argc, char* argv[])
     static gboolean trace = FALSE;
     static gboolean version = FALSE;
     static gboolean timestamps = FALSE;
+    static gboolean fuse = FALSE;
     static gchar *dump = NULL;
+    static gchar *cpu_placement = NULL;
+    static gchar *cost_cache = NULL;
+    static gint batch_size = 1;
 
     static GOptionEntry entries[] = {
         { "trace",   't', 0, G_OPTION_ARG_NONE, &trace, "enable tracing", NULL },
         { "dump",    'd', 0, G_OPTION_ARG_STRING, &dump, "Dump to JSON file", NULL },
         { "timestamps",0, 0, G_OPTION_ARG_NONE, &timestamps, "generate timestamps", NULL },
+        { "fuse",      0, 0, G_OPTION_ARG_NONE, &fuse, "fuse chains of GPU tasks", NULL },
+        { "cpu-placement", 0, 0, G_OPTION_ARG_STRING, &cpu_placement, "pin task threads to processors", "none|numa|core" },
+        { "cost-cache", 0, 0, G_OPTION_ARG_FILENAME, &cost_cache, "load and store task costs", "FILE" },
+        { "batch-size", 0, 0, G_OPTION_ARG_INT, &batch_size, "items passed to batch-capable tasks at once", "N" },
         { "quiet",   'q', 0, G_OPTION_ARG_NONE, &quiet, "be quiet", NULL },
         { "quieter",   0, 0, G_OPTION_ARG_NONE, &quieter, "be quieter", NULL },
         { "version",   0, 0, G_OPTION_ARG_NONE, &version, "Show version information", NULL },
@@ -573,8 +581,27 @@ main(int argc, char* argv[])
     g_object_set (sched,
                   "enable-tracing", trace,
                   "timestamps", timestamps,
+                  "fuse", fuse,
+                  "cost-cache", cost_cache,
+                  "batch-size", (guint) CLAMP (batch_size, 1, 1024),
                   NULL);
 
+    if (cpu_placement != NULL) {
+        GEnumClass *enum_class;
+        GEnumValue *placement;
+
+        enum_class = g_type_class_ref (UFO_TYPE_CPU_PLACEMENT);
+        placement = g_enum_get_value_by_nick (enum_class, cpu_placement);
+
+        if (placement == NULL) {
+            g_printerr ("Unknown CPU placement `%s'\n", cpu_placement);
+            return 1;
+        }
+
+        g_object_set (sched, "cpu-placement", placement->value, NULL);
+        g_type_class_unref (enum_class);
+    }
+
     if (!dump)
         ufo_base_scheduler_run (sched, graph, &error);
 
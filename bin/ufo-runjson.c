@@ -101,6 +101,11 @@ execute_json (const gchar *filename,
         scheduler = ufo_scheduler_new ();
     }
 
+    if ((NULL != options->scheduler) && (0 == g_ascii_strcasecmp (options->scheduler, "stealing"))) {
+        g_debug ("INFO: run-json: using work-stealing scheduler");
+        scheduler = ufo_stealing_scheduler_new ();
+    }
+
     if (!scheduler) {
         g_debug ("INFO: run-json: using dynamic scheduler by default");
         scheduler = ufo_scheduler_new ();
@@ -151,7 +156,7 @@ int main(int argc, char *argv[])
     GOptionEntry entries[] = {
         { "trace",     't', 0, G_OPTION_ARG_NONE, &options.trace, "enable tracing", NULL },
         { "scheduler", 's', 0, G_OPTION_ARG_STRING, &options.scheduler, "selecting a scheduler",
-          "dynamic|fixed"},
+          "dynamic|fixed|stealing"},
         { "timestamps",  0, 0, G_OPTION_ARG_NONE, &options.timestamps, "enable timestamps", NULL },
         { "quiet",     'q', 0, G_OPTION_ARG_NONE, &options.quiet, "be quiet", NULL },
         { "quieter",     0, 0, G_OPTION_ARG_NONE, &options.quieter, "be quieter", NULL },
@@ -19,13 +19,29 @@
 
 #include <string.h>
 #include <math.h>
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
 #include <ufo/ufo.h>
+#include "ufo/ufo-buffer-convert.h"
+#include "ufo/ufo-buffer-reduce.h"
 #include "test-suite.h"
 
+static const UfoBufferDepth depths[] = {
+    UFO_BUFFER_DEPTH_8U, UFO_BUFFER_DEPTH_12U, UFO_BUFFER_DEPTH_16U,
+    UFO_BUFFER_DEPTH_16S, UFO_BUFFER_DEPTH_32S, UFO_BUFFER_DEPTH_32U,
+};
+
+static const gchar *depth_names[] = { "8U", "12U", "16U", "16S", "32S", "32U" };
+
 typedef struct {
     UfoBuffer *buffer;
     guint n_data;
     const guint8 *data8;
+    const guint16 *data12;
     const guint16 *data16;
 } Fixture;
 
@@ -33,6 +49,7 @@ static void
 setup (Fixture *fixture, gconstpointer data)
 {
     static const guint8 data8[8] = { 1, 2, 1, 3, 1, 255, 1, 254 };
+    static const guint16 data12[8] = { 1, 2, 1, 3, 1, 4095, 1, 4094 };
     static const guint16 data16[8] = { 1, 2, 1, 3, 1, 65535, 1, 65534 };
 
     UfoRequisition requisition = {
@@ -42,6 +59,7 @@ setup (Fixture *fixture, gconstpointer data)
 
     fixture->buffer = ufo_buffer_new (&requisition, NULL);
     fixture->data8 = data8;
+    fixture->data12 = data12;
     fixture->data16 = data16;
     fixture->n_data = 8;
 }
@@ -81,6 +99,96 @@ test_convert_8_from_data (Fixture *fixture,
         g_assert (host_data[i] == ((gfloat) fixture->data8[i]));
 }
 
+static void
+test_convert_8_raw (Fixture *fixture,
+                    gconstpointer unused)
+{
+    guint8 *raw_data;
+    gfloat *host_data;
+
+    raw_data = ufo_buffer_get_raw_host_array (fixture->buffer, UFO_BUFFER_DEPTH_8U);
+    memcpy (raw_data, fixture->data8, fixture->n_data);
+    g_assert (ufo_buffer_get_depth (fixture->buffer) == UFO_BUFFER_DEPTH_8U);
+
+    host_data = ufo_buffer_get_host_array (fixture->buffer, NULL);
+    g_assert (ufo_buffer_get_depth (fixture->buffer) == UFO_BUFFER_DEPTH_32F);
+
+    for (guint i = 0; i < fixture->n_data; i++)
+        g_assert (host_data[i] == ((gfloat) fixture->data8[i]));
+}
+
+/*
+ * Pack pairs of 12-bit values into three bytes, most significant bits first.
+ */
+static void
+pack_12 (guint8 *dst, const guint16 *src, guint n)
+{
+    for (guint i = 0; i < n; i += 2) {
+        guint8 *triple = dst + 3 * i / 2;
+
+        triple[0] = src[i] >> 4;
+        triple[1] = ((src[i] & 0x0F) << 4) | (src[i + 1] >> 8);
+        triple[2] = src[i + 1] & 0xFF;
+    }
+}
+
+static void
+test_convert_12_raw (Fixture *fixture,
+                     gconstpointer unused)
+{
+    guint8 *raw_data;
+    gfloat *host_data;
+
+    raw_data = ufo_buffer_get_raw_host_array (fixture->buffer, UFO_BUFFER_DEPTH_12U);
+    pack_12 (raw_data, fixture->data12, fixture->n_data);
+    g_assert (ufo_buffer_get_depth (fixture->buffer) == UFO_BUFFER_DEPTH_12U);
+
+    host_data = ufo_buffer_get_host_array (fixture->buffer, NULL);
+    g_assert (ufo_buffer_get_depth (fixture->buffer) == UFO_BUFFER_DEPTH_32F);
+
+    for (guint i = 0; i < fixture->n_data; i++)
+        g_assert (host_data[i] == ((gfloat) fixture->data12[i]));
+}
+
+static void
+test_convert_16_raw (Fixture *fixture,
+                     gconstpointer unused)
+{
+    guint16 *raw_data;
+    gfloat *host_data;
+
+    raw_data = ufo_buffer_get_raw_host_array (fixture->buffer, UFO_BUFFER_DEPTH_16U);
+    memcpy (raw_data, fixture->data16, fixture->n_data * sizeof (guint16));
+    g_assert (ufo_buffer_get_depth (fixture->buffer) == UFO_BUFFER_DEPTH_16U);
+
+    host_data = ufo_buffer_get_host_array (fixture->buffer, NULL);
+    g_assert (ufo_buffer_get_depth (fixture->buffer) == UFO_BUFFER_DEPTH_32F);
+
+    for (guint i = 0; i < fixture->n_data; i++)
+        g_assert (host_data[i] == ((gfloat) fixture->data16[i]));
+}
+
+static void
+test_statistics (Fixture *fixture,
+                 gconstpointer unused)
+{
+    UfoBufferStatistics stats;
+    guint histogram[2];
+
+    ufo_buffer_convert_from_data (fixture->buffer, fixture->data8, UFO_BUFFER_DEPTH_8U);
+    ufo_buffer_get_statistics (fixture->buffer, NULL, &stats, 2, histogram);
+
+    g_assert (stats.min == 1.0f);
+    g_assert (stats.max == 255.0f);
+    g_assert (stats.sum == 518.0);
+    g_assert (stats.sum_squares == 129558.0);
+    g_assert_cmpuint (histogram[0], ==, 6);
+    g_assert_cmpuint (histogram[1], ==, 2);
+
+    g_assert (ufo_buffer_min (fixture->buffer, NULL) == 1.0f);
+    g_assert (ufo_buffer_max (fixture->buffer, NULL) == 255.0f);
+}
+
 static void
 test_convert_16 (Fixture *fixture,
                  gconstpointer unused)
@@ -167,6 +275,106 @@ test_copy_metadata (Fixture *fixture,
     g_object_unref (copy);
 }
 
+static void
+test_shared_metadata (Fixture *fixture,
+                      gconstpointer unused)
+{
+    GValue value = {0};
+    GValue *other;
+    UfoBuffer *copy;
+    GList *keys;
+
+    UfoRequisition requisition = {
+        .n_dims = 2,
+        .dims[0] = 8,
+        .dims[1] = 8,
+    };
+
+    copy = ufo_buffer_new (&requisition, NULL);
+
+    g_value_init (&value, G_TYPE_STRING);
+    g_value_set_string (&value, "foo");
+    ufo_buffer_set_metadata (fixture->buffer, "name", &value);
+    g_value_unset (&value);
+
+    g_value_init (&value, G_TYPE_INT);
+    g_value_set_int (&value, 1);
+    ufo_buffer_set_metadata (fixture->buffer, "index", &value);
+    ufo_buffer_copy_metadata (fixture->buffer, copy);
+
+    /* Modifying the copy must not affect the source */
+    g_value_set_int (&value, 2);
+    ufo_buffer_set_metadata (copy, "index", &value);
+
+    other = ufo_buffer_get_metadata (fixture->buffer, "index");
+    g_assert (g_value_get_int (other) == 1);
+    other = ufo_buffer_get_metadata (copy, "index");
+    g_assert (g_value_get_int (other) == 2);
+    other = ufo_buffer_get_metadata (copy, "name");
+    g_assert_cmpstr (g_value_get_string (other), ==, "foo");
+
+    keys = ufo_buffer_get_metadata_keys (copy);
+    g_assert (g_list_length (keys) == 2);
+    g_list_free (keys);
+
+    /* Keys only present in the destination are kept */
+    ufo_buffer_set_metadata (copy, "extra", &value);
+    ufo_buffer_copy_metadata (fixture->buffer, copy);
+    other = ufo_buffer_get_metadata (copy, "index");
+    g_assert (g_value_get_int (other) == 1);
+    g_assert (ufo_buffer_get_metadata (copy, "extra") != NULL);
+
+    g_object_unref (copy);
+}
+
+static void
+test_share (Fixture *fixture,
+            gconstpointer unused)
+{
+    UfoBuffer *view;
+    gfloat *data;
+    gfloat *view_data;
+    const gfloat *shared_data;
+
+    UfoRequisition requisition = {
+        .n_dims = 1,
+        .dims[0] = 8,
+    };
+
+    view = ufo_buffer_new (&requisition, NULL);
+    data = ufo_buffer_get_host_array (fixture->buffer, NULL);
+
+    for (guint i = 0; i < fixture->n_data; i++)
+        data[i] = (gfloat) fixture->data8[i];
+
+    ufo_buffer_share (fixture->buffer, view);
+    g_assert (ufo_buffer_is_shared (view));
+
+    /* Reading does not copy */
+    shared_data = ufo_buffer_get_host_array_readonly (view, NULL);
+    g_assert (shared_data == data);
+    g_assert (ufo_buffer_is_shared (view));
+
+    /* Writing does */
+    view_data = ufo_buffer_get_host_array (view, NULL);
+    g_assert (view_data != data);
+    g_assert (!ufo_buffer_is_shared (view));
+
+    for (guint i = 0; i < fixture->n_data; i++)
+        g_assert (view_data[i] == data[i]);
+
+    view_data[0] = -1.0f;
+    g_assert (data[0] == (gfloat) fixture->data8[0]);
+
+    /* Unsharing forgets the data of the source */
+    ufo_buffer_share (fixture->buffer, view);
+    ufo_buffer_unshare (view);
+    g_assert (!ufo_buffer_is_shared (view));
+    g_assert (ufo_buffer_get_location (view) == UFO_BUFFER_LOCATION_INVALID);
+
+    g_object_unref (view);
+}
+
 static void
 test_location (Fixture *fixture,
                gconstpointer unused)
@@ -174,6 +382,656 @@ test_location (Fixture *fixture,
     g_assert (ufo_buffer_get_location (fixture->buffer) == UFO_BUFFER_LOCATION_INVALID);
     ufo_buffer_get_host_array (fixture->buffer, NULL);
     g_assert (ufo_buffer_get_location (fixture->buffer) == UFO_BUFFER_LOCATION_HOST);
+    g_assert (ufo_buffer_is_valid_at (fixture->buffer, UFO_BUFFER_LOCATION_HOST));
+    g_assert (!ufo_buffer_is_valid_at (fixture->buffer, UFO_BUFFER_LOCATION_DEVICE));
+}
+
+static void
+test_location_readonly (Fixture *fixture,
+                        gconstpointer unused)
+{
+    ufo_buffer_get_host_array_readonly (fixture->buffer, NULL);
+    g_assert (ufo_buffer_get_location (fixture->buffer) == UFO_BUFFER_LOCATION_HOST);
+    g_assert (ufo_buffer_is_valid_at (fixture->buffer, UFO_BUFFER_LOCATION_HOST));
+
+    ufo_buffer_discard_location (fixture->buffer);
+    g_assert (ufo_buffer_get_location (fixture->buffer) == UFO_BUFFER_LOCATION_INVALID);
+    g_assert (!ufo_buffer_is_valid_at (fixture->buffer, UFO_BUFFER_LOCATION_HOST));
+}
+
+static void
+test_pool_reuse (Fixture *fixture,
+                 gconstpointer unused)
+{
+    UfoBufferPool *pool;
+    UfoBuffer *buffer;
+    gfloat *host_data;
+    gfloat *old_data;
+    guint64 n_hits;
+    guint64 n_misses;
+
+    UfoRequisition requisition = {
+        .n_dims = 2,
+        .dims[0] = 64,
+        .dims[1] = 64,
+    };
+
+    pool = ufo_buffer_pool_new ();
+    buffer = ufo_buffer_new_from_pool (&requisition, NULL, pool);
+    old_data = ufo_buffer_get_host_array (buffer, NULL);
+    old_data[0] = 1.0f;
+    g_object_unref (buffer);
+
+    /* Slightly smaller buffers fall into the same size class ... */
+    requisition.dims[1] = 63;
+    buffer = ufo_buffer_new_from_pool (&requisition, NULL, pool);
+    host_data = ufo_buffer_get_host_array (buffer, NULL);
+    g_assert (host_data == old_data);
+
+    /* ... and do not see the data of the previous user */
+    g_assert (host_data[0] == 0.0f);
+
+    /* Resizing returns the memory and takes a new one */
+    requisition.dims[1] = 128;
+    ufo_buffer_resize (buffer, &requisition);
+    ufo_buffer_get_host_array (buffer, NULL);
+    g_object_unref (buffer);
+
+    g_object_get (pool, "num-hits", &n_hits, "num-misses", &n_misses, NULL);
+    g_assert_cmpuint (n_hits, ==, 1);
+    g_assert_cmpuint (n_misses, ==, 2);
+
+    g_object_unref (pool);
+}
+
+static void
+test_pool_swap (Fixture *fixture,
+                gconstpointer unused)
+{
+    UfoBufferPool *pools[2];
+    UfoBuffer *buffers[2];
+    gfloat *host_data[2];
+
+    UfoRequisition requisition = {
+        .n_dims = 2,
+        .dims[0] = 64,
+        .dims[1] = 64,
+    };
+
+    for (guint i = 0; i < 2; i++) {
+        pools[i] = ufo_buffer_pool_new ();
+        buffers[i] = ufo_buffer_new_from_pool (&requisition, NULL, pools[i]);
+        host_data[i] = ufo_buffer_get_host_array (buffers[i], NULL);
+    }
+
+    ufo_buffer_swap_data (buffers[0], buffers[1]);
+    g_assert (ufo_buffer_get_host_array (buffers[0], NULL) == host_data[1]);
+    g_assert (ufo_buffer_get_host_array (buffers[1], NULL) == host_data[0]);
+
+    g_object_unref (buffers[0]);
+    g_object_unref (buffers[1]);
+
+    /* Swapped memory still goes back to the pool it came from */
+    for (guint i = 0; i < 2; i++) {
+        buffers[i] = ufo_buffer_new_from_pool (&requisition, NULL, pools[i]);
+        g_assert (ufo_buffer_get_host_array (buffers[i], NULL) == host_data[i]);
+        g_object_unref (buffers[i]);
+        g_object_unref (pools[i]);
+    }
+}
+
+static void
+test_pool_bounded (Fixture *fixture,
+                   gconstpointer unused)
+{
+    UfoBufferPool *pool;
+    UfoBuffer *buffers[2];
+    guint64 cached;
+    guint64 max_cached;
+
+    UfoRequisition requisition = {
+        .n_dims = 2,
+        .dims[0] = 64,
+        .dims[1] = 64,
+    };
+
+    /* Only one of the two released arrays fits */
+    pool = ufo_buffer_pool_new ();
+    g_object_set (pool, "max-cached", (guint64) (64 * 64 * sizeof (gfloat)), NULL);
+
+    for (guint i = 0; i < 2; i++) {
+        buffers[i] = ufo_buffer_new_from_pool (&requisition, NULL, pool);
+        ufo_buffer_get_host_array (buffers[i], NULL);
+    }
+
+    g_object_unref (buffers[0]);
+    g_object_unref (buffers[1]);
+    g_object_get (pool, "cached", &cached, NULL);
+    g_assert_cmpuint (cached, ==, 64 * 64 * sizeof (gfloat));
+    g_object_unref (pool);
+
+    if (g_getenv ("UFO_BUFFER_POOL_SIZE") == NULL) {
+        g_object_get (ufo_buffer_pool_get_default (), "max-cached", &max_cached, NULL);
+        g_assert_cmpuint (max_cached, >, 0);
+    }
+}
+
+static void
+test_mapped_fallback (void)
+{
+    UfoBuffer *buffer;
+    UfoProfiler *profiler;
+    gfloat *host_data;
+    guint64 n_maps;
+
+    UfoRequisition requisition = {
+        .n_dims = 1,
+        .dims[0] = 256,
+    };
+
+    /* Without a context, mapped buffers use regular host memory */
+    profiler = ufo_profiler_new ();
+    ufo_profiler_start (profiler, UFO_PROFILER_TIMER_CPU);
+    buffer = ufo_buffer_new_full (&requisition, NULL, NULL, UFO_BUFFER_MEMORY_MODE_MAPPED);
+    host_data = ufo_buffer_get_host_array (buffer, NULL);
+    host_data[255] = 1.0f;
+    g_assert (ufo_buffer_get_host_array (buffer, NULL)[255] == 1.0f);
+    ufo_profiler_stop (profiler, UFO_PROFILER_TIMER_CPU);
+    ufo_profiler_get_transfers (profiler, UFO_PROFILER_TRANSFER_MAP, &n_maps, NULL);
+    g_assert_cmpuint (n_maps, ==, 0);
+
+    g_object_unref (buffer);
+    g_object_unref (profiler);
+}
+
+static void
+test_convert_impls (void)
+{
+    /* Odd and not a multiple of any SIMD width to exercise the scalar tails */
+    const gsize n_pixels = 1001;
+    guint8 *raw;
+    gfloat *expected;
+    gfloat *result;
+
+    raw = g_malloc (n_pixels * sizeof (gfloat));
+    expected = g_malloc (n_pixels * sizeof (gfloat));
+    result = g_malloc (n_pixels * sizeof (gfloat));
+
+    for (gsize i = 0; i < n_pixels * sizeof (gfloat); i++)
+        raw[i] = (guint8) g_random_int ();
+
+    for (guint d = 0; d < G_N_ELEMENTS (depths); d++) {
+        gsize raw_size = ufo_convert_get_raw_size (n_pixels, depths[d]);
+
+        ufo_convert_data_with_impl (expected, raw, n_pixels, depths[d], UFO_CONVERT_IMPL_SCALAR);
+
+        for (UfoConvertImpl impl = 0; impl < UFO_CONVERT_IMPL_LAST; impl++) {
+            if (!ufo_convert_impl_supported (impl))
+                continue;
+
+            ufo_convert_data_with_impl (result, raw, n_pixels, depths[d], impl);
+            g_assert (memcmp (result, expected, n_pixels * sizeof (gfloat)) == 0);
+
+            /* In-place conversion as done by ufo_buffer_convert() */
+            memcpy (result, raw, raw_size);
+            ufo_convert_data_with_impl (result, result, n_pixels, depths[d], impl);
+            g_assert (memcmp (result, expected, n_pixels * sizeof (gfloat)) == 0);
+        }
+    }
+
+    g_free (raw);
+    g_free (expected);
+    g_free (result);
+}
+
+static cl_int
+get_event_status (cl_event event)
+{
+    cl_int status;
+
+    g_assert (clGetEventInfo (event, CL_EVENT_COMMAND_EXECUTION_STATUS,
+                              sizeof (cl_int), &status, NULL) == CL_SUCCESS);
+    return status;
+}
+
+/*
+ * An upload that waits for a user event must hold back a download enqueued on
+ * another queue, because the buffer chains its pending transfer into the wait
+ * list of the next one.
+ */
+static void
+test_transfers (void)
+{
+    UfoResources *resources;
+    UfoBuffer *buffer;
+    UfoProfiler *profiler;
+    UfoProfiler *other;
+    UfoRequisition requisition = { .n_dims = 1, .dims[0] = 256 };
+    GList *devices;
+    cl_context context;
+    cl_command_queue queue;
+    cl_int errcode;
+    guint64 n_copies;
+    guint64 n_bytes;
+    GError *error = NULL;
+
+    resources = ufo_resources_new (&error);
+
+    if (resources == NULL) {
+        g_error_free (error);
+#if GLIB_CHECK_VERSION (2, 38, 0)
+        g_test_skip ("an OpenCL device is required");
+#endif
+        return;
+    }
+
+    context = ufo_resources_get_context (resources);
+    devices = ufo_resources_get_devices (resources);
+    queue = clCreateCommandQueue (context, devices->data, 0, &errcode);
+    g_assert (errcode == CL_SUCCESS);
+
+    profiler = ufo_profiler_new ();
+    other = ufo_profiler_new ();
+    buffer = ufo_buffer_new (&requisition, context);
+    ufo_buffer_get_host_array (buffer, NULL);
+
+    /* The upload is counted by the profiler whose timer runs */
+    ufo_profiler_start (profiler, UFO_PROFILER_TIMER_CPU);
+    ufo_buffer_get_device_array (buffer, queue);
+    ufo_profiler_stop (profiler, UFO_PROFILER_TIMER_CPU);
+
+    /* ... and nothing outside of a timer */
+    ufo_buffer_get_host_array (buffer, queue);
+
+    ufo_profiler_get_transfers (profiler, UFO_PROFILER_TRANSFER_COPY, &n_copies, &n_bytes);
+    g_assert_cmpuint (n_copies, ==, 1);
+    g_assert_cmpuint (n_bytes, ==, 256 * sizeof (gfloat));
+    ufo_profiler_get_transfers (other, UFO_PROFILER_TRANSFER_COPY, &n_copies, NULL);
+    g_assert_cmpuint (n_copies, ==, 0);
+
+    g_object_unref (buffer);
+    g_object_unref (other);
+    g_object_unref (profiler);
+    clReleaseCommandQueue (queue);
+    g_list_free (devices);
+    g_object_unref (resources);
+}
+
+static void
+test_async_chain (void)
+{
+    UfoResources *resources;
+    UfoBuffer *buffer;
+    UfoRequisition requisition = { .n_dims = 1, .dims[0] = 256 };
+    GList *devices;
+    cl_context context;
+    cl_command_queue queues[2];
+    cl_event user_event;
+    cl_event upload;
+    cl_event download;
+    cl_event current;
+    cl_int errcode;
+    gfloat *host;
+    GError *error = NULL;
+
+    resources = ufo_resources_new (&error);
+
+    if (resources == NULL) {
+        g_error_free (error);
+#if GLIB_CHECK_VERSION (2, 38, 0)
+        g_test_skip ("an OpenCL device is required");
+#endif
+        return;
+    }
+
+    context = ufo_resources_get_context (resources);
+    devices = ufo_resources_get_devices (resources);
+
+    for (guint i = 0; i < 2; i++) {
+        queues[i] = clCreateCommandQueue (context, devices->data, 0, &errcode);
+        g_assert (errcode == CL_SUCCESS);
+    }
+
+    buffer = ufo_buffer_new (&requisition, context);
+    host = ufo_buffer_get_host_array (buffer, NULL);
+
+    for (guint i = 0; i < 256; i++)
+        host[i] = (gfloat) i;
+
+    user_event = clCreateUserEvent (context, &errcode);
+    g_assert (errcode == CL_SUCCESS);
+
+    /* The caller's wait list is passed on to the transfer */
+    ufo_buffer_get_device_array_async (buffer, queues[0], 1, (gpointer *) &user_event, (gpointer *) &upload);
+    g_assert (upload != NULL);
+
+    /* The pending upload ends up in the wait list of the download */
+    host = ufo_buffer_get_host_array_async (buffer, queues[1], 0, NULL, (gpointer *) &download);
+    g_assert (download != NULL && download != upload);
+    clFlush (queues[0]);
+    clFlush (queues[1]);
+    g_usleep (G_USEC_PER_SEC / 100);
+    g_assert (get_event_status (upload) != CL_COMPLETE);
+    g_assert (get_event_status (download) != CL_COMPLETE);
+
+    /* Without a transfer the pending event is handed out */
+    ufo_buffer_get_host_array_async (buffer, queues[1], 0, NULL, (gpointer *) &current);
+    g_assert (current == download);
+    clReleaseEvent (current);
+
+    clSetUserEventStatus (user_event, CL_COMPLETE);
+    g_assert (clWaitForEvents (1, &download) == CL_SUCCESS);
+    g_assert (get_event_status (upload) == CL_COMPLETE);
+
+    for (guint i = 0; i < 256; i++)
+        g_assert (host[i] == (gfloat) i);
+
+    /* Synchronous accessors wait for the pending transfer by themselves */
+    g_assert (ufo_buffer_get_device_array (buffer, queues[0]) != NULL);
+    g_assert (ufo_buffer_get_host_array (buffer, queues[0])[255] == 255.0f);
+
+    clReleaseEvent (upload);
+    clReleaseEvent (download);
+    clReleaseEvent (user_event);
+    g_object_unref (buffer);
+
+    for (guint i = 0; i < 2; i++)
+        clReleaseCommandQueue (queues[i]);
+
+    g_list_free (devices);
+    g_object_unref (resources);
+}
+
+/*
+ * A mapped host array is the device array itself, so making the device array
+ * valid asynchronously must unmap it instead of copying it onto itself.
+ */
+static void
+test_mapped_async (void)
+{
+    UfoResources *resources;
+    UfoBuffer *buffer;
+    UfoProfiler *profiler;
+    UfoRequisition requisition = { .n_dims = 1, .dims[0] = 256 };
+    GList *devices;
+    cl_context context;
+    cl_command_queue queue;
+    cl_event event;
+    cl_int errcode;
+    gfloat *host;
+    guint64 n_copies;
+    guint64 n_maps;
+    GError *error = NULL;
+
+    resources = ufo_resources_new (&error);
+
+    if (resources == NULL) {
+        g_error_free (error);
+#if GLIB_CHECK_VERSION (2, 38, 0)
+        g_test_skip ("an OpenCL device is required");
+#endif
+        return;
+    }
+
+    context = ufo_resources_get_context (resources);
+    devices = ufo_resources_get_devices (resources);
+    queue = clCreateCommandQueue (context, devices->data, 0, &errcode);
+    g_assert (errcode == CL_SUCCESS);
+
+    buffer = ufo_buffer_new_full (&requisition, context, NULL, UFO_BUFFER_MEMORY_MODE_MAPPED);
+    host = ufo_buffer_get_host_array (buffer, queue);
+
+    for (guint i = 0; i < 256; i++)
+        host[i] = (gfloat) i;
+
+    profiler = ufo_profiler_new ();
+    ufo_profiler_start (profiler, UFO_PROFILER_TIMER_CPU);
+    g_assert (ufo_buffer_get_device_array_async (buffer, queue, 0, NULL, (gpointer *) &event) != NULL);
+    ufo_profiler_stop (profiler, UFO_PROFILER_TIMER_CPU);
+
+    if (event != NULL) {
+        g_assert (clWaitForEvents (1, &event) == CL_SUCCESS);
+        clReleaseEvent (event);
+    }
+
+    ufo_profiler_get_transfers (profiler, UFO_PROFILER_TRANSFER_COPY, &n_copies, NULL);
+    ufo_profiler_get_transfers (profiler, UFO_PROFILER_TRANSFER_MAP, &n_maps, NULL);
+    g_assert_cmpuint (n_copies, ==, 0);
+    g_assert_cmpuint (n_maps, ==, 1);
+    g_assert (ufo_buffer_get_location (buffer) == UFO_BUFFER_LOCATION_DEVICE);
+
+    /* Host writes made while mapped survive the unmap */
+    host = ufo_buffer_get_host_array (buffer, queue);
+
+    for (guint i = 0; i < 256; i++)
+        g_assert (host[i] == (gfloat) i);
+
+    g_object_unref (buffer);
+    g_object_unref (profiler);
+    clReleaseCommandQueue (queue);
+    g_list_free (devices);
+    g_object_unref (resources);
+}
+
+/*
+ * Raw data converted with ufo_op_convert_depth() must end up as the same
+ * floats as when converted on the host.
+ */
+static void
+test_convert_on_device (Fixture *fixture,
+                        gconstpointer unused)
+{
+    static const UfoBufferDepth device_depths[] = {
+        UFO_BUFFER_DEPTH_8U, UFO_BUFFER_DEPTH_12U, UFO_BUFFER_DEPTH_16U,
+    };
+
+    UfoResources *resources;
+    UfoRequisition requisition;
+    GList *devices;
+    cl_context context;
+    cl_command_queue queue;
+    cl_int errcode;
+    gpointer kernel;
+    GError *error = NULL;
+
+    resources = ufo_resources_new (&error);
+
+    if (resources == NULL) {
+        g_error_free (error);
+#if GLIB_CHECK_VERSION (2, 38, 0)
+        g_test_skip ("an OpenCL device is required");
+#endif
+        return;
+    }
+
+    /* ufo_op_convert_depth() aborts if it cannot find its kernels */
+    kernel = ufo_resources_get_kernel (resources, "ufo-basic-ops.cl", "convert_8u", NULL, &error);
+
+    if (kernel == NULL) {
+        g_error_free (error);
+#if GLIB_CHECK_VERSION (2, 38, 0)
+        g_test_skip ("ufo-basic-ops.cl is not installed");
+#endif
+        g_object_unref (resources);
+        return;
+    }
+
+    UFO_RESOURCES_CHECK_CLERR (clReleaseKernel (kernel));
+    context = ufo_resources_get_context (resources);
+    devices = ufo_resources_get_devices (resources);
+    queue = clCreateCommandQueue (context, devices->data, 0, &errcode);
+    g_assert (errcode == CL_SUCCESS);
+    ufo_buffer_get_requisition (fixture->buffer, &requisition);
+
+    for (guint d = 0; d < G_N_ELEMENTS (device_depths); d++) {
+        UfoBuffer *buffer;
+        gpointer raw_data;
+        gfloat *host_data;
+
+        buffer = ufo_buffer_new (&requisition, context);
+        raw_data = ufo_buffer_get_raw_host_array (buffer, device_depths[d]);
+
+        if (device_depths[d] == UFO_BUFFER_DEPTH_8U)
+            memcpy (raw_data, fixture->data8, fixture->n_data);
+        else if (device_depths[d] == UFO_BUFFER_DEPTH_12U)
+            pack_12 (raw_data, fixture->data12, fixture->n_data);
+        else
+            memcpy (raw_data, fixture->data16, fixture->n_data * sizeof (guint16));
+
+        ufo_op_convert_depth (buffer, resources, queue);
+        g_assert (ufo_buffer_get_depth (buffer) == UFO_BUFFER_DEPTH_32F);
+        g_assert (ufo_buffer_get_location (buffer) == UFO_BUFFER_LOCATION_DEVICE);
+
+        host_data = ufo_buffer_get_host_array (buffer, queue);
+
+        for (guint i = 0; i < fixture->n_data; i++) {
+            gfloat expected = device_depths[d] == UFO_BUFFER_DEPTH_8U ? fixture->data8[i] :
+                (device_depths[d] == UFO_BUFFER_DEPTH_12U ? fixture->data12[i] : fixture->data16[i]);
+
+            g_assert (host_data[i] == expected);
+        }
+
+        g_object_unref (buffer);
+    }
+
+    clReleaseCommandQueue (queue);
+    g_list_free (devices);
+    g_object_unref (resources);
+}
+
+static void
+test_reduce_nan (void)
+{
+    /* NaN in the first, a middle and the last lane of several vector widths */
+    const gsize positions[] = { 0, 3, 8, 15, 16, 37, 100 };
+    const gsize n = 101;
+    gfloat *data;
+
+    data = g_malloc (n * sizeof (gfloat));
+
+    for (gsize i = 0; i < n; i++)
+        data[i] = (gfloat) i - 50.0f;
+
+    for (guint p = 0; p < G_N_ELEMENTS (positions); p++)
+        data[positions[p]] = NAN;
+
+    for (UfoConvertImpl impl = 0; impl < UFO_CONVERT_IMPL_LAST; impl++) {
+        UfoBufferStatistics expected;
+        UfoBufferStatistics stats;
+        gfloat expected_min, expected_max;
+        gfloat min, max;
+
+        if (!ufo_convert_impl_supported (impl))
+            continue;
+
+        ufo_reduce_min_max_with_impl (data, n, &expected_min, &expected_max, UFO_CONVERT_IMPL_SCALAR);
+        ufo_reduce_min_max_with_impl (data, n, &min, &max, impl);
+        g_assert (expected_min == -49.0f);
+        g_assert (expected_max == 49.0f);
+        g_assert (min == expected_min);
+        g_assert (max == expected_max);
+
+        ufo_reduce_statistics_with_impl (data, n, &expected, UFO_CONVERT_IMPL_SCALAR);
+        ufo_reduce_statistics_with_impl (data, n, &stats, impl);
+        g_assert (stats.min == expected.min);
+        g_assert (stats.max == expected.max);
+    }
+
+    g_free (data);
+}
+
+static gdouble
+measure_conversion (gfloat *dst,
+                    gconstpointer src,
+                    gsize n_pixels,
+                    UfoBufferDepth depth,
+                    gint impl)
+{
+    const guint n_runs = 10;
+    GTimer *timer;
+    gdouble elapsed;
+
+    timer = g_timer_new ();
+
+    for (guint i = 0; i < n_runs; i++) {
+        /* A negative implementation selects the threaded default path */
+        if (impl < 0)
+            ufo_convert_data (dst, src, n_pixels, depth);
+        else
+            ufo_convert_data_with_impl (dst, src, n_pixels, depth, (UfoConvertImpl) impl);
+    }
+
+    elapsed = g_timer_elapsed (timer, NULL) / n_runs;
+    g_timer_destroy (timer);
+
+    return n_pixels * sizeof (gfloat) / elapsed / 1e9;
+}
+
+static void
+test_convert_rate (void)
+{
+    const gsize n_pixels = 4096 * 4096;
+    UfoConvertImpl best;
+    gpointer raw;
+    gfloat *result;
+
+    best = ufo_convert_get_impl ();
+    raw = g_malloc0 (n_pixels * sizeof (gfloat));
+    result = g_malloc0 (n_pixels * sizeof (gfloat));
+
+    for (guint d = 0; d < G_N_ELEMENTS (depths); d++) {
+        gdouble scalar, simd, threaded;
+
+        scalar = measure_conversion (result, raw, n_pixels, depths[d], UFO_CONVERT_IMPL_SCALAR);
+        simd = measure_conversion (result, raw, n_pixels, depths[d], best);
+        threaded = measure_conversion (result, raw, n_pixels, depths[d], -1);
+
+        g_test_maximized_result (simd,
+                                 "%s: scalar %.2f GB/s, %s %.2f GB/s, threaded %.2f GB/s",
+                                 depth_names[d], scalar,
+                                 ufo_convert_impl_get_name (best), simd, threaded);
+    }
+
+    g_free (raw);
+    g_free (result);
+}
+
+static void
+test_pool_size_class (void)
+{
+    g_assert_cmpuint (ufo_buffer_pool_get_size_class (1), ==, 1);
+    g_assert_cmpuint (ufo_buffer_pool_get_size_class (1000), ==, 1024);
+    g_assert_cmpuint (ufo_buffer_pool_get_size_class (4096), ==, 4096);
+
+    for (gsize size = 4097; size < (1 << 20); size += 4093) {
+        gsize size_class = ufo_buffer_pool_get_size_class (size);
+
+        g_assert_cmpuint (size_class, >=, size);
+        g_assert_cmpuint (size_class, <=, size + size / 4);
+    }
+}
+
+static void
+test_cmp_dimensions (void)
+{
+    UfoRequisition requisition = { .n_dims = 2, .dims[0] = 64, .dims[1] = 32 };
+    UfoRequisition transposed = { .n_dims = 2, .dims[0] = 32, .dims[1] = 64 };
+    UfoRequisition larger = { .n_dims = 3, .dims[0] = 64, .dims[1] = 32, .dims[2] = 2 };
+    UfoRequisition result;
+    UfoBuffer *buffer;
+
+    buffer = ufo_buffer_new (&requisition, NULL);
+
+    g_assert_cmpint (ufo_buffer_cmp_dimensions (buffer, &requisition), ==, 0);
+    g_assert_cmpint (ufo_buffer_cmp_dimensions (buffer, &transposed), !=, 0);
+    g_assert_cmpint (ufo_buffer_cmp_dimensions (buffer, &larger), >, 0);
+
+    ufo_buffer_resize (buffer, &transposed);
+    ufo_buffer_get_requisition (buffer, &result);
+    g_assert_cmpuint (result.dims[0], ==, 32);
+    g_assert_cmpuint (result.dims[1], ==, 64);
+
+    g_object_unref (buffer);
 }
 
 void
@@ -187,6 +1045,14 @@ test_add_buffer (void)
                 Fixture, NULL,
                 setup, test_convert_8_from_data, teardown);
 
+    g_test_add ("/no-opencl/buffer/convert/8/raw",
+                Fixture, NULL,
+                setup, test_convert_8_raw, teardown);
+
+    g_test_add ("/no-opencl/buffer/convert/12/raw",
+                Fixture, NULL,
+                setup, test_convert_12_raw, teardown);
+
     g_test_add ("/no-opencl/buffer/convert/16/host",
                 Fixture, NULL,
                 setup, test_convert_16, teardown);
@@ -195,6 +1061,18 @@ test_add_buffer (void)
                 Fixture, NULL,
                 setup, test_convert_16_from_data, teardown);
 
+    g_test_add ("/no-opencl/buffer/convert/16/raw",
+                Fixture, NULL,
+                setup, test_convert_16_raw, teardown);
+
+    g_test_add ("/opencl/buffer/convert/device",
+                Fixture, NULL,
+                setup, test_convert_on_device, teardown);
+
+    g_test_add ("/no-opencl/buffer/statistics",
+                Fixture, NULL,
+                setup, test_statistics, teardown);
+
     g_test_add ("/no-opencl/buffer/metadata/insert",
                 Fixture, NULL,
                 setup, test_insert_metadata, teardown);
@@ -203,7 +1081,59 @@ test_add_buffer (void)
                 Fixture, NULL,
                 setup, test_copy_metadata, teardown);
 
+    g_test_add ("/no-opencl/buffer/metadata/shared",
+                Fixture, NULL,
+                setup, test_shared_metadata, teardown);
+
+    g_test_add ("/no-opencl/buffer/share",
+                Fixture, NULL,
+                setup, test_share, teardown);
+
     g_test_add ("/no-opencl/buffer/location",
                 Fixture, NULL,
                 setup, test_location, teardown);
+
+    g_test_add ("/no-opencl/buffer/location/readonly",
+                Fixture, NULL,
+                setup, test_location_readonly, teardown);
+
+    g_test_add ("/no-opencl/buffer/pool/reuse",
+                Fixture, NULL,
+                setup, test_pool_reuse, teardown);
+
+    g_test_add ("/no-opencl/buffer/pool/swap",
+                Fixture, NULL,
+                setup, test_pool_swap, teardown);
+
+    g_test_add ("/no-opencl/buffer/pool/bounded",
+                Fixture, NULL,
+                setup, test_pool_bounded, teardown);
+
+    g_test_add_func ("/no-opencl/buffer/pool/size-class",
+                     test_pool_size_class);
+
+    g_test_add_func ("/no-opencl/buffer/mapped/fallback",
+                     test_mapped_fallback);
+
+    g_test_add_func ("/no-opencl/buffer/convert/impls",
+                     test_convert_impls);
+
+    g_test_add_func ("/opencl/buffer/async/chain",
+                     test_async_chain);
+
+    g_test_add_func ("/opencl/buffer/mapped/async",
+                     test_mapped_async);
+
+    g_test_add_func ("/opencl/buffer/transfers",
+                     test_transfers);
+
+    g_test_add_func ("/no-opencl/buffer/reduce/nan",
+                     test_reduce_nan);
+
+    g_test_add_func ("/no-opencl/buffer/cmp-dimensions",
+                     test_cmp_dimensions);
+
+    if (g_test_perf ())
+        g_test_add_func ("/no-opencl/buffer/convert/rate",
+                         test_convert_rate);
 }
@@ -293,6 +293,38 @@ test_get_nodes_filtered (Fixture *fixture, gconstpointer data)
     g_list_free (nodes);
 }
 
+static void
+test_ports (Fixture *fixture, gconstpointer data)
+{
+    UfoTaskGraph *graph;
+    UfoTaskNode *source;
+    UfoTaskNode *first;
+    UfoTaskNode *second;
+    guint output;
+    guint input;
+
+    graph = UFO_TASK_GRAPH (ufo_task_graph_new ());
+    source = UFO_TASK_NODE (ufo_dummy_task_new ());
+    first = UFO_TASK_NODE (ufo_dummy_task_new ());
+    second = UFO_TASK_NODE (ufo_dummy_task_new ());
+
+    ufo_task_graph_connect_nodes_full (graph, source, first, 2);
+    ufo_task_graph_connect_ports (graph, source, 1, second, 3);
+
+    ufo_task_graph_get_ports (graph, source, first, &output, &input);
+    g_assert_cmpuint (output, ==, 0);
+    g_assert_cmpuint (input, ==, 2);
+
+    ufo_task_graph_get_ports (graph, source, second, &output, &input);
+    g_assert_cmpuint (output, ==, 1);
+    g_assert_cmpuint (input, ==, 3);
+
+    g_object_unref (graph);
+    g_object_unref (source);
+    g_object_unref (first);
+    g_object_unref (second);
+}
+
 void
 test_add_graph (void)
 {
@@ -310,6 +342,7 @@ test_add_graph (void)
         { "/no-opencl/graph/edges/remove",            test_remove_edge },
         { "/no-opencl/graph/labels",                  test_get_labels },
         { "/no-opencl/graph/expansion",               test_expansion },
+        { "/no-opencl/graph/ports",                   test_ports },
         { NULL, NULL }
     };
 
@@ -143,7 +143,59 @@ static void test_max_inputs() {
     }
 }
 
+/**
+ * Runs UFO_MAX_INPUT_NODES dummy-data inputs into one opencl-node with the
+ * work-stealing scheduler, which wakes the node from every input.
+ */
+static void test_max_inputs_stealing() {
+    UfoTaskGraph *graph;
+    UfoBaseScheduler *scheduler;
+    UfoPluginManager *manager;
+    GError *error = nullptr;
+
+    graph = UFO_TASK_GRAPH(ufo_task_graph_new());
+    manager = ufo_plugin_manager_new();
+    scheduler = ufo_stealing_scheduler_new();
+
+    auto opencl_kernel = ufo_plugin_manager_get_task(manager, "opencl", nullptr);
+    auto sink = ufo_plugin_manager_get_task(manager, "null", nullptr);
+    if (opencl_kernel == nullptr || sink == nullptr) {
+        std::cout << "This test requires ufo-filters." << std::endl;
+        g_assert(false);
+    }
+    g_object_set (G_OBJECT (opencl_kernel),
+                  "source", build_kernel(UFO_MAX_INPUT_NODES).c_str(),
+                  "kernel", "test_input",
+                  NULL);
+
+    std::vector<UfoTaskNode *> readers(UFO_MAX_INPUT_NODES);
+    for (std::size_t i = 0; i < readers.size(); ++i) {
+        readers[i] = ufo_plugin_manager_get_task(manager, "dummy-data", nullptr);
+        g_assert(readers[i] != nullptr);
+        g_object_set (G_OBJECT (readers[i]),
+                      "width", 256,
+                      "height", 256,
+                      "number", 100,
+                      NULL);
+        ufo_task_graph_connect_nodes_full(graph, readers[i], opencl_kernel, i);
+    }
+
+    ufo_task_graph_connect_nodes(graph, opencl_kernel, sink);
+    ufo_base_scheduler_run(scheduler, graph, &error);
+    g_assert_no_error(error);
+
+    for (const auto& reader: readers) {
+        g_object_unref(reader);
+    }
+    g_object_unref(graph);
+    g_object_unref(scheduler);
+    g_object_unref(manager);
+    g_object_unref(opencl_kernel);
+    g_object_unref(sink);
+}
+
 
 extern "C" void test_add_max_input_nodes(void) {
         g_test_add_func("/no-opencl/scheduler/max_input_nodes", test_max_inputs);
+        g_test_add_func("/no-opencl/scheduler/stealing/max_input_nodes", test_max_inputs_stealing);
 }
@@ -55,6 +55,221 @@ test_copy (void)
     g_object_unref (copy);
 }
 
+static void
+test_cpu_discover (void)
+{
+    GList *numa_nodes;
+    GList *cores;
+    GList *it;
+
+    g_assert (ufo_cpu_node_discover (UFO_CPU_PLACEMENT_NONE) == NULL);
+
+    numa_nodes = ufo_cpu_node_discover (UFO_CPU_PLACEMENT_NUMA);
+    cores = ufo_cpu_node_discover (UFO_CPU_PLACEMENT_CORE);
+
+#ifdef __linux__
+    g_assert (numa_nodes != NULL);
+    g_assert_cmpuint (g_list_length (cores), >=, g_list_length (numa_nodes));
+#endif
+
+    for (it = cores; it != NULL; it = g_list_next (it)) {
+        gchar *cpus;
+
+        cpus = ufo_cpu_node_get_cpu_list (UFO_CPU_NODE (it->data));
+        g_assert (cpus != NULL && cpus[0] != '\0');
+        g_free (cpus);
+    }
+
+    /* A single NUMA node covers all processors, so we can restore affinity */
+    if (g_list_length (numa_nodes) == 1) {
+        g_assert (ufo_cpu_node_bind (UFO_CPU_NODE (cores->data)));
+        g_assert (ufo_cpu_node_bind (UFO_CPU_NODE (numa_nodes->data)));
+    }
+
+    g_list_free_full (numa_nodes, g_object_unref);
+    g_list_free_full (cores, g_object_unref);
+}
+
+static guint
+get_numa_node (UfoTaskNode *node)
+{
+    return ufo_cpu_node_get_numa_node (UFO_CPU_NODE (ufo_task_node_get_cpu_node (node)));
+}
+
+static void
+test_cpu_map (void)
+{
+    UfoTaskGraph *graph;
+    UfoTaskNode *nodes[4];
+    GList *discovered;
+    GList *cpu_nodes = NULL;
+    gpointer mask;
+
+    discovered = ufo_cpu_node_discover (UFO_CPU_PLACEMENT_NUMA);
+
+    if (discovered == NULL)
+        return;
+
+    /* Pretend there are two NUMA nodes */
+    mask = ufo_cpu_node_get_affinity (UFO_CPU_NODE (discovered->data));
+    cpu_nodes = g_list_append (cpu_nodes, ufo_cpu_node_new_full (mask, 0));
+    cpu_nodes = g_list_append (cpu_nodes, ufo_cpu_node_new_full (mask, 1));
+
+    graph = UFO_TASK_GRAPH (ufo_task_graph_new ());
+
+    for (guint i = 0; i < 4; i++)
+        nodes[i] = UFO_TASK_NODE (ufo_dummy_task_new ());
+
+    g_object_set (nodes[0], "numa-node", 1, NULL);
+    ufo_task_graph_connect_nodes (graph, nodes[0], nodes[1]);
+    ufo_task_graph_connect_nodes (graph, nodes[2], nodes[3]);
+    ufo_task_graph_map_cpus (graph, cpu_nodes);
+
+    g_assert_cmpuint (get_numa_node (nodes[0]), ==, 1);
+    g_assert_cmpuint (get_numa_node (nodes[1]), ==, 1);
+    g_assert_cmpuint (get_numa_node (nodes[2]), ==, get_numa_node (nodes[3]));
+
+    for (guint i = 0; i < 4; i++) {
+        ufo_task_node_reset (nodes[i]);
+        g_assert (ufo_task_node_get_cpu_node (nodes[i]) == NULL);
+        g_object_unref (nodes[i]);
+    }
+
+    g_object_unref (graph);
+    g_list_free_full (cpu_nodes, g_object_unref);
+    g_list_free_full (discovered, g_object_unref);
+}
+
+/*
+ * Create a GPU node for the first device of @resources with the queues set in
+ * UFO_GPU_QUEUES, NULL if there is no OpenCL device.
+ */
+static UfoGpuNode *
+new_gpu_node (UfoResources **resources,
+              const gchar *queues)
+{
+    UfoNode *node;
+    GList *devices;
+    GError *error = NULL;
+
+    *resources = ufo_resources_new (&error);
+
+    if (*resources == NULL) {
+        g_error_free (error);
+#if GLIB_CHECK_VERSION (2, 38, 0)
+        g_test_skip ("an OpenCL device is required");
+#endif
+        return NULL;
+    }
+
+    g_setenv ("UFO_GPU_QUEUES", queues, TRUE);
+    devices = ufo_resources_get_devices (*resources);
+    node = ufo_gpu_node_new (ufo_resources_get_context (*resources), devices->data);
+    g_unsetenv ("UFO_GPU_QUEUES");
+    g_list_free (devices);
+
+    return UFO_GPU_NODE (node);
+}
+
+static void
+test_gpu_queues (void)
+{
+    UfoResources *resources;
+    UfoGpuNode *node;
+
+    /* Compute queues are clamped to at least one */
+    node = new_gpu_node (&resources, "0");
+
+    if (node == NULL)
+        return;
+
+    g_assert_cmpuint (ufo_gpu_node_get_num_cmd_queues (node), ==, 1);
+    g_object_unref (node);
+    g_object_unref (resources);
+
+    /* Defaults for an empty variable */
+    node = new_gpu_node (&resources, "");
+    g_assert_cmpuint (ufo_gpu_node_get_num_cmd_queues (node), ==, 2);
+    g_assert (ufo_gpu_node_get_nth_transfer_queue (node, 0) == ufo_gpu_node_get_nth_transfer_queue (node, 1));
+    g_assert (ufo_gpu_node_get_nth_transfer_queue (node, 0) != ufo_gpu_node_get_nth_cmd_queue (node, 0));
+    g_object_unref (node);
+    g_object_unref (resources);
+
+    node = new_gpu_node (&resources, "3,2");
+    g_assert_cmpuint (ufo_gpu_node_get_num_cmd_queues (node), ==, 3);
+    g_assert (ufo_gpu_node_get_cmd_queue (node) == ufo_gpu_node_get_nth_cmd_queue (node, 0));
+    g_assert (ufo_gpu_node_get_nth_cmd_queue (node, 0) != ufo_gpu_node_get_nth_cmd_queue (node, 1));
+    g_assert (ufo_gpu_node_get_nth_cmd_queue (node, 0) == ufo_gpu_node_get_nth_cmd_queue (node, 3));
+    g_assert (ufo_gpu_node_get_nth_transfer_queue (node, 0) != ufo_gpu_node_get_nth_transfer_queue (node, 1));
+    g_assert (ufo_gpu_node_get_nth_transfer_queue (node, 0) == ufo_gpu_node_get_nth_transfer_queue (node, 2));
+    g_object_unref (node);
+    g_object_unref (resources);
+}
+
+static void
+test_gpu_task_queues (void)
+{
+    UfoResources *resources;
+    UfoGpuNode *node;
+    UfoTaskNode *tasks[2];
+
+    node = new_gpu_node (&resources, "2,1");
+
+    if (node == NULL)
+        return;
+
+    for (guint i = 0; i < 2; i++) {
+        tasks[i] = UFO_TASK_NODE (ufo_dummy_task_new ());
+        g_assert (ufo_task_node_get_cmd_queue (tasks[i]) == NULL);
+        g_assert (ufo_task_node_get_transfer_queue (tasks[i]) == NULL);
+        ufo_task_node_set_proc_node (tasks[i], UFO_NODE (node));
+    }
+
+    /* Tasks on the same device get different compute but a shared transfer queue */
+    g_assert (ufo_task_node_get_cmd_queue (tasks[0]) != ufo_task_node_get_cmd_queue (tasks[1]));
+    g_assert (ufo_task_node_get_transfer_queue (tasks[0]) == ufo_task_node_get_transfer_queue (tasks[1]));
+    g_assert (ufo_task_node_get_transfer_queue (tasks[0]) != ufo_task_node_get_cmd_queue (tasks[0]));
+
+    /* Setting the same node again keeps the assigned queue */
+    ufo_task_node_set_proc_node (tasks[0], UFO_NODE (node));
+    g_assert (ufo_task_node_get_cmd_queue (tasks[0]) == ufo_gpu_node_get_nth_cmd_queue (node, 0));
+
+    for (guint i = 0; i < 2; i++)
+        g_object_unref (tasks[i]);
+
+    g_object_unref (node);
+    g_object_unref (resources);
+}
+
+static void
+test_gpu_single_queue (void)
+{
+    UfoResources *resources;
+    UfoGpuNode *node;
+    UfoTaskNode *tasks[2];
+
+    /* Everything of a device is serialized on one queue */
+    node = new_gpu_node (&resources, "1,0");
+
+    if (node == NULL)
+        return;
+
+    g_assert_cmpuint (ufo_gpu_node_get_num_cmd_queues (node), ==, 1);
+
+    for (guint i = 0; i < 2; i++) {
+        tasks[i] = UFO_TASK_NODE (ufo_dummy_task_new ());
+        ufo_task_node_set_proc_node (tasks[i], UFO_NODE (node));
+        g_assert (ufo_task_node_get_cmd_queue (tasks[i]) == ufo_gpu_node_get_cmd_queue (node));
+        g_assert (ufo_task_node_get_transfer_queue (tasks[i]) == ufo_gpu_node_get_cmd_queue (node));
+    }
+
+    for (guint i = 0; i < 2; i++)
+        g_object_unref (tasks[i]);
+
+    g_object_unref (node);
+    g_object_unref (resources);
+}
+
 void
 test_add_node (void)
 {
@@ -63,4 +278,19 @@ test_add_node (void)
 
     g_test_add_func ("/no-opencl/node/copy",
                      test_copy);
+
+    g_test_add_func ("/no-opencl/node/cpu/discover",
+                     test_cpu_discover);
+
+    g_test_add_func ("/no-opencl/node/cpu/map",
+                     test_cpu_map);
+
+    g_test_add_func ("/opencl/node/gpu/queues",
+                     test_gpu_queues);
+
+    g_test_add_func ("/opencl/node/gpu/task-queues",
+                     test_gpu_task_queues);
+
+    g_test_add_func ("/opencl/node/gpu/single-queue",
+                     test_gpu_single_queue);
 }
@@ -0,0 +1,441 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ufo/ufo.h>
+#include "test-suite.h"
+
+#define POISON_PILL ((gpointer) 0x1)
+
+typedef struct {
+    UfoTwoWayQueue *queue;
+    guint n_items;
+} Fixture;
+
+static void
+setup_async (Fixture *fixture, gconstpointer data)
+{
+    fixture->queue = ufo_two_way_queue_new_full (NULL, UFO_TWO_WAY_QUEUE_BACKEND_ASYNC, 2);
+    fixture->n_items = g_test_perf () ? 1000000 : 10000;
+}
+
+static void
+setup_ring (Fixture *fixture, gconstpointer data)
+{
+    fixture->queue = ufo_two_way_queue_new_full (NULL, UFO_TWO_WAY_QUEUE_BACKEND_RING, 2);
+    fixture->n_items = g_test_perf () ? 1000000 : 10000;
+}
+
+static void
+teardown (Fixture *fixture, gconstpointer data)
+{
+    ufo_two_way_queue_free (fixture->queue);
+}
+
+static gpointer
+consume (Fixture *fixture)
+{
+    guint n_consumed = 0;
+
+    while (1) {
+        gpointer item;
+
+        item = ufo_two_way_queue_consumer_pop (fixture->queue);
+
+        if (item == POISON_PILL)
+            break;
+
+        ufo_two_way_queue_consumer_push (fixture->queue, item);
+        n_consumed++;
+    }
+
+    return GUINT_TO_POINTER (n_consumed);
+}
+
+static guint
+transfer (Fixture *fixture)
+{
+    GThread *consumer;
+    static gint items[2];
+
+    ufo_two_way_queue_insert (fixture->queue, &items[0]);
+    ufo_two_way_queue_insert (fixture->queue, &items[1]);
+
+    consumer = g_thread_new (NULL, (GThreadFunc) consume, fixture);
+
+    for (guint i = 0; i < fixture->n_items; i++) {
+        gpointer item;
+
+        item = ufo_two_way_queue_producer_pop (fixture->queue);
+        g_assert (item == &items[0] || item == &items[1]);
+        ufo_two_way_queue_producer_push (fixture->queue, item);
+    }
+
+    ufo_two_way_queue_producer_push (fixture->queue, POISON_PILL);
+    return GPOINTER_TO_UINT (g_thread_join (consumer));
+}
+
+static void
+test_insert (Fixture *fixture, gconstpointer data)
+{
+    static gint items[3];
+
+    for (guint i = 0; i < 2; i++)
+        ufo_two_way_queue_insert (fixture->queue, &items[i]);
+
+    g_assert_cmpuint (ufo_two_way_queue_get_capacity (fixture->queue), ==, 2);
+    g_assert_cmpuint (g_list_length (ufo_two_way_queue_get_inserted (fixture->queue)), ==, 2);
+
+    /* Inserted items are available to the producer in insertion order */
+    g_assert (ufo_two_way_queue_producer_pop (fixture->queue) == &items[0]);
+    g_assert (ufo_two_way_queue_producer_pop (fixture->queue) == &items[1]);
+
+    ufo_two_way_queue_producer_push (fixture->queue, &items[1]);
+    g_assert (ufo_two_way_queue_consumer_pop (fixture->queue) == &items[1]);
+}
+
+static void
+test_try_pop (Fixture *fixture, gconstpointer data)
+{
+    static gint item;
+
+    g_assert (ufo_two_way_queue_producer_try_pop (fixture->queue) == NULL);
+    g_assert (ufo_two_way_queue_consumer_try_pop (fixture->queue) == NULL);
+
+    ufo_two_way_queue_insert (fixture->queue, &item);
+    g_assert (ufo_two_way_queue_consumer_try_pop (fixture->queue) == NULL);
+    g_assert (ufo_two_way_queue_producer_try_pop (fixture->queue) == &item);
+
+    ufo_two_way_queue_producer_push (fixture->queue, &item);
+    g_assert (ufo_two_way_queue_producer_try_pop (fixture->queue) == NULL);
+    g_assert (ufo_two_way_queue_consumer_try_pop (fixture->queue) == &item);
+}
+
+static gpointer
+overfill (Fixture *fixture)
+{
+    static gint items[16];
+
+    for (guint i = 0; i < G_N_ELEMENTS (items); i++)
+        ufo_two_way_queue_producer_push (fixture->queue, &items[i]);
+
+    return items;
+}
+
+static void
+test_overfill (Fixture *fixture, gconstpointer data)
+{
+    GThread *producer;
+    gint *items;
+    gpointer popped[16];
+
+    /* Pushing more than announced must wait for room instead of failing */
+    producer = g_thread_new (NULL, (GThreadFunc) overfill, fixture);
+    g_usleep (G_USEC_PER_SEC / 100);
+
+    for (guint i = 0; i < G_N_ELEMENTS (popped); i++)
+        popped[i] = ufo_two_way_queue_consumer_pop (fixture->queue);
+
+    items = g_thread_join (producer);
+
+    for (guint i = 0; i < G_N_ELEMENTS (popped); i++)
+        g_assert (popped[i] == &items[i]);
+}
+
+static void
+test_transfer (Fixture *fixture, gconstpointer data)
+{
+    g_assert_cmpuint (transfer (fixture), ==, fixture->n_items);
+}
+
+static void
+test_transfer_rate (Fixture *fixture, gconstpointer data)
+{
+    GTimer *timer;
+    gdouble elapsed;
+
+    timer = g_timer_new ();
+    g_assert_cmpuint (transfer (fixture), ==, fixture->n_items);
+    elapsed = g_timer_elapsed (timer, NULL);
+    g_timer_destroy (timer);
+
+    g_test_maximized_result (fixture->n_items / elapsed,
+                             "%s: %.0f transfers/s",
+                             ufo_two_way_queue_get_backend (fixture->queue) == UFO_TWO_WAY_QUEUE_BACKEND_RING ? "ring" : "async",
+                             fixture->n_items / elapsed);
+}
+
+static void
+test_group_forward (void)
+{
+    UfoRequisition requisition = { .n_dims = 1, .dims[0] = 16 };
+    UfoNode *producer;
+    UfoNode *consumer;
+    UfoGroup *origin;
+    UfoGroup *group;
+    UfoBuffer *buffer;
+    UfoBuffer *other;
+    GList *targets;
+
+    producer = ufo_dummy_task_new ();
+    consumer = ufo_dummy_task_new ();
+
+    targets = g_list_append (NULL, producer);
+    origin = ufo_group_new (targets, NULL, UFO_SEND_SCATTER);
+    g_list_free (targets);
+
+    targets = g_list_append (NULL, consumer);
+    group = ufo_group_new (targets, NULL, UFO_SEND_SCATTER);
+    g_list_free (targets);
+
+    /* Allocate all buffers of origin and send one of them */
+    buffer = ufo_group_pop_output_buffer (origin, &requisition);
+    other = ufo_group_pop_output_buffer (origin, &requisition);
+    ufo_group_return_output_buffer (origin, other);
+    ufo_group_push_output_buffer (origin, buffer);
+
+    g_assert (ufo_group_pop_input_buffer (origin, UFO_TASK (producer)) == buffer);
+    ufo_group_push_forwarded_buffer (group, buffer, origin, UFO_TASK (producer));
+    g_assert (ufo_group_pop_input_buffer (group, UFO_TASK (consumer)) == buffer);
+
+    g_assert (ufo_group_try_pop_output_buffer (origin, &requisition) == other);
+    g_assert (ufo_group_try_pop_output_buffer (origin, &requisition) == NULL);
+
+    /* Releasing it downstream must give it back to origin */
+    ufo_group_push_input_buffer (group, UFO_TASK (consumer), buffer);
+    g_assert (ufo_group_try_pop_output_buffer (origin, &requisition) == buffer);
+
+    g_object_unref (group);
+    g_object_unref (origin);
+    g_object_unref (consumer);
+    g_object_unref (producer);
+}
+
+static void
+test_group_scatter_batch (void)
+{
+    UfoRequisition requisition = { .n_dims = 1, .dims[0] = 16 };
+    UfoBuffer *outputs[4];
+    UfoNode *consumers[2];
+    UfoGroup *group;
+    GList *targets = NULL;
+
+    for (guint i = 0; i < 2; i++) {
+        consumers[i] = ufo_dummy_task_new ();
+        targets = g_list_append (targets, consumers[i]);
+    }
+
+    group = ufo_group_new (targets, NULL, UFO_SEND_SCATTER);
+    ufo_group_set_batch_size (group, 4);
+    g_list_free (targets);
+
+    /* Buffers must not drift between the queues of the targets */
+    for (guint round = 0; round < 8; round++) {
+        for (guint i = 0; i < 4; i++) {
+            outputs[i] = ufo_group_try_pop_output_buffer (group, &requisition);
+            g_assert (outputs[i] != NULL);
+        }
+
+        for (guint i = 0; i < 4; i++)
+            ufo_group_push_output_buffer (group, outputs[i]);
+
+        for (guint i = 0; i < 4; i++) {
+            UfoTask *target = UFO_TASK (consumers[i % 2]);
+            UfoBuffer *input = ufo_group_pop_input_buffer (group, target);
+
+            g_assert (input == outputs[i]);
+            ufo_group_push_input_buffer (group, target, input);
+        }
+    }
+
+    /* Unused buffers go back to their own target */
+    outputs[0] = ufo_group_pop_output_buffer (group, &requisition);
+    outputs[1] = ufo_group_pop_output_buffer (group, &requisition);
+    ufo_group_return_output_buffer (group, outputs[1]);
+    ufo_group_push_output_buffer (group, outputs[0]);
+    g_assert (ufo_group_pop_input_buffer (group, UFO_TASK (consumers[0])) == outputs[0]);
+    ufo_group_push_input_buffer (group, UFO_TASK (consumers[0]), outputs[0]);
+    g_assert (ufo_group_pop_output_buffer (group, &requisition) != NULL);
+
+    g_object_unref (group);
+    g_object_unref (consumers[0]);
+    g_object_unref (consumers[1]);
+}
+
+static void
+test_group_broadcast (void)
+{
+    UfoRequisition requisition = { .n_dims = 1, .dims[0] = 16 };
+    UfoNode *consumers[2];
+    UfoBuffer *inputs[2];
+    UfoBuffer *others[2];
+    UfoBuffer *buffer;
+    UfoGroup *group;
+    GList *targets = NULL;
+    gfloat *data;
+    gfloat *written;
+
+    for (guint i = 0; i < 2; i++) {
+        consumers[i] = ufo_dummy_task_new ();
+        targets = g_list_append (targets, consumers[i]);
+    }
+
+    group = ufo_group_new (targets, NULL, UFO_SEND_BROADCAST);
+    ufo_group_preallocate (group, &requisition);
+    g_list_free (targets);
+
+    buffer = ufo_group_pop_output_buffer (group, &requisition);
+    data = ufo_buffer_get_host_array (buffer, NULL);
+
+    for (guint i = 0; i < 16; i++)
+        data[i] = (gfloat) i;
+
+    ufo_group_push_output_buffer (group, buffer);
+
+    /* Both targets read the data of the producer without a copy */
+    for (guint i = 0; i < 2; i++) {
+        inputs[i] = ufo_group_pop_input_buffer (group, UFO_TASK (consumers[i]));
+        g_assert (inputs[i] != buffer);
+        g_assert (ufo_buffer_is_shared (inputs[i]));
+        g_assert (ufo_buffer_get_host_array_readonly (inputs[i], NULL) == data);
+    }
+
+    /* Writing copies the data for this target only */
+    written = ufo_buffer_get_host_array (inputs[0], NULL);
+    g_assert (written != data);
+    g_assert (!ufo_buffer_is_shared (inputs[0]));
+    g_assert (written[1] == 1.0f);
+    written[1] = -1.0f;
+
+    g_assert (data[1] == 1.0f);
+    g_assert (ufo_buffer_is_shared (inputs[1]));
+    g_assert (((const gfloat *) ufo_buffer_get_host_array_readonly (inputs[1], NULL))[1] == 1.0f);
+
+    /* The producer gets its buffer back once the last target released it */
+    for (guint i = 0; i < 2; i++) {
+        others[i] = ufo_group_try_pop_output_buffer (group, &requisition);
+        g_assert (others[i] != NULL);
+    }
+
+    ufo_group_push_input_buffer (group, UFO_TASK (consumers[0]), inputs[0]);
+    g_assert (ufo_group_try_pop_output_buffer (group, &requisition) == NULL);
+
+    ufo_group_push_input_buffer (group, UFO_TASK (consumers[1]), inputs[1]);
+    g_assert (ufo_group_try_pop_output_buffer (group, &requisition) == buffer);
+
+    ufo_group_return_output_buffer (group, buffer);
+    ufo_group_return_output_buffer (group, others[1]);
+    ufo_group_return_output_buffer (group, others[0]);
+
+    g_object_unref (group);
+    g_object_unref (consumers[0]);
+    g_object_unref (consumers[1]);
+}
+
+static void
+test_group_preallocate (void)
+{
+    UfoRequisition requisition = { .n_dims = 2, .dims[0] = 16, .dims[1] = 8 };
+    UfoRequisition result;
+    UfoNode *consumer;
+    UfoGroup *group;
+    UfoBuffer *buffer;
+    UfoBuffer *other;
+    GList *targets;
+
+    consumer = ufo_dummy_task_new ();
+    targets = g_list_append (NULL, consumer);
+    group = ufo_group_new (targets, NULL, UFO_SEND_SCATTER);
+    g_list_free (targets);
+
+    /* All buffers exist up-front with the final size */
+    ufo_group_preallocate (group, &requisition);
+    buffer = ufo_group_try_pop_output_buffer (group, &requisition);
+    other = ufo_group_try_pop_output_buffer (group, &requisition);
+    g_assert (buffer != NULL && other != NULL);
+    g_assert (ufo_group_try_pop_output_buffer (group, &requisition) == NULL);
+
+    ufo_buffer_get_requisition (other, &result);
+    g_assert_cmpuint (result.n_dims, ==, 2);
+    g_assert_cmpuint (result.dims[0], ==, 16);
+    g_assert_cmpuint (result.dims[1], ==, 8);
+
+    ufo_group_return_output_buffer (group, other);
+    ufo_group_return_output_buffer (group, buffer);
+
+    g_object_unref (group);
+    g_object_unref (consumer);
+}
+
+void
+test_add_queue (void)
+{
+    g_test_add ("/no-opencl/queue/async/insert",
+                Fixture, NULL,
+                setup_async, test_insert, teardown);
+
+    g_test_add ("/no-opencl/queue/ring/insert",
+                Fixture, NULL,
+                setup_ring, test_insert, teardown);
+
+    g_test_add ("/no-opencl/queue/async/try-pop",
+                Fixture, NULL,
+                setup_async, test_try_pop, teardown);
+
+    g_test_add ("/no-opencl/queue/ring/try-pop",
+                Fixture, NULL,
+                setup_ring, test_try_pop, teardown);
+
+    g_test_add ("/no-opencl/queue/async/transfer",
+                Fixture, NULL,
+                setup_async, test_transfer, teardown);
+
+    g_test_add ("/no-opencl/queue/ring/transfer",
+                Fixture, NULL,
+                setup_ring, test_transfer, teardown);
+
+    g_test_add ("/no-opencl/queue/async/overfill",
+                Fixture, NULL,
+                setup_async, test_overfill, teardown);
+
+    g_test_add ("/no-opencl/queue/ring/overfill",
+                Fixture, NULL,
+                setup_ring, test_overfill, teardown);
+
+    g_test_add_func ("/no-opencl/queue/group/broadcast",
+                     test_group_broadcast);
+
+    g_test_add_func ("/no-opencl/queue/group/forward",
+                     test_group_forward);
+
+    g_test_add_func ("/no-opencl/queue/group/preallocate",
+                     test_group_preallocate);
+
+    g_test_add_func ("/no-opencl/queue/group/scatter-batch",
+                     test_group_scatter_batch);
+
+    if (g_test_perf ()) {
+        g_test_add ("/no-opencl/queue/async/rate",
+                    Fixture, NULL,
+                    setup_async, test_transfer_rate, teardown);
+
+        g_test_add ("/no-opencl/queue/ring/rate",
+                    Fixture, NULL,
+                    setup_ring, test_transfer_rate, teardown);
+    }
+}
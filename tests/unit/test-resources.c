@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include <ufo/ufo.h>
+#include "test-suite.h"
+
+typedef struct {
+    gchar *cache_dir;
+    gchar *kernel_dir;
+    gchar *header;
+} Fixture;
+
+static const gchar *source =
+    "#include \"test-cache.h\"\n"
+    "kernel void fill (global float *x) { x[0] = VALUE; }\n";
+
+static void
+setup (Fixture *fixture, gconstpointer data)
+{
+    fixture->cache_dir = g_dir_make_tmp ("ufo-cache-XXXXXX", NULL);
+    fixture->kernel_dir = g_dir_make_tmp ("ufo-kernels-XXXXXX", NULL);
+    fixture->header = g_build_filename (fixture->kernel_dir, "test-cache.h", NULL);
+    g_assert (g_file_set_contents (fixture->header, "#define VALUE 1.0f\n", -1, NULL));
+
+    g_setenv ("UFO_PROGRAM_CACHE", fixture->cache_dir, TRUE);
+    g_setenv ("UFO_KERNEL_PATH", fixture->kernel_dir, TRUE);
+}
+
+static void
+remove_dir (const gchar *path)
+{
+    GDir *dir;
+    const gchar *name;
+
+    dir = g_dir_open (path, 0, NULL);
+
+    if (dir != NULL) {
+        while ((name = g_dir_read_name (dir)) != NULL) {
+            gchar *filename = g_build_filename (path, name, NULL);
+            g_unlink (filename);
+            g_free (filename);
+        }
+
+        g_dir_close (dir);
+    }
+
+    g_rmdir (path);
+}
+
+static void
+teardown (Fixture *fixture, gconstpointer data)
+{
+    g_unsetenv ("UFO_PROGRAM_CACHE");
+    g_unsetenv ("UFO_KERNEL_PATH");
+    remove_dir (fixture->cache_dir);
+    remove_dir (fixture->kernel_dir);
+    g_free (fixture->header);
+    g_free (fixture->cache_dir);
+    g_free (fixture->kernel_dir);
+}
+
+static guint
+count_files (const gchar *path)
+{
+    GDir *dir;
+    guint n_files = 0;
+
+    dir = g_dir_open (path, 0, NULL);
+
+    if (dir == NULL)
+        return 0;
+
+    while (g_dir_read_name (dir) != NULL)
+        n_files++;
+
+    g_dir_close (dir);
+    return n_files;
+}
+
+/*
+ * Build @code with a fresh resources object, so that only the on-disk cache
+ * can be shared between calls. Returns FALSE if there is no OpenCL device.
+ */
+static gboolean
+build_source (const gchar *code)
+{
+    UfoResources *resources;
+    GError *error = NULL;
+
+    resources = ufo_resources_new (&error);
+
+    if (resources == NULL) {
+        g_error_free (error);
+        return FALSE;
+    }
+
+    g_assert (ufo_resources_get_kernel_from_source (resources, code, "fill", NULL, &error) != NULL);
+    g_assert_no_error (error);
+    g_object_unref (resources);
+    return TRUE;
+}
+
+static void
+skip_missing_devices (void)
+{
+#if GLIB_CHECK_VERSION (2, 38, 0)
+    g_test_skip ("an OpenCL device is required");
+#endif
+}
+
+static void
+test_cache (Fixture *fixture, gconstpointer data)
+{
+    guint n_binaries;
+
+    if (!build_source (source)) {
+        skip_missing_devices ();
+        return;
+    }
+
+    /* One binary per device */
+    n_binaries = count_files (fixture->cache_dir);
+    g_assert_cmpuint (n_binaries, >, 0);
+
+    /* Same source and header hit the cache */
+    g_assert (build_source (source));
+    g_assert_cmpuint (count_files (fixture->cache_dir), ==, n_binaries);
+
+    /* A changed header must not load the old binaries */
+    g_assert (g_file_set_contents (fixture->header, "#define VALUE 2.0f\n", -1, NULL));
+    g_assert (build_source (source));
+    g_assert_cmpuint (count_files (fixture->cache_dir), ==, 2 * n_binaries);
+}
+
+static void
+test_cache_disabled (Fixture *fixture, gconstpointer data)
+{
+    gchar *default_dir;
+    gchar *unique;
+    guint n_default;
+
+    /* A source that was never built before would be stored by default */
+    default_dir = g_build_filename (g_get_user_cache_dir (), "ufo", "programs", NULL);
+    unique = g_strdup_printf ("%s/* %u */\n", source, g_random_int ());
+    n_default = count_files (default_dir);
+    g_setenv ("UFO_PROGRAM_CACHE", "", TRUE);
+
+    if (build_source (unique)) {
+        g_assert_cmpuint (count_files (fixture->cache_dir), ==, 0);
+        g_assert_cmpuint (count_files (default_dir), ==, n_default);
+    }
+    else {
+        skip_missing_devices ();
+    }
+
+    g_free (unique);
+    g_free (default_dir);
+}
+
+/*
+ * Check if @kernel was built with @option by looking at the build options of
+ * its program on the first device.
+ */
+static gboolean
+built_with (gpointer kernel, const gchar *option)
+{
+    cl_program program;
+    cl_device_id device;
+    gchar *options;
+    gsize size;
+    gboolean result;
+
+    UFO_RESOURCES_CHECK_CLERR (clGetKernelInfo (kernel, CL_KERNEL_PROGRAM, sizeof (cl_program), &program, NULL));
+    UFO_RESOURCES_CHECK_CLERR (clGetProgramInfo (program, CL_PROGRAM_DEVICES, sizeof (cl_device_id), &device, NULL));
+    UFO_RESOURCES_CHECK_CLERR (clGetProgramBuildInfo (program, device, CL_PROGRAM_BUILD_OPTIONS, 0, NULL, &size));
+    options = g_malloc0 (size + 1);
+    UFO_RESOURCES_CHECK_CLERR (clGetProgramBuildInfo (program, device, CL_PROGRAM_BUILD_OPTIONS, size, options, NULL));
+    result = strstr (options, option) != NULL;
+    g_free (options);
+    return result;
+}
+
+static void
+test_specialized_kernel (Fixture *fixture, gconstpointer data)
+{
+    UfoResources *resources;
+    gchar *filename;
+    gpointer kernels[4];
+    cl_program programs[2];
+    GError *error = NULL;
+
+    filename = g_build_filename (fixture->kernel_dir, "test-variant.cl", NULL);
+    g_assert (g_file_set_contents (filename,
+                                   "#ifndef UFO_WIDTH\n"
+                                   "#define UFO_WIDTH 1\n"
+                                   "#endif\n"
+                                   "kernel void fill (global float *x) { x[0] = UFO_WIDTH; }\n",
+                                   -1, NULL));
+
+    resources = ufo_resources_new (&error);
+
+    if (resources == NULL) {
+        g_error_free (error);
+        skip_missing_devices ();
+        g_free (filename);
+        return;
+    }
+
+    g_object_set (resources, "max-kernel-variants", 1, NULL);
+
+    /* Same shape hits the cached variant */
+    kernels[0] = ufo_resources_get_specialized_kernel (resources, "test-variant.cl", "fill", "-DUFO_WIDTH=512", &error);
+    g_assert_no_error (error);
+    kernels[1] = ufo_resources_get_specialized_kernel (resources, "test-variant.cl", "fill", "-DUFO_WIDTH=512", &error);
+    g_assert_no_error (error);
+    UFO_RESOURCES_CHECK_CLERR (clGetKernelInfo (kernels[0], CL_KERNEL_PROGRAM, sizeof (cl_program), &programs[0], NULL));
+    UFO_RESOURCES_CHECK_CLERR (clGetKernelInfo (kernels[1], CL_KERNEL_PROGRAM, sizeof (cl_program), &programs[1], NULL));
+    g_assert (programs[0] == programs[1]);
+    g_assert (built_with (kernels[0], "-DUFO_WIDTH=512"));
+
+    /* A new shape evicts the only variant ... */
+    kernels[2] = ufo_resources_get_specialized_kernel (resources, "test-variant.cl", "fill", "-DUFO_WIDTH=256", &error);
+    g_assert_no_error (error);
+    g_assert (built_with (kernels[2], "-DUFO_WIDTH=256"));
+
+    /* ... after which the shape counts as unstable and defines are ignored */
+    kernels[3] = ufo_resources_get_specialized_kernel (resources, "test-variant.cl", "fill", "-DUFO_WIDTH=512", &error);
+    g_assert_no_error (error);
+    g_assert (!built_with (kernels[3], "-DUFO_WIDTH"));
+
+    for (guint i = 0; i < 4; i++)
+        UFO_RESOURCES_CHECK_CLERR (clReleaseKernel (kernels[i]));
+
+    g_object_unref (resources);
+    g_free (filename);
+}
+
+static void
+test_requisition_defines (void)
+{
+    UfoRequisition requisition = {
+        .n_dims = 2,
+        .dims[0] = 512,
+        .dims[1] = 256,
+    };
+
+    gchar *defines;
+
+    defines = ufo_resources_get_requisition_defines (&requisition);
+    g_assert_cmpstr (defines, ==, "-DUFO_NUM_DIMS=2 -DUFO_WIDTH=512 -DUFO_HEIGHT=256");
+    g_free (defines);
+}
+
+void
+test_add_resources (void)
+{
+    g_test_add ("/opencl/resources/cache",
+                Fixture, NULL,
+                setup, test_cache, teardown);
+
+    g_test_add ("/opencl/resources/cache/disabled",
+                Fixture, NULL,
+                setup, test_cache_disabled, teardown);
+
+    g_test_add ("/opencl/resources/specialized-kernel",
+                Fixture, NULL,
+                setup, test_specialized_kernel, teardown);
+
+    g_test_add_func ("/no-opencl/resources/requisition-defines",
+                     test_requisition_defines);
+}
@@ -0,0 +1,1192 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include <ufo/ufo.h>
+#include "test-suite.h"
+
+typedef struct {
+    UfoPluginManager *manager;
+    UfoTaskGraph *graph;
+    GList *nodes;
+    guint n_items;
+} Fixture;
+
+/*
+ * A processor with two outputs, the first one a copy of the input and the
+ * second one the doubled input
+ */
+typedef struct {
+    UfoTaskNode parent_instance;
+} TestSplitTask;
+
+typedef struct {
+    UfoTaskNodeClass parent_class;
+} TestSplitTaskClass;
+
+static void test_split_task_interface_init (UfoTaskIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (TestSplitTask, test_split_task, UFO_TYPE_TASK_NODE,
+                         G_IMPLEMENT_INTERFACE (UFO_TYPE_TASK,
+                                                test_split_task_interface_init))
+
+static void
+test_split_task_setup (UfoTask *task,
+                       UfoResources *resources,
+                       GError **error)
+{
+}
+
+static void
+test_split_task_get_requisition (UfoTask *task,
+                                 UfoBuffer **inputs,
+                                 UfoRequisition *requisition,
+                                 GError **error)
+{
+    ufo_buffer_get_requisition (inputs[0], requisition);
+}
+
+static guint
+test_split_task_get_num_inputs (UfoTask *task)
+{
+    return 1;
+}
+
+static guint
+test_split_task_get_num_dimensions (UfoTask *task,
+                                    guint input)
+{
+    return 2;
+}
+
+static UfoTaskMode
+test_split_task_get_mode (UfoTask *task)
+{
+    return UFO_TASK_MODE_PROCESSOR | UFO_TASK_MODE_CPU;
+}
+
+static guint
+test_split_task_get_num_outputs (UfoTask *task)
+{
+    return 2;
+}
+
+static gboolean
+test_split_task_process_outputs (UfoTask *task,
+                                 UfoBuffer **inputs,
+                                 UfoBuffer **outputs,
+                                 UfoRequisition *requisitions)
+{
+    gfloat *in_mem;
+    gfloat *copy_mem;
+    gfloat *double_mem;
+
+    in_mem = ufo_buffer_get_host_array (inputs[0], NULL);
+    copy_mem = ufo_buffer_get_host_array (outputs[0], NULL);
+    double_mem = ufo_buffer_get_host_array (outputs[1], NULL);
+
+    for (gsize i = 0; i < ufo_buffer_get_size (inputs[0]) / sizeof (gfloat); i++) {
+        copy_mem[i] = in_mem[i];
+        double_mem[i] = 2.0f * in_mem[i];
+    }
+
+    return TRUE;
+}
+
+static gboolean
+test_split_task_process_batch (UfoTask *task,
+                               UfoBuffer **inputs,
+                               UfoBuffer **outputs,
+                               guint n_items,
+                               UfoRequisition *requisition)
+{
+    /* A batch has only one output per item, the scheduler must not use it */
+    g_assert_not_reached ();
+    return FALSE;
+}
+
+static void
+test_split_task_interface_init (UfoTaskIface *iface)
+{
+    iface->setup = test_split_task_setup;
+    iface->get_num_inputs = test_split_task_get_num_inputs;
+    iface->get_num_dimensions = test_split_task_get_num_dimensions;
+    iface->get_mode = test_split_task_get_mode;
+    iface->get_requisition = test_split_task_get_requisition;
+    iface->get_num_outputs = test_split_task_get_num_outputs;
+    iface->process_outputs = test_split_task_process_outputs;
+    iface->process_batch = test_split_task_process_batch;
+}
+
+static void
+test_split_task_class_init (TestSplitTaskClass *klass)
+{
+}
+
+static void
+test_split_task_init (TestSplitTask *task)
+{
+    ufo_task_node_set_plugin_name (UFO_TASK_NODE (task), "[split]");
+}
+
+/*
+ * An elementwise GPU processor computing x * scale + offset
+ */
+typedef struct {
+    UfoTaskNode parent_instance;
+    gint scale;
+    gint offset;
+    gpointer kernel;
+} TestScaleTask;
+
+typedef struct {
+    UfoTaskNodeClass parent_class;
+} TestScaleTaskClass;
+
+static void test_scale_task_interface_init (UfoTaskIface *iface);
+static void test_scale_task_elementwise_init (UfoElementwiseIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (TestScaleTask, test_scale_task, UFO_TYPE_TASK_NODE,
+                         G_IMPLEMENT_INTERFACE (UFO_TYPE_TASK,
+                                                test_scale_task_interface_init)
+                         G_IMPLEMENT_INTERFACE (UFO_TYPE_ELEMENTWISE,
+                                                test_scale_task_elementwise_init))
+
+static UfoTaskNode *
+test_scale_task_new (gint scale,
+                     gint offset)
+{
+    TestScaleTask *task;
+
+    task = g_object_new (test_scale_task_get_type (), NULL);
+    task->scale = scale;
+    task->offset = offset;
+    return UFO_TASK_NODE (task);
+}
+
+static gchar *
+test_scale_task_get_expression (UfoElementwise *elementwise)
+{
+    TestScaleTask *task = (TestScaleTask *) elementwise;
+
+    return g_strdup_printf ("x * %d.0f + %d.0f", task->scale, task->offset);
+}
+
+static void
+test_scale_task_setup (UfoTask *task,
+                       UfoResources *resources,
+                       GError **error)
+{
+    gchar *expression;
+    gchar *source;
+
+    expression = test_scale_task_get_expression (UFO_ELEMENTWISE (task));
+    source = g_strdup_printf ("kernel void scale (global const float *input, global float *output)\n"
+                              "{\n"
+                              "    const size_t idx = get_global_id (0);\n"
+                              "    float x = input[idx];\n"
+                              "    output[idx] = %s;\n"
+                              "}\n", expression);
+
+    ((TestScaleTask *) task)->kernel = ufo_resources_get_kernel_from_source (resources, source, "scale", NULL, error);
+    g_free (source);
+    g_free (expression);
+}
+
+static void
+test_scale_task_get_requisition (UfoTask *task,
+                                 UfoBuffer **inputs,
+                                 UfoRequisition *requisition,
+                                 GError **error)
+{
+    ufo_buffer_get_requisition (inputs[0], requisition);
+}
+
+static guint
+test_scale_task_get_num_inputs (UfoTask *task)
+{
+    return 1;
+}
+
+static guint
+test_scale_task_get_num_dimensions (UfoTask *task,
+                                    guint input)
+{
+    return 1;
+}
+
+static UfoTaskMode
+test_scale_task_get_mode (UfoTask *task)
+{
+    return UFO_TASK_MODE_PROCESSOR | UFO_TASK_MODE_GPU;
+}
+
+static gboolean
+test_scale_task_process (UfoTask *task,
+                         UfoBuffer **inputs,
+                         UfoBuffer *output,
+                         UfoRequisition *requisition)
+{
+    gpointer kernel;
+    gpointer cmd_queue;
+    gpointer in_mem;
+    gpointer out_mem;
+    gsize n_elements;
+
+    kernel = ((TestScaleTask *) task)->kernel;
+    cmd_queue = ufo_task_node_get_cmd_queue (UFO_TASK_NODE (task));
+    in_mem = ufo_buffer_get_device_array (inputs[0], cmd_queue);
+    out_mem = ufo_buffer_get_device_array (output, cmd_queue);
+    n_elements = ufo_buffer_get_size (output) / sizeof (gfloat);
+
+    clSetKernelArg (kernel, 0, sizeof (cl_mem), &in_mem);
+    clSetKernelArg (kernel, 1, sizeof (cl_mem), &out_mem);
+    ufo_profiler_call (ufo_task_node_get_profiler (UFO_TASK_NODE (task)),
+                       cmd_queue, kernel, 1, &n_elements, NULL);
+
+    return TRUE;
+}
+
+static void
+test_scale_task_interface_init (UfoTaskIface *iface)
+{
+    iface->setup = test_scale_task_setup;
+    iface->get_num_inputs = test_scale_task_get_num_inputs;
+    iface->get_num_dimensions = test_scale_task_get_num_dimensions;
+    iface->get_mode = test_scale_task_get_mode;
+    iface->get_requisition = test_scale_task_get_requisition;
+    iface->process = test_scale_task_process;
+}
+
+static void
+test_scale_task_elementwise_init (UfoElementwiseIface *iface)
+{
+    iface->get_expression = test_scale_task_get_expression;
+}
+
+static void
+test_scale_task_class_init (TestScaleTaskClass *klass)
+{
+}
+
+static void
+test_scale_task_init (TestScaleTask *task)
+{
+    ufo_task_node_set_plugin_name (UFO_TASK_NODE (task), "[scale]");
+}
+
+/*
+ * A copy task counting how often it is set up. It inherits the reset method of
+ * UfoCopyTask.
+ */
+typedef struct {
+    UfoCopyTask parent_instance;
+    guint n_setups;
+} TestCountTask;
+
+typedef struct {
+    UfoCopyTaskClass parent_class;
+} TestCountTaskClass;
+
+static void test_count_task_interface_init (UfoTaskIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (TestCountTask, test_count_task, UFO_TYPE_COPY_TASK,
+                         G_IMPLEMENT_INTERFACE (UFO_TYPE_TASK,
+                                                test_count_task_interface_init))
+
+static void
+test_count_task_setup (UfoTask *task,
+                       UfoResources *resources,
+                       GError **error)
+{
+    ((TestCountTask *) task)->n_setups++;
+}
+
+static void
+test_count_task_interface_init (UfoTaskIface *iface)
+{
+    iface->setup = test_count_task_setup;
+}
+
+static void
+test_count_task_class_init (TestCountTaskClass *klass)
+{
+}
+
+static void
+test_count_task_init (TestCountTask *task)
+{
+    task->n_setups = 0;
+}
+
+static void
+setup (Fixture *fixture, gconstpointer data)
+{
+    fixture->manager = ufo_plugin_manager_new ();
+    fixture->graph = UFO_TASK_GRAPH (ufo_task_graph_new ());
+    fixture->nodes = NULL;
+    fixture->n_items = g_test_perf () ? 5000 : 200;
+}
+
+static void
+teardown (Fixture *fixture, gconstpointer data)
+{
+    g_list_free_full (fixture->nodes, g_object_unref);
+    g_object_unref (fixture->graph);
+    g_object_unref (fixture->manager);
+}
+
+static UfoTaskNode *
+get_task (Fixture *fixture, const gchar *name)
+{
+    UfoTaskNode *node;
+    GError *error = NULL;
+
+    node = ufo_plugin_manager_get_task (fixture->manager, name, &error);
+
+    if (node == NULL) {
+        g_error_free (error);
+        return NULL;
+    }
+
+    fixture->nodes = g_list_append (fixture->nodes, node);
+    return node;
+}
+
+static UfoTaskNode *
+get_source (Fixture *fixture)
+{
+    UfoTaskNode *source;
+
+    source = get_task (fixture, "dummy-data");
+
+    if (source != NULL)
+        g_object_set (source, "width", 64, "height", 64, "number", fixture->n_items, NULL);
+
+    return source;
+}
+
+/*
+ * dummy-data -> n_copies * copy -> null
+ */
+static UfoTaskNode *
+build_chain (Fixture *fixture, guint n_copies)
+{
+    UfoTaskNode *previous;
+    UfoTaskNode *sink;
+
+    previous = get_source (fixture);
+    sink = get_task (fixture, "null");
+
+    if (previous == NULL || sink == NULL)
+        return NULL;
+
+    for (guint i = 0; i < n_copies; i++) {
+        UfoTaskNode *copy;
+
+        copy = UFO_TASK_NODE (ufo_copy_task_new ());
+        fixture->nodes = g_list_append (fixture->nodes, copy);
+        ufo_task_graph_connect_nodes (fixture->graph, previous, copy);
+        previous = copy;
+    }
+
+    ufo_task_graph_connect_nodes (fixture->graph, previous, sink);
+    return sink;
+}
+
+static void
+run_graph (Fixture *fixture, UfoBaseScheduler *scheduler)
+{
+    GError *error = NULL;
+
+    g_object_set (scheduler, "expand", FALSE, NULL);
+    ufo_base_scheduler_run (scheduler, fixture->graph, &error);
+    g_assert_no_error (error);
+    g_object_unref (scheduler);
+}
+
+static void
+skip_missing_plugins (void)
+{
+#if GLIB_CHECK_VERSION (2, 38, 0)
+    g_test_skip ("dummy-data and null tasks from ufo-filters are required");
+#endif
+}
+
+static void
+test_chain (Fixture *fixture, gconstpointer data)
+{
+    UfoTaskNode *sink;
+    guint n_processed;
+
+    sink = build_chain (fixture, 4);
+
+    if (sink == NULL) {
+        skip_missing_plugins ();
+        return;
+    }
+
+    run_graph (fixture, ufo_stealing_scheduler_new ());
+    g_object_get (sink, "num-processed", &n_processed, NULL);
+    g_assert_cmpuint (n_processed, ==, fixture->n_items);
+}
+
+static void
+test_single_worker (Fixture *fixture, gconstpointer data)
+{
+    UfoBaseScheduler *scheduler;
+    UfoTaskNode *sink;
+    guint n_processed;
+
+    sink = build_chain (fixture, 2);
+
+    if (sink == NULL) {
+        skip_missing_plugins ();
+        return;
+    }
+
+    /* One worker must be enough to interleave all steps */
+    scheduler = ufo_stealing_scheduler_new ();
+    g_object_set (scheduler, "num-workers", 1, NULL);
+    run_graph (fixture, scheduler);
+    g_object_get (sink, "num-processed", &n_processed, NULL);
+    g_assert_cmpuint (n_processed, ==, fixture->n_items);
+}
+
+static void
+test_broadcast (Fixture *fixture, gconstpointer data)
+{
+    UfoTaskNode *source;
+    UfoTaskNode *sinks[3];
+    guint n_processed;
+
+    source = get_source (fixture);
+
+    if (source == NULL) {
+        skip_missing_plugins ();
+        return;
+    }
+
+    ufo_task_node_set_send_pattern (source, UFO_SEND_BROADCAST);
+
+    for (guint i = 0; i < G_N_ELEMENTS (sinks); i++) {
+        UfoTaskNode *copy;
+
+        sinks[i] = get_task (fixture, "null");
+
+        if (sinks[i] == NULL) {
+            skip_missing_plugins ();
+            return;
+        }
+
+        copy = UFO_TASK_NODE (ufo_copy_task_new ());
+        fixture->nodes = g_list_append (fixture->nodes, copy);
+        ufo_task_graph_connect_nodes (fixture->graph, source, copy);
+        ufo_task_graph_connect_nodes (fixture->graph, copy, sinks[i]);
+    }
+
+    run_graph (fixture, ufo_stealing_scheduler_new ());
+
+    for (guint i = 0; i < G_N_ELEMENTS (sinks); i++) {
+        g_object_get (sinks[i], "num-processed", &n_processed, NULL);
+        g_assert_cmpuint (n_processed, ==, fixture->n_items);
+    }
+}
+
+static void
+test_fuse (Fixture *fixture, gconstpointer data)
+{
+    UfoTaskNode *source;
+    UfoTaskNode *sink;
+    UfoTaskNode *kernels[3];
+    UfoNode *fused;
+    GList *successors;
+
+    source = get_source (fixture);
+    sink = get_task (fixture, "null");
+
+    for (guint i = 0; i < G_N_ELEMENTS (kernels); i++)
+        kernels[i] = get_task (fixture, "opencl");
+
+    if (source == NULL || sink == NULL || kernels[0] == NULL) {
+#if GLIB_CHECK_VERSION (2, 38, 0)
+        g_test_skip ("dummy-data, opencl and null tasks from ufo-filters are required");
+#endif
+        return;
+    }
+
+    ufo_task_graph_connect_nodes (fixture->graph, source, kernels[0]);
+    ufo_task_graph_connect_nodes (fixture->graph, kernels[0], kernels[1]);
+    ufo_task_graph_connect_nodes (fixture->graph, kernels[1], kernels[2]);
+    ufo_task_graph_connect_nodes (fixture->graph, kernels[2], sink);
+
+    ufo_task_graph_fuse (fixture->graph);
+    g_assert_cmpuint (ufo_graph_get_num_nodes (UFO_GRAPH (fixture->graph)), ==, 3);
+    g_assert_cmpuint (ufo_graph_get_num_edges (UFO_GRAPH (fixture->graph)), ==, 2);
+
+    successors = ufo_graph_get_successors (UFO_GRAPH (fixture->graph), UFO_NODE (source));
+    fused = UFO_NODE (successors->data);
+    g_list_free (successors);
+
+    g_assert (UFO_IS_FUSED_TASK (fused));
+    g_assert_cmpuint (g_list_length (ufo_fused_task_get_tasks (UFO_FUSED_TASK (fused))), ==, 3);
+    g_assert (ufo_graph_is_connected (UFO_GRAPH (fixture->graph), fused, UFO_NODE (sink)));
+}
+
+static void
+test_expand_join (Fixture *fixture, gconstpointer data)
+{
+    UfoTaskNode *projections;
+    UfoTaskNode *darks;
+    UfoTaskNode *flats;
+    UfoTaskNode *averages[2];
+    UfoTaskNode *correct;
+    UfoTaskNode *kernel;
+    UfoTaskNode *sink;
+    UfoGraph *graph;
+    GError *error = NULL;
+
+    projections = get_source (fixture);
+    darks = get_source (fixture);
+    flats = get_source (fixture);
+    averages[0] = get_task (fixture, "average");
+    averages[1] = get_task (fixture, "average");
+    correct = get_task (fixture, "flat-field-correct");
+    kernel = get_task (fixture, "opencl");
+    sink = get_task (fixture, "null");
+
+    if (projections == NULL || averages[0] == NULL || correct == NULL || kernel == NULL || sink == NULL) {
+#if GLIB_CHECK_VERSION (2, 38, 0)
+        g_test_skip ("dummy-data, average, flat-field-correct, opencl and null tasks from ufo-filters are required");
+#endif
+        return;
+    }
+
+    ufo_task_graph_connect_nodes_full (fixture->graph, projections, correct, 0);
+    ufo_task_graph_connect_nodes (fixture->graph, darks, averages[0]);
+    ufo_task_graph_connect_nodes_full (fixture->graph, averages[0], correct, 1);
+    ufo_task_graph_connect_nodes (fixture->graph, flats, averages[1]);
+    ufo_task_graph_connect_nodes_full (fixture->graph, averages[1], correct, 2);
+    ufo_task_graph_connect_nodes (fixture->graph, correct, kernel);
+    ufo_task_graph_connect_nodes (fixture->graph, kernel, sink);
+
+    ufo_task_graph_expand (fixture->graph, NULL, 3, &error);
+    g_assert_no_error (error);
+
+    /* Both GPU tasks are replicated, the join included */
+    graph = UFO_GRAPH (fixture->graph);
+    g_assert_cmpuint (ufo_graph_get_num_nodes (graph), ==, 6 + 3 * 2);
+    g_assert_cmpuint (ufo_graph_get_num_predecessors (graph, UFO_NODE (sink)), ==, 3);
+
+    /* Projections are scattered, averaged companions are broadcast */
+    g_assert_cmpuint (ufo_graph_get_num_successors (graph, UFO_NODE (projections)), ==, 3);
+    g_assert_cmpint (ufo_task_node_get_send_pattern (projections), ==, UFO_SEND_SCATTER);
+
+    for (guint i = 0; i < G_N_ELEMENTS (averages); i++) {
+        g_assert_cmpuint (ufo_graph_get_num_successors (graph, UFO_NODE (averages[i])), ==, 3);
+        g_assert_cmpint (ufo_task_node_get_send_pattern (averages[i]), ==, UFO_SEND_BROADCAST);
+    }
+}
+
+/*
+ * dummy-data -> stack -> opencl -> null, where the stack emits a whole stream
+ * that must be scattered among the replicas
+ */
+static void
+test_expand_stack (Fixture *fixture, gconstpointer data)
+{
+    UfoBaseScheduler *scheduler;
+    UfoTaskNode *source;
+    UfoTaskNode *stack;
+    UfoTaskNode *kernel;
+    UfoTaskNode *sink;
+    guint n_processed;
+    GError *error = NULL;
+
+    source = get_source (fixture);
+    stack = get_task (fixture, "stack");
+    kernel = get_task (fixture, "opencl");
+    sink = get_task (fixture, "null");
+
+    if (source == NULL || stack == NULL || kernel == NULL || sink == NULL) {
+#if GLIB_CHECK_VERSION (2, 38, 0)
+        g_test_skip ("dummy-data, stack, opencl and null tasks from ufo-filters are required");
+#endif
+        return;
+    }
+
+    g_object_set (stack, "number", 8, NULL);
+    ufo_task_graph_connect_nodes (fixture->graph, source, stack);
+    ufo_task_graph_connect_nodes (fixture->graph, stack, kernel);
+    ufo_task_graph_connect_nodes (fixture->graph, kernel, sink);
+
+    ufo_task_graph_expand (fixture->graph, NULL, 3, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (ufo_graph_get_num_predecessors (UFO_GRAPH (fixture->graph), UFO_NODE (sink)), ==, 3);
+    g_assert_cmpint (ufo_task_node_get_send_pattern (stack), ==, UFO_SEND_SCATTER);
+
+    /* Every stack is processed by exactly one replica */
+    scheduler = ufo_scheduler_new ();
+    g_object_set (scheduler, "expand", FALSE, NULL);
+    ufo_base_scheduler_run (scheduler, fixture->graph, &error);
+    g_assert_no_error (error);
+    g_object_unref (scheduler);
+
+    g_object_get (sink, "num-processed", &n_processed, NULL);
+    g_assert_cmpuint (n_processed, ==, fixture->n_items / 8);
+}
+
+static void
+test_costs (Fixture *fixture, gconstpointer data)
+{
+    UfoTaskGraph *graph;
+    gchar *filename;
+    gdouble cost;
+    gint fd;
+    GError *error = NULL;
+
+    fd = g_file_open_tmp ("ufo-costs-XXXXXX", &filename, &error);
+    g_assert_no_error (error);
+    close (fd);
+
+    g_assert (!ufo_task_graph_get_cost (fixture->graph, "fft", &cost));
+    ufo_task_graph_set_cost (fixture->graph, "fft", 0.25);
+    ufo_task_graph_set_cost (fixture->graph, "backproject", 4.0);
+    g_assert (ufo_task_graph_save_costs (fixture->graph, filename, &error));
+    g_assert_no_error (error);
+
+    /* Saving keeps the costs of plugins the graph does not know about */
+    graph = UFO_TASK_GRAPH (ufo_task_graph_new ());
+    ufo_task_graph_set_cost (graph, "fft", 0.5);
+    g_assert (ufo_task_graph_save_costs (graph, filename, &error));
+    g_assert_no_error (error);
+    g_object_unref (graph);
+
+    graph = UFO_TASK_GRAPH (ufo_task_graph_new ());
+    g_assert (ufo_task_graph_load_costs (graph, filename, &error));
+    g_assert_no_error (error);
+    g_assert (ufo_task_graph_get_cost (graph, "fft", &cost));
+    g_assert_cmpfloat (cost, ==, 0.5);
+    g_assert (ufo_task_graph_get_cost (graph, "backproject", &cost));
+    g_assert_cmpfloat (cost, ==, 4.0);
+    g_object_unref (graph);
+
+    g_unlink (filename);
+    g_free (filename);
+}
+
+static UfoTaskNode *
+add_scale_task (Fixture *fixture, const gchar *plugin)
+{
+    UfoTaskNode *node;
+
+    node = test_scale_task_new (1, 0);
+    ufo_task_node_set_plugin_name (node, plugin);
+    fixture->nodes = g_list_append (fixture->nodes, node);
+    return node;
+}
+
+static void
+test_map_costs (Fixture *fixture, gconstpointer data)
+{
+    UfoTaskGraph *graph;
+    UfoTaskNode *light;
+    UfoTaskNode *heavy[2];
+    GList *gpus = NULL;
+    gchar *filename;
+    gint fd;
+    GError *error = NULL;
+
+    fd = g_file_open_tmp ("ufo-costs-XXXXXX", &filename, &error);
+    g_assert_no_error (error);
+    close (fd);
+
+    graph = UFO_TASK_GRAPH (ufo_task_graph_new ());
+    ufo_task_graph_set_cost (graph, "light", 0.001);
+    ufo_task_graph_set_cost (graph, "heavy", 1.0);
+    g_assert (ufo_task_graph_save_costs (graph, filename, &error));
+    g_assert_no_error (error);
+    g_object_unref (graph);
+
+    /* light -> 2 * heavy, mapped without any device, only the identity of the
+     * processing nodes matters */
+    light = add_scale_task (fixture, "light");
+    heavy[0] = add_scale_task (fixture, "heavy");
+    heavy[1] = add_scale_task (fixture, "heavy");
+    ufo_task_graph_connect_nodes (fixture->graph, light, heavy[0]);
+    ufo_task_graph_connect_nodes (fixture->graph, light, heavy[1]);
+
+    for (guint i = 0; i < 2; i++)
+        gpus = g_list_append (gpus, ufo_node_new (NULL));
+
+    g_assert (ufo_task_graph_load_costs (fixture->graph, filename, &error));
+    g_assert_no_error (error);
+    ufo_task_graph_map (fixture->graph, gpus);
+
+    /* The heavy tasks are worth a transfer and run on different GPUs */
+    g_assert (ufo_task_node_get_proc_node (light) == gpus->data);
+    g_assert (ufo_task_node_get_proc_node (heavy[0]) != NULL);
+    g_assert (ufo_task_node_get_proc_node (heavy[1]) != NULL);
+    g_assert (ufo_task_node_get_proc_node (heavy[0]) != ufo_task_node_get_proc_node (heavy[1]));
+
+    g_list_free_full (gpus, g_object_unref);
+    g_unlink (filename);
+    g_free (filename);
+}
+
+static void
+test_session (Fixture *fixture, gconstpointer data)
+{
+    UfoBaseScheduler *scheduler;
+    UfoTaskNode *source;
+    UfoTaskNode *count;
+    UfoTaskNode *sink;
+    guint n_processed;
+    GError *error = NULL;
+
+    source = get_source (fixture);
+    sink = get_task (fixture, "null");
+
+    if (source == NULL || sink == NULL) {
+        skip_missing_plugins ();
+        return;
+    }
+
+    count = UFO_TASK_NODE (g_object_new (test_count_task_get_type (), NULL));
+    fixture->nodes = g_list_append (fixture->nodes, count);
+    ufo_task_graph_connect_nodes (fixture->graph, source, count);
+    ufo_task_graph_connect_nodes (fixture->graph, count, sink);
+
+    scheduler = ufo_scheduler_new ();
+    g_object_set (scheduler, "expand", FALSE, NULL);
+    g_assert (ufo_base_scheduler_prepare (scheduler, fixture->graph, &error));
+    g_assert_no_error (error);
+
+    /* Every run must see the whole stream again */
+    for (guint i = 0; i < 3; i++) {
+        ufo_base_scheduler_run_prepared (scheduler, &error);
+        g_assert_no_error (error);
+        g_object_get (sink, "num-processed", &n_processed, NULL);
+        g_assert_cmpuint (n_processed, ==, fixture->n_items);
+    }
+
+    /* Tasks that can be reset are set up only once per session */
+    g_assert_cmpuint (((TestCountTask *) count)->n_setups, ==, 1);
+
+    ufo_base_scheduler_release (scheduler);
+    g_object_unref (scheduler);
+}
+
+static gpointer
+run_in_thread (Fixture *fixture)
+{
+    UfoBaseScheduler *scheduler;
+    GError *error = NULL;
+
+    scheduler = ufo_scheduler_new ();
+    g_object_set (scheduler, "expand", FALSE, NULL);
+    ufo_base_scheduler_run (scheduler, fixture->graph, &error);
+    g_object_unref (scheduler);
+    return error;
+}
+
+static gpointer
+run_prepared_in_thread (UfoBaseScheduler *scheduler)
+{
+    GError *error = NULL;
+
+    ufo_base_scheduler_run_prepared (scheduler, &error);
+    return error;
+}
+
+/*
+ * dummy-data -> 3 * copy -> output, where the copies are fed round-robin and
+ * joined at the same input
+ */
+static void
+test_scatter_order (Fixture *fixture, gconstpointer data)
+{
+    UfoTaskNode *source;
+    UfoNode *sink;
+    GThread *thread;
+    GError *error;
+
+    source = get_source (fixture);
+
+    if (source == NULL) {
+        skip_missing_plugins ();
+        return;
+    }
+
+    sink = ufo_output_task_new (2);
+    fixture->nodes = g_list_append (fixture->nodes, sink);
+    ufo_task_node_set_send_pattern (source, UFO_SEND_SCATTER);
+
+    for (guint i = 0; i < 3; i++) {
+        UfoTaskNode *copy;
+
+        copy = UFO_TASK_NODE (ufo_copy_task_new ());
+        fixture->nodes = g_list_append (fixture->nodes, copy);
+        ufo_task_graph_connect_nodes (fixture->graph, source, copy);
+        ufo_task_graph_connect_nodes (fixture->graph, copy, UFO_TASK_NODE (sink));
+    }
+
+    thread = g_thread_new (NULL, (GThreadFunc) run_in_thread, fixture);
+
+    for (guint i = 0; i < fixture->n_items; i++) {
+        UfoBuffer *buffer;
+
+        buffer = ufo_output_task_get_output_buffer (UFO_OUTPUT_TASK (sink));
+        g_assert_cmpuint (ufo_buffer_get_sequence (buffer), ==, i);
+        ufo_output_task_release_output_buffer (UFO_OUTPUT_TASK (sink), buffer);
+    }
+
+    error = g_thread_join (thread);
+    g_assert_no_error (error);
+}
+
+/*
+ * dummy-data -> copy -> copy -> output, where the copies process batches
+ */
+static void
+test_batches (Fixture *fixture, gconstpointer data)
+{
+    guint batch_sizes[] = { 1, 3, 4 };
+
+    for (guint b = 0; b < G_N_ELEMENTS (batch_sizes); b++) {
+        UfoBaseScheduler *scheduler;
+        UfoTaskNode *source;
+        UfoTaskNode *previous;
+        UfoNode *sink;
+        GThread *thread;
+        GError *error = NULL;
+
+        g_object_unref (fixture->graph);
+        fixture->graph = UFO_TASK_GRAPH (ufo_task_graph_new ());
+
+        source = get_source (fixture);
+
+        if (source == NULL) {
+            skip_missing_plugins ();
+            return;
+        }
+
+        sink = ufo_output_task_new (2);
+        fixture->nodes = g_list_append (fixture->nodes, sink);
+        previous = source;
+
+        for (guint i = 0; i < 2; i++) {
+            UfoTaskNode *copy;
+
+            copy = UFO_TASK_NODE (ufo_copy_task_new ());
+            fixture->nodes = g_list_append (fixture->nodes, copy);
+            g_assert (ufo_task_supports_batches (UFO_TASK (copy)));
+            ufo_task_graph_connect_nodes (fixture->graph, previous, copy);
+            previous = copy;
+        }
+
+        ufo_task_graph_connect_nodes (fixture->graph, previous, UFO_TASK_NODE (sink));
+
+        scheduler = ufo_scheduler_new ();
+        g_object_set (scheduler, "expand", FALSE, "batch-size", batch_sizes[b], NULL);
+        g_assert (ufo_base_scheduler_prepare (scheduler, fixture->graph, &error));
+        g_assert_no_error (error);
+
+        /* The output task waits until its buffer is released, so read it here */
+        thread = g_thread_new (NULL, (GThreadFunc) run_prepared_in_thread, scheduler);
+
+        for (guint i = 0; i < fixture->n_items; i++) {
+            UfoBuffer *buffer;
+
+            buffer = ufo_output_task_get_output_buffer (UFO_OUTPUT_TASK (sink));
+            g_assert (buffer != NULL);
+            g_assert_cmpuint (ufo_buffer_get_sequence (buffer), ==, i);
+            ufo_output_task_release_output_buffer (UFO_OUTPUT_TASK (sink), buffer);
+        }
+
+        /* Nothing follows the last item */
+        g_assert (ufo_output_task_get_output_buffer (UFO_OUTPUT_TASK (sink)) == NULL);
+        error = g_thread_join (thread);
+        g_assert_no_error (error);
+
+        ufo_base_scheduler_release (scheduler);
+        g_object_unref (scheduler);
+    }
+}
+
+/*
+ * input -> scale (2x + 1) -> scale (3x - 4) -> output, fused into one kernel
+ */
+static void
+test_fuse_elementwise (Fixture *fixture, gconstpointer data)
+{
+    const guint n_items = 4;
+    const gsize n_pixels = 1000;
+    UfoBaseScheduler *scheduler;
+    UfoResources *resources;
+    UfoNode *source;
+    UfoNode *sink;
+    UfoTaskNode *scales[2];
+    UfoNode *fused;
+    UfoBuffer *input;
+    UfoRequisition requisition = { .n_dims = 1, .dims[0] = n_pixels };
+    GList *successors;
+    GThread *thread;
+    GError *error = NULL;
+
+    resources = ufo_resources_new (&error);
+
+    if (resources == NULL) {
+        g_error_free (error);
+#if GLIB_CHECK_VERSION (2, 38, 0)
+        g_test_skip ("an OpenCL device is required");
+#endif
+        return;
+    }
+
+    source = ufo_input_task_new ();
+    sink = ufo_output_task_new (1);
+    scales[0] = test_scale_task_new (2, 1);
+    scales[1] = test_scale_task_new (3, -4);
+    fixture->nodes = g_list_append (fixture->nodes, source);
+    fixture->nodes = g_list_append (fixture->nodes, sink);
+    fixture->nodes = g_list_append (fixture->nodes, scales[0]);
+    fixture->nodes = g_list_append (fixture->nodes, scales[1]);
+
+    ufo_task_graph_connect_nodes (fixture->graph, UFO_TASK_NODE (source), scales[0]);
+    ufo_task_graph_connect_nodes (fixture->graph, scales[0], scales[1]);
+    ufo_task_graph_connect_nodes (fixture->graph, scales[1], UFO_TASK_NODE (sink));
+
+    scheduler = ufo_scheduler_new ();
+    ufo_base_scheduler_set_resources (scheduler, resources);
+    g_object_set (scheduler, "expand", FALSE, "fuse", TRUE, NULL);
+    g_assert (ufo_base_scheduler_prepare (scheduler, fixture->graph, &error));
+    g_assert_no_error (error);
+
+    /* Both scales run as one generated kernel */
+    successors = ufo_graph_get_successors (UFO_GRAPH (fixture->graph), source);
+    fused = UFO_NODE (successors->data);
+    g_list_free (successors);
+    g_assert (UFO_IS_FUSED_TASK (fused));
+    g_assert (ufo_task_get_mode (UFO_TASK (fused)) & UFO_TASK_MODE_INPLACE);
+
+    thread = g_thread_new (NULL, (GThreadFunc) run_prepared_in_thread, scheduler);
+    input = ufo_buffer_new (&requisition, ufo_resources_get_context (resources));
+
+    for (guint i = 0; i < n_items; i++) {
+        UfoBuffer *output;
+        gfloat *in_mem;
+        gfloat *out_mem;
+
+        in_mem = ufo_buffer_get_host_array (input, NULL);
+
+        for (gsize j = 0; j < n_pixels; j++)
+            in_mem[j] = (gfloat) (i * n_pixels + j);
+
+        ufo_input_task_release_input_buffer (UFO_INPUT_TASK (source), input);
+        output = ufo_output_task_get_output_buffer (UFO_OUTPUT_TASK (sink));
+        out_mem = ufo_buffer_get_host_array (output, NULL);
+
+        for (gsize j = 0; j < n_pixels; j++)
+            g_assert_cmpfloat (out_mem[j], ==, (2.0f * (i * n_pixels + j) + 1.0f) * 3.0f - 4.0f);
+
+        ufo_output_task_release_output_buffer (UFO_OUTPUT_TASK (sink), output);
+        input = ufo_input_task_get_input_buffer (UFO_INPUT_TASK (source));
+    }
+
+    ufo_input_task_stop (UFO_INPUT_TASK (source));
+    error = g_thread_join (thread);
+    g_assert_no_error (error);
+
+    g_object_unref (input);
+    ufo_base_scheduler_release (scheduler);
+    g_object_unref (scheduler);
+    g_object_unref (resources);
+}
+
+/*
+ * dummy-data -> split -> output (port 0)
+ *                     -> output (port 1)
+ */
+static void
+test_outputs (Fixture *fixture, gconstpointer data)
+{
+    UfoBaseScheduler *scheduler;
+    UfoTaskNode *source;
+    UfoTaskNode *split;
+    UfoNode *sinks[2];
+    GThread *thread;
+    GError *error = NULL;
+
+    source = get_source (fixture);
+
+    if (source == NULL) {
+        skip_missing_plugins ();
+        return;
+    }
+
+    split = UFO_TASK_NODE (g_object_new (test_split_task_get_type (), NULL));
+    fixture->nodes = g_list_append (fixture->nodes, split);
+    g_assert (!ufo_task_supports_batches (UFO_TASK (split)));
+    ufo_task_graph_connect_nodes (fixture->graph, source, split);
+
+    for (guint i = 0; i < 2; i++) {
+        sinks[i] = ufo_output_task_new (2);
+        fixture->nodes = g_list_append (fixture->nodes, sinks[i]);
+        ufo_task_graph_connect_ports (fixture->graph, split, i, UFO_TASK_NODE (sinks[i]), 0);
+    }
+
+    /* Batching must not take over a task with several outputs */
+    scheduler = ufo_scheduler_new ();
+    g_object_set (scheduler, "expand", FALSE, "batch-size", 4, NULL);
+    g_assert (ufo_base_scheduler_prepare (scheduler, fixture->graph, &error));
+    g_assert_no_error (error);
+
+    thread = g_thread_new (NULL, (GThreadFunc) run_prepared_in_thread, scheduler);
+
+    for (guint i = 0; i < fixture->n_items; i++) {
+        UfoBuffer *copy;
+        UfoBuffer *doubled;
+        gfloat *copy_mem;
+        gfloat *double_mem;
+
+        copy = ufo_output_task_get_output_buffer (UFO_OUTPUT_TASK (sinks[0]));
+        doubled = ufo_output_task_get_output_buffer (UFO_OUTPUT_TASK (sinks[1]));
+        g_assert (copy != NULL && doubled != NULL);
+        g_assert_cmpuint (ufo_buffer_get_sequence (copy), ==, i);
+        g_assert_cmpuint (ufo_buffer_get_sequence (doubled), ==, i);
+
+        copy_mem = ufo_buffer_get_host_array (copy, NULL);
+        double_mem = ufo_buffer_get_host_array (doubled, NULL);
+
+        for (gsize j = 0; j < ufo_buffer_get_size (copy) / sizeof (gfloat); j++)
+            g_assert (double_mem[j] == 2.0f * copy_mem[j]);
+
+        ufo_output_task_release_output_buffer (UFO_OUTPUT_TASK (sinks[0]), copy);
+        ufo_output_task_release_output_buffer (UFO_OUTPUT_TASK (sinks[1]), doubled);
+    }
+
+    error = g_thread_join (thread);
+    g_assert_no_error (error);
+
+    ufo_base_scheduler_release (scheduler);
+    g_object_unref (scheduler);
+}
+
+static gdouble
+time_chain (Fixture *fixture, UfoBaseScheduler *scheduler)
+{
+    GTimer *timer;
+    gdouble elapsed;
+
+    timer = g_timer_new ();
+    run_graph (fixture, scheduler);
+    elapsed = g_timer_elapsed (timer, NULL);
+    g_timer_destroy (timer);
+    return elapsed;
+}
+
+static void
+test_chain_rate (Fixture *fixture, gconstpointer data)
+{
+    gdouble classic;
+    gdouble stealing;
+
+    if (build_chain (fixture, 8) == NULL) {
+        skip_missing_plugins ();
+        return;
+    }
+
+    classic = time_chain (fixture, ufo_scheduler_new ());
+    stealing = time_chain (fixture, ufo_stealing_scheduler_new ());
+
+    g_test_minimized_result (stealing,
+                             "thread per task: %.3fs, work stealing: %.3fs",
+                             classic, stealing);
+}
+
+void
+test_add_scheduler (void)
+{
+    g_test_add ("/no-opencl/scheduler/stealing/chain",
+                Fixture, NULL,
+                setup, test_chain, teardown);
+
+    g_test_add ("/no-opencl/scheduler/stealing/single-worker",
+                Fixture, NULL,
+                setup, test_single_worker, teardown);
+
+    g_test_add ("/no-opencl/scheduler/stealing/broadcast",
+                Fixture, NULL,
+                setup, test_broadcast, teardown);
+
+    g_test_add ("/no-opencl/scheduler/fuse",
+                Fixture, NULL,
+                setup, test_fuse, teardown);
+
+    g_test_add ("/opencl/scheduler/fuse/elementwise",
+                Fixture, NULL,
+                setup, test_fuse_elementwise, teardown);
+
+    g_test_add ("/no-opencl/scheduler/expand/join",
+                Fixture, NULL,
+                setup, test_expand_join, teardown);
+
+    g_test_add ("/no-opencl/scheduler/expand/stack",
+                Fixture, NULL,
+                setup, test_expand_stack, teardown);
+
+    g_test_add ("/no-opencl/scheduler/costs",
+                Fixture, NULL,
+                setup, test_costs, teardown);
+
+    g_test_add ("/no-opencl/scheduler/costs/map",
+                Fixture, NULL,
+                setup, test_map_costs, teardown);
+
+    g_test_add ("/no-opencl/scheduler/session",
+                Fixture, NULL,
+                setup, test_session, teardown);
+
+    g_test_add ("/no-opencl/scheduler/batches",
+                Fixture, NULL,
+                setup, test_batches, teardown);
+
+    g_test_add ("/no-opencl/scheduler/outputs",
+                Fixture, NULL,
+                setup, test_outputs, teardown);
+
+    g_test_add ("/no-opencl/scheduler/scatter/order",
+                Fixture, NULL,
+                setup, test_scatter_order, teardown);
+
+    if (g_test_perf ()) {
+        g_test_add ("/no-opencl/scheduler/stealing/rate",
+                    Fixture, NULL,
+                    setup, test_chain_rate, teardown);
+    }
+}
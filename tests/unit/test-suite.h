@@ -24,6 +24,9 @@ void test_add_buffer (void);
 void test_add_graph (void);
 void test_add_node (void);
 void test_add_profiler (void);
+void test_add_queue (void);
+void test_add_resources (void);
+void test_add_scheduler (void);
 void test_add_max_input_nodes(void);
 
 #endif
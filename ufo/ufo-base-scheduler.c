@@ -30,9 +30,13 @@
 #endif
 
 #include "ufo-base-scheduler.h"
+#include "ufo-buffer-pool.h"
+#include "ufo-cpu-node.h"
 #include "ufo-task-node.h"
 #include "ufo-task-iface.h"
+#include "ufo-two-way-queue.h"
 #include "ufo-priv.h"
+#include "ufo-enums.h"
 
 /**
  * SECTION:ufo-base-scheduler
@@ -58,20 +62,32 @@ struct _UfoBaseSchedulerPrivate {
     GError          *construct_error;
     UfoResources    *resources;
     GList           *gpu_nodes;
+    GList           *cpu_nodes;
     gboolean         expand;
+    gboolean         fuse;
     gboolean         trace;
     gboolean         ran;
     gboolean         timestamps;
     gdouble          time;
+    UfoTwoWayQueueBackend queue_backend;
+    UfoCpuPlacement  cpu_placement;
+    gchar           *cost_cache;
+    guint            batch_size;
+    UfoTaskGraph    *prepared;
 };
 
 enum {
     PROP_0,
     PROP_EXPAND,
+    PROP_FUSE,
     PROP_ENABLE_TRACING,
     PROP_TIMESTAMPS,
     PROP_TIME,
     PROP_MAX_INPUT_NODES,
+    PROP_QUEUE_BACKEND,
+    PROP_CPU_PLACEMENT,
+    PROP_COST_CACHE,
+    PROP_BATCH_SIZE,
     N_PROPERTIES,
 };
 
@@ -117,6 +133,121 @@ write_tracing_data (UfoTaskGraph *graph)
     g_list_free (nodes);
 }
 
+static void
+log_buffer_pool_statistics (void)
+{
+    guint64 n_hits;
+    guint64 n_misses;
+    guint64 high_water;
+
+    g_object_get (ufo_buffer_pool_get_default (),
+                  "num-hits", &n_hits,
+                  "num-misses", &n_misses,
+                  "high-water", &high_water,
+                  NULL);
+
+    g_debug ("INFO Buffer pool: %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses, high-water %3.2f MB",
+             n_hits, n_misses, high_water / 1024. / 1024.);
+}
+
+static void
+log_transfer_statistics (UfoTaskGraph *graph)
+{
+    GList *nodes;
+    GList *it;
+    guint64 n_copies = 0, n_maps = 0;
+    guint64 copied = 0, mapped = 0;
+
+    nodes = ufo_graph_get_nodes (UFO_GRAPH (graph));
+
+    g_list_for (nodes, it) {
+        UfoProfiler *profiler;
+        guint64 n, n_bytes;
+
+        profiler = ufo_task_node_get_profiler (UFO_TASK_NODE (it->data));
+        ufo_profiler_get_transfers (profiler, UFO_PROFILER_TRANSFER_COPY, &n, &n_bytes);
+        n_copies += n;
+        copied += n_bytes;
+        ufo_profiler_get_transfers (profiler, UFO_PROFILER_TRANSFER_MAP, &n, &n_bytes);
+        n_maps += n;
+        mapped += n_bytes;
+    }
+
+    g_list_free (nodes);
+
+    g_debug ("INFO Transfers: %" G_GUINT64_FORMAT " copies (%3.2f MB), %" G_GUINT64_FORMAT " maps (%3.2f MB)",
+             n_copies, copied / 1024. / 1024., n_maps, mapped / 1024. / 1024.);
+}
+
+static void
+load_costs (UfoTaskGraph *graph,
+            const gchar *filename)
+{
+    GError *error = NULL;
+
+    if (!g_file_test (filename, G_FILE_TEST_EXISTS))
+        return;
+
+    if (!ufo_task_graph_load_costs (graph, filename, &error)) {
+        g_warning ("Could not load costs: %s", error->message);
+        g_error_free (error);
+    }
+}
+
+static void
+save_costs (UfoTaskGraph *graph,
+            const gchar *filename)
+{
+    GError *error = NULL;
+
+    ufo_task_graph_update_costs (graph);
+
+    if (!ufo_task_graph_save_costs (graph, filename, &error)) {
+        g_warning ("Could not save costs: %s", error->message);
+        g_error_free (error);
+    }
+}
+
+static gboolean
+begin_run (UfoBaseScheduler *scheduler,
+           UfoTaskGraph *graph,
+           GError **error)
+{
+    if (!ufo_task_graph_is_alright (graph, error))
+        return FALSE;
+
+    if (scheduler->priv->trace)
+        enable_tracing (graph);
+
+    if (scheduler->priv->cost_cache != NULL)
+        load_costs (graph, scheduler->priv->cost_cache);
+
+    return TRUE;
+}
+
+static void
+end_run (UfoBaseScheduler *scheduler,
+         UfoTaskGraph *graph,
+         GTimer *timer,
+         GError *run_error,
+         GError **error)
+{
+    scheduler->priv->time = g_timer_elapsed (timer, NULL);
+
+    if (run_error != NULL)
+        g_propagate_error (error, run_error);
+    else if (scheduler->priv->cost_cache != NULL)
+        save_costs (graph, scheduler->priv->cost_cache);
+
+    log_buffer_pool_statistics ();
+    log_transfer_statistics (graph);
+
+    if (scheduler->priv->trace)
+        write_tracing_data (graph);
+
+    g_timer_destroy (timer);
+}
+
 void
 ufo_base_scheduler_run (UfoBaseScheduler *scheduler,
                         UfoTaskGraph *graph,
@@ -124,6 +255,7 @@ ufo_base_scheduler_run (UfoBaseScheduler *scheduler,
 {
     UfoBaseSchedulerClass *klass;
     GTimer *timer;
+    GError *tmp_error = NULL;
 
     g_return_if_fail (UFO_IS_BASE_SCHEDULER (scheduler));
 
@@ -131,20 +263,108 @@ ufo_base_scheduler_run (UfoBaseScheduler *scheduler,
 
     g_return_if_fail (klass != NULL && klass->run != NULL);
 
-    if (!ufo_task_graph_is_alright (graph, error))
+    /* The prepared graph may share tasks with @graph */
+    ufo_base_scheduler_release (scheduler);
+
+    if (!begin_run (scheduler, graph, error))
         return;
 
-    if (scheduler->priv->trace)
-        enable_tracing (graph);
+    timer = g_timer_new ();
+    (*klass->run)(scheduler, graph, &tmp_error);
+    end_run (scheduler, graph, timer, tmp_error, error);
+}
+
+/**
+ * ufo_base_scheduler_prepare:
+ * @scheduler: A #UfoBaseScheduler
+ * @task_graph: A #UfoTaskGraph
+ * @error: Location for a #GError or %NULL
+ *
+ * Set up @task_graph once for repeated execution with
+ * ufo_base_scheduler_run_prepared(). Schedulers that support sessions keep
+ * their threads, groups and buffers until ufo_base_scheduler_release() is
+ * called, others set up @task_graph on every run. A previously prepared graph
+ * is released first.
+ *
+ * Returns: %TRUE if @task_graph can be run.
+ */
+gboolean
+ufo_base_scheduler_prepare (UfoBaseScheduler *scheduler,
+                            UfoTaskGraph *task_graph,
+                            GError **error)
+{
+    UfoBaseSchedulerClass *klass;
+
+    g_return_val_if_fail (UFO_IS_BASE_SCHEDULER (scheduler) && UFO_IS_TASK_GRAPH (task_graph), FALSE);
+
+    klass = UFO_BASE_SCHEDULER_GET_CLASS (scheduler);
+    ufo_base_scheduler_release (scheduler);
+
+    if (!begin_run (scheduler, task_graph, error))
+        return FALSE;
+
+    if (!(*klass->prepare)(scheduler, task_graph, error))
+        return FALSE;
+
+    scheduler->priv->prepared = g_object_ref (task_graph);
+    return TRUE;
+}
+
+/**
+ * ufo_base_scheduler_run_prepared:
+ * @scheduler: A #UfoBaseScheduler
+ * @error: Location for a #GError or %NULL
+ *
+ * Run the graph set up with ufo_base_scheduler_prepare() once more. Tasks are
+ * reset with ufo_task_reset() before every run but the first.
+ */
+void
+ufo_base_scheduler_run_prepared (UfoBaseScheduler *scheduler,
+                                 GError **error)
+{
+    UfoBaseSchedulerClass *klass;
+    UfoTaskGraph *graph;
+    GTimer *timer;
+    GError *tmp_error = NULL;
+
+    g_return_if_fail (UFO_IS_BASE_SCHEDULER (scheduler));
+
+    klass = UFO_BASE_SCHEDULER_GET_CLASS (scheduler);
+    graph = scheduler->priv->prepared;
+
+    if (graph == NULL) {
+        g_set_error (error, UFO_BASE_SCHEDULER_ERROR, UFO_BASE_SCHEDULER_ERROR_SETUP,
+                     "No task graph prepared");
+        return;
+    }
 
     timer = g_timer_new ();
-    (*klass->run)(scheduler, graph, error);
-    scheduler->priv->time = g_timer_elapsed (timer, NULL);
+    (*klass->run_prepared)(scheduler, &tmp_error);
+    end_run (scheduler, graph, timer, tmp_error, error);
+}
 
-    if (scheduler->priv->trace)
-        write_tracing_data (graph);
+/**
+ * ufo_base_scheduler_release:
+ * @scheduler: A #UfoBaseScheduler
+ *
+ * Stop the threads and free the groups and buffers kept for the graph set up
+ * with ufo_base_scheduler_prepare().
+ */
+void
+ufo_base_scheduler_release (UfoBaseScheduler *scheduler)
+{
+    UfoBaseSchedulerClass *klass;
 
-    g_timer_destroy (timer);
+    g_return_if_fail (UFO_IS_BASE_SCHEDULER (scheduler));
+
+    if (scheduler->priv->prepared == NULL)
+        return;
+
+    klass = UFO_BASE_SCHEDULER_GET_CLASS (scheduler);
+    (*klass->release)(scheduler);
+
+    g_object_unref (scheduler->priv->prepared);
+    scheduler->priv->prepared = NULL;
 }
 
 void
@@ -224,6 +444,31 @@ ufo_base_scheduler_set_gpu_nodes (UfoBaseScheduler *scheduler,
     scheduler->priv->gpu_nodes = g_list_copy (gpu_nodes);
 }
 
+/**
+ * ufo_base_scheduler_get_cpu_nodes:
+ * @scheduler: A #UfoBaseScheduler
+ *
+ * Get the processors that task threads are pinned to according to the
+ * #UfoBaseScheduler:cpu-placement property.
+ *
+ * Returns: (transfer container) (element-type Ufo.CpuNode): List with
+ * #UfoCpuNode objects or %NULL if threads are not pinned. Free with
+ * g_list_free() but not its elements.
+ */
+GList *
+ufo_base_scheduler_get_cpu_nodes (UfoBaseScheduler *scheduler)
+{
+    UfoBaseSchedulerPrivate *priv;
+
+    g_return_val_if_fail (UFO_IS_BASE_SCHEDULER (scheduler), NULL);
+    priv = UFO_BASE_SCHEDULER_GET_PRIVATE (scheduler);
+
+    if (priv->cpu_nodes == NULL)
+        priv->cpu_nodes = ufo_cpu_node_discover (priv->cpu_placement);
+
+    return g_list_copy (priv->cpu_nodes);
+}
+
 static void
 ufo_base_scheduler_run_real (UfoBaseScheduler *scheduler,
                              UfoTaskGraph *graph,
@@ -233,6 +478,26 @@ ufo_base_scheduler_run_real (UfoBaseScheduler *scheduler,
                  "UfoBaseScheduler::run not implemented");
 }
 
+static gboolean
+ufo_base_scheduler_prepare_real (UfoBaseScheduler *scheduler,
+                                 UfoTaskGraph *graph,
+                                 GError **error)
+{
+    return TRUE;
+}
+
+static void
+ufo_base_scheduler_run_prepared_real (UfoBaseScheduler *scheduler,
+                                      GError **error)
+{
+    UFO_BASE_SCHEDULER_GET_CLASS (scheduler)->run (scheduler, scheduler->priv->prepared, error);
+}
+
+static void
+ufo_base_scheduler_release_real (UfoBaseScheduler *scheduler)
+{
+}
+
 static void
 ufo_base_scheduler_set_property (GObject *object,
                                  guint property_id,
@@ -246,6 +511,10 @@ ufo_base_scheduler_set_property (GObject *object,
             priv->expand = g_value_get_boolean (value);
             break;
 
+        case PROP_FUSE:
+            priv->fuse = g_value_get_boolean (value);
+            break;
+
         case PROP_ENABLE_TRACING:
             priv->trace = g_value_get_boolean (value);
             break;
@@ -254,6 +523,27 @@ ufo_base_scheduler_set_property (GObject *object,
             priv->timestamps = g_value_get_boolean (value);
             break;
 
+        case PROP_QUEUE_BACKEND:
+            priv->queue_backend = g_value_get_enum (value);
+            break;
+
+        case PROP_CPU_PLACEMENT:
+            if (priv->cpu_placement != (UfoCpuPlacement) g_value_get_enum (value)) {
+                g_list_free_full (priv->cpu_nodes, g_object_unref);
+                priv->cpu_nodes = NULL;
+                priv->cpu_placement = g_value_get_enum (value);
+            }
+            break;
+
+        case PROP_COST_CACHE:
+            g_free (priv->cost_cache);
+            priv->cost_cache = g_value_dup_string (value);
+            break;
+
+        case PROP_BATCH_SIZE:
+            priv->batch_size = g_value_get_uint (value);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -273,6 +563,10 @@ ufo_base_scheduler_get_property (GObject *object,
             g_value_set_boolean (value, priv->expand);
             break;
 
+        case PROP_FUSE:
+            g_value_set_boolean (value, priv->fuse);
+            break;
+
         case PROP_ENABLE_TRACING:
             g_value_set_boolean (value, priv->trace);
             break;
@@ -289,6 +583,22 @@ ufo_base_scheduler_get_property (GObject *object,
             g_value_set_uint(value, UFO_MAX_INPUT_NODES);
             break;
 
+        case PROP_QUEUE_BACKEND:
+            g_value_set_enum (value, priv->queue_backend);
+            break;
+
+        case PROP_CPU_PLACEMENT:
+            g_value_set_enum (value, priv->cpu_placement);
+            break;
+
+        case PROP_COST_CACHE:
+            g_value_set_string (value, priv->cost_cache);
+            break;
+
+        case PROP_BATCH_SIZE:
+            g_value_set_uint (value, priv->batch_size);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -301,12 +611,16 @@ ufo_base_scheduler_dispose (GObject *object)
     UfoBaseSchedulerPrivate *priv;
 
     priv = UFO_BASE_SCHEDULER_GET_PRIVATE (object);
+    ufo_base_scheduler_release (UFO_BASE_SCHEDULER (object));
 
     if (priv->resources != NULL) {
         g_object_unref (priv->resources);
         priv->resources = NULL;
     }
 
+    g_list_free_full (priv->cpu_nodes, g_object_unref);
+    priv->cpu_nodes = NULL;
+
     G_OBJECT_CLASS (ufo_base_scheduler_parent_class)->dispose (object);
 }
 
@@ -318,6 +632,7 @@ ufo_base_scheduler_finalize (GObject *object)
     priv = UFO_BASE_SCHEDULER_GET_PRIVATE (object);
 
     g_clear_error (&priv->construct_error);
+    g_free (priv->cost_cache);
 
     G_OBJECT_CLASS (ufo_base_scheduler_parent_class)->finalize (object);
 }
@@ -363,6 +678,9 @@ ufo_base_scheduler_class_init (UfoBaseSchedulerClass *klass)
     GObjectClass *oclass = G_OBJECT_CLASS (klass);
 
     klass->run = ufo_base_scheduler_run_real;
+    klass->prepare = ufo_base_scheduler_prepare_real;
+    klass->run_prepared = ufo_base_scheduler_run_prepared_real;
+    klass->release = ufo_base_scheduler_release_real;
     oclass->set_property = ufo_base_scheduler_set_property;
     oclass->get_property = ufo_base_scheduler_get_property;
     oclass->dispose = ufo_base_scheduler_dispose;
@@ -375,6 +693,13 @@ ufo_base_scheduler_class_init (UfoBaseSchedulerClass *klass)
                               TRUE,
                               G_PARAM_READWRITE);
 
+    properties[PROP_FUSE] =
+        g_param_spec_boolean ("fuse",
+                              "Fuse chains of GPU processors into single tasks",
+                              "Fuse chains of GPU processors into single tasks",
+                              FALSE,
+                              G_PARAM_READWRITE);
+
     properties[PROP_ENABLE_TRACING] =
         g_param_spec_boolean ("enable-tracing",
                               "Enable and write profile traces",
@@ -403,6 +728,36 @@ ufo_base_scheduler_class_init (UfoBaseSchedulerClass *klass)
                           1, G_MAXUINT, UFO_MAX_INPUT_NODES,
                           G_PARAM_READABLE);
 
+    properties[PROP_QUEUE_BACKEND] =
+        g_param_spec_enum ("queue-backend",
+                           "Queue implementation used to pass buffers between tasks",
+                           "Queue implementation used to pass buffers between tasks",
+                           UFO_TYPE_TWO_WAY_QUEUE_BACKEND,
+                           UFO_TWO_WAY_QUEUE_BACKEND_ASYNC,
+                           G_PARAM_READWRITE);
+
+    properties[PROP_CPU_PLACEMENT] =
+        g_param_spec_enum ("cpu-placement",
+                           "Granularity at which task threads are pinned to processors",
+                           "Granularity at which task threads are pinned to processors",
+                           UFO_TYPE_CPU_PLACEMENT,
+                           UFO_CPU_PLACEMENT_NONE,
+                           G_PARAM_READWRITE);
+
+    properties[PROP_COST_CACHE] =
+        g_param_spec_string ("cost-cache",
+                             "File to load and store measured task costs",
+                             "File to load and store measured task costs",
+                             NULL,
+                             G_PARAM_READWRITE);
+
+    properties[PROP_BATCH_SIZE] =
+        g_param_spec_uint ("batch-size",
+                           "Maximum number of items passed to batch-capable tasks at once",
+                           "Maximum number of items passed to batch-capable tasks at once",
+                           1, 1024, 1,
+                           G_PARAM_READWRITE);
+
     for (guint i = PROP_0 + 1; i < N_PROPERTIES; i++)
         g_object_class_install_property (oclass, i, properties[i]);
 
@@ -416,10 +771,17 @@ ufo_base_scheduler_init (UfoBaseScheduler *scheduler)
 
     scheduler->priv = priv = UFO_BASE_SCHEDULER_GET_PRIVATE (scheduler);
     priv->expand = TRUE;
+    priv->fuse = FALSE;
     priv->trace = FALSE;
     priv->timestamps = FALSE;
     priv->ran = FALSE;
     priv->time = 0.0;
+    priv->queue_backend = UFO_TWO_WAY_QUEUE_BACKEND_ASYNC;
+    priv->cpu_placement = UFO_CPU_PLACEMENT_NONE;
     priv->gpu_nodes = NULL;
+    priv->cpu_nodes = NULL;
     priv->resources = NULL;
+    priv->cost_cache = NULL;
+    priv->batch_size = 1;
+    priv->prepared = NULL;
 }
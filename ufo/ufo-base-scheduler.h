@@ -71,18 +71,28 @@ struct _UfoBaseSchedulerClass {
 
     void (*run) (UfoBaseScheduler *scheduler, UfoTaskGraph *graph, GError **error);
     void (*abort) (UfoBaseScheduler *scheduler);
+    gboolean (*prepare) (UfoBaseScheduler *scheduler, UfoTaskGraph *graph, GError **error);
+    void (*run_prepared) (UfoBaseScheduler *scheduler, GError **error);
+    void (*release) (UfoBaseScheduler *scheduler);
 };
 
 void            ufo_base_scheduler_run              (UfoBaseScheduler   *scheduler,
                                                      UfoTaskGraph       *task_graph,
                                                      GError            **error);
 void            ufo_base_scheduler_abort            (UfoBaseScheduler   *scheduler);
+gboolean        ufo_base_scheduler_prepare          (UfoBaseScheduler   *scheduler,
+                                                     UfoTaskGraph       *task_graph,
+                                                     GError            **error);
+void            ufo_base_scheduler_run_prepared     (UfoBaseScheduler   *scheduler,
+                                                     GError            **error);
+void            ufo_base_scheduler_release          (UfoBaseScheduler   *scheduler);
 void            ufo_base_scheduler_set_resources    (UfoBaseScheduler   *scheduler,
                                                      UfoResources       *resources);
 UfoResources   *ufo_base_scheduler_get_resources    (UfoBaseScheduler   *scheduler,
                                                      GError            **error);
 void            ufo_base_scheduler_set_gpu_nodes    (UfoBaseScheduler   *scheduler,
                                                      GList              *gpu_nodes);
+GList          *ufo_base_scheduler_get_cpu_nodes    (UfoBaseScheduler   *scheduler);
 GType           ufo_base_scheduler_get_type         (void);
 GQuark          ufo_base_scheduler_error_quark      (void);
 
@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include <math.h>
+#include <string.h>
 
 #ifdef __APPLE__
 #include <OpenCL/cl.h>
@@ -28,9 +29,15 @@
 #endif
 
 #include "ufo-basic-ops.h"
+#include "ufo-buffer-reduce.h"
+#include "ufo-priv.h"
 
 #define OPS_FILENAME "ufo-basic-ops.cl"
 
+/* Reduction kernels need a power of two local size */
+#define REDUCE_LOCAL_SIZE   128
+#define REDUCE_MAX_GROUPS   64
+
 static cl_event
 operation (const gchar *kernel_name,
            UfoBuffer *arg1,
@@ -70,24 +77,21 @@ ufo_op_set (UfoBuffer *arg,
     cl_mem d_arg;
     cl_event event;
     GError *error = NULL;
-    static GMutex mutex;
 
     ufo_buffer_get_requisition (arg, &requisition);
     d_arg = ufo_buffer_get_device_image (arg, command_queue);
-    kernel = ufo_resources_get_cached_kernel (resources, OPS_FILENAME, "operation_set", &error);
+    kernel = ufo_resources_get_thread_kernel (resources, OPS_FILENAME, "operation_set", &error);
 
     if (error) {
         g_error ("%s\n", error->message);
         return NULL;
     }
 
-    g_mutex_lock (&mutex);
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_arg));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(gfloat), (void *) &value));
     UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
                                                        requisition.n_dims, NULL, requisition.dims,
                                                        NULL, 0, NULL, &event));
-    g_mutex_unlock (&mutex);
 
     return event;
 }
@@ -112,25 +116,22 @@ ufo_op_inv (UfoBuffer *arg,
     cl_kernel kernel;
     cl_mem d_arg;
     GError *error = NULL;
-    static GMutex mutex;
 
     ufo_buffer_get_requisition (arg, &requisition);
 
     d_arg = ufo_buffer_get_device_image (arg, command_queue);
-    kernel = ufo_resources_get_cached_kernel (resources, OPS_FILENAME, "operation_inv", &error);
+    kernel = ufo_resources_get_thread_kernel (resources, OPS_FILENAME, "operation_inv", &error);
 
     if (error) {
         g_error ("%s\n", error->message);
         return NULL;
     }
 
-    g_mutex_lock (&mutex);
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 0, sizeof(void *), (void *) &d_arg));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 1, sizeof(void *), (void *) &d_arg));
     UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel(command_queue, kernel,
                                                       requisition.n_dims, NULL, requisition.dims,
                                                       NULL, 0, NULL, &event));
-    g_mutex_unlock (&mutex);
 
     return event;
 }
@@ -275,7 +276,6 @@ ufo_op_mul_rows (UfoBuffer *arg1,
     cl_event event;
     UfoRequisition arg1_requisition, arg2_requisition, out_requisition;
     GError *error = NULL;
-    static GMutex mutex;
 
     ufo_buffer_get_requisition (arg1, &arg1_requisition);
     ufo_buffer_get_requisition (arg2, &arg2_requisition);
@@ -294,17 +294,16 @@ ufo_op_mul_rows (UfoBuffer *arg1,
         return NULL;
     }
 
-    cl_mem d_arg1 = ufo_buffer_get_device_image (arg1, command_queue);
-    cl_mem d_arg2 = ufo_buffer_get_device_image (arg2, command_queue);
+    cl_mem d_arg1 = ufo_buffer_get_device_image_readonly (arg1, command_queue);
+    cl_mem d_arg2 = ufo_buffer_get_device_image_readonly (arg2, command_queue);
     cl_mem d_out  = ufo_buffer_get_device_image (out, command_queue);
-    cl_kernel kernel = ufo_resources_get_cached_kernel (resources, OPS_FILENAME, "op_mulRows", &error);
+    cl_kernel kernel = ufo_resources_get_thread_kernel (resources, OPS_FILENAME, "op_mulRows", &error);
 
     if (error != NULL) {
         g_error ("Error: %s\n", error->message);
         return NULL;
     }
 
-    g_mutex_lock (&mutex);
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_arg1));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(void *), (void *) &d_arg2));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof(void *), (void *) &d_out));
@@ -316,7 +315,6 @@ ufo_op_mul_rows (UfoBuffer *arg1,
     UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
                                                        operation_requisition.n_dims, NULL, operation_requisition.dims,
                                                        NULL, 0, NULL, &event));
-    g_mutex_unlock (&mutex);
 
     return event;
 }
@@ -332,7 +330,6 @@ operation (const gchar *kernel_name,
     UfoRequisition arg1_requisition, arg2_requisition, out_requisition;
     cl_event event;
     GError *error = NULL;
-    static GMutex mutex;
 
     ufo_buffer_get_requisition (arg1, &arg1_requisition);
     ufo_buffer_get_requisition (arg2, &arg2_requisition);
@@ -346,17 +343,16 @@ operation (const gchar *kernel_name,
         return NULL;
     }
 
-    cl_mem d_arg1 = ufo_buffer_get_device_image (arg1, command_queue);
-    cl_mem d_arg2 = ufo_buffer_get_device_image (arg2, command_queue);
+    cl_mem d_arg1 = ufo_buffer_get_device_image_readonly (arg1, command_queue);
+    cl_mem d_arg2 = ufo_buffer_get_device_image_readonly (arg2, command_queue);
     cl_mem d_out = ufo_buffer_get_device_image (out, command_queue);
-    cl_kernel kernel = ufo_resources_get_cached_kernel (resources, OPS_FILENAME, kernel_name, &error);
+    cl_kernel kernel = ufo_resources_get_thread_kernel (resources, OPS_FILENAME, kernel_name, &error);
 
     if (error) {
         g_error ("%s\n", error->message);
         return NULL;
     }
 
-    g_mutex_lock (&mutex);
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_arg1));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(void *), (void *) &d_arg2));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof(void *), (void *) &d_out));
@@ -364,7 +360,6 @@ operation (const gchar *kernel_name,
     UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
                                                        arg1_requisition.n_dims, NULL, arg1_requisition.dims,
                                                        NULL, 0, NULL, &event));
-    g_mutex_unlock (&mutex);
 
     return event;
 }
@@ -381,7 +376,6 @@ operation2 (const gchar *kernel_name,
     UfoRequisition arg1_requisition, arg2_requisition, out_requisition;
     cl_event event;
     GError *error = NULL;
-    static GMutex mutex;
 
     ufo_buffer_get_requisition (arg1, &arg1_requisition);
     ufo_buffer_get_requisition (arg2, &arg2_requisition);
@@ -395,17 +389,16 @@ operation2 (const gchar *kernel_name,
         return NULL;
     }
 
-    cl_mem d_arg1 = ufo_buffer_get_device_image (arg1, command_queue);
-    cl_mem d_arg2 = ufo_buffer_get_device_image (arg2, command_queue);
+    cl_mem d_arg1 = ufo_buffer_get_device_image_readonly (arg1, command_queue);
+    cl_mem d_arg2 = ufo_buffer_get_device_image_readonly (arg2, command_queue);
     cl_mem d_out = ufo_buffer_get_device_image (out, command_queue);
-    cl_kernel kernel = ufo_resources_get_cached_kernel (resources, OPS_FILENAME, kernel_name, &error);
+    cl_kernel kernel = ufo_resources_get_thread_kernel (resources, OPS_FILENAME, kernel_name, &error);
 
     if (error) {
         g_error ("%s\n", error->message);
         return NULL;
     }
 
-    g_mutex_lock (&mutex);
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 0, sizeof(void *), (void *) &d_arg1));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 1, sizeof(void *), (void *) &d_arg2));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 2, sizeof(gfloat), (void *) &modifier));
@@ -414,7 +407,6 @@ operation2 (const gchar *kernel_name,
     UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
                                                        arg1_requisition.n_dims, NULL, arg1_requisition.dims,
                                                        NULL, 0, NULL, &event));
-    g_mutex_unlock (&mutex);
 
     return event;
 }
@@ -439,28 +431,25 @@ ufo_op_gradient_magnitudes (UfoBuffer *arg,
     UfoRequisition arg_requisition;
     cl_event event;
     GError *error = NULL;
-    static GMutex mutex;
 
     ufo_buffer_get_requisition (arg, &arg_requisition);
     ufo_buffer_resize (out, &arg_requisition);
 
-    cl_mem d_arg = ufo_buffer_get_device_image (arg, command_queue);
+    cl_mem d_arg = ufo_buffer_get_device_image_readonly (arg, command_queue);
     cl_mem d_out = ufo_buffer_get_device_image (out, command_queue);
 
-    cl_kernel kernel = ufo_resources_get_cached_kernel (resources, OPS_FILENAME, "operation_gradient_magnitude", &error);
+    cl_kernel kernel = ufo_resources_get_thread_kernel (resources, OPS_FILENAME, "operation_gradient_magnitude", &error);
 
     if (error) {
         g_error ("%s\n", error->message);
     }
 
-    g_mutex_lock (&mutex);
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_arg));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(void *), (void *) &d_out));
 
     UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
                                                        arg_requisition.n_dims, NULL, arg_requisition.dims,
                                                        NULL, 0, NULL, &event));
-    g_mutex_unlock (&mutex);
 
     return event;
 }
@@ -487,22 +476,20 @@ ufo_op_gradient_directions (UfoBuffer *arg,
     UfoRequisition arg_requisition;
     cl_event event;
     GError *error = NULL;
-    static GMutex mutex;
 
     ufo_buffer_get_requisition (arg, &arg_requisition);
     ufo_buffer_resize (out, &arg_requisition);
 
-    cl_mem d_arg = ufo_buffer_get_device_image (arg, command_queue);
-    cl_mem d_magnitudes = ufo_buffer_get_device_image (magnitudes, command_queue);
+    cl_mem d_arg = ufo_buffer_get_device_image_readonly (arg, command_queue);
+    cl_mem d_magnitudes = ufo_buffer_get_device_image_readonly (magnitudes, command_queue);
     cl_mem d_out = ufo_buffer_get_device_image (out, command_queue);
 
-    cl_kernel kernel = ufo_resources_get_cached_kernel (resources, OPS_FILENAME, "operation_gradient_direction", &error);
+    cl_kernel kernel = ufo_resources_get_thread_kernel (resources, OPS_FILENAME, "operation_gradient_direction", &error);
 
     if (error) {
         g_error ("%s\n", error->message);
     }
 
-    g_mutex_lock (&mutex);
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_arg));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(void *), (void *) &d_magnitudes));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof(void *), (void *) &d_out));
@@ -510,11 +497,182 @@ ufo_op_gradient_directions (UfoBuffer *arg,
     UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
                                                        arg_requisition.n_dims, NULL, arg_requisition.dims,
                                                        NULL, 0, NULL, &event));
-    g_mutex_unlock (&mutex);
 
     return event;
 }
 
+static gsize
+get_num_elements (UfoBuffer *buffer)
+{
+    UfoRequisition requisition;
+    gsize n = 1;
+
+    ufo_buffer_get_requisition (buffer, &requisition);
+
+    for (guint i = 0; i < requisition.n_dims; i++)
+        n *= requisition.dims[i];
+
+    return n;
+}
+
+/*
+ * Reduce on the device if the data is only up-to-date there, so we do not
+ * trigger a device to host transfer just for a few numbers. Work items and
+ * groups sum in single precision and only the group results are added up in
+ * double precision, whereas the host reductions use double precision
+ * throughout. Sums over large buffers may thus differ in the last digits of a
+ * float.
+ */
+static gboolean
+is_device_resident (UfoBuffer *buffer)
+{
+    return !ufo_buffer_is_valid_at (buffer, UFO_BUFFER_LOCATION_HOST) &&
+           ufo_buffer_get_location (buffer) != UFO_BUFFER_LOCATION_INVALID;
+}
+
+static void
+reduce_on_device (const gchar *kernel_name,
+                  UfoBuffer *arg1,
+                  UfoBuffer *arg2,
+                  UfoResources *resources,
+                  gpointer command_queue,
+                  UfoBufferStatistics *result)
+{
+    cl_float4 partial[REDUCE_MAX_GROUPS];
+    cl_kernel kernel;
+    cl_mem d_arg1;
+    cl_mem d_arg2;
+    cl_mem d_partial;
+    cl_uint n;
+    gsize local_size = REDUCE_LOCAL_SIZE;
+    gsize global_size;
+    gsize n_groups;
+    GError *error = NULL;
+
+    n = (cl_uint) get_num_elements (arg1);
+    n_groups = CLAMP ((n + local_size - 1) / local_size, 1, REDUCE_MAX_GROUPS);
+    global_size = n_groups * local_size;
+
+    d_arg1 = ufo_buffer_get_device_array_readonly (arg1, command_queue);
+    d_arg2 = arg2 != NULL ? ufo_buffer_get_device_array_readonly (arg2, command_queue) : d_arg1;
+    kernel = ufo_resources_get_thread_kernel (resources, OPS_FILENAME, kernel_name, &error);
+
+    if (error) {
+        g_error ("%s\n", error->message);
+        return;
+    }
+
+    d_partial = ufo_resources_get_thread_mem (resources, "reduce-partial", REDUCE_MAX_GROUPS * sizeof (cl_float4));
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &d_arg1));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof (cl_mem), &d_arg2));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof (cl_mem), &d_partial));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 3, local_size * sizeof (cl_float4), NULL));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 4, sizeof (cl_uint), &n));
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
+                                                       1, NULL, &global_size, &local_size,
+                                                       0, NULL, NULL));
+
+    /* Only the per-group results are read back */
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueReadBuffer (command_queue, d_partial, CL_TRUE,
+                                                    0, n_groups * sizeof (cl_float4), partial,
+                                                    0, NULL, NULL));
+
+    result->min = G_MAXFLOAT;
+    result->max = -G_MAXFLOAT;
+    result->sum = 0.0;
+    result->sum_squares = 0.0;
+
+    for (gsize i = 0; i < n_groups; i++) {
+        result->min = MIN (result->min, partial[i].s[0]);
+        result->max = MAX (result->max, partial[i].s[1]);
+        result->sum += partial[i].s[2];
+        result->sum_squares += partial[i].s[3];
+    }
+}
+
+static void
+histogram_on_device (UfoBuffer *arg,
+                     gfloat lower,
+                     gfloat upper,
+                     guint n_bins,
+                     guint *histogram,
+                     UfoResources *resources,
+                     gpointer command_queue)
+{
+    cl_kernel kernel;
+    cl_mem d_arg;
+    cl_mem d_bins;
+    cl_uint n;
+    gsize global_size;
+    GError *error = NULL;
+
+    n = (cl_uint) get_num_elements (arg);
+    global_size = CLAMP ((n + REDUCE_LOCAL_SIZE - 1) / REDUCE_LOCAL_SIZE, 1, REDUCE_MAX_GROUPS) * REDUCE_LOCAL_SIZE;
+
+    d_arg = ufo_buffer_get_device_array_readonly (arg, command_queue);
+    kernel = ufo_resources_get_thread_kernel (resources, OPS_FILENAME, "histogram", &error);
+
+    if (error) {
+        g_error ("%s\n", error->message);
+        return;
+    }
+
+    memset (histogram, 0, n_bins * sizeof (guint));
+    d_bins = ufo_resources_get_thread_mem (resources, "histogram-bins", n_bins * sizeof (cl_uint));
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueWriteBuffer (command_queue, d_bins, CL_FALSE,
+                                                     0, n_bins * sizeof (cl_uint), histogram,
+                                                     0, NULL, NULL));
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &d_arg));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof (cl_mem), &d_bins));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof (cl_uint), &n));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 3, sizeof (cl_uint), &n_bins));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 4, sizeof (cl_float), &lower));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 5, sizeof (cl_float), &upper));
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
+                                                       1, NULL, &global_size, NULL,
+                                                       0, NULL, NULL));
+
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueReadBuffer (command_queue, d_bins, CL_TRUE,
+                                                    0, n_bins * sizeof (cl_uint), histogram,
+                                                    0, NULL, NULL));
+}
+
+/**
+ * ufo_op_statistics:
+ * @arg: A #UfoBuffer
+ * @resources: #UfoResources object
+ * @command_queue: A valid cl_command_queue
+ * @stats: (out caller-allocates): Location for the statistics
+ * @n_bins: Number of histogram bins or 0
+ * @histogram: (array length=n_bins) (allow-none): Array of @n_bins counters
+ *  or %NULL
+ *
+ * Like ufo_buffer_get_statistics() but reduces @arg on the device if its data
+ * is not valid on the host, so that only the results need to be transferred.
+ * The device accumulates partial sums in single precision, so the sums may
+ * differ slightly from the host result for large buffers.
+ */
+void
+ufo_op_statistics (UfoBuffer *arg,
+                   UfoResources *resources,
+                   gpointer command_queue,
+                   UfoBufferStatistics *stats,
+                   guint n_bins,
+                   guint *histogram)
+{
+    if (!is_device_resident (arg)) {
+        ufo_buffer_get_statistics (arg, command_queue, stats, n_bins, histogram);
+        return;
+    }
+
+    reduce_on_device ("reduce_statistics", arg, NULL, resources, command_queue, stats);
+
+    if (n_bins > 0 && histogram != NULL)
+        histogram_on_device (arg, stats->min, stats->max, n_bins, histogram, resources, command_queue);
+}
+
 /**
  * ufo_op_l1_norm:
  * @arg: A #UfoBuffer
@@ -528,20 +686,15 @@ ufo_op_l1_norm (UfoBuffer *arg,
                 UfoResources *resources,
                 gpointer command_queue)
 {
-    UfoRequisition arg_requisition;
-    gfloat *values;
-    gfloat norm = 0;
+    UfoBufferStatistics result;
 
-    ufo_buffer_get_requisition (arg, &arg_requisition);
-    values = ufo_buffer_get_host_array (arg, command_queue);
-
-    for (guint i = 0; i < arg_requisition.dims[0]; ++i) {
-        for (guint j = 0; j < arg_requisition.dims[1]; ++j) {
-            norm += (gfloat) fabs (values[i * arg_requisition.dims[1] + j]);
-        }
+    if (is_device_resident (arg)) {
+        reduce_on_device ("reduce_abs_sum", arg, NULL, resources, command_queue, &result);
+        return (gfloat) result.sum;
     }
 
-    return norm;
+    return (gfloat) ufo_reduce_abs_sum (ufo_buffer_get_host_array_readonly (arg, command_queue),
+                                        get_num_elements (arg));
 }
 
 /**
@@ -559,44 +712,33 @@ ufo_op_euclidean_distance (UfoBuffer *arg1,
                            UfoResources *resources,
                            gpointer command_queue)
 {
-    UfoRequisition arg1_requisition, arg2_requisition;
-    guint length;
-    gfloat diff;
-    gfloat norm = 0;
-    guint length1 = 0;
-    guint length2 = 0;
-    gfloat *values1;
-    gfloat *values2;
+    UfoBufferStatistics result;
+    gsize length;
+    gsize length1;
+    gsize length2;
+    gdouble norm;
+    const gfloat *values1;
+    const gfloat *values2;
 
-    ufo_buffer_get_requisition (arg1, &arg1_requisition);
-    ufo_buffer_get_requisition (arg2, &arg2_requisition);
-
-    for (guint i = 0; i < arg1_requisition.n_dims; ++i)
-        length1 += (guint)arg1_requisition.dims[i];
-
-    for (guint i = 0; i < arg2_requisition.n_dims; ++i)
-        length2 += (guint)arg2_requisition.dims[i];
+    length1 = get_num_elements (arg1);
+    length2 = get_num_elements (arg2);
 
     if (length2 != length1)
         g_warning ("Sizes of buffers are not the same. Zero-padding applied.");
-
-    length = length2 < length1 ? length2 : length1;
-    values1 = ufo_buffer_get_host_array (arg1, command_queue);
-    values2 = ufo_buffer_get_host_array (arg2, command_queue);
-
-    for (guint i = 0; i < length; ++i) {
-        diff = values1[i] - values2[i];
-        norm += powf (diff, 2);
+    else if (is_device_resident (arg1) && is_device_resident (arg2)) {
+        reduce_on_device ("reduce_squared_distance", arg1, arg2, resources, command_queue, &result);
+        return (gfloat) sqrt (result.sum);
     }
 
-    for (guint i = length; i < length2; ++i)
-        norm += powf (values2[i], 2);
+    length = MIN (length1, length2);
+    values1 = ufo_buffer_get_host_array_readonly (arg1, command_queue);
+    values2 = ufo_buffer_get_host_array_readonly (arg2, command_queue);
 
-    for (guint i = length; i < length1; ++i)
-        norm += powf (values1[i], 2);
+    norm = ufo_reduce_squared_distance (values1, values2, length) +
+           ufo_reduce_squared_distance (values1 + length, NULL, length1 - length) +
+           ufo_reduce_squared_distance (values2 + length, NULL, length2 - length);
 
-    norm = sqrtf(norm);
-    return norm;
+    return (gfloat) sqrt (norm);
 }
 
 /**
@@ -612,7 +754,15 @@ ufo_op_l2_norm (UfoBuffer *arg,
                 UfoResources *resources,
                 gpointer command_queue)
 {
-    return ufo_op_euclidean_distance (arg, arg, resources, command_queue);
+    UfoBufferStatistics result;
+
+    if (is_device_resident (arg)) {
+        reduce_on_device ("reduce_statistics", arg, NULL, resources, command_queue, &result);
+        return (gfloat) sqrt (result.sum_squares);
+    }
+
+    return (gfloat) sqrt (ufo_reduce_squared_distance (ufo_buffer_get_host_array_readonly (arg, command_queue),
+                                                       NULL, get_num_elements (arg)));
 }
 
 /**
@@ -633,28 +783,25 @@ ufo_op_POSC (UfoBuffer *arg,
     UfoRequisition arg_requisition;
     cl_event event;
     GError *error = NULL;
-    static GMutex mutex;
 
     ufo_buffer_get_requisition (arg, &arg_requisition);
     ufo_buffer_resize (out, &arg_requisition);
 
-    cl_mem d_arg = ufo_buffer_get_device_image (arg, command_queue);
+    cl_mem d_arg = ufo_buffer_get_device_image_readonly (arg, command_queue);
     cl_mem d_out = ufo_buffer_get_device_image (out, command_queue);
 
-    cl_kernel kernel = ufo_resources_get_cached_kernel (resources, OPS_FILENAME, "POSC", &error);
+    cl_kernel kernel = ufo_resources_get_thread_kernel (resources, OPS_FILENAME, "POSC", &error);
 
     if (error) {
         g_error ("%s\n", error->message);
     }
 
-    g_mutex_lock (&mutex);
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof(void *), (void *) &d_arg));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof(void *), (void *) &d_out));
 
     UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
                                                        arg_requisition.n_dims, NULL, arg_requisition.dims,
                                                        NULL, 0, NULL, &event));
-    g_mutex_unlock (&mutex);
 
     return event;
 }
@@ -677,28 +824,76 @@ ufo_op_gradient_descent (UfoBuffer *arg,
     UfoRequisition arg_requisition;
     cl_event event;
     GError *error = NULL;
-    static GMutex mutex;
 
     ufo_buffer_get_requisition (arg, &arg_requisition);
     ufo_buffer_resize (out, &arg_requisition);
 
-    cl_mem d_arg = ufo_buffer_get_device_image (arg, command_queue);
+    cl_mem d_arg = ufo_buffer_get_device_image_readonly (arg, command_queue);
     cl_mem d_out = ufo_buffer_get_device_image (out, command_queue);
 
-    cl_kernel kernel = ufo_resources_get_cached_kernel (resources, OPS_FILENAME, "descent_grad", &error);
+    cl_kernel kernel = ufo_resources_get_thread_kernel (resources, OPS_FILENAME, "descent_grad", &error);
 
     if (error) {
         g_error ("%s\n", error->message);
     }
 
-    g_mutex_lock (&mutex);
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 0, sizeof(void *), (void *) &d_arg));
     UFO_RESOURCES_CHECK_CLERR (clSetKernelArg(kernel, 1, sizeof(void *), (void *) &d_out));
 
     UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (command_queue, kernel,
                                                        arg_requisition.n_dims, NULL, arg_requisition.dims,
                                                        NULL, 0, NULL, &event));
-    g_mutex_unlock (&mutex);
 
     return event;
 }
+
+/**
+ * ufo_op_convert_depth:
+ * @arg: A #UfoBuffer
+ * @resources: #UfoResources object
+ * @command_queue: A valid cl_command_queue
+ *
+ * Upload raw data of @arg in its compact storage depth and convert it to
+ * 32-bit floats on the device. Does nothing if @arg does not hold raw data.
+ */
+void
+ufo_op_convert_depth (UfoBuffer *arg,
+                      UfoResources *resources,
+                      gpointer command_queue)
+{
+    const gchar *kernel_name;
+    cl_kernel kernel;
+    GError *error = NULL;
+
+    switch (ufo_buffer_get_depth (arg)) {
+        case UFO_BUFFER_DEPTH_8U:
+            kernel_name = "convert_8u";
+            break;
+        case UFO_BUFFER_DEPTH_12U:
+            kernel_name = "convert_12u";
+            break;
+        case UFO_BUFFER_DEPTH_16U:
+            kernel_name = "convert_16u";
+            break;
+        case UFO_BUFFER_DEPTH_16S:
+            kernel_name = "convert_16s";
+            break;
+        case UFO_BUFFER_DEPTH_32S:
+            kernel_name = "convert_32s";
+            break;
+        case UFO_BUFFER_DEPTH_32U:
+            kernel_name = "convert_32u";
+            break;
+        default:
+            return;
+    }
+
+    kernel = ufo_resources_get_thread_kernel (resources, OPS_FILENAME, kernel_name, &error);
+
+    if (error) {
+        g_error ("%s\n", error->message);
+        return;
+    }
+
+    ufo_buffer_convert_raw_on_device (arg, kernel, command_queue);
+}
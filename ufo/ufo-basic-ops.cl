@@ -323,4 +323,174 @@ void descent_grad (__read_only image2d_t arg_r,
 
   float value = part[0] - part[1] - part[2];
   write_imagef(out, coord_w, value);
-}
\ No newline at end of file
+}
+
+__kernel
+void convert_8u (__global const uchar *in,
+                 __global float *out,
+                 const uint n)
+{
+  const uint idx = get_global_id(0);
+
+  if (idx < n)
+    out[idx] = (float) in[idx];
+}
+
+__kernel
+void convert_12u (__global const uchar *in,
+                  __global float *out,
+                  const uint n)
+{
+  const uint idx = get_global_id(0);
+  const uint i = 2 * idx;
+  const uint j = 3 * idx;
+
+  if (i >= n)
+    return;
+
+  out[i] = (float) ((in[j] << 4) | ((in[j + 1] & 0xF0) >> 4));
+
+  if (i + 1 < n)
+    out[i + 1] = (float) (((in[j + 1] & 0x0F) << 8) | in[j + 2]);
+}
+
+__kernel
+void convert_16u (__global const ushort *in,
+                  __global float *out,
+                  const uint n)
+{
+  const uint idx = get_global_id(0);
+
+  if (idx < n)
+    out[idx] = (float) in[idx];
+}
+
+__kernel
+void convert_16s (__global const short *in,
+                  __global float *out,
+                  const uint n)
+{
+  const uint idx = get_global_id(0);
+
+  if (idx < n)
+    out[idx] = (float) in[idx];
+}
+
+__kernel
+void convert_32s (__global const int *in,
+                  __global float *out,
+                  const uint n)
+{
+  const uint idx = get_global_id(0);
+
+  if (idx < n)
+    out[idx] = (float) in[idx];
+}
+
+__kernel
+void convert_32u (__global const uint *in,
+                  __global float *out,
+                  const uint n)
+{
+  const uint idx = get_global_id(0);
+
+  if (idx < n)
+    out[idx] = (float) in[idx];
+}
+
+/*
+ * Reductions accumulate (min, max, sum, sum of squares) per work item with a
+ * grid-stride loop, reduce them in local memory and write one partial result
+ * per work group. The local size must be a power of two.
+ */
+void reduce_work_group (float4 acc,
+                        __local float4 *scratch,
+                        __global float4 *partial)
+{
+  const uint lid = get_local_id(0);
+
+  scratch[lid] = acc;
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  for (uint s = get_local_size(0) / 2; s > 0; s >>= 1) {
+    if (lid < s) {
+      float4 a = scratch[lid];
+      float4 b = scratch[lid + s];
+      scratch[lid] = (float4) (fmin(a.x, b.x), fmax(a.y, b.y), a.z + b.z, a.w + b.w);
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  if (lid == 0)
+    partial[get_group_id(0)] = scratch[0];
+}
+
+__kernel
+void reduce_statistics (__global const float *in,
+                        __global const float *unused,
+                        __global float4 *partial,
+                        __local float4 *scratch,
+                        const uint n)
+{
+  float4 acc = (float4) (MAXFLOAT, -MAXFLOAT, 0.0f, 0.0f);
+
+  for (uint i = get_global_id(0); i < n; i += get_global_size(0)) {
+    const float v = in[i];
+    acc = (float4) (fmin(acc.x, v), fmax(acc.y, v), acc.z + v, acc.w + v * v);
+  }
+
+  reduce_work_group (acc, scratch, partial);
+}
+
+__kernel
+void reduce_abs_sum (__global const float *in,
+                     __global const float *unused,
+                     __global float4 *partial,
+                     __local float4 *scratch,
+                     const uint n)
+{
+  float4 acc = (float4) (MAXFLOAT, -MAXFLOAT, 0.0f, 0.0f);
+
+  for (uint i = get_global_id(0); i < n; i += get_global_size(0))
+    acc.z += fabs(in[i]);
+
+  reduce_work_group (acc, scratch, partial);
+}
+
+__kernel
+void reduce_squared_distance (__global const float *in1,
+                              __global const float *in2,
+                              __global float4 *partial,
+                              __local float4 *scratch,
+                              const uint n)
+{
+  float4 acc = (float4) (MAXFLOAT, -MAXFLOAT, 0.0f, 0.0f);
+
+  for (uint i = get_global_id(0); i < n; i += get_global_size(0)) {
+    const float diff = in1[i] - in2[i];
+    acc.z += diff * diff;
+  }
+
+  reduce_work_group (acc, scratch, partial);
+}
+
+__kernel
+void histogram (__global const float *in,
+                __global uint *bins,
+                const uint n,
+                const uint n_bins,
+                const float lower,
+                const float upper)
+{
+  const float scale = upper > lower ? n_bins / (upper - lower) : 0.0f;
+
+  for (uint i = get_global_id(0); i < n; i += get_global_size(0)) {
+    const float v = in[i];
+
+    if (!(v >= lower && v <= upper))
+      continue;
+
+    atomic_inc (&bins[min((uint) ((v - lower) * scale), n_bins - 1)]);
+  }
+}
@@ -82,6 +82,12 @@ gpointer ufo_op_gradient_directions
                              UfoBuffer      *out,
                              UfoResources   *resources,
                              gpointer        command_queue);
+void ufo_op_statistics      (UfoBuffer      *arg,
+                             UfoResources   *resources,
+                             gpointer        command_queue,
+                             UfoBufferStatistics *stats,
+                             guint           n_bins,
+                             guint          *histogram);
 gfloat ufo_op_l1_norm       (UfoBuffer      *arg,
                              UfoResources   *resources,
                              gpointer        command_queue);
@@ -102,6 +108,9 @@ gpointer ufo_op_gradient_descent
                              UfoBuffer      *out,
                              UfoResources   *resources,
                              gpointer        command_queue);
+void ufo_op_convert_depth   (UfoBuffer      *arg,
+                             UfoResources   *resources,
+                             gpointer        command_queue);
 
 G_END_DECLS
 
@@ -0,0 +1,649 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "ufo-buffer-convert.h"
+
+/*
+ * All conversions run from the back to the front of the data. Because the
+ * source elements are at most as wide as the 32-bit float target, this allows
+ * converting in place, i.e. with dst pointing to the same memory as src. The
+ * vectorized versions keep this property as long as every block is loaded
+ * completely before it is stored.
+ *
+ * Frames larger than CHUNK_MIN_PIXELS are split into chunks that are
+ * converted in parallel, unless in-place conversion of narrow data would make
+ * the chunks overlap.
+ */
+#define CHUNK_MIN_PIXELS    (1 << 20)
+#define CHUNK_ALIGNMENT     64
+#define MAX_CHUNKS          16
+
+typedef struct {
+    GMutex  lock;
+    GCond   cond;
+    guint   remaining;
+} ConvertJob;
+
+typedef struct {
+    gfloat          *dst;
+    gconstpointer    src;
+    gsize            start;
+    gsize            end;
+    UfoBufferDepth   depth;
+    UfoConvertImpl   impl;
+    ConvertJob      *job;
+} ConvertChunk;
+
+static void
+convert_12u_scalar (gfloat *dst,
+                    const guint8 *src,
+                    gsize start,
+                    gsize end)
+{
+    gsize i = end;
+    gsize j;
+
+    /* start is always even, hence an odd number of pixels leaves a single
+     * pixel formed by the upper one and a half bytes of the last triple. */
+    if ((end - start) % 2) {
+        i = end - 1;
+        j = 3 * i / 2;
+        dst[i] = (gfloat) ((src[j] << 4) | ((src[j + 1] & 0xF0) >> 4));
+    }
+
+    while (i > start) {
+        guint8 first, second, third;
+
+        i -= 2;
+        j = 3 * i / 2;
+        first = src[j];
+        second = src[j + 1];
+        third = src[j + 2];
+        /* First pixel: shift first byte by 4 and add the upper half of the second byte */
+        dst[i] = (gfloat) ((first << 4) | ((second & 0xF0) >> 4));
+        /* Second pixel: shift second byte by 8 and add the lower half of the second byte */
+        dst[i + 1] = (gfloat) (((second & 0x0F) << 8) | third);
+    }
+}
+
+static void
+convert_scalar (gfloat *dst,
+                gconstpointer data,
+                gsize start,
+                gsize end,
+                UfoBufferDepth depth)
+{
+    switch (depth) {
+        case UFO_BUFFER_DEPTH_8U:
+            {
+                const guint8 *src = (const guint8 *) data;
+
+                for (gsize i = end; i > start; i--)
+                    dst[i - 1] = (gfloat) src[i - 1];
+            }
+            break;
+        case UFO_BUFFER_DEPTH_12U:
+            convert_12u_scalar (dst, (const guint8 *) data, start, end);
+            break;
+        case UFO_BUFFER_DEPTH_16U:
+            {
+                const guint16 *src = (const guint16 *) data;
+
+                for (gsize i = end; i > start; i--)
+                    dst[i - 1] = (gfloat) src[i - 1];
+            }
+            break;
+        case UFO_BUFFER_DEPTH_16S:
+            {
+                const gint16 *src = (const gint16 *) data;
+
+                for (gsize i = end; i > start; i--)
+                    dst[i - 1] = (gfloat) src[i - 1];
+            }
+            break;
+        case UFO_BUFFER_DEPTH_32S:
+            {
+                const gint32 *src = (const gint32 *) data;
+
+                for (gsize i = end; i > start; i--)
+                    dst[i - 1] = (gfloat) src[i - 1];
+            }
+            break;
+        case UFO_BUFFER_DEPTH_32U:
+            {
+                const guint32 *src = (const guint32 *) data;
+
+                for (gsize i = end; i > start; i--)
+                    dst[i - 1] = (gfloat) src[i - 1];
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Convert [start, end) in blocks of width pixels from back to front. The last
+ * pixels that do not fill a whole block, and reserve pixels that a block may
+ * read beyond its end, are converted by the scalar code first.
+ */
+#define CONVERT_BLOCKS(width, reserve, block)                                   \
+    {                                                                           \
+        gsize n_blocks = (end - start) > (reserve) ?                            \
+                         (end - start - (reserve)) / (width) : 0;               \
+        gsize i = start + n_blocks * (width);                                   \
+                                                                                \
+        convert_scalar (dst, data, i, end, depth);                              \
+                                                                                \
+        while (i > start) {                                                     \
+            i -= (width);                                                       \
+            block;                                                              \
+        }                                                                       \
+    }
+
+#ifdef UFO_CONVERT_X86
+
+static inline UFO_TARGET("sse2") __m128
+cvt_u32_sse2 (__m128i v)
+{
+    /* There is no unsigned conversion before AVX-512. Both halves convert
+     * exactly, so the sum is rounded only once like a scalar conversion. */
+    __m128 hi = _mm_cvtepi32_ps (_mm_srli_epi32 (v, 16));
+    __m128 lo = _mm_cvtepi32_ps (_mm_and_si128 (v, _mm_set1_epi32 (0xFFFF)));
+
+    return _mm_add_ps (_mm_mul_ps (hi, _mm_set1_ps (65536.0f)), lo);
+}
+
+static UFO_TARGET("sse2") void
+convert_sse2 (gfloat *dst,
+              gconstpointer data,
+              gsize start,
+              gsize end,
+              UfoBufferDepth depth)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+
+    switch (depth) {
+        case UFO_BUFFER_DEPTH_8U:
+            CONVERT_BLOCKS (8, 0, {
+                __m128i v = _mm_loadl_epi64 ((const __m128i *) ((const guint8 *) data + i));
+                __m128i w = _mm_unpacklo_epi8 (v, zero);
+                _mm_storeu_ps (dst + i, _mm_cvtepi32_ps (_mm_unpacklo_epi16 (w, zero)));
+                _mm_storeu_ps (dst + i + 4, _mm_cvtepi32_ps (_mm_unpackhi_epi16 (w, zero)));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_16U:
+            CONVERT_BLOCKS (8, 0, {
+                __m128i v = _mm_loadu_si128 ((const __m128i *) ((const guint16 *) data + i));
+                _mm_storeu_ps (dst + i, _mm_cvtepi32_ps (_mm_unpacklo_epi16 (v, zero)));
+                _mm_storeu_ps (dst + i + 4, _mm_cvtepi32_ps (_mm_unpackhi_epi16 (v, zero)));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_16S:
+            CONVERT_BLOCKS (8, 0, {
+                __m128i v = _mm_loadu_si128 ((const __m128i *) ((const gint16 *) data + i));
+                _mm_storeu_ps (dst + i, _mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16)));
+                _mm_storeu_ps (dst + i + 4, _mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpackhi_epi16 (v, v), 16)));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_32S:
+            CONVERT_BLOCKS (8, 0, {
+                __m128i a = _mm_loadu_si128 ((const __m128i *) ((const gint32 *) data + i));
+                __m128i b = _mm_loadu_si128 ((const __m128i *) ((const gint32 *) data + i + 4));
+                _mm_storeu_ps (dst + i, _mm_cvtepi32_ps (a));
+                _mm_storeu_ps (dst + i + 4, _mm_cvtepi32_ps (b));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_32U:
+            CONVERT_BLOCKS (8, 0, {
+                __m128i a = _mm_loadu_si128 ((const __m128i *) ((const guint32 *) data + i));
+                __m128i b = _mm_loadu_si128 ((const __m128i *) ((const guint32 *) data + i + 4));
+                _mm_storeu_ps (dst + i, cvt_u32_sse2 (a));
+                _mm_storeu_ps (dst + i + 4, cvt_u32_sse2 (b));
+            });
+            break;
+        default:
+            /* 12-bit unpacking needs byte shuffles that SSE2 lacks */
+            convert_scalar (dst, data, start, end, depth);
+    }
+}
+
+static inline UFO_TARGET("avx2") __m256
+cvt_u32_avx2 (__m256i v)
+{
+    __m256 hi = _mm256_cvtepi32_ps (_mm256_srli_epi32 (v, 16));
+    __m256 lo = _mm256_cvtepi32_ps (_mm256_and_si256 (v, _mm256_set1_epi32 (0xFFFF)));
+
+    return _mm256_add_ps (_mm256_mul_ps (hi, _mm256_set1_ps (65536.0f)), lo);
+}
+
+static inline UFO_TARGET("avx2") __m128i
+unpack_12u_avx2 (const guint8 *src)
+{
+    /* Each three bytes form two pixels. Gather the big-endian 16-bit words
+     * (b0 b1) and (b1 b2), shift the first and mask the second. */
+    const __m128i shuffle = _mm_setr_epi8 (1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    __m128i v = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) src), shuffle);
+
+    return _mm_blend_epi16 (_mm_and_si128 (v, _mm_set1_epi16 (0x0FFF)), _mm_srli_epi16 (v, 4), 0x55);
+}
+
+static UFO_TARGET("avx2") void
+convert_avx2 (gfloat *dst,
+              gconstpointer data,
+              gsize start,
+              gsize end,
+              UfoBufferDepth depth)
+{
+    switch (depth) {
+        case UFO_BUFFER_DEPTH_8U:
+            CONVERT_BLOCKS (8, 0, {
+                __m128i v = _mm_loadl_epi64 ((const __m128i *) ((const guint8 *) data + i));
+                _mm256_storeu_ps (dst + i, _mm256_cvtepi32_ps (_mm256_cvtepu8_epi32 (v)));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_12U:
+            /* A block of eight pixels loads 16 instead of 12 bytes, so keep
+             * three pixels (at least four bytes) in reserve at the end */
+            CONVERT_BLOCKS (8, 3, {
+                __m128i v = unpack_12u_avx2 ((const guint8 *) data + 3 * i / 2);
+                _mm256_storeu_ps (dst + i, _mm256_cvtepi32_ps (_mm256_cvtepu16_epi32 (v)));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_16U:
+            CONVERT_BLOCKS (8, 0, {
+                __m128i v = _mm_loadu_si128 ((const __m128i *) ((const guint16 *) data + i));
+                _mm256_storeu_ps (dst + i, _mm256_cvtepi32_ps (_mm256_cvtepu16_epi32 (v)));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_16S:
+            CONVERT_BLOCKS (8, 0, {
+                __m128i v = _mm_loadu_si128 ((const __m128i *) ((const gint16 *) data + i));
+                _mm256_storeu_ps (dst + i, _mm256_cvtepi32_ps (_mm256_cvtepi16_epi32 (v)));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_32S:
+            CONVERT_BLOCKS (8, 0, {
+                __m256i v = _mm256_loadu_si256 ((const __m256i *) ((const gint32 *) data + i));
+                _mm256_storeu_ps (dst + i, _mm256_cvtepi32_ps (v));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_32U:
+            CONVERT_BLOCKS (8, 0, {
+                __m256i v = _mm256_loadu_si256 ((const __m256i *) ((const guint32 *) data + i));
+                _mm256_storeu_ps (dst + i, cvt_u32_avx2 (v));
+            });
+            break;
+        default:
+            break;
+    }
+}
+
+static UFO_TARGET("avx512f,avx2") void
+convert_avx512 (gfloat *dst,
+                gconstpointer data,
+                gsize start,
+                gsize end,
+                UfoBufferDepth depth)
+{
+    switch (depth) {
+        case UFO_BUFFER_DEPTH_8U:
+            CONVERT_BLOCKS (16, 0, {
+                __m128i v = _mm_loadu_si128 ((const __m128i *) ((const guint8 *) data + i));
+                _mm512_storeu_ps (dst + i, _mm512_cvtepi32_ps (_mm512_cvtepu8_epi32 (v)));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_16U:
+            CONVERT_BLOCKS (16, 0, {
+                __m256i v = _mm256_loadu_si256 ((const __m256i *) ((const guint16 *) data + i));
+                _mm512_storeu_ps (dst + i, _mm512_cvtepi32_ps (_mm512_cvtepu16_epi32 (v)));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_16S:
+            CONVERT_BLOCKS (16, 0, {
+                __m256i v = _mm256_loadu_si256 ((const __m256i *) ((const gint16 *) data + i));
+                _mm512_storeu_ps (dst + i, _mm512_cvtepi32_ps (_mm512_cvtepi16_epi32 (v)));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_32S:
+            CONVERT_BLOCKS (16, 0, {
+                __m512i v = _mm512_loadu_si512 ((const void *) ((const gint32 *) data + i));
+                _mm512_storeu_ps (dst + i, _mm512_cvtepi32_ps (v));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_32U:
+            CONVERT_BLOCKS (16, 0, {
+                __m512i v = _mm512_loadu_si512 ((const void *) ((const guint32 *) data + i));
+                _mm512_storeu_ps (dst + i, _mm512_cvtepu32_ps (v));
+            });
+            break;
+        default:
+            /* The shuffle-based 12-bit unpacker gains nothing from wider registers */
+            convert_avx2 (dst, data, start, end, depth);
+    }
+}
+
+#endif
+
+#ifdef UFO_CONVERT_NEON
+
+static void
+convert_neon (gfloat *dst,
+              gconstpointer data,
+              gsize start,
+              gsize end,
+              UfoBufferDepth depth)
+{
+    switch (depth) {
+        case UFO_BUFFER_DEPTH_8U:
+            CONVERT_BLOCKS (8, 0, {
+                uint16x8_t w = vmovl_u8 (vld1_u8 ((const guint8 *) data + i));
+                vst1q_f32 (dst + i, vcvtq_f32_u32 (vmovl_u16 (vget_low_u16 (w))));
+                vst1q_f32 (dst + i + 4, vcvtq_f32_u32 (vmovl_u16 (vget_high_u16 (w))));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_16U:
+            CONVERT_BLOCKS (8, 0, {
+                uint16x8_t w = vld1q_u16 ((const guint16 *) data + i);
+                vst1q_f32 (dst + i, vcvtq_f32_u32 (vmovl_u16 (vget_low_u16 (w))));
+                vst1q_f32 (dst + i + 4, vcvtq_f32_u32 (vmovl_u16 (vget_high_u16 (w))));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_16S:
+            CONVERT_BLOCKS (8, 0, {
+                int16x8_t w = vld1q_s16 ((const gint16 *) data + i);
+                vst1q_f32 (dst + i, vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (w))));
+                vst1q_f32 (dst + i + 4, vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (w))));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_32S:
+            CONVERT_BLOCKS (8, 0, {
+                int32x4_t a = vld1q_s32 ((const gint32 *) data + i);
+                int32x4_t b = vld1q_s32 ((const gint32 *) data + i + 4);
+                vst1q_f32 (dst + i, vcvtq_f32_s32 (a));
+                vst1q_f32 (dst + i + 4, vcvtq_f32_s32 (b));
+            });
+            break;
+        case UFO_BUFFER_DEPTH_32U:
+            CONVERT_BLOCKS (8, 0, {
+                uint32x4_t a = vld1q_u32 ((const guint32 *) data + i);
+                uint32x4_t b = vld1q_u32 ((const guint32 *) data + i + 4);
+                vst1q_f32 (dst + i, vcvtq_f32_u32 (a));
+                vst1q_f32 (dst + i + 4, vcvtq_f32_u32 (b));
+            });
+            break;
+        default:
+            convert_scalar (dst, data, start, end, depth);
+    }
+}
+
+#endif
+
+static UfoConvertImpl
+detect_impl (void)
+{
+#if defined(UFO_CONVERT_X86)
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("avx512f") && __builtin_cpu_supports ("avx2"))
+        return UFO_CONVERT_IMPL_AVX512;
+
+    if (__builtin_cpu_supports ("avx2"))
+        return UFO_CONVERT_IMPL_AVX2;
+
+    if (__builtin_cpu_supports ("sse2"))
+        return UFO_CONVERT_IMPL_SSE2;
+#elif defined(UFO_CONVERT_NEON)
+    return UFO_CONVERT_IMPL_NEON;
+#endif
+
+    return UFO_CONVERT_IMPL_SCALAR;
+}
+
+/*
+ * ufo_convert_get_impl:
+ *
+ * Returns: The fastest conversion implementation supported by this CPU.
+ */
+UfoConvertImpl
+ufo_convert_get_impl (void)
+{
+    static gsize impl = 0;
+
+    if (g_once_init_enter (&impl)) {
+        UfoConvertImpl detected = detect_impl ();
+
+        g_debug ("INFO Using %s depth conversion", ufo_convert_impl_get_name (detected));
+        g_once_init_leave (&impl, (gsize) detected + 1);
+    }
+
+    return (UfoConvertImpl) (impl - 1);
+}
+
+gboolean
+ufo_convert_impl_supported (UfoConvertImpl impl)
+{
+    UfoConvertImpl best = ufo_convert_get_impl ();
+
+    if (impl == UFO_CONVERT_IMPL_SCALAR)
+        return TRUE;
+
+#if defined(UFO_CONVERT_X86)
+    return impl != UFO_CONVERT_IMPL_NEON && impl <= best;
+#else
+    return impl == best;
+#endif
+}
+
+const gchar *
+ufo_convert_impl_get_name (UfoConvertImpl impl)
+{
+    static const gchar *names[] = { "scalar", "SSE2", "AVX2", "AVX-512", "NEON" };
+
+    g_return_val_if_fail (impl < UFO_CONVERT_IMPL_LAST, NULL);
+    return names[impl];
+}
+
+gsize
+ufo_convert_get_raw_size (gsize n_pixels,
+                          UfoBufferDepth depth)
+{
+    switch (depth) {
+        case UFO_BUFFER_DEPTH_8U:
+            return n_pixels;
+        case UFO_BUFFER_DEPTH_12U:
+            return (3 * n_pixels + 1) / 2;
+        case UFO_BUFFER_DEPTH_16U:
+        case UFO_BUFFER_DEPTH_16S:
+            return n_pixels * 2;
+        default:
+            return n_pixels * 4;
+    }
+}
+
+static void
+convert_range (gfloat *dst,
+               gconstpointer src,
+               gsize start,
+               gsize end,
+               UfoBufferDepth depth,
+               UfoConvertImpl impl)
+{
+    switch (impl) {
+#if defined(UFO_CONVERT_X86)
+        case UFO_CONVERT_IMPL_SSE2:
+            convert_sse2 (dst, src, start, end, depth);
+            break;
+        case UFO_CONVERT_IMPL_AVX2:
+            convert_avx2 (dst, src, start, end, depth);
+            break;
+        case UFO_CONVERT_IMPL_AVX512:
+            convert_avx512 (dst, src, start, end, depth);
+            break;
+#elif defined(UFO_CONVERT_NEON)
+        case UFO_CONVERT_IMPL_NEON:
+            convert_neon (dst, src, start, end, depth);
+            break;
+#endif
+        default:
+            convert_scalar (dst, src, start, end, depth);
+    }
+}
+
+/*
+ * ufo_convert_data_with_impl:
+ * @dst: Float output for @n_pixels elements
+ * @src: Input data, may be identical to @dst
+ * @n_pixels: Number of elements
+ * @depth: Depth of @src
+ * @impl: Implementation to use, falls back to scalar code if not supported
+ *
+ * Convert @src in a single thread. Mainly useful for benchmarking.
+ */
+void
+ufo_convert_data_with_impl (gfloat *dst,
+                            gconstpointer src,
+                            gsize n_pixels,
+                            UfoBufferDepth depth,
+                            UfoConvertImpl impl)
+{
+    if (!ufo_convert_impl_supported (impl))
+        impl = UFO_CONVERT_IMPL_SCALAR;
+
+    convert_range (dst, src, 0, n_pixels, depth, impl);
+}
+
+static void
+convert_chunk (ConvertChunk *chunk,
+               gpointer unused)
+{
+    ConvertJob *job = chunk->job;
+
+    convert_range (chunk->dst, chunk->src, chunk->start, chunk->end, chunk->depth, chunk->impl);
+
+    g_mutex_lock (&job->lock);
+    job->remaining--;
+    g_cond_signal (&job->cond);
+    g_mutex_unlock (&job->lock);
+}
+
+static GThreadPool *
+get_thread_pool (void)
+{
+    static gsize pool = 0;
+
+    if (g_once_init_enter (&pool)) {
+        GThreadPool *new_pool;
+
+        new_pool = g_thread_pool_new ((GFunc) convert_chunk, NULL,
+                                      (gint) MIN (g_get_num_processors (), MAX_CHUNKS),
+                                      FALSE, NULL);
+        g_once_init_leave (&pool, (gsize) new_pool);
+    }
+
+    return (GThreadPool *) pool;
+}
+
+static gboolean
+can_split (gfloat *dst,
+           gconstpointer src,
+           gsize n_pixels,
+           UfoBufferDepth depth)
+{
+    const guint8 *d = (const guint8 *) dst;
+    const guint8 *s = (const guint8 *) src;
+
+    /* 32-bit elements keep their position, so chunks never overlap */
+    if (depth == UFO_BUFFER_DEPTH_32S || depth == UFO_BUFFER_DEPTH_32U)
+        return TRUE;
+
+    return s + ufo_convert_get_raw_size (n_pixels, depth) <= d ||
+           d + n_pixels * sizeof (gfloat) <= s;
+}
+
+/*
+ * ufo_convert_data:
+ * @dst: Float output for @n_pixels elements
+ * @src: Input data, may be identical to @dst
+ * @n_pixels: Number of elements
+ * @depth: Depth of @src
+ *
+ * Convert @src to floats with the fastest implementation for this CPU. Large
+ * frames are converted by several threads if @src and @dst do not overlap.
+ */
+void
+ufo_convert_data (gfloat *dst,
+                  gconstpointer src,
+                  gsize n_pixels,
+                  UfoBufferDepth depth)
+{
+    ConvertChunk chunks[MAX_CHUNKS];
+    ConvertJob job;
+    GThreadPool *pool;
+    UfoConvertImpl impl;
+    gsize n_chunks;
+    gsize chunk_size;
+    guint n_pushed = 0;
+
+    impl = ufo_convert_get_impl ();
+    n_chunks = MIN (MIN ((gsize) g_get_num_processors (), MAX_CHUNKS), n_pixels / CHUNK_MIN_PIXELS);
+
+    if (n_chunks < 2 || !can_split (dst, src, n_pixels, depth)) {
+        convert_range (dst, src, 0, n_pixels, depth, impl);
+        return;
+    }
+
+    /* Aligned chunk boundaries keep 12-bit pixel pairs and SIMD blocks intact */
+    chunk_size = (n_pixels / n_chunks + CHUNK_ALIGNMENT - 1) & ~((gsize) CHUNK_ALIGNMENT - 1);
+    pool = get_thread_pool ();
+
+    g_mutex_init (&job.lock);
+    g_cond_init (&job.cond);
+
+    for (gsize i = 1; i < n_chunks && i * chunk_size < n_pixels; i++) {
+        ConvertChunk *chunk = &chunks[n_pushed++];
+
+        chunk->dst = dst;
+        chunk->src = src;
+        chunk->start = i * chunk_size;
+        chunk->end = MIN (chunk->start + chunk_size, n_pixels);
+        chunk->depth = depth;
+        chunk->impl = impl;
+        chunk->job = &job;
+    }
+
+    job.remaining = n_pushed;
+
+    for (guint i = 0; i < n_pushed; i++)
+        g_thread_pool_push (pool, &chunks[i], NULL);
+
+    convert_range (dst, src, 0, MIN (chunk_size, n_pixels), depth, impl);
+
+    g_mutex_lock (&job.lock);
+
+    while (job.remaining > 0)
+        g_cond_wait (&job.cond, &job.lock);
+
+    g_mutex_unlock (&job.lock);
+
+    g_mutex_clear (&job.lock);
+    g_cond_clear (&job.cond);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UFO_BUFFER_CONVERT_H
+#define UFO_BUFFER_CONVERT_H
+
+#include <glib.h>
+#include "ufo-buffer.h"
+
+/* Private depth conversion routines used by UfoBuffer */
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define UFO_CONVERT_X86
+#include <immintrin.h>
+#define UFO_TARGET(isa) __attribute__((target(isa)))
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define UFO_CONVERT_NEON
+#include <arm_neon.h>
+#endif
+
+typedef enum {
+    UFO_CONVERT_IMPL_SCALAR = 0,
+    UFO_CONVERT_IMPL_SSE2,
+    UFO_CONVERT_IMPL_AVX2,
+    UFO_CONVERT_IMPL_AVX512,
+    UFO_CONVERT_IMPL_NEON,
+    UFO_CONVERT_IMPL_LAST
+} UfoConvertImpl;
+
+UfoConvertImpl  ufo_convert_get_impl           (void);
+gboolean        ufo_convert_impl_supported     (UfoConvertImpl  impl);
+const gchar    *ufo_convert_impl_get_name      (UfoConvertImpl  impl);
+gsize           ufo_convert_get_raw_size       (gsize           n_pixels,
+                                                UfoBufferDepth  depth);
+void            ufo_convert_data_with_impl     (gfloat         *dst,
+                                                gconstpointer   src,
+                                                gsize           n_pixels,
+                                                UfoBufferDepth  depth,
+                                                UfoConvertImpl  impl);
+void            ufo_convert_data               (gfloat         *dst,
+                                                gconstpointer   src,
+                                                gsize           n_pixels,
+                                                UfoBufferDepth  depth);
+
+#endif
@@ -0,0 +1,717 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "ufo-buffer-pool.h"
+#include "ufo-buffer.h"
+#include "ufo-resources.h"
+#include "ufo-priv.h"
+
+/**
+ * SECTION:ufo-buffer-pool
+ * @Short_description: Recycle buffer memory
+ * @Title: UfoBufferPool
+ *
+ * A #UfoBufferPool keeps host arrays, device arrays and device images of
+ * released or resized #UfoBuffer objects around and hands them out again
+ * instead of allocating new memory. Memory is binned by context, location and
+ * size class, so that buffers of slightly different sizes share their storage.
+ *
+ * Buffers created with ufo_buffer_new_from_pool() draw their storage from a
+ * pool and return it when they are resized or finalized. Most users should use
+ * the process-wide pool returned by ufo_buffer_pool_get_default().
+ *
+ * The process-wide pools cache at most 1 GB unless UFO_BUFFER_POOL_SIZE is
+ * set to another number of megabytes.
+ */
+
+G_DEFINE_TYPE (UfoBufferPool, ufo_buffer_pool, G_TYPE_OBJECT)
+
+#define UFO_BUFFER_POOL_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), UFO_TYPE_BUFFER_POOL, UfoBufferPoolPrivate))
+
+typedef struct {
+    gpointer            context;
+    UfoBufferLocation   location;
+    gsize               size;
+    gsize               dims[3];
+} PoolKey;
+
+struct _UfoBufferPoolPrivate {
+    GMutex       lock;
+    GHashTable  *bins;          /* PoolKey to GSList of cached memory */
+    guint64      n_hits;
+    guint64      n_misses;
+    guint64      in_use;
+    guint64      high_water;
+    guint64      cached;
+    guint64      max_cached;
+};
+
+enum {
+    PROP_0,
+    PROP_NUM_HITS,
+    PROP_NUM_MISSES,
+    PROP_HIGH_WATER,
+    PROP_CACHED,
+    PROP_MAX_CACHED,
+    N_PROPERTIES
+};
+
+static GParamSpec *properties[N_PROPERTIES] = { NULL, };
+
+#define DEFAULT_MAX_CACHED_MB   1024
+
+static guint
+pool_key_hash (gconstpointer data)
+{
+    const PoolKey *key = data;
+    guint hash;
+
+    hash = g_direct_hash (key->context);
+    hash = hash * 31 + (guint) key->location;
+    hash = hash * 31 + (guint) key->size;
+
+    for (guint i = 0; i < 3; i++)
+        hash = hash * 31 + (guint) key->dims[i];
+
+    return hash;
+}
+
+static gboolean
+pool_key_equal (gconstpointer a, gconstpointer b)
+{
+    const PoolKey *ka = a;
+    const PoolKey *kb = b;
+
+    return ka->context == kb->context &&
+           ka->location == kb->location &&
+           ka->size == kb->size &&
+           ka->dims[0] == kb->dims[0] &&
+           ka->dims[1] == kb->dims[1] &&
+           ka->dims[2] == kb->dims[2];
+}
+
+static void
+free_mem (UfoBufferLocation location, gpointer mem)
+{
+    if (location == UFO_BUFFER_LOCATION_HOST) {
+        g_free (mem);
+    }
+    else {
+        g_debug ("FREE %p [pooled]", mem);
+        UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject ((cl_mem) mem));
+    }
+}
+
+/**
+ * ufo_buffer_pool_new:
+ *
+ * Create a new, empty buffer pool.
+ *
+ * Returns: (transfer full): A new #UfoBufferPool.
+ */
+UfoBufferPool *
+ufo_buffer_pool_new (void)
+{
+    return UFO_BUFFER_POOL (g_object_new (UFO_TYPE_BUFFER_POOL, NULL));
+}
+
+/*
+ * Create a pool that is shared by the whole process and thus bounded.
+ */
+static UfoBufferPool *
+new_process_pool (void)
+{
+    UfoBufferPool *pool;
+    const gchar *var;
+    guint64 max_cached = DEFAULT_MAX_CACHED_MB;
+
+    var = g_getenv ("UFO_BUFFER_POOL_SIZE");
+
+    if (var != NULL && *var != '\0')
+        max_cached = g_ascii_strtoull (var, NULL, 10);
+
+    pool = ufo_buffer_pool_new ();
+    pool->priv->max_cached = max_cached * 1024 * 1024;
+    return pool;
+}
+
+/* Pools of ufo_buffer_pool_get_for_numa_node() indexed by NUMA node */
+static GMutex numa_lock;
+static GPtrArray *numa_pools = NULL;
+
+/**
+ * ufo_buffer_pool_get_default:
+ *
+ * Get the process-wide buffer pool used by the schedulers.
+ *
+ * Returns: (transfer none): The default #UfoBufferPool.
+ */
+UfoBufferPool *
+ufo_buffer_pool_get_default (void)
+{
+    static gsize pool = 0;
+
+    if (g_once_init_enter (&pool)) {
+        UfoBufferPool *default_pool = new_process_pool ();
+        g_once_init_leave (&pool, (gsize) default_pool);
+    }
+
+    return UFO_BUFFER_POOL (pool);
+}
+
+/**
+ * ufo_buffer_pool_get_for_numa_node:
+ * @numa_node: Index of a NUMA node
+ *
+ * Get the process-wide buffer pool for buffers produced by threads pinned to
+ * @numa_node. Keeping those buffers separate ensures that recycled host memory
+ * stays local to the threads that use it.
+ *
+ * Returns: (transfer none): The #UfoBufferPool of @numa_node.
+ */
+UfoBufferPool *
+ufo_buffer_pool_get_for_numa_node (guint numa_node)
+{
+    UfoBufferPool *pool;
+
+    g_mutex_lock (&numa_lock);
+
+    if (numa_pools == NULL)
+        numa_pools = g_ptr_array_new ();
+
+    if (numa_node >= numa_pools->len)
+        g_ptr_array_set_size (numa_pools, numa_node + 1);
+
+    pool = g_ptr_array_index (numa_pools, numa_node);
+
+    if (pool == NULL) {
+        pool = new_process_pool ();
+        g_ptr_array_index (numa_pools, numa_node) = pool;
+    }
+
+    g_mutex_unlock (&numa_lock);
+    return pool;
+}
+
+/**
+ * ufo_buffer_pool_get_size_class:
+ * @size: Requested size in bytes
+ *
+ * Round @size up to its size class. Sizes up to a page are rounded to the next
+ * power of two, larger sizes to the next eighth of the enclosing power of two
+ * which wastes at most a quarter of the requested size.
+ *
+ * Returns: Size of the class @size belongs to.
+ */
+gsize
+ufo_buffer_pool_get_size_class (gsize size)
+{
+    gsize power = 1;
+    gsize step;
+
+    while (power < size)
+        power <<= 1;
+
+    if (power <= 4096)
+        return power;
+
+    step = power / 8;
+    return ((size + step - 1) / step) * step;
+}
+
+static gpointer
+pool_get (UfoBufferPoolPrivate *priv, PoolKey *key)
+{
+    GSList *list;
+    gpointer mem = NULL;
+
+    g_mutex_lock (&priv->lock);
+
+    list = g_hash_table_lookup (priv->bins, key);
+
+    if (list != NULL) {
+        mem = list->data;
+        list = g_slist_delete_link (list, list);
+
+        if (list != NULL) {
+            g_hash_table_insert (priv->bins, g_memdup (key, sizeof (PoolKey)), list);
+        }
+        else
+            g_hash_table_remove (priv->bins, key);
+
+        priv->n_hits++;
+        priv->cached -= key->size;
+    }
+    else {
+        priv->n_misses++;
+    }
+
+    priv->in_use += key->size;
+    priv->high_water = MAX (priv->high_water, priv->in_use);
+
+    g_mutex_unlock (&priv->lock);
+
+    return mem;
+}
+
+static void
+pool_put (UfoBufferPoolPrivate *priv, PoolKey *key, gpointer mem)
+{
+    gboolean keep;
+
+    g_mutex_lock (&priv->lock);
+
+    priv->in_use -= MIN (priv->in_use, key->size);
+    keep = priv->max_cached == 0 || priv->cached + key->size <= priv->max_cached;
+
+    if (keep) {
+        GSList *list;
+
+        list = g_hash_table_lookup (priv->bins, key);
+        list = g_slist_prepend (list, mem);
+        g_hash_table_insert (priv->bins, g_memdup (key, sizeof (PoolKey)), list);
+        priv->cached += key->size;
+    }
+
+    g_mutex_unlock (&priv->lock);
+
+    if (!keep)
+        free_mem (key->location, mem);
+}
+
+static void
+init_key (PoolKey *key,
+          gpointer context,
+          UfoBufferLocation location,
+          gsize size)
+{
+    key->context = context;
+    key->location = location;
+    key->size = size;
+    key->dims[0] = key->dims[1] = key->dims[2] = 0;
+}
+
+/**
+ * ufo_buffer_pool_get_host_mem: (skip)
+ * @pool: A #UfoBufferPool
+ * @size: Number of bytes required
+ * @capacity: (out): Location to store the actual size of the returned memory
+ *
+ * Get zero-initialized host memory of at least @size bytes. The memory must be
+ * returned with ufo_buffer_pool_put_host_mem() or freed with g_free().
+ *
+ * Returns: Host memory of @capacity bytes.
+ */
+gpointer
+ufo_buffer_pool_get_host_mem (UfoBufferPool *pool,
+                              gsize size,
+                              gsize *capacity)
+{
+    PoolKey key;
+    gpointer mem;
+
+    g_return_val_if_fail (UFO_IS_BUFFER_POOL (pool), NULL);
+
+    init_key (&key, NULL, UFO_BUFFER_LOCATION_HOST, ufo_buffer_pool_get_size_class (size));
+    mem = pool_get (pool->priv, &key);
+
+    if (mem != NULL)
+        memset (mem, 0, key.size);
+    else
+        mem = g_malloc0 (key.size);
+
+    *capacity = key.size;
+    return mem;
+}
+
+/**
+ * ufo_buffer_pool_put_host_mem: (skip)
+ * @pool: A #UfoBufferPool
+ * @mem: Host memory acquired with ufo_buffer_pool_get_host_mem()
+ * @capacity: Capacity as returned by ufo_buffer_pool_get_host_mem()
+ *
+ * Return host memory to @pool.
+ */
+void
+ufo_buffer_pool_put_host_mem (UfoBufferPool *pool,
+                              gpointer mem,
+                              gsize capacity)
+{
+    PoolKey key;
+
+    g_return_if_fail (UFO_IS_BUFFER_POOL (pool));
+    init_key (&key, NULL, UFO_BUFFER_LOCATION_HOST, capacity);
+    pool_put (pool->priv, &key, mem);
+}
+
+/**
+ * ufo_buffer_pool_get_device_mem: (skip)
+ * @pool: A #UfoBufferPool
+ * @context: A cl_context
+ * @size: Number of bytes required
+ * @capacity: (out): Location to store the actual size of the returned memory
+ *
+ * Get a read-write cl_mem buffer of at least @size bytes in @context.
+ *
+ * Returns: A cl_mem object of @capacity bytes.
+ */
+gpointer
+ufo_buffer_pool_get_device_mem (UfoBufferPool *pool,
+                                gpointer context,
+                                gsize size,
+                                gsize *capacity)
+{
+    PoolKey key;
+    cl_mem mem;
+    cl_int err;
+
+    g_return_val_if_fail (UFO_IS_BUFFER_POOL (pool), NULL);
+
+    init_key (&key, context, UFO_BUFFER_LOCATION_DEVICE, ufo_buffer_pool_get_size_class (size));
+    mem = pool_get (pool->priv, &key);
+
+    if (mem == NULL) {
+        mem = clCreateBuffer (context, CL_MEM_READ_WRITE, key.size, NULL, &err);
+        UFO_RESOURCES_CHECK_CLERR (err);
+        g_debug ("ALOC %p [size=%3.2f MB, type=buffer, pooled]", (gpointer) mem, key.size / 1024. / 1024.);
+    }
+
+    *capacity = key.size;
+    return mem;
+}
+
+/**
+ * ufo_buffer_pool_put_device_mem: (skip)
+ * @pool: A #UfoBufferPool
+ * @context: The cl_context @mem was created in
+ * @mem: A cl_mem acquired with ufo_buffer_pool_get_device_mem()
+ * @capacity: Capacity as returned by ufo_buffer_pool_get_device_mem()
+ *
+ * Return device memory to @pool.
+ */
+void
+ufo_buffer_pool_put_device_mem (UfoBufferPool *pool,
+                                gpointer context,
+                                gpointer mem,
+                                gsize capacity)
+{
+    PoolKey key;
+
+    g_return_if_fail (UFO_IS_BUFFER_POOL (pool));
+    init_key (&key, context, UFO_BUFFER_LOCATION_DEVICE, capacity);
+    pool_put (pool->priv, &key, mem);
+}
+
+/**
+ * ufo_buffer_pool_get_device_image: (skip)
+ * @pool: A #UfoBufferPool
+ * @context: A cl_context
+ * @width: Width of the image
+ * @height: Height of the image
+ * @depth: Depth of the image, 1 for two-dimensional images
+ *
+ * Look up a cached float image with the exact dimensions. Images are not
+ * binned by size class because their shape is part of the object.
+ *
+ * Returns: A cl_mem image or %NULL if none is cached. In the latter case, the
+ * caller must create the image itself.
+ */
+gpointer
+ufo_buffer_pool_get_device_image (UfoBufferPool *pool,
+                                  gpointer context,
+                                  gsize width,
+                                  gsize height,
+                                  gsize depth)
+{
+    PoolKey key;
+
+    g_return_val_if_fail (UFO_IS_BUFFER_POOL (pool), NULL);
+
+    init_key (&key, context, UFO_BUFFER_LOCATION_DEVICE_IMAGE, width * height * depth * sizeof (gfloat));
+    key.dims[0] = width;
+    key.dims[1] = height;
+    key.dims[2] = depth;
+
+    return pool_get (pool->priv, &key);
+}
+
+/**
+ * ufo_buffer_pool_put_device_image: (skip)
+ * @pool: A #UfoBufferPool
+ * @context: The cl_context @mem was created in
+ * @mem: A cl_mem image
+ * @width: Width of the image
+ * @height: Height of the image
+ * @depth: Depth of the image, 1 for two-dimensional images
+ *
+ * Return a device image to @pool.
+ */
+void
+ufo_buffer_pool_put_device_image (UfoBufferPool *pool,
+                                  gpointer context,
+                                  gpointer mem,
+                                  gsize width,
+                                  gsize height,
+                                  gsize depth)
+{
+    PoolKey key;
+
+    g_return_if_fail (UFO_IS_BUFFER_POOL (pool));
+
+    init_key (&key, context, UFO_BUFFER_LOCATION_DEVICE_IMAGE, width * height * depth * sizeof (gfloat));
+    key.dims[0] = width;
+    key.dims[1] = height;
+    key.dims[2] = depth;
+
+    pool_put (pool->priv, &key, mem);
+}
+
+static void
+remove_bins (UfoBufferPoolPrivate *priv,
+             gpointer context)
+{
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+
+    g_mutex_lock (&priv->lock);
+    g_hash_table_iter_init (&iter, priv->bins);
+
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        PoolKey *pool_key = key;
+        GSList *it;
+
+        if (context != NULL && pool_key->context != context)
+            continue;
+
+        for (it = value; it != NULL; it = g_slist_next (it)) {
+            free_mem (pool_key->location, it->data);
+            priv->cached -= MIN (priv->cached, pool_key->size);
+        }
+
+        g_slist_free (value);
+        g_hash_table_iter_remove (&iter);
+    }
+
+    g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * ufo_buffer_pool_release_context:
+ * @pool: A #UfoBufferPool
+ * @context: A cl_context
+ *
+ * Free all cached device memory belonging to @context. This must be called
+ * before the context is destroyed.
+ */
+void
+ufo_buffer_pool_release_context (UfoBufferPool *pool,
+                                 gpointer context)
+{
+    g_return_if_fail (UFO_IS_BUFFER_POOL (pool));
+
+    if (context != NULL)
+        remove_bins (pool->priv, context);
+}
+
+/*
+ * Free the cached device memory of @context in the default and all NUMA node
+ * pools, so that none of them keeps the context alive.
+ */
+void
+ufo_purge_buffer_pools (gpointer context)
+{
+    ufo_buffer_pool_release_context (ufo_buffer_pool_get_default (), context);
+
+    g_mutex_lock (&numa_lock);
+
+    if (numa_pools != NULL) {
+        for (guint i = 0; i < numa_pools->len; i++) {
+            UfoBufferPool *pool = g_ptr_array_index (numa_pools, i);
+
+            if (pool != NULL)
+                ufo_buffer_pool_release_context (pool, context);
+        }
+    }
+
+    g_mutex_unlock (&numa_lock);
+}
+
+/**
+ * ufo_buffer_pool_clear:
+ * @pool: A #UfoBufferPool
+ *
+ * Free all cached memory. Memory currently used by buffers is not affected.
+ */
+void
+ufo_buffer_pool_clear (UfoBufferPool *pool)
+{
+    g_return_if_fail (UFO_IS_BUFFER_POOL (pool));
+    remove_bins (pool->priv, NULL);
+}
+
+static void
+ufo_buffer_pool_set_property (GObject *object,
+                              guint property_id,
+                              const GValue *value,
+                              GParamSpec *pspec)
+{
+    UfoBufferPoolPrivate *priv = UFO_BUFFER_POOL_GET_PRIVATE (object);
+
+    switch (property_id) {
+        case PROP_MAX_CACHED:
+            g_mutex_lock (&priv->lock);
+            priv->max_cached = g_value_get_uint64 (value);
+            g_mutex_unlock (&priv->lock);
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+            break;
+    }
+}
+
+static void
+ufo_buffer_pool_get_property (GObject *object,
+                              guint property_id,
+                              GValue *value,
+                              GParamSpec *pspec)
+{
+    UfoBufferPoolPrivate *priv = UFO_BUFFER_POOL_GET_PRIVATE (object);
+
+    g_mutex_lock (&priv->lock);
+
+    switch (property_id) {
+        case PROP_NUM_HITS:
+            g_value_set_uint64 (value, priv->n_hits);
+            break;
+
+        case PROP_NUM_MISSES:
+            g_value_set_uint64 (value, priv->n_misses);
+            break;
+
+        case PROP_HIGH_WATER:
+            g_value_set_uint64 (value, priv->high_water);
+            break;
+
+        case PROP_CACHED:
+            g_value_set_uint64 (value, priv->cached);
+            break;
+
+        case PROP_MAX_CACHED:
+            g_value_set_uint64 (value, priv->max_cached);
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+            break;
+    }
+
+    g_mutex_unlock (&priv->lock);
+}
+
+static void
+ufo_buffer_pool_finalize (GObject *object)
+{
+    UfoBufferPoolPrivate *priv;
+
+    priv = UFO_BUFFER_POOL_GET_PRIVATE (object);
+
+    remove_bins (priv, NULL);
+    g_hash_table_destroy (priv->bins);
+    g_mutex_clear (&priv->lock);
+
+    G_OBJECT_CLASS (ufo_buffer_pool_parent_class)->finalize (object);
+}
+
+static void
+ufo_buffer_pool_class_init (UfoBufferPoolClass *klass)
+{
+    GObjectClass *oclass = G_OBJECT_CLASS (klass);
+
+    oclass->set_property = ufo_buffer_pool_set_property;
+    oclass->get_property = ufo_buffer_pool_get_property;
+    oclass->finalize = ufo_buffer_pool_finalize;
+
+    properties[PROP_NUM_HITS] =
+        g_param_spec_uint64 ("num-hits",
+                             "Number of requests served from the cache",
+                             "Number of requests served from the cache",
+                             0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE);
+
+    properties[PROP_NUM_MISSES] =
+        g_param_spec_uint64 ("num-misses",
+                             "Number of requests that needed an allocation",
+                             "Number of requests that needed an allocation",
+                             0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE);
+
+    properties[PROP_HIGH_WATER] =
+        g_param_spec_uint64 ("high-water",
+                             "Maximum number of bytes handed out at once",
+                             "Maximum number of bytes handed out at once",
+                             0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE);
+
+    properties[PROP_CACHED] =
+        g_param_spec_uint64 ("cached",
+                             "Number of bytes currently cached",
+                             "Number of bytes currently cached",
+                             0, G_MAXUINT64, 0,
+                             G_PARAM_READABLE);
+
+    properties[PROP_MAX_CACHED] =
+        g_param_spec_uint64 ("max-cached",
+                             "Maximum number of bytes to cache, 0 for no limit",
+                             "Maximum number of bytes to cache, 0 for no limit",
+                             0, G_MAXUINT64, 0,
+                             G_PARAM_READWRITE);
+
+    for (guint i = PROP_0 + 1; i < N_PROPERTIES; i++)
+        g_object_class_install_property (oclass, i, properties[i]);
+
+    g_type_class_add_private (klass, sizeof (UfoBufferPoolPrivate));
+}
+
+static void
+ufo_buffer_pool_init (UfoBufferPool *pool)
+{
+    UfoBufferPoolPrivate *priv;
+
+    pool->priv = priv = UFO_BUFFER_POOL_GET_PRIVATE (pool);
+    g_mutex_init (&priv->lock);
+    priv->bins = g_hash_table_new_full (pool_key_hash, pool_key_equal, g_free, NULL);
+    priv->n_hits = 0;
+    priv->n_misses = 0;
+    priv->in_use = 0;
+    priv->high_water = 0;
+    priv->cached = 0;
+    priv->max_cached = 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UFO_BUFFER_POOL_H
+#define __UFO_BUFFER_POOL_H
+
+#if !defined (__UFO_H_INSIDE__) && !defined (UFO_COMPILATION)
+#error "Only <ufo/ufo.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define UFO_TYPE_BUFFER_POOL             (ufo_buffer_pool_get_type())
+#define UFO_BUFFER_POOL(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), UFO_TYPE_BUFFER_POOL, UfoBufferPool))
+#define UFO_IS_BUFFER_POOL(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), UFO_TYPE_BUFFER_POOL))
+#define UFO_BUFFER_POOL_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), UFO_TYPE_BUFFER_POOL, UfoBufferPoolClass))
+#define UFO_IS_BUFFER_POOL_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), UFO_TYPE_BUFFER_POOL))
+#define UFO_BUFFER_POOL_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS((obj), UFO_TYPE_BUFFER_POOL, UfoBufferPoolClass))
+
+typedef struct _UfoBufferPool           UfoBufferPool;
+typedef struct _UfoBufferPoolClass      UfoBufferPoolClass;
+typedef struct _UfoBufferPoolPrivate    UfoBufferPoolPrivate;
+
+/**
+ * UfoBufferPool:
+ *
+ * Caches host and device memory of released #UfoBuffer objects. The contents
+ * of the #UfoBufferPool structure are private and should only be accessed via
+ * the provided API.
+ */
+struct _UfoBufferPool {
+    /*< private >*/
+    GObject parent_instance;
+
+    UfoBufferPoolPrivate *priv;
+};
+
+/**
+ * UfoBufferPoolClass:
+ *
+ * #UfoBufferPool class
+ */
+struct _UfoBufferPoolClass {
+    /*< private >*/
+    GObjectClass parent_class;
+};
+
+UfoBufferPool  *ufo_buffer_pool_new                 (void);
+UfoBufferPool  *ufo_buffer_pool_get_default         (void);
+UfoBufferPool  *ufo_buffer_pool_get_for_numa_node   (guint           numa_node);
+gpointer        ufo_buffer_pool_get_host_mem        (UfoBufferPool  *pool,
+                                                     gsize           size,
+                                                     gsize          *capacity);
+void            ufo_buffer_pool_put_host_mem        (UfoBufferPool  *pool,
+                                                     gpointer        mem,
+                                                     gsize           capacity);
+gpointer        ufo_buffer_pool_get_device_mem      (UfoBufferPool  *pool,
+                                                     gpointer        context,
+                                                     gsize           size,
+                                                     gsize          *capacity);
+void            ufo_buffer_pool_put_device_mem      (UfoBufferPool  *pool,
+                                                     gpointer        context,
+                                                     gpointer        mem,
+                                                     gsize           capacity);
+gpointer        ufo_buffer_pool_get_device_image    (UfoBufferPool  *pool,
+                                                     gpointer        context,
+                                                     gsize           width,
+                                                     gsize           height,
+                                                     gsize           depth);
+void            ufo_buffer_pool_put_device_image    (UfoBufferPool  *pool,
+                                                     gpointer        context,
+                                                     gpointer        mem,
+                                                     gsize           width,
+                                                     gsize           height,
+                                                     gsize           depth);
+void            ufo_buffer_pool_release_context     (UfoBufferPool  *pool,
+                                                     gpointer        context);
+void            ufo_buffer_pool_clear               (UfoBufferPool  *pool);
+gsize           ufo_buffer_pool_get_size_class      (gsize           size);
+GType           ufo_buffer_pool_get_type            (void);
+
+G_END_DECLS
+
+#endif
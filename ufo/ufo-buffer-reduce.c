@@ -0,0 +1,549 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "ufo-buffer-convert.h"
+#include "ufo-buffer-reduce.h"
+
+/*
+ * Sums are accumulated in double precision, min and max in single precision.
+ * The vectorized versions process as many whole vectors as possible and leave
+ * the rest to the scalar code, which continues from their partial results.
+ */
+
+static void
+statistics_scalar (const gfloat *data,
+                   gsize n,
+                   UfoBufferStatistics *stats)
+{
+    for (gsize i = 0; i < n; i++) {
+        gfloat v = data[i];
+
+        if (v < stats->min)
+            stats->min = v;
+
+        if (v > stats->max)
+            stats->max = v;
+
+        stats->sum += v;
+        stats->sum_squares += (gdouble) v * v;
+    }
+}
+
+static void
+min_max_scalar (const gfloat *data,
+                gsize n,
+                gfloat *min,
+                gfloat *max)
+{
+    for (gsize i = 0; i < n; i++) {
+        if (data[i] < *min)
+            *min = data[i];
+
+        if (data[i] > *max)
+            *max = data[i];
+    }
+}
+
+static void
+fold_min_max (const gfloat *mins,
+              const gfloat *maxs,
+              guint n_lanes,
+              gfloat *min,
+              gfloat *max)
+{
+    for (guint i = 0; i < n_lanes; i++) {
+        if (mins[i] < *min)
+            *min = mins[i];
+
+        if (maxs[i] > *max)
+            *max = maxs[i];
+    }
+}
+
+static gdouble
+abs_sum_scalar (const gfloat *data,
+                gsize n)
+{
+    gdouble sum = 0.0;
+
+    for (gsize i = 0; i < n; i++)
+        sum += fabsf (data[i]);
+
+    return sum;
+}
+
+static gdouble
+squared_distance_scalar (const gfloat *a,
+                         const gfloat *b,
+                         gsize n)
+{
+    gdouble sum = 0.0;
+
+    for (gsize i = 0; i < n; i++) {
+        gdouble diff = b != NULL ? a[i] - b[i] : a[i];
+        sum += diff * diff;
+    }
+
+    return sum;
+}
+
+#ifdef UFO_CONVERT_X86
+
+static inline UFO_TARGET("avx2") gdouble
+hsum_avx2 (__m256d v)
+{
+    gdouble lanes[4];
+
+    _mm256_storeu_pd (lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+static UFO_TARGET("avx2") void
+statistics_avx2 (const gfloat *data,
+                 gsize n,
+                 UfoBufferStatistics *stats)
+{
+    __m256 vmin = _mm256_set1_ps (stats->min);
+    __m256 vmax = _mm256_set1_ps (stats->max);
+    __m256d sum = _mm256_setzero_pd ();
+    __m256d squares = _mm256_setzero_pd ();
+    gfloat mins[8];
+    gfloat maxs[8];
+    gsize i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps (data + i);
+        __m256d lo = _mm256_cvtps_pd (_mm256_castps256_ps128 (v));
+        __m256d hi = _mm256_cvtps_pd (_mm256_extractf128_ps (v, 1));
+
+        vmin = _mm256_min_ps (v, vmin);
+        vmax = _mm256_max_ps (v, vmax);
+        sum = _mm256_add_pd (sum, _mm256_add_pd (lo, hi));
+        squares = _mm256_add_pd (squares, _mm256_add_pd (_mm256_mul_pd (lo, lo), _mm256_mul_pd (hi, hi)));
+    }
+
+    _mm256_storeu_ps (mins, vmin);
+    _mm256_storeu_ps (maxs, vmax);
+    fold_min_max (mins, maxs, 8, &stats->min, &stats->max);
+    stats->sum += hsum_avx2 (sum);
+    stats->sum_squares += hsum_avx2 (squares);
+
+    statistics_scalar (data + i, n - i, stats);
+}
+
+static UFO_TARGET("avx2") void
+min_max_avx2 (const gfloat *data,
+              gsize n,
+              gfloat *min,
+              gfloat *max)
+{
+    __m256 vmin0 = _mm256_set1_ps (*min);
+    __m256 vmax0 = _mm256_set1_ps (*max);
+    __m256 vmin1 = vmin0;
+    __m256 vmax1 = vmax0;
+    gfloat mins[8];
+    gfloat maxs[8];
+    gsize i;
+
+    /*
+     * Two independent accumulators hide the latency of min and max. The data
+     * goes first because minps/maxps return the second operand if either is
+     * NaN, which skips NaN like the scalar comparison does.
+     */
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m256 a = _mm256_loadu_ps (data + i);
+        __m256 b = _mm256_loadu_ps (data + i + 8);
+
+        vmin0 = _mm256_min_ps (a, vmin0);
+        vmax0 = _mm256_max_ps (a, vmax0);
+        vmin1 = _mm256_min_ps (b, vmin1);
+        vmax1 = _mm256_max_ps (b, vmax1);
+    }
+
+    _mm256_storeu_ps (mins, _mm256_min_ps (vmin0, vmin1));
+    _mm256_storeu_ps (maxs, _mm256_max_ps (vmax0, vmax1));
+    fold_min_max (mins, maxs, 8, min, max);
+    min_max_scalar (data + i, n - i, min, max);
+}
+
+static UFO_TARGET("avx2") gdouble
+abs_sum_avx2 (const gfloat *data,
+              gsize n)
+{
+    const __m256 mask = _mm256_castsi256_ps (_mm256_set1_epi32 (0x7FFFFFFF));
+    __m256d sum = _mm256_setzero_pd ();
+    gsize i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_and_ps (_mm256_loadu_ps (data + i), mask);
+
+        sum = _mm256_add_pd (sum, _mm256_cvtps_pd (_mm256_castps256_ps128 (v)));
+        sum = _mm256_add_pd (sum, _mm256_cvtps_pd (_mm256_extractf128_ps (v, 1)));
+    }
+
+    return hsum_avx2 (sum) + abs_sum_scalar (data + i, n - i);
+}
+
+static UFO_TARGET("avx2") gdouble
+squared_distance_avx2 (const gfloat *a,
+                       const gfloat *b,
+                       gsize n)
+{
+    __m256d sum = _mm256_setzero_pd ();
+    gsize i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps (a + i);
+        __m256d lo, hi;
+
+        if (b != NULL)
+            v = _mm256_sub_ps (v, _mm256_loadu_ps (b + i));
+
+        lo = _mm256_cvtps_pd (_mm256_castps256_ps128 (v));
+        hi = _mm256_cvtps_pd (_mm256_extractf128_ps (v, 1));
+        sum = _mm256_add_pd (sum, _mm256_add_pd (_mm256_mul_pd (lo, lo), _mm256_mul_pd (hi, hi)));
+    }
+
+    return hsum_avx2 (sum) + squared_distance_scalar (a + i, b != NULL ? b + i : NULL, n - i);
+}
+
+static inline UFO_TARGET("sse2") gdouble
+hsum_sse2 (__m128d v)
+{
+    gdouble lanes[2];
+
+    _mm_storeu_pd (lanes, v);
+    return lanes[0] + lanes[1];
+}
+
+static UFO_TARGET("sse2") void
+statistics_sse2 (const gfloat *data,
+                 gsize n,
+                 UfoBufferStatistics *stats)
+{
+    __m128 vmin = _mm_set1_ps (stats->min);
+    __m128 vmax = _mm_set1_ps (stats->max);
+    __m128d sum = _mm_setzero_pd ();
+    __m128d squares = _mm_setzero_pd ();
+    gfloat mins[4];
+    gfloat maxs[4];
+    gsize i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps (data + i);
+        __m128d lo = _mm_cvtps_pd (v);
+        __m128d hi = _mm_cvtps_pd (_mm_movehl_ps (v, v));
+
+        vmin = _mm_min_ps (v, vmin);
+        vmax = _mm_max_ps (v, vmax);
+        sum = _mm_add_pd (sum, _mm_add_pd (lo, hi));
+        squares = _mm_add_pd (squares, _mm_add_pd (_mm_mul_pd (lo, lo), _mm_mul_pd (hi, hi)));
+    }
+
+    _mm_storeu_ps (mins, vmin);
+    _mm_storeu_ps (maxs, vmax);
+    fold_min_max (mins, maxs, 4, &stats->min, &stats->max);
+    stats->sum += hsum_sse2 (sum);
+    stats->sum_squares += hsum_sse2 (squares);
+
+    statistics_scalar (data + i, n - i, stats);
+}
+
+static UFO_TARGET("sse2") void
+min_max_sse2 (const gfloat *data,
+              gsize n,
+              gfloat *min,
+              gfloat *max)
+{
+    __m128 vmin = _mm_set1_ps (*min);
+    __m128 vmax = _mm_set1_ps (*max);
+    gfloat mins[4];
+    gfloat maxs[4];
+    gsize i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps (data + i);
+
+        vmin = _mm_min_ps (v, vmin);
+        vmax = _mm_max_ps (v, vmax);
+    }
+
+    _mm_storeu_ps (mins, vmin);
+    _mm_storeu_ps (maxs, vmax);
+    fold_min_max (mins, maxs, 4, min, max);
+    min_max_scalar (data + i, n - i, min, max);
+}
+
+static UFO_TARGET("sse2") gdouble
+abs_sum_sse2 (const gfloat *data,
+              gsize n)
+{
+    const __m128 mask = _mm_castsi128_ps (_mm_set1_epi32 (0x7FFFFFFF));
+    __m128d sum = _mm_setzero_pd ();
+    gsize i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m128 v = _mm_and_ps (_mm_loadu_ps (data + i), mask);
+
+        sum = _mm_add_pd (sum, _mm_cvtps_pd (v));
+        sum = _mm_add_pd (sum, _mm_cvtps_pd (_mm_movehl_ps (v, v)));
+    }
+
+    return hsum_sse2 (sum) + abs_sum_scalar (data + i, n - i);
+}
+
+static UFO_TARGET("sse2") gdouble
+squared_distance_sse2 (const gfloat *a,
+                       const gfloat *b,
+                       gsize n)
+{
+    __m128d sum = _mm_setzero_pd ();
+    gsize i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps (a + i);
+        __m128d lo, hi;
+
+        if (b != NULL)
+            v = _mm_sub_ps (v, _mm_loadu_ps (b + i));
+
+        lo = _mm_cvtps_pd (v);
+        hi = _mm_cvtps_pd (_mm_movehl_ps (v, v));
+        sum = _mm_add_pd (sum, _mm_add_pd (_mm_mul_pd (lo, lo), _mm_mul_pd (hi, hi)));
+    }
+
+    return hsum_sse2 (sum) + squared_distance_scalar (a + i, b != NULL ? b + i : NULL, n - i);
+}
+
+#endif
+
+/*
+ * The AVX2 versions are used for AVX-512 machines as well, wider vectors do
+ * not pay off for these memory-bound loops.
+ */
+static UfoConvertImpl
+clamp_impl (UfoConvertImpl impl)
+{
+    return impl == UFO_CONVERT_IMPL_AVX512 ? UFO_CONVERT_IMPL_AVX2 : impl;
+}
+
+static UfoConvertImpl
+get_impl (void)
+{
+    return clamp_impl (ufo_convert_get_impl ());
+}
+
+/*
+ * ufo_reduce_statistics:
+ * @data: Float data
+ * @n: Number of elements in @data
+ * @stats: Location for the result
+ *
+ * Compute minimum, maximum, sum and sum of squares of @data in one pass.
+ */
+void
+ufo_reduce_statistics (const gfloat *data,
+                       gsize n,
+                       UfoBufferStatistics *stats)
+{
+    ufo_reduce_statistics_with_impl (data, n, stats, get_impl ());
+}
+
+/*
+ * ufo_reduce_statistics_with_impl:
+ * @data: Float data
+ * @n: Number of elements in @data
+ * @stats: Location for the result
+ * @impl: Implementation to use, must be supported by the host
+ *
+ * Same as ufo_reduce_statistics() but with a fixed implementation.
+ */
+void
+ufo_reduce_statistics_with_impl (const gfloat *data,
+                                 gsize n,
+                                 UfoBufferStatistics *stats,
+                                 UfoConvertImpl impl)
+{
+    stats->min = G_MAXFLOAT;
+    stats->max = -G_MAXFLOAT;
+    stats->sum = 0.0;
+    stats->sum_squares = 0.0;
+
+    switch (clamp_impl (impl)) {
+#ifdef UFO_CONVERT_X86
+        case UFO_CONVERT_IMPL_AVX2:
+            statistics_avx2 (data, n, stats);
+            break;
+        case UFO_CONVERT_IMPL_SSE2:
+            statistics_sse2 (data, n, stats);
+            break;
+#endif
+        default:
+            statistics_scalar (data, n, stats);
+    }
+}
+
+/*
+ * ufo_reduce_min_max:
+ * @data: Float data
+ * @n: Number of elements in @data
+ * @min: Location for the minimum
+ * @max: Location for the maximum
+ *
+ * Find minimum and maximum of @data in one pass.
+ */
+void
+ufo_reduce_min_max (const gfloat *data,
+                    gsize n,
+                    gfloat *min,
+                    gfloat *max)
+{
+    ufo_reduce_min_max_with_impl (data, n, min, max, get_impl ());
+}
+
+/*
+ * ufo_reduce_min_max_with_impl:
+ * @data: Float data
+ * @n: Number of elements in @data
+ * @min: Location for the minimum
+ * @max: Location for the maximum
+ * @impl: Implementation to use, must be supported by the host
+ *
+ * Same as ufo_reduce_min_max() but with a fixed implementation.
+ */
+void
+ufo_reduce_min_max_with_impl (const gfloat *data,
+                              gsize n,
+                              gfloat *min,
+                              gfloat *max,
+                              UfoConvertImpl impl)
+{
+    gfloat min_value = G_MAXFLOAT;
+    gfloat max_value = -G_MAXFLOAT;
+
+    switch (clamp_impl (impl)) {
+#ifdef UFO_CONVERT_X86
+        case UFO_CONVERT_IMPL_AVX2:
+            min_max_avx2 (data, n, &min_value, &max_value);
+            break;
+        case UFO_CONVERT_IMPL_SSE2:
+            min_max_sse2 (data, n, &min_value, &max_value);
+            break;
+#endif
+        default:
+            min_max_scalar (data, n, &min_value, &max_value);
+    }
+
+    if (min != NULL)
+        *min = min_value;
+
+    if (max != NULL)
+        *max = max_value;
+}
+
+/*
+ * ufo_reduce_abs_sum:
+ * @data: Float data
+ * @n: Number of elements in @data
+ *
+ * Returns: Sum of absolute values of @data.
+ */
+gdouble
+ufo_reduce_abs_sum (const gfloat *data,
+                    gsize n)
+{
+    switch (get_impl ()) {
+#ifdef UFO_CONVERT_X86
+        case UFO_CONVERT_IMPL_AVX2:
+            return abs_sum_avx2 (data, n);
+        case UFO_CONVERT_IMPL_SSE2:
+            return abs_sum_sse2 (data, n);
+#endif
+        default:
+            return abs_sum_scalar (data, n);
+    }
+}
+
+/*
+ * ufo_reduce_squared_distance:
+ * @a: Float data
+ * @b: Float data or %NULL
+ * @n: Number of elements in @a and @b
+ *
+ * Returns: Sum of squared differences of @a and @b or sum of squares of @a if
+ * @b is %NULL.
+ */
+gdouble
+ufo_reduce_squared_distance (const gfloat *a,
+                             const gfloat *b,
+                             gsize n)
+{
+    switch (get_impl ()) {
+#ifdef UFO_CONVERT_X86
+        case UFO_CONVERT_IMPL_AVX2:
+            return squared_distance_avx2 (a, b, n);
+        case UFO_CONVERT_IMPL_SSE2:
+            return squared_distance_sse2 (a, b, n);
+#endif
+        default:
+            return squared_distance_scalar (a, b, n);
+    }
+}
+
+/*
+ * ufo_reduce_histogram:
+ * @data: Float data
+ * @n: Number of elements in @data
+ * @min: Lower bound of the first bin
+ * @max: Upper bound of the last bin
+ * @n_bins: Number of bins
+ * @histogram: Array of @n_bins counters
+ *
+ * Count the elements of @data in @n_bins equally sized bins spanning [@min,
+ * @max]. Values equal to @max are counted in the last bin, values outside the
+ * range are ignored.
+ */
+void
+ufo_reduce_histogram (const gfloat *data,
+                      gsize n,
+                      gfloat min,
+                      gfloat max,
+                      guint n_bins,
+                      guint *histogram)
+{
+    gdouble scale;
+
+    memset (histogram, 0, n_bins * sizeof (guint));
+    scale = max > min ? n_bins / ((gdouble) max - min) : 0.0;
+
+    for (gsize i = 0; i < n; i++) {
+        gdouble pos = (data[i] - (gdouble) min) * scale;
+
+        /* Also rejects NaN */
+        if (!(pos >= 0.0) || data[i] > max)
+            continue;
+
+        histogram[pos >= n_bins ? n_bins - 1 : (guint) pos]++;
+    }
+}
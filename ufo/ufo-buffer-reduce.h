@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UFO_BUFFER_REDUCE_H
+#define UFO_BUFFER_REDUCE_H
+
+#include <glib.h>
+#include "ufo-buffer.h"
+#include "ufo-buffer-convert.h"
+
+/* Private vectorized host reductions used by UfoBuffer and the basic ops */
+
+void    ufo_reduce_statistics           (const gfloat   *data,
+                                         gsize           n,
+                                         UfoBufferStatistics *stats);
+void    ufo_reduce_min_max              (const gfloat   *data,
+                                         gsize           n,
+                                         gfloat         *min,
+                                         gfloat         *max);
+void    ufo_reduce_statistics_with_impl (const gfloat   *data,
+                                         gsize           n,
+                                         UfoBufferStatistics *stats,
+                                         UfoConvertImpl  impl);
+void    ufo_reduce_min_max_with_impl    (const gfloat   *data,
+                                         gsize           n,
+                                         gfloat         *min,
+                                         gfloat         *max,
+                                         UfoConvertImpl  impl);
+gdouble ufo_reduce_abs_sum              (const gfloat   *data,
+                                         gsize           n);
+gdouble ufo_reduce_squared_distance     (const gfloat   *a,
+                                         const gfloat   *b,
+                                         gsize           n);
+void    ufo_reduce_histogram            (const gfloat   *data,
+                                         gsize           n,
+                                         gfloat          min,
+                                         gfloat          max,
+                                         guint           n_bins,
+                                         guint          *histogram);
+
+#endif
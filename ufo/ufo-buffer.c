@@ -28,6 +28,10 @@
 #endif
 
 #include "ufo-buffer.h"
+#include "ufo-buffer-pool.h"
+#include "ufo-buffer-convert.h"
+#include "ufo-buffer-reduce.h"
+#include "ufo-profiler.h"
 #include "ufo-resources.h"
 #include "ufo-priv.h"
 
@@ -62,6 +66,16 @@
  * ufo_buffer_get_device_array_view().
  */
 
+/**
+ * UfoBufferStatistics:
+ * @min: Smallest value
+ * @max: Largest value
+ * @sum: Sum of all values
+ * @sum_squares: Sum of all squared values
+ *
+ * Result of ufo_buffer_get_statistics() and ufo_op_statistics().
+ */
+
 /**
  * UfoBufferDepth:
  * @UFO_BUFFER_DEPTH_INVALID: default for unknown/unset values
@@ -73,7 +87,8 @@
  * @UFO_BUFFER_DEPTH_32U: 32 bit unsigned
  * @UFO_BUFFER_DEPTH_32F: 32 bit float
  *
- * Source depth of data as used in ufo_buffer_convert().
+ * Source depth of data as used in ufo_buffer_convert() and storage depth of
+ * raw data set with ufo_buffer_get_raw_host_array().
  */
 
 /**
@@ -96,8 +111,43 @@
  * Layout of the backed data memory.
  */
 
+/**
+ * UfoBufferMemoryMode:
+ * @UFO_BUFFER_MEMORY_MODE_SEPARATE: Host and device memory are allocated
+ *  separately and data is copied between them
+ * @UFO_BUFFER_MEMORY_MODE_MAPPED: Host memory is obtained by mapping the device
+ *  array which is allocated with %CL_MEM_ALLOC_HOST_PTR. This avoids copies on
+ *  devices sharing memory with the host and uses pinned memory otherwise.
+ *
+ * Allocation strategy of host memory, see UfoResources:buffer-memory-mode.
+ */
+
 G_DEFINE_TYPE(UfoBuffer, ufo_buffer, G_TYPE_OBJECT)
 
+/* Metadata entries that fit into a store without further allocation */
+#define METADATA_INLINE_ENTRIES 4
+
+typedef struct {
+    GQuark  key;
+    GValue  value;
+} MetadataEntry;
+
+/*
+ * Metadata is kept in a small reference-counted array keyed by interned
+ * strings. Copying metadata to another buffer usually just shares the store,
+ * which is only duplicated when one of the buffers modifies it.
+ */
+typedef struct {
+    gint            ref_count;
+    guint           n_entries;
+    guint           capacity;
+    MetadataEntry  *entries;
+    MetadataEntry   inline_entries[METADATA_INLINE_ENTRIES];
+} Metadata;
+
+static Metadata *metadata_ref (Metadata *meta);
+static void metadata_unref (Metadata *meta);
+
 #define UFO_BUFFER_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), UFO_TYPE_BUFFER, UfoBufferPrivate))
 
 enum {
@@ -118,19 +168,116 @@ struct _UfoBufferPrivate {
     cl_channel_order    channel_order_3d;  /* Supported channel order for CL_MEM_OBJECT_IMAGE3D type and CL_FLOAT image_channel_data_type */
     cl_command_queue    last_queue;
     gsize               size;           /* size of buffer in bytes */
-    UfoBufferLocation   location;
+    UfoBufferLocation   location;       /* most recently written copy */
     UfoBufferLocation   last_location;
+    guint               valid;          /* mask of copies that are up-to-date */
+    guint               borrowed;       /* mask of copies owned by a shared buffer */
+    cl_event            pending_event;  /* last asynchronous transfer */
+    UfoBufferMemoryMode memory_mode;
+    gboolean            mapped;         /* host_array is mapped from device_array */
+    UfoBufferDepth      depth;          /* storage depth of host_array */
     UfoBufferLayout     layout;
-    GHashTable         *metadata;
+    guint64             sequence;       /* position in the generated stream */
+    Metadata           *metadata;       /* shared, copy-on-write */
     GList              *sub_device_arrays;
+    UfoBufferPool      *pool;
+    gsize               host_capacity;      /* non-zero if host_array is pooled */
+    gsize               device_capacity;    /* non-zero if device_array is pooled */
 };
 
+#define VALID(location) ((location) == UFO_BUFFER_LOCATION_INVALID ? 0 : (1 << (location)))
+
+/*
+ * Each of host array, device array and device image can hold an up-to-date
+ * copy of the data at the same time. Write access makes the accessed copy the
+ * only valid one, read-only access adds the accessed copy to the valid ones.
+ */
+static void make_exclusive (UfoBufferPrivate *priv, UfoBufferLocation location);
+
 static void
 update_location (UfoBufferPrivate *priv,
                  UfoBufferLocation new_location)
 {
+    make_exclusive (priv, new_location);
     priv->last_location = priv->location;
     priv->location = new_location;
+    priv->valid = VALID (new_location);
+}
+
+static void
+add_valid_location (UfoBufferPrivate *priv,
+                    UfoBufferLocation location)
+{
+    if (priv->location == UFO_BUFFER_LOCATION_INVALID)
+        update_location (priv, location);
+    else
+        priv->valid |= VALID (location);
+}
+
+static gboolean
+is_valid (UfoBufferPrivate *priv,
+          UfoBufferLocation location)
+{
+    return (priv->valid & VALID (location)) != 0;
+}
+
+/*
+ * A buffer that shares the data of another buffer (see ufo_buffer_share())
+ * borrows its host array and device array. Borrowed memory is neither written
+ * nor freed, write access replaces it with a private copy first.
+ */
+static gboolean
+is_borrowed (UfoBufferPrivate *priv,
+             UfoBufferLocation location)
+{
+    return (priv->borrowed & VALID (location)) != 0;
+}
+
+/*
+ * Asynchronous transfers leave an event behind that must complete before any
+ * of the buffer memory is touched again. Synchronous accessors wait for it,
+ * asynchronous accessors add it to the wait list of the next transfer.
+ */
+static void
+wait_pending (UfoBufferPrivate *priv)
+{
+    if (priv->pending_event != NULL) {
+        UFO_RESOURCES_CHECK_CLERR (clWaitForEvents (1, &priv->pending_event));
+        UFO_RESOURCES_CHECK_CLERR (clReleaseEvent (priv->pending_event));
+        priv->pending_event = NULL;
+    }
+}
+
+static void
+set_pending (UfoBufferPrivate *priv,
+             cl_event event)
+{
+    if (priv->pending_event != NULL)
+        UFO_RESOURCES_CHECK_CLERR (clReleaseEvent (priv->pending_event));
+
+    priv->pending_event = event;
+}
+
+static cl_event *
+get_wait_list (UfoBufferPrivate *priv,
+               guint n_events,
+               gpointer *events,
+               cl_uint *n_wait)
+{
+    cl_event *wait_list;
+
+    *n_wait = 0;
+    wait_list = g_new0 (cl_event, n_events + 1);
+
+    for (guint i = 0; i < n_events; i++) {
+        if (events[i] != NULL)
+            wait_list[(*n_wait)++] = events[i];
+    }
+
+    if (priv->pending_event != NULL)
+        wait_list[(*n_wait)++] = priv->pending_event;
+
+    return wait_list;
 }
 
 static void
@@ -156,13 +303,161 @@ compute_required_size (UfoRequisition *requisition)
     return size;
 }
 
+static gboolean
+uses_mapping (UfoBufferPrivate *priv)
+{
+    return priv->memory_mode == UFO_BUFFER_MEMORY_MODE_MAPPED && priv->borrowed == 0 &&
+           priv->context != NULL && priv->last_queue != NULL;
+}
+
+static void
+unmap_host_array (UfoBufferPrivate *priv)
+{
+    cl_event event;
+
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueUnmapMemObject (priv->last_queue, priv->device_array,
+                                                        priv->host_array, 0, NULL, &event));
+    UFO_RESOURCES_CHECK_CLERR (clWaitForEvents (1, &event));
+    UFO_RESOURCES_CHECK_CLERR (clReleaseEvent (event));
+    ufo_profiler_record_transfer (UFO_PROFILER_TRANSFER_MAP, priv->size);
+
+    priv->host_array = NULL;
+    priv->mapped = FALSE;
+
+    /* Host writes are now visible in the device array */
+    if (is_valid (priv, UFO_BUFFER_LOCATION_HOST)) {
+        priv->valid = (priv->valid & ~VALID (UFO_BUFFER_LOCATION_HOST)) | VALID (UFO_BUFFER_LOCATION_DEVICE);
+
+        if (priv->location == UFO_BUFFER_LOCATION_HOST)
+            priv->location = UFO_BUFFER_LOCATION_DEVICE;
+    }
+}
+
+static void
+release_host_mem (UfoBufferPrivate *priv)
+{
+    wait_pending (priv);
+
+    if (is_borrowed (priv, UFO_BUFFER_LOCATION_HOST)) {
+        priv->borrowed &= ~VALID (UFO_BUFFER_LOCATION_HOST);
+        priv->host_array = NULL;
+        return;
+    }
+
+    if (priv->mapped)
+        unmap_host_array (priv);
+
+    if (priv->host_array != NULL) {
+        if (priv->host_capacity > 0 && priv->pool != NULL)
+            ufo_buffer_pool_put_host_mem (priv->pool, priv->host_array, priv->host_capacity);
+        else if (priv->host_capacity > 0 || priv->free)
+            g_free (priv->host_array);
+    }
+
+    priv->host_array = NULL;
+    priv->host_capacity = 0;
+}
+
+static void
+release_device_array (UfoBufferPrivate *priv)
+{
+    wait_pending (priv);
+
+    if (is_borrowed (priv, UFO_BUFFER_LOCATION_DEVICE)) {
+        priv->borrowed &= ~VALID (UFO_BUFFER_LOCATION_DEVICE);
+        priv->device_array = NULL;
+        return;
+    }
+
+    if (priv->mapped)
+        unmap_host_array (priv);
+
+    if (priv->device_array != NULL) {
+        if (priv->device_capacity > 0 && priv->pool != NULL)
+            ufo_buffer_pool_put_device_mem (priv->pool, priv->context, priv->device_array, priv->device_capacity);
+        else
+            UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (priv->device_array));
+    }
+
+    priv->device_array = NULL;
+    priv->device_capacity = 0;
+}
+
+static void
+release_device_image (UfoBufferPrivate *priv)
+{
+    wait_pending (priv);
+
+    if (priv->device_image != NULL) {
+        if (priv->pool != NULL) {
+            ufo_buffer_pool_put_device_image (priv->pool, priv->context, priv->device_image,
+                                              priv->requisition.dims[0], priv->requisition.dims[1],
+                                              priv->requisition.n_dims == 3 ? priv->requisition.dims[2] : 1);
+        }
+        else
+            UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (priv->device_image));
+    }
+
+    priv->device_image = NULL;
+}
+
+static void alloc_device_array (UfoBufferPrivate *priv);
+static void convert_raw_host_array (UfoBufferPrivate *priv);
+
+static void
+map_host_array (UfoBufferPrivate *priv)
+{
+    cl_int err;
+
+    if (priv->device_array == NULL)
+        alloc_device_array (priv);
+
+    priv->host_array = clEnqueueMapBuffer (priv->last_queue, priv->device_array, CL_TRUE,
+                                           CL_MAP_READ | CL_MAP_WRITE, 0, priv->size,
+                                           0, NULL, NULL, &err);
+    UFO_RESOURCES_CHECK_CLERR (err);
+    ufo_profiler_record_transfer (UFO_PROFILER_TRANSFER_MAP, priv->size);
+
+    priv->free = TRUE;
+    priv->host_capacity = 0;
+    priv->mapped = TRUE;
+
+    /* While mapped, only the host may access the data */
+    if (is_valid (priv, UFO_BUFFER_LOCATION_DEVICE)) {
+        priv->valid = (priv->valid & ~VALID (UFO_BUFFER_LOCATION_DEVICE)) | VALID (UFO_BUFFER_LOCATION_HOST);
+
+        if (priv->location == UFO_BUFFER_LOCATION_DEVICE)
+            priv->location = UFO_BUFFER_LOCATION_HOST;
+    }
+}
+
 static void
 alloc_host_mem (UfoBufferPrivate *priv)
 {
-    if (priv->host_array != NULL && priv->free)
-        g_free (priv->host_array);
+    if (priv->host_array != NULL && (priv->free || priv->host_capacity > 0))
+        release_host_mem (priv);
+
+    if (uses_mapping (priv))
+        map_host_array (priv);
+    else if (priv->pool != NULL)
+        priv->host_array = ufo_buffer_pool_get_host_mem (priv->pool, priv->size, &priv->host_capacity);
+    else
+        priv->host_array = g_malloc0 (priv->size);
+}
+
+/*
+ * Raw integer data is only ever held in the host array. Discard it if the
+ * buffer is about to be overwritten anyway.
+ */
+static void
+drop_raw_host_array (UfoBufferPrivate *priv)
+{
+    if (priv->depth == UFO_BUFFER_DEPTH_32F)
+        return;
 
-    priv->host_array = g_malloc0 (priv->size);
+    release_host_mem (priv);
+    priv->depth = UFO_BUFFER_DEPTH_32F;
+    priv->valid &= ~VALID (UFO_BUFFER_LOCATION_HOST);
 }
 
 static void
@@ -171,8 +466,21 @@ alloc_device_array (UfoBufferPrivate *priv)
     cl_int err;
     cl_mem mem;
 
-    if (priv->device_array != NULL)
-        UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (priv->device_array));
+    release_device_array (priv);
+
+    if (priv->memory_mode == UFO_BUFFER_MEMORY_MODE_MAPPED) {
+        mem = clCreateBuffer (priv->context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, priv->size, NULL, &err);
+        g_debug ("ALOC %p [size=%3.2f MB, type=mapped buffer]", (gpointer) mem, priv->size / 1024. / 1024.);
+        UFO_RESOURCES_CHECK_CLERR (err);
+        priv->device_array = mem;
+        return;
+    }
+
+    if (priv->pool != NULL) {
+        priv->device_array = ufo_buffer_pool_get_device_mem (priv->pool, priv->context,
+                                                             priv->size, &priv->device_capacity);
+        return;
+    }
 
     mem = clCreateBuffer (priv->context, CL_MEM_READ_WRITE, priv->size, NULL, &err);
     g_debug ("ALOC %p [size=%3.2f MB, type=buffer]", (gpointer) mem, priv->size / 1024. / 1024.);
@@ -181,6 +489,65 @@ alloc_device_array (UfoBufferPrivate *priv)
     priv->device_array = mem;
 }
 
+/* Forget all borrowed memory, data that was only available there is lost */
+static void
+drop_shared (UfoBufferPrivate *priv)
+{
+    if (priv->borrowed == 0)
+        return;
+
+    priv->valid &= ~priv->borrowed;
+
+    if (is_borrowed (priv, UFO_BUFFER_LOCATION_HOST)) {
+        release_host_mem (priv);
+        priv->depth = UFO_BUFFER_DEPTH_32F;
+    }
+
+    if (is_borrowed (priv, UFO_BUFFER_LOCATION_DEVICE))
+        release_device_array (priv);
+
+    if (!is_valid (priv, priv->location))
+        priv->location = UFO_BUFFER_LOCATION_INVALID;
+}
+
+static gsize get_raw_size (UfoBufferPrivate *priv, UfoBufferDepth depth);
+
+/*
+ * Prepare write access to @location by copying borrowed memory there and
+ * forgetting all other borrowed copies.
+ */
+static void
+make_exclusive (UfoBufferPrivate *priv,
+                UfoBufferLocation location)
+{
+    if (priv->borrowed == 0)
+        return;
+
+    if (location == UFO_BUFFER_LOCATION_HOST && is_borrowed (priv, UFO_BUFFER_LOCATION_HOST)) {
+        gpointer shared = priv->host_array;
+
+        priv->host_array = NULL;
+        priv->borrowed &= ~VALID (UFO_BUFFER_LOCATION_HOST);
+        alloc_host_mem (priv);
+        memcpy (priv->host_array, shared, get_raw_size (priv, priv->depth));
+    }
+    else if (location == UFO_BUFFER_LOCATION_DEVICE && is_borrowed (priv, UFO_BUFFER_LOCATION_DEVICE)) {
+        cl_mem shared = priv->device_array;
+        cl_event event;
+
+        priv->device_array = NULL;
+        priv->borrowed &= ~VALID (UFO_BUFFER_LOCATION_DEVICE);
+        alloc_device_array (priv);
+
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueCopyBuffer (priv->last_queue, shared, priv->device_array,
+                                                        0, 0, priv->size, 0, NULL, &event));
+        UFO_RESOURCES_CHECK_CLERR (clWaitForEvents (1, &event));
+        UFO_RESOURCES_CHECK_CLERR (clReleaseEvent (event));
+    }
+
+    drop_shared (priv);
+}
+
 static cl_channel_order
 get_image_channel_order (cl_context context,
                          cl_mem_object_type image_type)
@@ -300,8 +667,7 @@ alloc_device_image (UfoBufferPrivate *priv)
     g_assert ((priv->requisition.n_dims == 2) ||
               (priv->requisition.n_dims == 3));
 
-    if (priv->device_image != NULL)
-        UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (priv->device_image));
+    release_device_image (priv);
 
     format.image_channel_data_type = CL_FLOAT;
 
@@ -310,6 +676,16 @@ alloc_device_image (UfoBufferPrivate *priv)
     height = priv->requisition.dims[1];
     depth = priv->requisition.dims[2];
 
+    if (priv->pool != NULL) {
+        mem = ufo_buffer_pool_get_device_image (priv->pool, priv->context, width, height,
+                                                priv->requisition.n_dims == 3 ? depth : 1);
+
+        if (mem != NULL) {
+            priv->device_image = mem;
+            return;
+        }
+    }
+
     if (priv->requisition.n_dims == 2) {
         if (!priv->channel_order_2d) {
             priv->channel_order_2d = get_image_channel_order (priv->context, CL_MEM_OBJECT_IMAGE2D);
@@ -363,6 +739,60 @@ ufo_buffer_new (UfoRequisition *requisition,
     return buffer;
 }
 
+/**
+ * ufo_buffer_new_from_pool:
+ * @requisition: (in): size requisition
+ * @context: (in) (allow-none): cl_context to use for creating the device array
+ * @pool: A #UfoBufferPool
+ *
+ * Create a new #UfoBuffer whose host and device memory is taken from @pool and
+ * returned to it when the buffer is resized or destroyed.
+ *
+ * Return value: A new #UfoBuffer with the given dimensions.
+ */
+UfoBuffer *
+ufo_buffer_new_from_pool (UfoRequisition *requisition,
+                          gpointer context,
+                          UfoBufferPool *pool)
+{
+    g_return_val_if_fail (UFO_IS_BUFFER_POOL (pool), NULL);
+    return ufo_buffer_new_full (requisition, context, pool, UFO_BUFFER_MEMORY_MODE_SEPARATE);
+}
+
+/**
+ * ufo_buffer_new_full:
+ * @requisition: (in): size requisition
+ * @context: (in) (allow-none): cl_context to use for creating the device array
+ * @pool: (allow-none): A #UfoBufferPool or %NULL
+ * @mode: Allocation strategy for host memory
+ *
+ * Create a new #UfoBuffer whose memory is taken from @pool if given and whose
+ * host memory is allocated according to @mode. Mapped buffers bypass the pool
+ * for the device array. Without a context or command queue, host memory is
+ * allocated separately regardless of @mode.
+ *
+ * Return value: A new #UfoBuffer with the given dimensions.
+ */
+UfoBuffer *
+ufo_buffer_new_full (UfoRequisition *requisition,
+                     gpointer context,
+                     UfoBufferPool *pool,
+                     UfoBufferMemoryMode mode)
+{
+    UfoBuffer *buffer;
+
+    buffer = ufo_buffer_new (requisition, context);
+
+    if (buffer != NULL) {
+        buffer->priv->memory_mode = mode;
+
+        if (pool != NULL)
+            buffer->priv->pool = g_object_ref (pool);
+    }
+
+    return buffer;
+}
+
 /**
  * ufo_buffer_new_with_size:
  * @dims: (element-type guint): size requisition
@@ -466,20 +896,33 @@ transfer_host_to_host (UfoBufferPrivate *src_priv,
 }
 
 static void
-transfer_host_to_device (UfoBufferPrivate *src_priv,
-                         UfoBufferPrivate *dst_priv,
-                         cl_command_queue queue)
+enqueue_host_to_device (UfoBufferPrivate *src_priv,
+                        UfoBufferPrivate *dst_priv,
+                        cl_command_queue queue,
+                        cl_bool blocking,
+                        cl_uint n_events,
+                        const cl_event *wait_list,
+                        cl_event *event)
 {
     cl_int errcode;
 
     errcode = clEnqueueWriteBuffer (queue,
                                     dst_priv->device_array,
-                                    CL_TRUE,
+                                    blocking,
                                     0, src_priv->size,
                                     src_priv->host_array,
-                                    0, NULL, NULL);
+                                    n_events, n_events > 0 ? wait_list : NULL, event);
 
     UFO_RESOURCES_CHECK_CLERR (errcode);
+    ufo_profiler_record_transfer (UFO_PROFILER_TRANSFER_COPY, src_priv->size);
+}
+
+static void
+transfer_host_to_device (UfoBufferPrivate *src_priv,
+                         UfoBufferPrivate *dst_priv,
+                         cl_command_queue queue)
+{
+    enqueue_host_to_device (src_priv, dst_priv, queue, CL_TRUE, 0, NULL, NULL);
 }
 
 static void
@@ -505,6 +948,7 @@ transfer_host_to_image (UfoBufferPrivate *src_priv,
     UFO_RESOURCES_CHECK_CLERR (errcode);
     UFO_RESOURCES_CHECK_CLERR (clWaitForEvents (1, &event));
     UFO_RESOURCES_CHECK_CLERR (clReleaseEvent (event));
+    ufo_profiler_record_transfer (UFO_PROFILER_TRANSFER_COPY, src_priv->size);
 }
 
 static void
@@ -528,20 +972,33 @@ transfer_device_to_device (UfoBufferPrivate *src_priv,
 }
 
 static void
-transfer_device_to_host (UfoBufferPrivate *src_priv,
-                         UfoBufferPrivate *dst_priv,
-                         cl_command_queue queue)
+enqueue_device_to_host (UfoBufferPrivate *src_priv,
+                        UfoBufferPrivate *dst_priv,
+                        cl_command_queue queue,
+                        cl_bool blocking,
+                        cl_uint n_events,
+                        const cl_event *wait_list,
+                        cl_event *event)
 {
     cl_int errcode;
 
     errcode = clEnqueueReadBuffer (queue,
                                    src_priv->device_array,
-                                   CL_TRUE,
+                                   blocking,
                                    0, src_priv->size,
                                    dst_priv->host_array,
-                                   0, NULL, NULL);
+                                   n_events, n_events > 0 ? wait_list : NULL, event);
 
     UFO_RESOURCES_CHECK_CLERR (errcode);
+    ufo_profiler_record_transfer (UFO_PROFILER_TRANSFER_COPY, src_priv->size);
+}
+
+static void
+transfer_device_to_host (UfoBufferPrivate *src_priv,
+                         UfoBufferPrivate *dst_priv,
+                         cl_command_queue queue)
+{
+    enqueue_device_to_host (src_priv, dst_priv, queue, CL_TRUE, 0, NULL, NULL);
 }
 
 static void
@@ -591,9 +1048,13 @@ transfer_image_to_image (UfoBufferPrivate *src_priv,
 }
 
 static void
-transfer_image_to_host (UfoBufferPrivate *src_priv,
-                        UfoBufferPrivate *dst_priv,
-                        cl_command_queue queue)
+enqueue_image_to_host (UfoBufferPrivate *src_priv,
+                       UfoBufferPrivate *dst_priv,
+                       cl_command_queue queue,
+                       cl_bool blocking,
+                       cl_uint n_events,
+                       const cl_event *wait_list,
+                       cl_event *event)
 {
     cl_int errcode;
     size_t region[3];
@@ -603,21 +1064,32 @@ transfer_image_to_host (UfoBufferPrivate *src_priv,
 
     errcode = clEnqueueReadImage (queue,
                                   src_priv->device_image,
-                                  CL_TRUE,
+                                  blocking,
                                   origin, region,
                                   0, 0,
                                   dst_priv->host_array,
-                                  0, NULL, NULL);
+                                  n_events, n_events > 0 ? wait_list : NULL, event);
 
     UFO_RESOURCES_CHECK_CLERR (errcode);
+    ufo_profiler_record_transfer (UFO_PROFILER_TRANSFER_COPY, src_priv->size);
 }
 
 static void
-transfer_image_to_device (UfoBufferPrivate *src_priv,
-                          UfoBufferPrivate *dst_priv,
-                          cl_command_queue queue)
+transfer_image_to_host (UfoBufferPrivate *src_priv,
+                        UfoBufferPrivate *dst_priv,
+                        cl_command_queue queue)
+{
+    enqueue_image_to_host (src_priv, dst_priv, queue, CL_TRUE, 0, NULL, NULL);
+}
+
+static void
+enqueue_image_to_device (UfoBufferPrivate *src_priv,
+                         UfoBufferPrivate *dst_priv,
+                         cl_command_queue queue,
+                         cl_uint n_events,
+                         const cl_event *wait_list,
+                         cl_event *event)
 {
-    cl_event event;
     cl_int errcode;
     size_t region[3];
     size_t origin[] = { 0, 0, 0 };
@@ -628,9 +1100,19 @@ transfer_image_to_device (UfoBufferPrivate *src_priv,
                                           src_priv->device_image,
                                           dst_priv->device_array,
                                           origin, region, 0,
-                                          0, NULL, &event);
+                                          n_events, n_events > 0 ? wait_list : NULL, event);
 
     UFO_RESOURCES_CHECK_CLERR (errcode);
+}
+
+static void
+transfer_image_to_device (UfoBufferPrivate *src_priv,
+                          UfoBufferPrivate *dst_priv,
+                          cl_command_queue queue)
+{
+    cl_event event;
+
+    enqueue_image_to_device (src_priv, dst_priv, queue, 0, NULL, &event);
     UFO_RESOURCES_CHECK_CLERR (clWaitForEvents (1, &event));
     UFO_RESOURCES_CHECK_CLERR (clReleaseEvent (event));
 }
@@ -671,9 +1153,16 @@ ufo_buffer_copy (UfoBuffer *src, UfoBuffer *dst)
     dpriv = dst->priv;
     queue = spriv->last_queue != NULL ? spriv->last_queue : dpriv->last_queue;
 
+    wait_pending (spriv);
+    wait_pending (dpriv);
+    convert_raw_host_array (spriv);
+    drop_shared (dpriv);
+    drop_raw_host_array (dpriv);
+
     if (spriv->location == UFO_BUFFER_LOCATION_INVALID) {
         alloc_host_mem (spriv);
         spriv->location = UFO_BUFFER_LOCATION_HOST;
+        spriv->valid = VALID (UFO_BUFFER_LOCATION_HOST);
     }
 
     if (dpriv->location == UFO_BUFFER_LOCATION_INVALID ||
@@ -684,6 +1173,7 @@ ufo_buffer_copy (UfoBuffer *src, UfoBuffer *dst)
 
     transfer[spriv->location][dpriv->location](spriv, dpriv, queue);
     dpriv->last_queue = queue;
+    dpriv->valid = VALID (dpriv->location);
 }
 
 /**
@@ -706,9 +1196,37 @@ ufo_buffer_dup (UfoBuffer *buffer)
     return copy;
 }
 
-/**
- * ufo_buffer_swap_data:
- * @src: Buffer to receive data from @dst
+/*
+ * Memory goes back to the pool it was taken from. Swapping the current copies
+ * of buffers from different pools thus swaps the pools too, after the stale
+ * copies at the other locations were released to their original pools.
+ */
+static void
+swap_pools (UfoBufferPrivate *src,
+            UfoBufferPrivate *dst)
+{
+    UfoBufferPrivate *privs[2] = { src, dst };
+    UfoBufferPool *tmp;
+
+    for (guint i = 0; i < 2; i++) {
+        if (privs[i]->location != UFO_BUFFER_LOCATION_HOST)
+            release_host_mem (privs[i]);
+
+        if (privs[i]->location != UFO_BUFFER_LOCATION_DEVICE)
+            release_device_array (privs[i]);
+
+        if (privs[i]->location != UFO_BUFFER_LOCATION_DEVICE_IMAGE)
+            release_device_image (privs[i]);
+    }
+
+    tmp = src->pool;
+    src->pool = dst->pool;
+    dst->pool = tmp;
+}
+
+/**
+ * ufo_buffer_swap_data:
+ * @src: Buffer to receive data from @dst
  * @dst: Buffer to receive data from @src
  *
  * Swap the *content* of the two buffers if possible (i.e. data resides on the
@@ -720,25 +1238,51 @@ void
 ufo_buffer_swap_data (UfoBuffer *src,
                       UfoBuffer *dst)
 {
-    GHashTable *tmp_meta;
+    Metadata *tmp_meta;
 
-    if (src->priv->location != dst->priv->location) {
+    if (src->priv->location != dst->priv->location || src->priv->mapped || dst->priv->mapped ||
+        src->priv->borrowed != 0 || dst->priv->borrowed != 0) {
         ufo_buffer_copy (src, dst);
         return;
     }
 
+    wait_pending (src->priv);
+    wait_pending (dst->priv);
+
+    if (src->priv->pool != dst->priv->pool && src->priv->location != UFO_BUFFER_LOCATION_INVALID)
+        swap_pools (src->priv, dst->priv);
+
     tmp_meta = src->priv->metadata;
     src->priv->metadata = dst->priv->metadata;
     dst->priv->metadata = tmp_meta;
 
+    /* Only the current copies are swapped, all others become stale */
+    src->priv->valid = VALID (src->priv->location);
+    dst->priv->valid = VALID (dst->priv->location);
+
     switch (src->priv->location) {
         case UFO_BUFFER_LOCATION_HOST:
             {
                 gfloat *tmp;
+                gsize tmp_capacity;
+                gboolean tmp_free;
+                UfoBufferDepth tmp_depth;
 
                 tmp = src->priv->host_array;
                 src->priv->host_array = dst->priv->host_array;
                 dst->priv->host_array = tmp;
+
+                tmp_capacity = src->priv->host_capacity;
+                src->priv->host_capacity = dst->priv->host_capacity;
+                dst->priv->host_capacity = tmp_capacity;
+
+                tmp_free = src->priv->free;
+                src->priv->free = dst->priv->free;
+                dst->priv->free = tmp_free;
+
+                tmp_depth = src->priv->depth;
+                src->priv->depth = dst->priv->depth;
+                dst->priv->depth = tmp_depth;
             }
             break;
 
@@ -746,9 +1290,15 @@ ufo_buffer_swap_data (UfoBuffer *src,
             {
                 cl_mem tmp;
 
+                gsize tmp_capacity;
+
                 tmp = src->priv->device_array;
                 src->priv->device_array = dst->priv->device_array;
                 dst->priv->device_array = tmp;
+
+                tmp_capacity = src->priv->device_capacity;
+                src->priv->device_capacity = dst->priv->device_capacity;
+                dst->priv->device_capacity = tmp_capacity;
             }
             break;
 
@@ -767,6 +1317,105 @@ ufo_buffer_swap_data (UfoBuffer *src,
     }
 }
 
+/**
+ * ufo_buffer_share:
+ * @src: Source #UfoBuffer
+ * @dst: Destination #UfoBuffer
+ *
+ * Let @dst refer to the host and device data of @src without copying it. Any
+ * memory previously held by @dst is released, the metadata of @src is shared
+ * as well. Read-only access to @dst uses the memory of @src, write access
+ * makes a private copy first. @src must not be modified or destroyed until
+ * @dst is written to or ufo_buffer_unshare() is called on it. If @src has no
+ * valid host or device copy, the data is copied with ufo_buffer_copy().
+ */
+void
+ufo_buffer_share (UfoBuffer *src,
+                  UfoBuffer *dst)
+{
+    UfoBufferPrivate *spriv;
+    UfoBufferPrivate *dpriv;
+
+    g_return_if_fail (UFO_IS_BUFFER (src) && UFO_IS_BUFFER (dst));
+
+    spriv = src->priv;
+    dpriv = dst->priv;
+
+    wait_pending (spriv);
+
+    if (!is_valid (spriv, UFO_BUFFER_LOCATION_HOST) &&
+        !(is_valid (spriv, UFO_BUFFER_LOCATION_DEVICE) && spriv->context == dpriv->context)) {
+        ufo_buffer_copy (src, dst);
+        return;
+    }
+
+    if (ufo_buffer_cmp_dimensions (dst, &spriv->requisition) != 0)
+        ufo_buffer_resize (dst, &spriv->requisition);
+
+    /* A mapped array must be unmapped before its device array is released */
+    if (dpriv->host_array != NULL && (dpriv->free || dpriv->host_capacity > 0 || dpriv->mapped))
+        release_host_mem (dpriv);
+
+    dpriv->host_array = NULL;
+    release_device_array (dpriv);
+    release_device_image (dpriv);
+
+    if (is_valid (spriv, UFO_BUFFER_LOCATION_HOST)) {
+        dpriv->host_array = spriv->host_array;
+        dpriv->borrowed |= VALID (UFO_BUFFER_LOCATION_HOST);
+    }
+
+    if (is_valid (spriv, UFO_BUFFER_LOCATION_DEVICE) && spriv->context == dpriv->context) {
+        dpriv->device_array = spriv->device_array;
+        dpriv->borrowed |= VALID (UFO_BUFFER_LOCATION_DEVICE);
+    }
+
+    dpriv->valid = dpriv->borrowed;
+    dpriv->location = is_borrowed (dpriv, spriv->location) ? spriv->location :
+        (is_borrowed (dpriv, UFO_BUFFER_LOCATION_HOST) ? UFO_BUFFER_LOCATION_HOST : UFO_BUFFER_LOCATION_DEVICE);
+    dpriv->last_location = dpriv->location;
+    dpriv->depth = spriv->depth;
+    dpriv->layout = spriv->layout;
+    dpriv->sequence = spriv->sequence;
+
+    /* Readers must synchronize with the queue that produced the data */
+    if (spriv->last_queue != NULL)
+        dpriv->last_queue = spriv->last_queue;
+
+    metadata_unref (dpriv->metadata);
+    dpriv->metadata = spriv->metadata != NULL ? metadata_ref (spriv->metadata) : NULL;
+}
+
+/**
+ * ufo_buffer_unshare:
+ * @buffer: A #UfoBuffer
+ *
+ * Stop referring to data shared with ufo_buffer_share(). Data that was only
+ * available in the shared memory is lost.
+ */
+void
+ufo_buffer_unshare (UfoBuffer *buffer)
+{
+    g_return_if_fail (UFO_IS_BUFFER (buffer));
+    drop_shared (buffer->priv);
+}
+
+/**
+ * ufo_buffer_is_shared:
+ * @buffer: A #UfoBuffer
+ *
+ * Check if @buffer still refers to data of another buffer.
+ *
+ * Returns: %TRUE if @buffer has not yet copied data shared with
+ * ufo_buffer_share().
+ */
+gboolean
+ufo_buffer_is_shared (UfoBuffer *buffer)
+{
+    g_return_val_if_fail (UFO_IS_BUFFER (buffer), FALSE);
+    return buffer->priv->borrowed != 0;
+}
+
 /**
  * ufo_buffer_resize:
  * @buffer: A #UfoBuffer
@@ -790,21 +1439,13 @@ ufo_buffer_resize (UfoBuffer *buffer,
 
     priv = UFO_BUFFER_GET_PRIVATE (buffer);
 
-    if (priv->host_array != NULL && priv->free) {
-        g_free (priv->host_array);
-        priv->host_array = NULL;
-    }
+    if (priv->host_array != NULL && (priv->free || priv->host_capacity > 0))
+        release_host_mem (priv);
 
-    if (priv->device_array != NULL) {
-        UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (priv->device_array));
-        priv->device_array = NULL;
-    }
-
-    if (priv->device_image != NULL) {
-        UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (priv->device_image));
-        priv->device_image = NULL;
-    }
+    release_device_array (priv);
+    release_device_image (priv);
 
+    priv->depth = UFO_BUFFER_DEPTH_32F;
     priv->size = compute_required_size (requisition);
     copy_requisition (requisition, &priv->requisition);
 }
@@ -823,20 +1464,25 @@ ufo_buffer_cmp_dimensions (UfoBuffer *buffer,
                            UfoRequisition *requisition)
 {
     UfoBufferPrivate *priv;
-    gint result;
+    gsize size;
 
     g_return_val_if_fail (UFO_IS_BUFFER(buffer), FALSE);
 
     priv = buffer->priv;
-    result = 0;
 
-    for (guint i = 0; i < priv->requisition.n_dims; i++) {
-        gint req_dim = (gint) requisition->dims[i];
-        gint host_dim = (gint) priv->requisition.dims[i];
-        result += req_dim - host_dim;
+    if (requisition->n_dims == priv->requisition.n_dims) {
+        guint i = 0;
+
+        while (i < priv->requisition.n_dims && requisition->dims[i] == priv->requisition.dims[i])
+            i++;
+
+        if (i == priv->requisition.n_dims)
+            return 0;
     }
 
-    return result;
+    /* Differently shaped buffers of the same size are never equal */
+    size = compute_required_size (requisition);
+    return size < priv->size ? -1 : 1;
 }
 
 /**
@@ -858,12 +1504,28 @@ ufo_buffer_get_requisition (UfoBuffer *buffer,
     copy_requisition (&priv->requisition, requisition);
 }
 
+/*
+ * Kernels and transfers that other tasks enqueued on another queue may still
+ * use the device memory. A marker on the previous queue becomes the pending
+ * event, which subsequent accesses through @queue wait for or chain on.
+ */
 static void
 update_last_queue (UfoBufferPrivate *priv,
                    cl_command_queue queue)
 {
-    if (queue != NULL)
-        priv->last_queue = queue;
+    if (queue == NULL)
+        return;
+
+    if (priv->last_queue != NULL && priv->last_queue != queue &&
+        (priv->device_array != NULL || priv->device_image != NULL)) {
+        cl_event marker;
+
+        UFO_RESOURCES_CHECK_CLERR (clEnqueueMarker (priv->last_queue, &marker));
+        UFO_RESOURCES_CHECK_CLERR (clFlush (priv->last_queue));
+        set_pending (priv, marker);
+    }
+
+    priv->last_queue = queue;
 }
 
 /**
@@ -903,9 +1565,12 @@ ufo_buffer_set_host_array (UfoBuffer *buffer, gpointer array, gboolean free_data
     g_return_if_fail (UFO_IS_BUFFER (buffer));
 
     priv = buffer->priv;
+    wait_pending (priv);
+    drop_shared (priv);
+    drop_raw_host_array (priv);
 
-    if (priv->free)
-        g_free (priv->host_array);
+    if (priv->free || priv->host_capacity > 0)
+        release_host_mem (priv);
 
     priv->free = free_data;
     priv->host_array = array;
@@ -913,12 +1578,36 @@ ufo_buffer_set_host_array (UfoBuffer *buffer, gpointer array, gboolean free_data
     update_location (priv, UFO_BUFFER_LOCATION_HOST);
 }
 
+static void
+make_host_array_valid (UfoBufferPrivate *priv,
+                       gpointer cmd_queue)
+{
+    update_last_queue (priv, cmd_queue);
+    wait_pending (priv);
+    convert_raw_host_array (priv);
+
+    /* Replace stale, separately allocated host memory by a mapping */
+    if (priv->host_array == NULL ||
+        (uses_mapping (priv) && !priv->mapped && !is_valid (priv, UFO_BUFFER_LOCATION_HOST)))
+        alloc_host_mem (priv);
+
+    if (is_valid (priv, UFO_BUFFER_LOCATION_HOST))
+        return;
+
+    if (is_valid (priv, UFO_BUFFER_LOCATION_DEVICE) && priv->device_array)
+        transfer_device_to_host (priv, priv, priv->last_queue);
+    else if (is_valid (priv, UFO_BUFFER_LOCATION_DEVICE_IMAGE) && priv->device_image)
+        transfer_image_to_host (priv, priv, priv->last_queue);
+}
+
 /**
  * ufo_buffer_get_host_array:
  * @buffer: A #UfoBuffer.
  * @cmd_queue: (allow-none): A cl_command_queue object or %NULL.
  *
- * Returns a flat C-array containing the raw float data.
+ * Returns a flat C-array containing the raw float data. The host array becomes
+ * the only valid copy of the data, i.e. subsequent device accesses will
+ * transfer the data back.
  *
  * Returns: Float array.
  */
@@ -930,19 +1619,100 @@ ufo_buffer_get_host_array (UfoBuffer *buffer, gpointer cmd_queue)
     g_return_val_if_fail (UFO_IS_BUFFER (buffer), NULL);
     priv = buffer->priv;
 
+    make_host_array_valid (priv, cmd_queue);
+    update_location (priv, UFO_BUFFER_LOCATION_HOST);
+
+    return priv->host_array;
+}
+
+/**
+ * ufo_buffer_get_host_array_readonly:
+ * @buffer: A #UfoBuffer.
+ * @cmd_queue: (allow-none): A cl_command_queue object or %NULL.
+ *
+ * Returns a flat C-array containing the raw float data that must not be
+ * modified. Unlike ufo_buffer_get_host_array(), device copies stay valid and
+ * are not transferred again on the next device access.
+ *
+ * Returns: Float array.
+ */
+const gfloat *
+ufo_buffer_get_host_array_readonly (UfoBuffer *buffer, gpointer cmd_queue)
+{
+    UfoBufferPrivate *priv;
+
+    g_return_val_if_fail (UFO_IS_BUFFER (buffer), NULL);
+    priv = buffer->priv;
+
+    make_host_array_valid (priv, cmd_queue);
+    add_valid_location (priv, UFO_BUFFER_LOCATION_HOST);
+
+    return priv->host_array;
+}
+
+/**
+ * ufo_buffer_get_host_array_async:
+ * @buffer: A #UfoBuffer.
+ * @cmd_queue: (allow-none): A cl_command_queue object or %NULL.
+ * @n_events: Number of events in @wait_list
+ * @wait_list: (array length=n_events) (allow-none): cl_event objects that must
+ *  complete before the transfer starts
+ * @event: (out) (allow-none): Location for a cl_event that completes once the
+ *  host array holds the data or %NULL
+ *
+ * Like ufo_buffer_get_host_array() but enqueues the transfer from device
+ * memory without blocking. The returned array must not be accessed before
+ * @event has completed. The event is also kept by @buffer, so that subsequent
+ * accesses wait for or chain on it. If no transfer is necessary, @wait_list is
+ * ignored and @event is set to the pending event of @buffer which may be %NULL.
+ *
+ * Returns: Float array.
+ */
+gfloat *
+ufo_buffer_get_host_array_async (UfoBuffer *buffer,
+                                 gpointer cmd_queue,
+                                 guint n_events,
+                                 gpointer *wait_list,
+                                 gpointer *event)
+{
+    UfoBufferPrivate *priv;
+
+    g_return_val_if_fail (UFO_IS_BUFFER (buffer), NULL);
+    priv = buffer->priv;
+
     update_last_queue (priv, cmd_queue);
+    convert_raw_host_array (priv);
 
     if (priv->host_array == NULL)
         alloc_host_mem (priv);
 
-    if (priv->location == UFO_BUFFER_LOCATION_DEVICE && priv->device_array)
-        transfer_device_to_host (priv, priv, priv->last_queue);
+    if (!is_valid (priv, UFO_BUFFER_LOCATION_HOST)) {
+        cl_event *waits;
+        cl_event transfer_event = NULL;
+        cl_uint n_waits;
 
-    if (priv->location == UFO_BUFFER_LOCATION_DEVICE_IMAGE && priv->device_image)
-        transfer_image_to_host (priv, priv, priv->last_queue);
+        waits = get_wait_list (priv, n_events, wait_list, &n_waits);
+
+        if (is_valid (priv, UFO_BUFFER_LOCATION_DEVICE) && priv->device_array)
+            enqueue_device_to_host (priv, priv, priv->last_queue, CL_FALSE, n_waits, waits, &transfer_event);
+        else if (is_valid (priv, UFO_BUFFER_LOCATION_DEVICE_IMAGE) && priv->device_image)
+            enqueue_image_to_host (priv, priv, priv->last_queue, CL_FALSE, n_waits, waits, &transfer_event);
+
+        if (transfer_event != NULL)
+            set_pending (priv, transfer_event);
+
+        g_free (waits);
+    }
 
     update_location (priv, UFO_BUFFER_LOCATION_HOST);
 
+    if (event != NULL) {
+        *event = priv->pending_event;
+
+        if (priv->pending_event != NULL)
+            UFO_RESOURCES_CHECK_CLERR (clRetainEvent (priv->pending_event));
+    }
+
     return priv->host_array;
 }
 
@@ -963,6 +1733,8 @@ void ufo_buffer_set_device_array (UfoBuffer *buffer, gpointer array, gboolean fr
     g_return_if_fail (UFO_IS_BUFFER (buffer));
 
     priv = buffer->priv;
+    wait_pending (priv);
+    drop_shared (priv);
 
     UFO_RESOURCES_CHECK_CLERR (clGetMemObjectInfo (array, CL_MEM_SIZE, sizeof (gsize), &size, NULL));
 
@@ -977,13 +1749,37 @@ void ufo_buffer_set_device_array (UfoBuffer *buffer, gpointer array, gboolean fr
                    size, priv->size);
     }
 
-    if (priv->free && priv->device_array)
-         UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (priv->device_array));
+    if (priv->free || priv->device_capacity > 0)
+        release_device_array (priv);
 
+    drop_raw_host_array (priv);
     priv->device_array = array;
     update_location (priv, UFO_BUFFER_LOCATION_DEVICE);
 }
 
+static void
+make_device_array_valid (UfoBufferPrivate *priv,
+                         gpointer cmd_queue)
+{
+    update_last_queue (priv, cmd_queue);
+    wait_pending (priv);
+    convert_raw_host_array (priv);
+
+    if (priv->mapped)
+        unmap_host_array (priv);
+
+    if (priv->device_array == NULL)
+        alloc_device_array (priv);
+
+    if (is_valid (priv, UFO_BUFFER_LOCATION_DEVICE))
+        return;
+
+    if (is_valid (priv, UFO_BUFFER_LOCATION_HOST) && priv->host_array)
+        transfer_host_to_device (priv, priv, priv->last_queue);
+    else if (is_valid (priv, UFO_BUFFER_LOCATION_DEVICE_IMAGE) && priv->device_image)
+        transfer_image_to_device (priv, priv, priv->last_queue);
+}
+
 /**
  * ufo_buffer_get_device_array:
  * @buffer: A #UfoBuffer.
@@ -1003,19 +1799,104 @@ ufo_buffer_get_device_array (UfoBuffer *buffer, gpointer cmd_queue)
     g_return_val_if_fail (UFO_IS_BUFFER (buffer), NULL);
     priv = buffer->priv;
 
+    make_device_array_valid (priv, cmd_queue);
+    update_location (priv, UFO_BUFFER_LOCATION_DEVICE);
+
+    return priv->device_array;
+}
+
+/**
+ * ufo_buffer_get_device_array_readonly:
+ * @buffer: A #UfoBuffer.
+ * @cmd_queue: (allow-none): A cl_command_queue object or %NULL.
+ *
+ * Return the current cl_mem object of @buffer for reading. Unlike
+ * ufo_buffer_get_device_array(), other valid copies stay valid. Kernels must
+ * not write into the returned object.
+ *
+ * Returns: (transfer none): A cl_mem object associated with @buffer.
+ */
+gpointer
+ufo_buffer_get_device_array_readonly (UfoBuffer *buffer, gpointer cmd_queue)
+{
+    UfoBufferPrivate *priv;
+
+    g_return_val_if_fail (UFO_IS_BUFFER (buffer), NULL);
+    priv = buffer->priv;
+
+    make_device_array_valid (priv, cmd_queue);
+    add_valid_location (priv, UFO_BUFFER_LOCATION_DEVICE);
+
+    return priv->device_array;
+}
+
+/**
+ * ufo_buffer_get_device_array_async:
+ * @buffer: A #UfoBuffer.
+ * @cmd_queue: (allow-none): A cl_command_queue object or %NULL.
+ * @n_events: Number of events in @wait_list
+ * @wait_list: (array length=n_events) (allow-none): cl_event objects that must
+ *  complete before the transfer starts
+ * @event: (out) (allow-none): Location for a cl_event that completes once the
+ *  device array holds the data or %NULL
+ *
+ * Like ufo_buffer_get_device_array() but enqueues the transfer without
+ * blocking, so that uploading the next input can overlap with computation on
+ * the current one. Kernels using the returned object should wait for @event.
+ * The event is also kept by @buffer, so that subsequent accesses wait for or
+ * chain on it. If no transfer is necessary, @wait_list is ignored and @event is
+ * set to the pending event of @buffer which may be %NULL.
+ *
+ * Returns: (transfer none): A cl_mem object associated with @buffer.
+ */
+gpointer
+ufo_buffer_get_device_array_async (UfoBuffer *buffer,
+                                   gpointer cmd_queue,
+                                   guint n_events,
+                                   gpointer *wait_list,
+                                   gpointer *event)
+{
+    UfoBufferPrivate *priv;
+
+    g_return_val_if_fail (UFO_IS_BUFFER (buffer), NULL);
+    priv = buffer->priv;
+
     update_last_queue (priv, cmd_queue);
+    convert_raw_host_array (priv);
+
+    if (priv->mapped)
+        unmap_host_array (priv);
 
     if (priv->device_array == NULL)
         alloc_device_array (priv);
 
-    if (priv->location == UFO_BUFFER_LOCATION_HOST && priv->host_array)
-        transfer_host_to_device (priv, priv, priv->last_queue);
+    if (!is_valid (priv, UFO_BUFFER_LOCATION_DEVICE)) {
+        cl_event *waits;
+        cl_event transfer_event = NULL;
+        cl_uint n_waits;
 
-    if (priv->location == UFO_BUFFER_LOCATION_DEVICE_IMAGE && priv->device_array)
-        transfer_image_to_device (priv, priv, priv->last_queue);
+        waits = get_wait_list (priv, n_events, wait_list, &n_waits);
+
+        if (is_valid (priv, UFO_BUFFER_LOCATION_HOST) && priv->host_array)
+            enqueue_host_to_device (priv, priv, priv->last_queue, CL_FALSE, n_waits, waits, &transfer_event);
+        else if (is_valid (priv, UFO_BUFFER_LOCATION_DEVICE_IMAGE) && priv->device_image)
+            enqueue_image_to_device (priv, priv, priv->last_queue, n_waits, waits, &transfer_event);
+
+        if (transfer_event != NULL)
+            set_pending (priv, transfer_event);
+
+        g_free (waits);
+    }
 
     update_location (priv, UFO_BUFFER_LOCATION_DEVICE);
 
+    if (event != NULL) {
+        *event = priv->pending_event;
+
+        if (priv->pending_event != NULL)
+            UFO_RESOURCES_CHECK_CLERR (clRetainEvent (priv->pending_event));
+    }
+
     return priv->device_array;
 }
 
@@ -1056,8 +1937,9 @@ ufo_buffer_get_device_array_with_offset (UfoBuffer *buffer,
                                                    sizeof (size_t),
                                                    &size, NULL));
 
+    /* Pooled device memory may be larger than the buffer itself */
     region.origin = offset;
-    region.size = size - offset;
+    region.size = MIN (size, priv->size) - offset;
 
     sub_buffer = clCreateSubBuffer (device_array, mem_flags, CL_BUFFER_CREATE_TYPE_REGION,
                                     &region, &errcode);
@@ -1105,6 +1987,8 @@ ufo_buffer_get_device_array_view (UfoBuffer *buffer,
     }
 
     update_last_queue (priv, cmd_queue);
+    wait_pending (priv);
+    convert_raw_host_array (priv);
 
     size = region->size[0] * region->size[1] * region->size[2] * sizeof(float);
     src_row_pitch = sizeof(float) * priv->requisition.dims[0];
@@ -1179,6 +2063,26 @@ ufo_buffer_get_device_array_view (UfoBuffer *buffer,
     return mem;
 }
 
+static void
+make_device_image_valid (UfoBufferPrivate *priv,
+                         gpointer cmd_queue)
+{
+    update_last_queue (priv, cmd_queue);
+    wait_pending (priv);
+    convert_raw_host_array (priv);
+
+    if (priv->device_image == NULL)
+        alloc_device_image (priv);
+
+    if (is_valid (priv, UFO_BUFFER_LOCATION_DEVICE_IMAGE))
+        return;
+
+    if (is_valid (priv, UFO_BUFFER_LOCATION_DEVICE) && priv->device_array)
+        transfer_device_to_image (priv, priv, priv->last_queue);
+    else if (is_valid (priv, UFO_BUFFER_LOCATION_HOST) && priv->host_array)
+        transfer_host_to_image (priv, priv, priv->last_queue);
+}
+
 /**
  * ufo_buffer_get_device_image:
  * @buffer: A #UfoBuffer.
@@ -1199,18 +2103,34 @@ ufo_buffer_get_device_image (UfoBuffer *buffer,
     g_return_val_if_fail (UFO_IS_BUFFER (buffer), NULL);
     priv = buffer->priv;
 
-    update_last_queue (priv, cmd_queue);
+    make_device_image_valid (priv, cmd_queue);
+    update_location (priv, UFO_BUFFER_LOCATION_DEVICE_IMAGE);
 
-    if (priv->device_image == NULL)
-        alloc_device_image (priv);
+    return priv->device_image;
+}
 
-    if (priv->location == UFO_BUFFER_LOCATION_HOST && priv->host_array)
-        transfer_host_to_image (priv, priv, priv->last_queue);
+/**
+ * ufo_buffer_get_device_image_readonly:
+ * @buffer: A #UfoBuffer.
+ * @cmd_queue: (allow-none): A cl_command_queue object or %NULL.
+ *
+ * Return the current cl_mem image object of @buffer for reading. Unlike
+ * ufo_buffer_get_device_image(), other valid copies stay valid. Kernels must
+ * not write into the returned object.
+ *
+ * Returns: (transfer none): A cl_mem image object associated with @buffer.
+ */
+gpointer
+ufo_buffer_get_device_image_readonly (UfoBuffer *buffer,
+                                      gpointer cmd_queue)
+{
+    UfoBufferPrivate *priv;
 
-    if (priv->location == UFO_BUFFER_LOCATION_DEVICE && priv->device_array)
-        transfer_device_to_image (priv, priv, priv->last_queue);
+    g_return_val_if_fail (UFO_IS_BUFFER (buffer), NULL);
+    priv = buffer->priv;
 
-    update_location (priv, UFO_BUFFER_LOCATION_DEVICE_IMAGE);
+    make_device_image_valid (priv, cmd_queue);
+    add_valid_location (priv, UFO_BUFFER_LOCATION_DEVICE_IMAGE);
 
     return priv->device_image;
 }
@@ -1238,7 +2158,28 @@ void
 ufo_buffer_discard_location (UfoBuffer *buffer)
 {
     g_return_if_fail (UFO_IS_BUFFER (buffer));
+    drop_shared (buffer->priv);
+    drop_raw_host_array (buffer->priv);
     buffer->priv->location = buffer->priv->last_location;
+    buffer->priv->valid = VALID (buffer->priv->location);
+}
+
+/**
+ * ufo_buffer_is_valid_at:
+ * @buffer: A #UfoBuffer
+ * @location: A #UfoBufferLocation
+ *
+ * Check if the copy of the data at @location is up-to-date. Several locations
+ * can be valid at the same time after read-only accesses.
+ *
+ * Returns: %TRUE if accessing @location does not require a transfer.
+ */
+gboolean
+ufo_buffer_is_valid_at (UfoBuffer *buffer,
+                        UfoBufferLocation location)
+{
+    g_return_val_if_fail (UFO_IS_BUFFER (buffer), FALSE);
+    return is_valid (buffer->priv, location);
 }
 
 /**
@@ -1267,76 +2208,40 @@ ufo_buffer_set_layout (UfoBuffer *buffer, UfoBufferLayout layout)
     buffer->priv->layout = layout;
 }
 
+/**
+ * ufo_buffer_get_sequence:
+ * @buffer: A #UfoBuffer
+ *
+ * Return the position of @buffer in the stream of its generator.
+ */
+guint64
+ufo_buffer_get_sequence (UfoBuffer *buffer)
+{
+    return buffer->priv->sequence;
+}
+
+/**
+ * ufo_buffer_set_sequence:
+ * @buffer: A #UfoBuffer
+ * @sequence: Position of the data in the stream
+ *
+ * Set the sequence number of @buffer. The scheduler numbers the items of each
+ * generator consecutively and passes the numbers on to the results, so that
+ * items can be put back into order after they were processed in parallel.
+ */
+void
+ufo_buffer_set_sequence (UfoBuffer *buffer, guint64 sequence)
+{
+    g_return_if_fail (UFO_IS_BUFFER (buffer));
+    buffer->priv->sequence = sequence;
+}
+
 static void
 convert_data (UfoBufferPrivate *priv,
               gconstpointer data,
               UfoBufferDepth depth)
 {
-    gint n_pixels;
-    gfloat *dst;
-
-    n_pixels = (gint) (priv->size / 4);
-    dst = priv->host_array;
-
-    /* To save a memory allocation and several copies, we process data from back
-     * to front. This is possible if src bit depth is at most half as wide as
-     * the 32-bit target buffer. The processor cache should not be a
-     * problem. */
-    if (depth == UFO_BUFFER_DEPTH_8U) {
-        const guint8 *src = (const guint8 *) data;
-
-        for (gint i = (n_pixels - 1); i >= 0; i--)
-            dst[i] = ((gfloat) src[i]);
-    }
-    else if (depth == UFO_BUFFER_DEPTH_12U) {
-        gint j;
-        guchar first, second, third;
-        const guchar *src = (const guchar *) data;
-
-        if (n_pixels % 2) {
-            /* If there is an odd number of pixels we take care of the last two
-             * bytes forming the last pixel and process the rest in the loop. */
-            first = src[3 * n_pixels / 2 - 1];
-            second = src[3 * n_pixels / 2];
-            dst[n_pixels - 1] = (gfloat) ((first << 4) | ((second & 0xF0) >> 4));
-            n_pixels -= 1;
-        }
-
-        for (gint i = (n_pixels - 2); i >= 0; i -= 2) {
-            j = 3 * i / 2;
-            first = src[j];
-            second = src[j + 1];
-            third = src[j + 2];
-            /* First pixel: shift first byte by 4 and add the upper half of the second byte */
-            dst[i] = (gfloat) ((first << 4) | ((second & 0xF0) >> 4));
-            /* Second pixel: shift second byte by 8 and add the lower half of the second byte */
-            dst[i + 1] = (gfloat) (((second & 0x0F) << 8) | third);
-        }
-    }
-    else if (depth == UFO_BUFFER_DEPTH_16U) {
-        const guint16 *src = (const guint16 *) data;
-
-        for (gint i = (n_pixels - 1); i >= 0; i--)
-            dst[i] = ((gfloat) src[i]);
-    }
-    else if (depth == UFO_BUFFER_DEPTH_16S) {
-        const gint16 *src = (const gint16 *) data;
-
-        for (gint i = (n_pixels - 1); i >= 0; i--)
-            dst[i] = ((gfloat) src[i]);
-    }
-    else if (depth == UFO_BUFFER_DEPTH_32S) {
-        const gint32 *src = (const gint32 *) data;
-
-        for (gint i = (n_pixels - 1); i >= 0; i--)
-            dst[i] = ((gfloat) src[i]);
-    }
-    else if (depth == UFO_BUFFER_DEPTH_32U) {
-        const guint32 *src = (const guint32 *) data;
-
-        for (gint i = (n_pixels - 1); i >= 0; i--)
-            dst[i] = ((gfloat) src[i]);
-    }
+    ufo_convert_data (priv->host_array, data, priv->size / sizeof (gfloat), depth);
 }
 
 /**
@@ -1356,8 +2261,19 @@ ufo_buffer_convert (UfoBuffer *buffer,
     g_return_if_fail (UFO_IS_BUFFER (buffer));
     priv = buffer->priv;
 
-    if (priv->host_array != NULL)
+    wait_pending (priv);
+
+    /* Raw data already knows its depth */
+    if (priv->depth != UFO_BUFFER_DEPTH_32F) {
+        convert_raw_host_array (priv);
+        return;
+    }
+
+    if (priv->host_array != NULL) {
+        make_exclusive (priv, UFO_BUFFER_LOCATION_HOST);
         convert_data (priv, priv->host_array, depth);
+        update_location (priv, UFO_BUFFER_LOCATION_HOST);
+    }
 }
 
 /**
@@ -1381,10 +2297,354 @@ ufo_buffer_convert_from_data (UfoBuffer *buffer,
     g_return_if_fail (UFO_IS_BUFFER (buffer));
     priv = buffer->priv;
 
+    wait_pending (priv);
+    drop_shared (priv);
+    drop_raw_host_array (priv);
+
     if (priv->host_array == NULL)
         alloc_host_mem (priv);
 
     convert_data (priv, data, depth);
+    update_location (priv, UFO_BUFFER_LOCATION_HOST);
+}
+
+static gsize
+get_raw_size (UfoBufferPrivate *priv,
+              UfoBufferDepth depth)
+{
+    return ufo_convert_get_raw_size (get_num_elements (priv), depth);
+}
+
+static void
+convert_raw_host_array (UfoBufferPrivate *priv)
+{
+    gpointer raw;
+    gsize raw_capacity;
+    gboolean borrowed;
+
+    if (priv->depth == UFO_BUFFER_DEPTH_32F)
+        return;
+
+    wait_pending (priv);
+
+    raw = priv->host_array;
+    raw_capacity = priv->host_capacity;
+    borrowed = is_borrowed (priv, UFO_BUFFER_LOCATION_HOST);
+    priv->host_array = NULL;
+    priv->host_capacity = 0;
+    priv->borrowed &= ~VALID (UFO_BUFFER_LOCATION_HOST);
+
+    alloc_host_mem (priv);
+    convert_data (priv, raw, priv->depth);
+    priv->depth = UFO_BUFFER_DEPTH_32F;
+    update_location (priv, UFO_BUFFER_LOCATION_HOST);
+
+    if (borrowed)
+        return;
+
+    if (raw_capacity > 0 && priv->pool != NULL)
+        ufo_buffer_pool_put_host_mem (priv->pool, raw, raw_capacity);
+    else
+        g_free (raw);
+}
+
+/**
+ * ufo_buffer_get_raw_host_array:
+ * @buffer: A #UfoBuffer
+ * @depth: Storage depth of the data that is going to be written
+ *
+ * Return host memory that is just large enough to hold the elements of @buffer
+ * with @depth bits. Unlike ufo_buffer_convert(), the data is kept in this
+ * compact form when it is queued and is only widened to 32-bit floats on first
+ * float access, either on the host or, with ufo_op_convert_depth(), on the
+ * device after uploading the compact data. Any previous content is discarded.
+ *
+ * Returns: (transfer none): Host memory for raw data of @depth.
+ */
+gpointer
+ufo_buffer_get_raw_host_array (UfoBuffer *buffer,
+                               UfoBufferDepth depth)
+{
+    UfoBufferPrivate *priv;
+    gsize raw_size;
+
+    g_return_val_if_fail (UFO_IS_BUFFER (buffer), NULL);
+    priv = buffer->priv;
+
+    if (depth == UFO_BUFFER_DEPTH_32F || depth == UFO_BUFFER_DEPTH_INVALID)
+        return ufo_buffer_get_host_array (buffer, NULL);
+
+    wait_pending (priv);
+    drop_shared (priv);
+
+    if (priv->host_array != NULL && (priv->free || priv->host_capacity > 0 || priv->mapped))
+        release_host_mem (priv);
+
+    raw_size = get_raw_size (priv, depth);
+
+    if (priv->pool != NULL)
+        priv->host_array = ufo_buffer_pool_get_host_mem (priv->pool, raw_size, &priv->host_capacity);
+    else
+        priv->host_array = g_malloc0 (raw_size);
+
+    priv->free = TRUE;
+    priv->depth = depth;
+    update_location (priv, UFO_BUFFER_LOCATION_HOST);
+
+    return priv->host_array;
+}
+
+/**
+ * ufo_buffer_get_depth:
+ * @buffer: A #UfoBuffer
+ *
+ * Get the storage depth of @buffer. This is %UFO_BUFFER_DEPTH_32F unless raw
+ * data was written with ufo_buffer_get_raw_host_array() and not yet converted.
+ *
+ * Returns: The current #UfoBufferDepth.
+ */
+UfoBufferDepth
+ufo_buffer_get_depth (UfoBuffer *buffer)
+{
+    g_return_val_if_fail (UFO_IS_BUFFER (buffer), UFO_BUFFER_DEPTH_INVALID);
+    return buffer->priv->depth;
+}
+
+/**
+ * ufo_buffer_convert_raw_on_device:
+ * @buffer: A #UfoBuffer
+ * @kernel: A cl_kernel taking the compact input, the float output and the
+ *  number of elements
+ * @cmd_queue: A cl_command_queue
+ *
+ * Upload raw data in its compact form and widen it with @kernel into the
+ * device array, which becomes the only valid copy. This is a no-op if @buffer
+ * does not hold raw data. Use ufo_op_convert_depth() instead of calling this
+ * directly.
+ */
+void
+ufo_buffer_convert_raw_on_device (UfoBuffer *buffer,
+                                  gpointer kernel,
+                                  gpointer cmd_queue)
+{
+    UfoBufferPrivate *priv;
+    cl_mem raw_mem;
+    cl_event events[2];
+    cl_uint n_pixels;
+    cl_int errcode;
+    gsize raw_size;
+    gsize raw_capacity;
+    gsize work_size;
+
+    g_return_if_fail (UFO_IS_BUFFER (buffer));
+    priv = buffer->priv;
+
+    if (priv->depth == UFO_BUFFER_DEPTH_32F)
+        return;
+
+    update_last_queue (priv, cmd_queue);
+    wait_pending (priv);
+
+    raw_size = get_raw_size (priv, priv->depth);
+    n_pixels = (cl_uint) get_num_elements (priv);
+    work_size = priv->depth == UFO_BUFFER_DEPTH_12U ? (n_pixels + 1) / 2 : n_pixels;
+    raw_capacity = 0;
+
+    if (priv->pool != NULL) {
+        raw_mem = ufo_buffer_pool_get_device_mem (priv->pool, priv->context, raw_size, &raw_capacity);
+    }
+    else {
+        raw_mem = clCreateBuffer (priv->context, CL_MEM_READ_ONLY, raw_size, NULL, &errcode);
+        UFO_RESOURCES_CHECK_CLERR (errcode);
+    }
+
+    if (priv->device_array == NULL)
+        alloc_device_array (priv);
+
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueWriteBuffer (priv->last_queue, raw_mem, CL_FALSE,
+                                                     0, raw_size, priv->host_array,
+                                                     0, NULL, &events[0]));
+    ufo_profiler_record_transfer (UFO_PROFILER_TRANSFER_COPY, raw_size);
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 0, sizeof (cl_mem), &raw_mem));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 1, sizeof (cl_mem), &priv->device_array));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (kernel, 2, sizeof (cl_uint), &n_pixels));
+    UFO_RESOURCES_CHECK_CLERR (clEnqueueNDRangeKernel (priv->last_queue, kernel,
+                                                       1, NULL, &work_size, NULL,
+                                                       1, &events[0], &events[1]));
+    UFO_RESOURCES_CHECK_CLERR (clWaitForEvents (1, &events[1]));
+    UFO_RESOURCES_CHECK_CLERR (clReleaseEvent (events[0]));
+    UFO_RESOURCES_CHECK_CLERR (clReleaseEvent (events[1]));
+
+    if (raw_capacity > 0)
+        ufo_buffer_pool_put_device_mem (priv->pool, priv->context, raw_mem, raw_capacity);
+    else
+        UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (raw_mem));
+
+    /* The compact host copy is not needed anymore */
+    release_host_mem (priv);
+    priv->depth = UFO_BUFFER_DEPTH_32F;
+    update_location (priv, UFO_BUFFER_LOCATION_DEVICE);
+}
+
+/*
+ * Values of these types do not own any memory and can be copied and dropped
+ * without going through the GValue machinery.
+ */
+static gboolean
+value_is_scalar (GType type)
+{
+    switch (G_TYPE_FUNDAMENTAL (type)) {
+        case G_TYPE_CHAR:
+        case G_TYPE_UCHAR:
+        case G_TYPE_BOOLEAN:
+        case G_TYPE_INT:
+        case G_TYPE_UINT:
+        case G_TYPE_LONG:
+        case G_TYPE_ULONG:
+        case G_TYPE_INT64:
+        case G_TYPE_UINT64:
+        case G_TYPE_ENUM:
+        case G_TYPE_FLAGS:
+        case G_TYPE_FLOAT:
+        case G_TYPE_DOUBLE:
+        case G_TYPE_POINTER:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+static void
+copy_value (const GValue *src,
+            GValue *dst)
+{
+    if (value_is_scalar (G_VALUE_TYPE (src))) {
+        *dst = *src;
+    }
+    else {
+        memset (dst, 0, sizeof (GValue));
+        g_value_init (dst, G_VALUE_TYPE (src));
+        g_value_copy (src, dst);
+    }
+}
+
+static void
+clear_value (GValue *value)
+{
+    if (!value_is_scalar (G_VALUE_TYPE (value)))
+        g_value_unset (value);
+}
+
+static Metadata *
+metadata_new (guint capacity)
+{
+    Metadata *meta;
+
+    meta = g_new0 (Metadata, 1);
+    meta->ref_count = 1;
+    meta->capacity = MAX (capacity, METADATA_INLINE_ENTRIES);
+    meta->entries = meta->capacity > METADATA_INLINE_ENTRIES ?
+        g_new0 (MetadataEntry, meta->capacity) : meta->inline_entries;
+
+    return meta;
+}
+
+static Metadata *
+metadata_ref (Metadata *meta)
+{
+    g_atomic_int_inc (&meta->ref_count);
+    return meta;
+}
+
+static void
+metadata_unref (Metadata *meta)
+{
+    if (meta == NULL || !g_atomic_int_dec_and_test (&meta->ref_count))
+        return;
+
+    for (guint i = 0; i < meta->n_entries; i++)
+        clear_value (&meta->entries[i].value);
+
+    if (meta->entries != meta->inline_entries)
+        g_free (meta->entries);
+
+    g_free (meta);
+}
+
+static MetadataEntry *
+metadata_lookup (Metadata *meta,
+                 GQuark key)
+{
+    if (meta == NULL || key == 0)
+        return NULL;
+
+    for (guint i = 0; i < meta->n_entries; i++) {
+        if (meta->entries[i].key == key)
+            return &meta->entries[i];
+    }
+
+    return NULL;
+}
+
+static void
+metadata_insert (Metadata *meta,
+                 GQuark key,
+                 const GValue *value)
+{
+    MetadataEntry *entry;
+
+    entry = metadata_lookup (meta, key);
+
+    if (entry != NULL) {
+        clear_value (&entry->value);
+    }
+    else {
+        if (meta->n_entries == meta->capacity) {
+            meta->capacity *= 2;
+
+            if (meta->entries == meta->inline_entries) {
+                meta->entries = g_new0 (MetadataEntry, meta->capacity);
+                memcpy (meta->entries, meta->inline_entries, sizeof (meta->inline_entries));
+            }
+            else {
+                meta->entries = g_renew (MetadataEntry, meta->entries, meta->capacity);
+            }
+        }
+
+        entry = &meta->entries[meta->n_entries++];
+        entry->key = key;
+    }
+
+    copy_value (value, &entry->value);
+}
+
+/* Return the metadata store of @priv, unshared so that it can be modified */
+static Metadata *
+get_writable_metadata (UfoBufferPrivate *priv)
+{
+    Metadata *copy;
+
+    if (priv->metadata == NULL) {
+        priv->metadata = metadata_new (0);
+        return priv->metadata;
+    }
+
+    if (g_atomic_int_get (&priv->metadata->ref_count) == 1)
+        return priv->metadata;
+
+    copy = metadata_new (priv->metadata->n_entries);
+
+    for (guint i = 0; i < priv->metadata->n_entries; i++) {
+        copy->entries[i].key = priv->metadata->entries[i].key;
+        copy_value (&priv->metadata->entries[i].value, &copy->entries[i].value);
+    }
+
+    copy->n_entries = priv->metadata->n_entries;
+    metadata_unref (priv->metadata);
+    priv->metadata = copy;
+
+    return copy;
 }
 
 /**
@@ -1394,14 +2654,21 @@ ufo_buffer_convert_from_data (UfoBuffer *buffer,
  *
  * Retrieve meta data.
  *
- * Returns: previously defined metadata #GValue for this buffer.
+ * Returns: (transfer none): previously defined metadata #GValue for this
+ * buffer. It must not be modified and is valid until the metadata of @buffer
+ * changes.
  */
 GValue *
 ufo_buffer_get_metadata (UfoBuffer *buffer,
                          const gchar *name)
 {
+    MetadataEntry *entry;
+
     g_return_val_if_fail (UFO_IS_BUFFER (buffer), NULL);
-    return g_hash_table_lookup (buffer->priv->metadata, name);
+
+    /* Names that were never interned cannot be keys of any buffer */
+    entry = metadata_lookup (buffer->priv->metadata, g_quark_try_string (name));
+    return entry != NULL ? &entry->value : NULL;
 }
 
 /**
@@ -1417,24 +2684,20 @@ ufo_buffer_set_metadata (UfoBuffer *buffer,
                          const gchar *name,
                          GValue *value)
 {
-    UfoBufferPrivate *priv;
-    GValue *old;
-    GValue *new;
-
     g_return_if_fail (UFO_IS_BUFFER (buffer));
-    priv = buffer->priv;
-
-    old = g_hash_table_lookup (priv->metadata, name);
+    metadata_insert (get_writable_metadata (buffer->priv), g_quark_from_string (name), value);
+}
 
-    if (old != NULL) {
-        g_value_unset (old);
+static gboolean
+metadata_is_subset (Metadata *subset,
+                    Metadata *meta)
+{
+    for (guint i = 0; i < subset->n_entries; i++) {
+        if (metadata_lookup (meta, subset->entries[i].key) == NULL)
+            return FALSE;
     }
 
-    new = g_malloc0 (sizeof (GValue));
-    g_value_init (new, G_VALUE_TYPE ((GValue *) value));
-    g_value_copy (value, new);
-
-    g_hash_table_replace (priv->metadata, g_strdup (name), new);
+    return TRUE;
 }
 
 /**
@@ -1442,29 +2705,34 @@ ufo_buffer_set_metadata (UfoBuffer *buffer,
  * @src: Source buffer
  * @dst: Destination buffer
  *
- * Copies meta data content from @src to @dst.
+ * Copies meta data content from @src to @dst. Unless @dst has keys that @src
+ * does not have, both buffers share the metadata afterwards and no memory is
+ * allocated.
  */
 void
 ufo_buffer_copy_metadata (UfoBuffer *src,
                           UfoBuffer *dst)
 {
-    UfoBufferPrivate *priv;
-    GList *keys;
-    GList *it;
+    Metadata *meta;
+    Metadata *dst_meta;
 
     g_return_if_fail (UFO_IS_BUFFER (src) && UFO_IS_BUFFER (dst));
-    priv = src->priv;
-    keys = g_hash_table_get_keys (priv->metadata);
+    meta = src->priv->metadata;
 
-    g_list_for (keys, it) {
-        GValue *value;
-        const gchar *name = (const gchar *) it->data;
+    if (meta == NULL || meta->n_entries == 0 || meta == dst->priv->metadata)
+        return;
 
-        value = ufo_buffer_get_metadata (src, name);
-        ufo_buffer_set_metadata (dst, name, value);
+    /* The result would be identical to the source metadata */
+    if (dst->priv->metadata == NULL || metadata_is_subset (dst->priv->metadata, meta)) {
+        metadata_unref (dst->priv->metadata);
+        dst->priv->metadata = metadata_ref (meta);
+        return;
     }
 
-    g_list_free (keys);
+    dst_meta = get_writable_metadata (dst->priv);
+
+    for (guint i = 0; i < meta->n_entries; i++)
+        metadata_insert (dst_meta, meta->entries[i].key, &meta->entries[i].value);
 }
 
 /**
@@ -1480,8 +2748,32 @@ ufo_buffer_copy_metadata (UfoBuffer *src,
 GList *
 ufo_buffer_get_metadata_keys (UfoBuffer *buffer)
 {
+    Metadata *meta;
+    GList *keys = NULL;
+
     g_return_val_if_fail (UFO_IS_BUFFER (buffer), NULL);
-    return g_hash_table_get_keys (buffer->priv->metadata);
+    meta = buffer->priv->metadata;
+
+    for (guint i = 0; meta != NULL && i < meta->n_entries; i++)
+        keys = g_list_prepend (keys, (gpointer) g_quark_to_string (meta->entries[i].key));
+
+    return keys;
+}
+
+static const gfloat *
+get_host_data_for_reduction (UfoBuffer *buffer,
+                             gpointer cmd_queue,
+                             const gchar *func)
+{
+    UfoBufferPrivate *priv = buffer->priv;
+
+    if (!is_valid (priv, UFO_BUFFER_LOCATION_HOST) && priv->location != UFO_BUFFER_LOCATION_INVALID &&
+        cmd_queue == NULL && priv->last_queue == NULL) {
+        g_warning ("%s() needs a command queue for non-host buffers", func);
+        return NULL;
+    }
+
+    return ufo_buffer_get_host_array_readonly (buffer, cmd_queue);
 }
 
 /**
@@ -1489,7 +2781,8 @@ ufo_buffer_get_metadata_keys (UfoBuffer *buffer)
  * @buffer: A #UfoBuffer
  * @cmd_queue: An OpenCL command queue or %NULL
  *
- * Return the maximum value of @buffer.
+ * Return the maximum value of @buffer. Data that is not valid on the host is
+ * transferred using @cmd_queue first, use ufo_op_statistics() to avoid that.
  *
  * Returns: The maximum found.
  */
@@ -1497,26 +2790,17 @@ gfloat
 ufo_buffer_max (UfoBuffer *buffer,
                 gpointer cmd_queue)
 {
-    UfoBufferPrivate *priv;
-    gsize n;
-    gfloat max = -G_MAXFLOAT;
+    const gfloat *data;
+    gfloat max;
 
     g_return_val_if_fail (UFO_IS_BUFFER (buffer), 0.0f);
 
-    priv = buffer->priv;
+    data = get_host_data_for_reduction (buffer, cmd_queue, "max");
 
-    if (priv->location != UFO_BUFFER_LOCATION_HOST) {
-        g_warning ("max() not supported for non-host buffers");
+    if (data == NULL)
         return 0.0f;
-    }
-
-    n = get_num_elements (priv);
-
-    for (gsize i = 0; i < n; i++) {
-        if (priv->host_array[i] > max)
-            max = priv->host_array[i];
-    }
 
+    ufo_reduce_min_max (data, get_num_elements (buffer->priv), NULL, &max);
     return max;
 }
 
@@ -1525,7 +2809,8 @@ ufo_buffer_max (UfoBuffer *buffer,
  * @buffer: A #UfoBuffer
  * @cmd_queue: An OpenCL command queue or %NULL
  *
- * Return the minimum value of @buffer.
+ * Return the minimum value of @buffer. Data that is not valid on the host is
+ * transferred using @cmd_queue first, use ufo_op_statistics() to avoid that.
  *
  * Returns: The minimum found.
  */
@@ -1533,27 +2818,59 @@ gfloat
 ufo_buffer_min (UfoBuffer *buffer,
                 gpointer cmd_queue)
 {
-    UfoBufferPrivate *priv;
-    gsize n;
-    gfloat min = G_MAXFLOAT;
+    const gfloat *data;
+    gfloat min;
 
     g_return_val_if_fail (UFO_IS_BUFFER (buffer), 0.0f);
 
-    priv = buffer->priv;
+    data = get_host_data_for_reduction (buffer, cmd_queue, "min");
 
-    if (priv->location != UFO_BUFFER_LOCATION_HOST) {
-        g_warning ("min() not supported for non-host buffers");
+    if (data == NULL)
         return 0.0f;
-    }
 
-    n = get_num_elements (priv);
+    ufo_reduce_min_max (data, get_num_elements (buffer->priv), &min, NULL);
+    return min;
+}
 
-    for (gsize i = 0; i < n; i++) {
-        if (priv->host_array[i] < min)
-            min = priv->host_array[i];
-    }
+/**
+ * ufo_buffer_get_statistics:
+ * @buffer: A #UfoBuffer
+ * @cmd_queue: An OpenCL command queue or %NULL
+ * @stats: (out caller-allocates): Location for the statistics
+ * @n_bins: Number of histogram bins or 0
+ * @histogram: (array length=n_bins) (allow-none): Array of @n_bins counters
+ *  or %NULL
+ *
+ * Compute minimum, maximum, sum and sum of squares of @buffer in a single pass
+ * over the host data. If @histogram is given, a second pass counts the values
+ * in @n_bins equally sized bins between minimum and maximum. Data that is not
+ * valid on the host is transferred using @cmd_queue first, use
+ * ufo_op_statistics() to compute the statistics on the device instead.
+ */
+void
+ufo_buffer_get_statistics (UfoBuffer *buffer,
+                           gpointer cmd_queue,
+                           UfoBufferStatistics *stats,
+                           guint n_bins,
+                           guint *histogram)
+{
+    const gfloat *data;
+    gsize n;
 
-    return min;
+    g_return_if_fail (UFO_IS_BUFFER (buffer));
+    g_return_if_fail (stats != NULL);
+
+    memset (stats, 0, sizeof (UfoBufferStatistics));
+    data = get_host_data_for_reduction (buffer, cmd_queue, "get_statistics");
+
+    if (data == NULL)
+        return;
+
+    n = get_num_elements (buffer->priv);
+    ufo_reduce_statistics (data, n, stats);
+
+    if (n_bins > 0 && histogram != NULL)
+        ufo_reduce_histogram (data, n, stats->min, stats->max, n_bins, histogram);
 }
 
 /**
@@ -1600,8 +2917,10 @@ ufo_buffer_finalize (GObject *gobject)
     UfoBuffer *buffer = UFO_BUFFER (gobject);
     UfoBufferPrivate *priv = UFO_BUFFER_GET_PRIVATE (buffer);
 
-    if (priv->free)
-        g_free (priv->host_array);
+    wait_pending (priv);
+
+    if (priv->free || priv->host_capacity > 0)
+        release_host_mem (priv);
 
     priv->host_array = NULL;
 
@@ -1609,10 +2928,13 @@ ufo_buffer_finalize (GObject *gobject)
         free_cl_mem ((cl_mem *) &it->data);
     }
 
-    free_cl_mem (&priv->device_array);
-    free_cl_mem (&priv->device_image);
+    release_device_array (priv);
+    release_device_image (priv);
+
+    if (priv->pool != NULL)
+        g_object_unref (priv->pool);
 
-    g_hash_table_destroy (priv->metadata);
+    metadata_unref (priv->metadata);
     g_debug ("FREE buffer %p", (gpointer) gobject);
 
     G_OBJECT_CLASS(ufo_buffer_parent_class)->finalize(gobject);
@@ -1640,9 +2962,18 @@ ufo_buffer_init (UfoBuffer *buffer)
 
     priv->location = UFO_BUFFER_LOCATION_INVALID;
     priv->last_location = UFO_BUFFER_LOCATION_INVALID;
+    priv->valid = 0;
+    priv->borrowed = 0;
+    priv->pending_event = NULL;
+    priv->memory_mode = UFO_BUFFER_MEMORY_MODE_SEPARATE;
+    priv->mapped = FALSE;
+    priv->depth = UFO_BUFFER_DEPTH_32F;
     priv->requisition.n_dims = 0;
-    priv->metadata = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    priv->metadata = NULL;
     priv->sub_device_arrays = NULL;
+    priv->pool = NULL;
+    priv->host_capacity = 0;
+    priv->device_capacity = 0;
 }
 
 static void
@@ -25,6 +25,7 @@
 #endif
 
 #include <glib-object.h>
+#include <ufo/ufo-buffer-pool.h>
 
 G_BEGIN_DECLS
 
@@ -45,6 +46,7 @@ typedef struct _UfoBufferPrivate    UfoBufferPrivate;
 typedef struct _UfoBufferParamSpec  UfoBufferParamSpec;
 typedef struct _UfoRequisition      UfoRequisition;
 typedef struct _UfoRegion           UfoRegion;
+typedef struct _UfoBufferStatistics UfoBufferStatistics;
 
 /**
  * UfoBuffer:
@@ -93,6 +95,13 @@ struct _UfoRegion {
     gsize size[UFO_BUFFER_MAX_NDIMS];
 };
 
+struct _UfoBufferStatistics {
+    gfloat  min;
+    gfloat  max;
+    gdouble sum;
+    gdouble sum_squares;
+};
+
 typedef enum {
     UFO_BUFFER_DEPTH_INVALID,
     UFO_BUFFER_DEPTH_8U,
@@ -116,8 +125,20 @@ typedef enum {
     UFO_BUFFER_LAYOUT_COMPLEX_INTERLEAVED
 } UfoBufferLayout;
 
+typedef enum {
+    UFO_BUFFER_MEMORY_MODE_SEPARATE = 0,
+    UFO_BUFFER_MEMORY_MODE_MAPPED
+} UfoBufferMemoryMode;
+
 UfoBuffer*  ufo_buffer_new                  (UfoRequisition *requisition,
                                              gpointer        context);
+UfoBuffer*  ufo_buffer_new_from_pool        (UfoRequisition *requisition,
+                                             gpointer        context,
+                                             UfoBufferPool  *pool);
+UfoBuffer*  ufo_buffer_new_full             (UfoRequisition *requisition,
+                                             gpointer        context,
+                                             UfoBufferPool  *pool,
+                                             UfoBufferMemoryMode mode);
 UfoBuffer*  ufo_buffer_new_with_size        (GList          *dims,
                                              gpointer        context);
 UfoBuffer*  ufo_buffer_new_with_data        (UfoRequisition *requisition,
@@ -135,6 +156,10 @@ void        ufo_buffer_copy                 (UfoBuffer      *src,
 UfoBuffer  *ufo_buffer_dup                  (UfoBuffer      *buffer);
 void        ufo_buffer_swap_data            (UfoBuffer      *src,
                                              UfoBuffer      *dst);
+void        ufo_buffer_share                (UfoBuffer      *src,
+                                             UfoBuffer      *dst);
+void        ufo_buffer_unshare              (UfoBuffer      *buffer);
+gboolean    ufo_buffer_is_shared            (UfoBuffer      *buffer);
 void        ufo_buffer_set_host_array       (UfoBuffer      *buffer,
                                              gpointer        array,
                                              gboolean        free_data);
@@ -142,16 +167,37 @@ void        ufo_buffer_copy_host_array      (UfoBuffer      *buffer,
 		                                     gpointer        array);
 gfloat*     ufo_buffer_get_host_array       (UfoBuffer      *buffer,
                                              gpointer        cmd_queue);
+const gfloat*
+            ufo_buffer_get_host_array_readonly
+                                            (UfoBuffer      *buffer,
+                                             gpointer        cmd_queue);
+gfloat*     ufo_buffer_get_host_array_async (UfoBuffer      *buffer,
+                                             gpointer        cmd_queue,
+                                             guint           n_events,
+                                             gpointer       *wait_list,
+                                             gpointer       *event);
 void        ufo_buffer_set_device_array     (UfoBuffer      *buffer,
                                              gpointer        array,
                                              gboolean        free_data);
 gpointer    ufo_buffer_get_device_array     (UfoBuffer      *buffer,
                                              gpointer        cmd_queue);
+gpointer    ufo_buffer_get_device_array_readonly
+                                            (UfoBuffer      *buffer,
+                                             gpointer        cmd_queue);
+gpointer    ufo_buffer_get_device_array_async
+                                            (UfoBuffer      *buffer,
+                                             gpointer        cmd_queue,
+                                             guint           n_events,
+                                             gpointer       *wait_list,
+                                             gpointer       *event);
 gpointer    ufo_buffer_get_device_array_view(UfoBuffer      *buffer,
                                              gpointer        cmd_queue,
                                              UfoRegion      *region);
 gpointer    ufo_buffer_get_device_image     (UfoBuffer      *buffer,
                                              gpointer        cmd_queue);
+gpointer    ufo_buffer_get_device_image_readonly
+                                            (UfoBuffer      *buffer,
+                                             gpointer        cmd_queue);
 gpointer    ufo_buffer_get_device_array_with_offset
                                             (UfoBuffer      *buffer,
                                              gpointer        cmd_queue,
@@ -159,15 +205,27 @@ gpointer    ufo_buffer_get_device_array_with_offset
 UfoBufferLocation
             ufo_buffer_get_location         (UfoBuffer      *buffer);
 void        ufo_buffer_discard_location     (UfoBuffer      *buffer);
+gboolean    ufo_buffer_is_valid_at          (UfoBuffer      *buffer,
+                                             UfoBufferLocation location);
 void        ufo_buffer_set_layout           (UfoBuffer      *buffer,
                                              UfoBufferLayout layout);
 UfoBufferLayout
             ufo_buffer_get_layout           (UfoBuffer      *buffer);
+void        ufo_buffer_set_sequence         (UfoBuffer      *buffer,
+                                             guint64         sequence);
+guint64     ufo_buffer_get_sequence         (UfoBuffer      *buffer);
 void        ufo_buffer_convert              (UfoBuffer      *buffer,
                                              UfoBufferDepth  depth);
 void        ufo_buffer_convert_from_data    (UfoBuffer      *buffer,
                                              gconstpointer   data,
                                              UfoBufferDepth  depth);
+gpointer    ufo_buffer_get_raw_host_array   (UfoBuffer      *buffer,
+                                             UfoBufferDepth  depth);
+UfoBufferDepth
+            ufo_buffer_get_depth            (UfoBuffer      *buffer);
+void        ufo_buffer_convert_raw_on_device(UfoBuffer      *buffer,
+                                             gpointer        kernel,
+                                             gpointer        cmd_queue);
 GValue     *ufo_buffer_get_metadata         (UfoBuffer      *buffer,
                                              const gchar    *name);
 void        ufo_buffer_set_metadata         (UfoBuffer      *buffer,
@@ -181,6 +239,11 @@ gfloat      ufo_buffer_max                  (UfoBuffer      *buffer,
                                              gpointer        cmd_queue);
 gfloat      ufo_buffer_min                  (UfoBuffer      *buffer,
                                              gpointer        cmd_queue);
+void        ufo_buffer_get_statistics       (UfoBuffer      *buffer,
+                                             gpointer        cmd_queue,
+                                             UfoBufferStatistics *stats,
+                                             guint           n_bins,
+                                             guint          *histogram);
 
 GType       ufo_buffer_get_type             (void);
 
@@ -68,6 +68,11 @@ ufo_copy_task_setup (UfoTask *task,
 {
 }
 
+static void
+ufo_copy_task_reset (UfoTask *task)
+{
+}
+
 static guint
 ufo_copy_task_get_num_inputs (UfoTask *task)
 {
@@ -84,7 +89,7 @@ ufo_copy_task_get_num_dimensions (UfoTask *task,
 static UfoTaskMode
 ufo_copy_task_get_mode (UfoTask *task)
 {
-    return UFO_TASK_MODE_PROCESSOR | UFO_TASK_MODE_CPU;
+    return UFO_TASK_MODE_PROCESSOR | UFO_TASK_MODE_CPU | UFO_TASK_MODE_FIXED_SHAPE;
 }
 
 static void
@@ -106,15 +111,30 @@ ufo_copy_task_process (UfoTask *task,
     return TRUE;
 }
 
+static gboolean
+ufo_copy_task_process_batch (UfoTask *task,
+                             UfoBuffer **inputs,
+                             UfoBuffer **outputs,
+                             guint n_items,
+                             UfoRequisition *requisition)
+{
+    for (guint i = 0; i < n_items; i++)
+        ufo_buffer_copy (inputs[i], outputs[i]);
+
+    return TRUE;
+}
+
 static void
 ufo_task_interface_init (UfoTaskIface *iface)
 {
     iface->setup = ufo_copy_task_setup;
+    iface->reset = ufo_copy_task_reset;
     iface->get_num_inputs = ufo_copy_task_get_num_inputs;
     iface->get_num_dimensions = ufo_copy_task_get_num_dimensions;
     iface->get_mode = ufo_copy_task_get_mode;
     iface->get_requisition = ufo_copy_task_get_requisition;
     iface->process = ufo_copy_task_process;
+    iface->process_batch = ufo_copy_task_process_batch;
 }
 
 static void
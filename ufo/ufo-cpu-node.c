@@ -21,9 +21,11 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <sched.h>
 
 #include "ufo-cpu-node.h"
+#include "ufo-priv.h"
 
 G_DEFINE_TYPE (UfoCpuNode, ufo_cpu_node, UFO_TYPE_NODE)
 
@@ -36,10 +38,27 @@ struct _UfoCpuNodePrivate {
 #else
     cpu_set_t *mask;
 #endif
+    guint numa_node;
 };
 
 UfoNode *
 ufo_cpu_node_new (gpointer mask)
+{
+    return ufo_cpu_node_new_full (mask, 0);
+}
+
+/**
+ * ufo_cpu_node_new_full:
+ * @mask: A cpu_set_t mask of the processors that belong to the node
+ * @numa_node: Index of the NUMA node the processors belong to
+ *
+ * Create a node for a set of processors on @numa_node.
+ *
+ * Returns: (transfer full): A new #UfoCpuNode.
+ */
+UfoNode *
+ufo_cpu_node_new_full (gpointer mask,
+                       guint numa_node)
 {
     UfoCpuNode *node;
 
@@ -50,9 +69,202 @@ ufo_cpu_node_new (gpointer mask)
 #else
     node->priv->mask = g_memdup (mask, sizeof (cpu_set_t));
 #endif
+    node->priv->numa_node = numa_node;
     return UFO_NODE (node);
 }
 
+#ifndef __APPLE__
+static gboolean
+parse_cpu_list (const gchar *list,
+                cpu_set_t *set)
+{
+    gchar **ranges;
+    gboolean success = TRUE;
+
+    CPU_ZERO (set);
+    ranges = g_strsplit (list, ",", -1);
+
+    for (guint i = 0; success && ranges[i] != NULL; i++) {
+        gchar *end;
+        guint64 first;
+        guint64 last;
+
+        if (ranges[i][0] == '\0')
+            continue;
+
+        first = g_ascii_strtoull (ranges[i], &end, 10);
+        last = first;
+
+        if (end != ranges[i] && *end == '-')
+            last = g_ascii_strtoull (end + 1, &end, 10);
+
+        success = end != ranges[i] && *end == '\0' && first <= last && last < CPU_SETSIZE;
+
+        for (guint64 cpu = first; success && cpu <= last; cpu++)
+            CPU_SET (cpu, set);
+    }
+
+    g_strfreev (ranges);
+    return success;
+}
+
+/*
+ * Read a processor list such as "0-3,8-11" as used by sysfs.
+ */
+static gboolean
+read_cpu_list (const gchar *filename,
+               cpu_set_t *set)
+{
+    gchar *contents;
+    gboolean success;
+
+    if (!g_file_get_contents (filename, &contents, NULL, NULL))
+        return FALSE;
+
+    success = parse_cpu_list (g_strstrip (contents), set);
+    g_free (contents);
+    return success;
+}
+
+static gint
+compare_index (gconstpointer a,
+               gconstpointer b)
+{
+    return (gint) GPOINTER_TO_UINT (a) - (gint) GPOINTER_TO_UINT (b);
+}
+
+static GList *
+discover_numa_nodes (cpu_set_t *allowed)
+{
+    GDir *dir;
+    GList *indices = NULL;
+    GList *nodes = NULL;
+    GList *it;
+
+    dir = g_dir_open ("/sys/devices/system/node", 0, NULL);
+
+    if (dir != NULL) {
+        const gchar *name;
+
+        while ((name = g_dir_read_name (dir)) != NULL) {
+            if (g_str_has_prefix (name, "node") && g_ascii_isdigit (name[4])) {
+                guint index = (guint) g_ascii_strtoull (name + 4, NULL, 10);
+                indices = g_list_insert_sorted (indices, GUINT_TO_POINTER (index), compare_index);
+            }
+        }
+
+        g_dir_close (dir);
+    }
+
+    g_list_for (indices, it) {
+        guint index;
+        gchar *filename;
+        cpu_set_t set;
+
+        index = GPOINTER_TO_UINT (it->data);
+        filename = g_strdup_printf ("/sys/devices/system/node/node%u/cpulist", index);
+
+        if (read_cpu_list (filename, &set)) {
+            CPU_AND (&set, &set, allowed);
+
+            /* Memory-only nodes and nodes we may not run on are useless */
+            if (CPU_COUNT (&set) > 0)
+                nodes = g_list_append (nodes, ufo_cpu_node_new_full (&set, index));
+        }
+
+        g_free (filename);
+    }
+
+    g_list_free (indices);
+
+    /* Without NUMA information all processors form one node */
+    if (nodes == NULL)
+        nodes = g_list_append (nodes, ufo_cpu_node_new_full (allowed, 0));
+
+    return nodes;
+}
+
+/*
+ * Split a NUMA node into cores, keeping hardware threads of the same core
+ * together.
+ */
+static GList *
+split_into_cores (UfoCpuNode *numa_node,
+                  GList *cores)
+{
+    cpu_set_t remaining;
+
+    remaining = *numa_node->priv->mask;
+
+    for (gint cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        cpu_set_t core;
+        gchar *filename;
+
+        if (!CPU_ISSET (cpu, &remaining))
+            continue;
+
+        filename = g_strdup_printf ("/sys/devices/system/cpu/cpu%i/topology/thread_siblings_list", cpu);
+
+        if (!read_cpu_list (filename, &core))
+            CPU_ZERO (&core);
+
+        CPU_SET (cpu, &core);
+        CPU_AND (&core, &core, &remaining);
+        CPU_XOR (&remaining, &remaining, &core);
+        cores = g_list_append (cores, ufo_cpu_node_new_full (&core, numa_node->priv->numa_node));
+        g_free (filename);
+    }
+
+    return cores;
+}
+#endif
+
+/**
+ * ufo_cpu_node_discover:
+ * @placement: Granularity of the nodes
+ *
+ * Create nodes for the processors this process may run on, either one per
+ * NUMA node or one per core. The topology is read from sysfs; if it is not
+ * available, all processors are considered to be on NUMA node 0.
+ *
+ * Returns: (transfer full) (element-type Ufo.CpuNode): List of #UfoCpuNode
+ * objects or %NULL if @placement is #UFO_CPU_PLACEMENT_NONE or processor
+ * affinity is not supported. Free with g_list_free_full() and
+ * g_object_unref().
+ */
+GList *
+ufo_cpu_node_discover (UfoCpuPlacement placement)
+{
+#ifdef __APPLE__
+    return NULL;
+#else
+    cpu_set_t allowed;
+    GList *numa_nodes;
+    GList *cores = NULL;
+    GList *it;
+
+    if (placement == UFO_CPU_PLACEMENT_NONE)
+        return NULL;
+
+    if (sched_getaffinity (0, sizeof (cpu_set_t), &allowed) != 0) {
+        g_warning ("Could not get processor affinity: %s", g_strerror (errno));
+        return NULL;
+    }
+
+    numa_nodes = discover_numa_nodes (&allowed);
+
+    if (placement == UFO_CPU_PLACEMENT_NUMA)
+        return numa_nodes;
+
+    g_list_for (numa_nodes, it) {
+        cores = split_into_cores (UFO_CPU_NODE (it->data), cores);
+    }
+
+    g_list_free_full (numa_nodes, g_object_unref);
+    return cores;
+#endif
+}
+
 /**
  * ufo_cpu_node_get_affinity:
  * @node: A #UfoCpuNode
@@ -69,6 +281,89 @@ ufo_cpu_node_get_affinity (UfoCpuNode *node)
     return node->priv->mask;
 }
 
+/**
+ * ufo_cpu_node_get_numa_node:
+ * @node: A #UfoCpuNode
+ *
+ * Get the NUMA node that the processors of @node belong to.
+ *
+ * Returns: Index of the NUMA node.
+ */
+guint
+ufo_cpu_node_get_numa_node (UfoCpuNode *node)
+{
+    g_return_val_if_fail (UFO_IS_CPU_NODE (node), 0);
+    return node->priv->numa_node;
+}
+
+/**
+ * ufo_cpu_node_get_cpu_list:
+ * @node: A #UfoCpuNode
+ *
+ * Get the processors of @node in the same notation as `taskset -c`, e.g.
+ * "0-3,8".
+ *
+ * Returns: (transfer full): A newly allocated string.
+ */
+gchar *
+ufo_cpu_node_get_cpu_list (UfoCpuNode *node)
+{
+    GString *list;
+
+    g_return_val_if_fail (UFO_IS_CPU_NODE (node), NULL);
+    list = g_string_new (NULL);
+
+#ifndef __APPLE__
+    for (gint cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        gint last = cpu;
+
+        if (!CPU_ISSET (cpu, node->priv->mask))
+            continue;
+
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET (last + 1, node->priv->mask))
+            last++;
+
+        if (list->len > 0)
+            g_string_append_c (list, ',');
+
+        if (last > cpu)
+            g_string_append_printf (list, "%i-%i", cpu, last);
+        else
+            g_string_append_printf (list, "%i", cpu);
+
+        cpu = last;
+    }
+#endif
+
+    return g_string_free (list, FALSE);
+}
+
+/**
+ * ufo_cpu_node_bind:
+ * @node: A #UfoCpuNode
+ *
+ * Restrict the calling thread to the processors of @node. Memory that the
+ * thread touches first is then allocated on the NUMA node of @node.
+ *
+ * Returns: %TRUE if the thread was pinned, %FALSE otherwise.
+ */
+gboolean
+ufo_cpu_node_bind (UfoCpuNode *node)
+{
+    g_return_val_if_fail (UFO_IS_CPU_NODE (node), FALSE);
+
+#ifdef __APPLE__
+    return FALSE;
+#else
+    if (sched_setaffinity (0, sizeof (cpu_set_t), node->priv->mask) != 0) {
+        g_warning ("Could not pin thread to processors: %s", g_strerror (errno));
+        return FALSE;
+    }
+
+    return TRUE;
+#endif
+}
+
 static void
 ufo_cpu_node_finalize (GObject *object)
 {
@@ -88,7 +383,9 @@ static UfoNode *
 ufo_cpu_node_copy_real (UfoNode *node,
                         GError **error)
 {
-    return UFO_NODE (ufo_cpu_node_new (UFO_CPU_NODE (node)->priv->mask));
+    UfoCpuNodePrivate *priv = UFO_CPU_NODE (node)->priv;
+
+    return ufo_cpu_node_new_full (priv->mask, priv->numa_node);
 }
 
 static gboolean
@@ -137,4 +434,5 @@ ufo_cpu_node_init (UfoCpuNode *self)
     UfoCpuNodePrivate *priv;
     self->priv = priv = UFO_CPU_NODE_GET_PRIVATE (self);
     priv->mask = NULL;
+    priv->numa_node = 0;
 }
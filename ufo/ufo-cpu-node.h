@@ -39,6 +39,23 @@ typedef struct _UfoCpuNode           UfoCpuNode;
 typedef struct _UfoCpuNodeClass      UfoCpuNodeClass;
 typedef struct _UfoCpuNodePrivate    UfoCpuNodePrivate;
 
+/**
+ * UfoCpuPlacement:
+ * @UFO_CPU_PLACEMENT_NONE: Do not pin task threads, the operating system
+ *  decides where they run.
+ * @UFO_CPU_PLACEMENT_NUMA: Pin task threads to all processors of one NUMA
+ *  node.
+ * @UFO_CPU_PLACEMENT_CORE: Pin task threads to a single core, including its
+ *  hardware threads.
+ *
+ * Granularity of the #UfoCpuNode objects that task threads are pinned to.
+ */
+typedef enum {
+    UFO_CPU_PLACEMENT_NONE,
+    UFO_CPU_PLACEMENT_NUMA,
+    UFO_CPU_PLACEMENT_CORE
+} UfoCpuPlacement;
+
 /**
  * UfoCpuNode:
  *
@@ -62,8 +79,14 @@ struct _UfoCpuNodeClass {
     UfoNodeClass parent_class;
 };
 
-UfoNode     *ufo_cpu_node_new           (gpointer mask);
-gpointer     ufo_cpu_node_get_affinity  (UfoCpuNode *node);
+UfoNode     *ufo_cpu_node_new           (gpointer        mask);
+UfoNode     *ufo_cpu_node_new_full      (gpointer        mask,
+                                         guint           numa_node);
+GList       *ufo_cpu_node_discover      (UfoCpuPlacement placement);
+gpointer     ufo_cpu_node_get_affinity  (UfoCpuNode     *node);
+guint        ufo_cpu_node_get_numa_node (UfoCpuNode     *node);
+gchar       *ufo_cpu_node_get_cpu_list  (UfoCpuNode     *node);
+gboolean     ufo_cpu_node_bind          (UfoCpuNode     *node);
 GType        ufo_cpu_node_get_type      (void);
 
 G_END_DECLS
@@ -64,6 +64,11 @@ ufo_dummy_task_setup (UfoTask *task,
 {
 }
 
+static void
+ufo_dummy_task_reset (UfoTask *task)
+{
+}
+
 static void
 ufo_dummy_task_get_requisition (UfoTask *task,
                                 UfoBuffer **inputs,
@@ -95,6 +100,7 @@ static void
 ufo_task_interface_init (UfoTaskIface *iface)
 {
     iface->setup = ufo_dummy_task_setup;
+    iface->reset = ufo_dummy_task_reset;
     iface->get_num_inputs = ufo_dummy_task_get_num_inputs;
     iface->get_num_dimensions = ufo_dummy_task_get_num_dimensions;
     iface->get_mode = ufo_dummy_task_get_mode;
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "ufo-elementwise-iface.h"
+
+/**
+ * SECTION:ufo-elementwise-iface
+ * @Short_description: Elementwise GPU operations
+ * @Title: UfoElementwise
+ *
+ * Tasks that implement this interface describe their operation as a single
+ * OpenCL expression of the float variable `x`, which holds the input element,
+ * for example `"x * 2.0f + 1.0f"`. ufo_task_graph_fuse() concatenates the
+ * expressions of a chain of such tasks into one generated kernel, so that the
+ * chain reads and writes global memory only once per element.
+ */
+
+typedef UfoElementwiseIface UfoElementwiseInterface;
+
+G_DEFINE_INTERFACE (UfoElementwise, ufo_elementwise, G_TYPE_OBJECT)
+
+/**
+ * ufo_elementwise_get_expression:
+ * @elementwise: A #UfoElementwise
+ *
+ * Get the expression that computes an output element from the input element
+ * `x`. Parameters of the task must be inlined as constants, so the expression
+ * is valid only until a property changes.
+ *
+ * Returns: (transfer full) (allow-none): The expression or %NULL if the task
+ * cannot be expressed elementwise with its current parameters.
+ */
+gchar *
+ufo_elementwise_get_expression (UfoElementwise *elementwise)
+{
+    g_return_val_if_fail (UFO_IS_ELEMENTWISE (elementwise), NULL);
+    return UFO_ELEMENTWISE_GET_IFACE (elementwise)->get_expression (elementwise);
+}
+
+static gchar *
+ufo_elementwise_get_expression_real (UfoElementwise *elementwise)
+{
+    return NULL;
+}
+
+static void
+ufo_elementwise_default_init (UfoElementwiseInterface *iface)
+{
+    iface->get_expression = ufo_elementwise_get_expression_real;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UFO_ELEMENTWISE_IFACE_H
+#define __UFO_ELEMENTWISE_IFACE_H
+
+#if !defined (__UFO_H_INSIDE__) && !defined (UFO_COMPILATION)
+#error "Only <ufo/ufo.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define UFO_TYPE_ELEMENTWISE             (ufo_elementwise_get_type())
+#define UFO_ELEMENTWISE(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), UFO_TYPE_ELEMENTWISE, UfoElementwise))
+#define UFO_ELEMENTWISE_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), UFO_TYPE_ELEMENTWISE, UfoElementwiseIface))
+#define UFO_IS_ELEMENTWISE(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), UFO_TYPE_ELEMENTWISE))
+#define UFO_IS_ELEMENTWISE_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), UFO_TYPE_ELEMENTWISE))
+#define UFO_ELEMENTWISE_GET_IFACE(inst)  (G_TYPE_INSTANCE_GET_INTERFACE((inst), UFO_TYPE_ELEMENTWISE, UfoElementwiseIface))
+
+typedef struct _UfoElementwise         UfoElementwise;
+typedef struct _UfoElementwiseIface    UfoElementwiseIface;
+
+/**
+ * UfoElementwiseIface:
+ * @get_expression: Return the OpenCL expression of the task
+ *
+ * Interface for GPU processors whose output element depends only on the same
+ * element of their single input.
+ */
+struct _UfoElementwiseIface {
+    /*< private >*/
+    GTypeInterface parent_iface;
+
+    /*< public >*/
+    gchar * (*get_expression) (UfoElementwise *elementwise);
+};
+
+gchar  *ufo_elementwise_get_expression  (UfoElementwise *elementwise);
+GType   ufo_elementwise_get_type        (void);
+
+G_END_DECLS
+
+#endif
@@ -71,6 +71,7 @@ typedef struct {
     UfoTask *task;
     GList *connections;
     cl_context context;
+    UfoBufferMemoryMode memory_mode;
     UfoBaseScheduler    *scheduler;
 } TaskData;
 
@@ -145,12 +146,12 @@ release_input_data (UfoTwoWayQueue **in_queues, UfoBuffer **inputs, guint n_inpu
 }
 
 static UfoBuffer *
-pop_output_data (UfoTwoWayQueue *queue, UfoRequisition *requisition, cl_context context)
+pop_output_data (UfoTwoWayQueue *queue, UfoRequisition *requisition, TaskData *data)
 {
     UfoBuffer *buffer;
 
     if (ufo_two_way_queue_get_capacity (queue) < 2) {
-        buffer = ufo_buffer_new (requisition, context);
+        buffer = ufo_buffer_new_full (requisition, data->context, ufo_buffer_pool_get_default (), data->memory_mode);
         ufo_two_way_queue_insert (queue, buffer);
     }
 
@@ -233,7 +234,7 @@ generate_loop (TaskData *data, GError **error)
                 break;
             }
 
-            output = pop_output_data (out_queue, &requisition, data->context);
+            output = pop_output_data (out_queue, &requisition, data);
             active = ufo_task_generate (data->task, output, &requisition) && !priv->aborted;
 
             if (!active)
@@ -293,7 +294,7 @@ process_loop (TaskData *data, GError **error)
             g_list_for (out_queues, it) {
                 UfoTwoWayQueue *out_queue = (UfoTwoWayQueue *) it->data;
 
-                output = pop_output_data (out_queue, &requisition, data->context);
+                output = pop_output_data (out_queue, &requisition, data);
 
                 for (guint i = 0; i < n_inputs; i++)
                     ufo_buffer_copy_metadata (inputs[i], output);
@@ -376,7 +377,7 @@ reduce_loop (TaskData *data, GError **error)
     } else {
         /* Get the scratchpad output buffers from all successors */
         for (guint i = 0; i < n_outputs; i++) {
-            outputs[i] = pop_output_data (output_queues[i], &requisition, data->context);
+            outputs[i] = pop_output_data (output_queues[i], &requisition, data);
         }
 
         do {
@@ -490,8 +491,10 @@ setup_tasks (UfoGraph *graph,
     GList *gpu_nodes;
     GList *nodes;
     GList *it;
+    UfoTwoWayQueueBackend backend;
 
     data = g_new0 (ProcessData, 1);
+    g_object_get (scheduler, "queue-backend", &backend, NULL);
 
     data->connections = NULL;
     data->tasks = NULL;
@@ -523,8 +526,8 @@ setup_tasks (UfoGraph *graph,
             connection = g_new0 (Connection, 1);
             connection->from = source_task;
             connection->to = dest_task;
-            connection->port = (guint) GPOINTER_TO_INT (ufo_graph_get_edge_label (graph, source_node, dest_node));
-            connection->queue = ufo_two_way_queue_new (NULL);
+            connection->port = UFO_EDGE_LABEL_INPUT (ufo_graph_get_edge_label (graph, source_node, dest_node));
+            connection->queue = ufo_two_way_queue_new_full (NULL, backend, 2);
 
             data->queues = g_list_append (data->queues, connection->queue);
             data->connections = g_list_append (data->connections, connection);
@@ -603,6 +606,7 @@ ufo_fixed_scheduler_run (UfoBaseScheduler *scheduler,
         tdata->task = UFO_TASK (it->data);
         tdata->connections = pdata->connections;
         tdata->context = ufo_resources_get_context (resources);
+        g_object_get (resources, "buffer-memory-mode", &tdata->memory_mode, NULL);
         tdata->scheduler = scheduler;
         thread = g_thread_new (NULL, (GThreadFunc) run_local, tdata);
         threads = g_list_append (threads, thread);
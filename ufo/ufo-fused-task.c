@@ -0,0 +1,468 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "ufo-fused-task.h"
+#include "ufo-elementwise-iface.h"
+#include "ufo-task-iface.h"
+#include "ufo-priv.h"
+
+/**
+ * SECTION:ufo-fused-task
+ * @Short_description: Run a chain of GPU processors as one task
+ * @Title: UfoFusedTask
+ *
+ * A fused task runs a linear chain of GPU processors on a single thread with
+ * a single command queue. Intermediate results never leave the device: each
+ * link of the chain owns one device buffer that is reused for every frame.
+ *
+ * If all tasks of the chain implement #UfoElementwise, their expressions are
+ * concatenated into one generated kernel and the intermediate buffers are not
+ * needed at all. Fused tasks are created by ufo_task_graph_fuse().
+ */
+
+static void ufo_task_interface_init (UfoTaskIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (UfoFusedTask, ufo_fused_task, UFO_TYPE_TASK_NODE,
+                         G_IMPLEMENT_INTERFACE (UFO_TYPE_TASK,
+                                                ufo_task_interface_init))
+
+#define UFO_FUSED_TASK_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), UFO_TYPE_FUSED_TASK, UfoFusedTaskPrivate))
+
+struct _UfoFusedTaskPrivate {
+    GList           *tasks;
+    guint            n_tasks;
+    UfoBuffer      **intermediates;
+    UfoRequisition  *requisitions;
+    UfoResources    *resources;
+    gpointer         kernel;
+};
+
+enum {
+    PROP_0,
+    N_PROPERTIES
+};
+
+UfoNode *
+ufo_fused_task_new (void)
+{
+    return UFO_NODE (g_object_new (UFO_TYPE_FUSED_TASK, NULL));
+}
+
+/**
+ * ufo_fused_task_add_task:
+ * @task: A #UfoFusedTask
+ * @member: A #UfoTaskNode processing the output of the previously added task
+ *
+ * Append @member to the chain of tasks run by @task.
+ */
+void
+ufo_fused_task_add_task (UfoFusedTask *task,
+                         UfoTaskNode *member)
+{
+    UfoFusedTaskPrivate *priv;
+
+    g_return_if_fail (UFO_IS_FUSED_TASK (task) && UFO_IS_TASK_NODE (member));
+    priv = task->priv;
+    priv->tasks = g_list_append (priv->tasks, g_object_ref (member));
+    priv->n_tasks++;
+}
+
+/**
+ * ufo_fused_task_get_tasks:
+ * @task: A #UfoFusedTask
+ *
+ * Get the chain of tasks run by @task in processing order.
+ *
+ * Returns: (transfer none) (element-type UfoTaskNode): List of tasks.
+ */
+GList *
+ufo_fused_task_get_tasks (UfoFusedTask *task)
+{
+    g_return_val_if_fail (UFO_IS_FUSED_TASK (task), NULL);
+    return task->priv->tasks;
+}
+
+static void
+free_intermediates (UfoFusedTaskPrivate *priv)
+{
+    if (priv->intermediates != NULL) {
+        for (guint i = 0; i < priv->n_tasks; i++) {
+            if (priv->intermediates[i] != NULL)
+                g_object_unref (priv->intermediates[i]);
+        }
+
+        g_free (priv->intermediates);
+        priv->intermediates = NULL;
+    }
+
+    g_free (priv->requisitions);
+    priv->requisitions = NULL;
+}
+
+/*
+ * Concatenate the expressions of all tasks into one kernel. Returns NULL if any
+ * of the tasks is not elementwise, in which case the tasks are run one after
+ * the other.
+ */
+static gpointer
+build_elementwise_kernel (UfoFusedTaskPrivate *priv)
+{
+    GString *source;
+    GList *it;
+    gpointer kernel;
+    GError *tmp_error = NULL;
+
+    source = g_string_new ("kernel void\n"
+                           "fused_elementwise (global const float *input, global float *output)\n"
+                           "{\n"
+                           "    const size_t idx = get_global_id (0);\n"
+                           "    float x = input[idx];\n\n");
+
+    g_list_for (priv->tasks, it) {
+        gchar *expression = NULL;
+
+        if (UFO_IS_ELEMENTWISE (it->data))
+            expression = ufo_elementwise_get_expression (UFO_ELEMENTWISE (it->data));
+
+        if (expression == NULL) {
+            g_string_free (source, TRUE);
+            return NULL;
+        }
+
+        g_string_append_printf (source, "    x = (%s);\n", expression);
+        g_free (expression);
+    }
+
+    g_string_append (source, "    output[idx] = x;\n}\n");
+    kernel = ufo_resources_get_kernel_from_source (priv->resources, source->str,
+                                                   "fused_elementwise", NULL, &tmp_error);
+
+    if (kernel == NULL) {
+        g_debug ("WARN Could not build fused kernel, running tasks separately: %s", tmp_error->message);
+        g_error_free (tmp_error);
+    }
+
+    g_string_free (source, TRUE);
+    return kernel;
+}
+
+static void
+ufo_fused_task_setup (UfoTask *task,
+                      UfoResources *resources,
+                      GError **error)
+{
+    UfoFusedTaskPrivate *priv;
+    UfoTaskNode *node;
+    UfoNode *proc_node;
+    UfoProfiler *profiler;
+    GList *it;
+    guint index;
+    guint total;
+    GError *tmp_error = NULL;
+
+    priv = UFO_FUSED_TASK_GET_PRIVATE (task);
+    node = UFO_TASK_NODE (task);
+    proc_node = ufo_task_node_get_proc_node (node);
+    profiler = ufo_task_node_get_profiler (node);
+    ufo_task_node_get_partition (node, &index, &total);
+
+    g_list_for (priv->tasks, it) {
+        UfoTaskNode *member = UFO_TASK_NODE (it->data);
+
+        if (proc_node != NULL)
+            ufo_task_node_set_proc_node (member, proc_node);
+
+        if (profiler != NULL)
+            ufo_task_node_set_profiler (member, profiler);
+
+        ufo_task_node_set_partition (member, index, total);
+        ufo_task_setup (UFO_TASK (member), resources, &tmp_error);
+
+        if (tmp_error != NULL) {
+            g_propagate_error (error, tmp_error);
+            return;
+        }
+    }
+
+    free_intermediates (priv);
+    priv->intermediates = g_new0 (UfoBuffer *, priv->n_tasks);
+    priv->requisitions = g_new0 (UfoRequisition, priv->n_tasks);
+    priv->resources = resources;
+    priv->kernel = build_elementwise_kernel (priv);
+}
+
+static void
+ufo_fused_task_reset (UfoTask *task)
+{
+    UfoFusedTaskPrivate *priv;
+    GList *it;
+    GError *error = NULL;
+
+    priv = UFO_FUSED_TASK_GET_PRIVATE (task);
+
+    /* Keep the fused kernel and intermediates, members are set up again only
+     * if they cannot be reset */
+    g_list_for (priv->tasks, it) {
+        ufo_task_reset (UFO_TASK (it->data), priv->resources, &error);
+
+        if (error != NULL) {
+            g_warning ("%s", error->message);
+            g_clear_error (&error);
+        }
+    }
+}
+
+static guint
+ufo_fused_task_get_num_inputs (UfoTask *task)
+{
+    UfoFusedTaskPrivate *priv = UFO_FUSED_TASK_GET_PRIVATE (task);
+    return ufo_task_get_num_inputs (UFO_TASK (priv->tasks->data));
+}
+
+static guint
+ufo_fused_task_get_num_dimensions (UfoTask *task,
+                                   guint input)
+{
+    UfoFusedTaskPrivate *priv = UFO_FUSED_TASK_GET_PRIVATE (task);
+    return ufo_task_get_num_dimensions (UFO_TASK (priv->tasks->data), input);
+}
+
+static UfoTaskMode
+ufo_fused_task_get_mode (UfoTask *task)
+{
+    UfoFusedTaskPrivate *priv = UFO_FUSED_TASK_GET_PRIVATE (task);
+    UfoTaskMode mode = UFO_TASK_MODE_PROCESSOR | UFO_TASK_MODE_GPU | UFO_TASK_MODE_FIXED_SHAPE;
+    GList *it;
+
+    /* Every work item of the fused kernel reads and writes only its own pixel */
+    if (priv->kernel != NULL)
+        return mode | UFO_TASK_MODE_INPLACE;
+
+    g_list_for (priv->tasks, it) {
+        if (!(ufo_task_get_mode (UFO_TASK (it->data)) & UFO_TASK_MODE_FIXED_SHAPE))
+            return mode & ~UFO_TASK_MODE_FIXED_SHAPE;
+    }
+
+    return mode;
+}
+
+static void
+ufo_fused_task_get_requisition (UfoTask *task,
+                                UfoBuffer **inputs,
+                                UfoRequisition *requisition,
+                                GError **error)
+{
+    UfoFusedTaskPrivate *priv;
+    UfoBuffer *current;
+    GList *it;
+    guint i = 0;
+    GError *tmp_error = NULL;
+
+    priv = UFO_FUSED_TASK_GET_PRIVATE (task);
+
+    if (priv->kernel != NULL) {
+        ufo_buffer_get_requisition (inputs[0], requisition);
+        return;
+    }
+
+    current = inputs[0];
+
+    g_list_for (priv->tasks, it) {
+        ufo_task_get_requisition (UFO_TASK (it->data), &current, &priv->requisitions[i], &tmp_error);
+
+        if (tmp_error != NULL) {
+            g_propagate_error (error, tmp_error);
+            return;
+        }
+
+        if (it->next == NULL)
+            break;
+
+        if (priv->intermediates[i] == NULL)
+            priv->intermediates[i] = ufo_buffer_new (&priv->requisitions[i],
+                                                     ufo_resources_get_context (priv->resources));
+        else
+            ufo_buffer_resize (priv->intermediates[i], &priv->requisitions[i]);
+
+        current = priv->intermediates[i];
+        i++;
+    }
+
+    *requisition = priv->requisitions[i];
+}
+
+static gboolean
+process_elementwise (UfoTask *task,
+                     UfoBuffer *input,
+                     UfoBuffer *output,
+                     UfoRequisition *requisition)
+{
+    UfoFusedTaskPrivate *priv;
+    cl_command_queue cmd_queue;
+    cl_mem in_mem;
+    cl_mem out_mem;
+    gsize n_elements;
+
+    priv = UFO_FUSED_TASK_GET_PRIVATE (task);
+    cmd_queue = ufo_task_node_get_cmd_queue (UFO_TASK_NODE (task));
+    in_mem = ufo_buffer_get_device_array_readonly (input, cmd_queue);
+    out_mem = ufo_buffer_get_device_array (output, cmd_queue);
+    n_elements = ufo_buffer_get_size (output) / sizeof (gfloat);
+
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->kernel, 0, sizeof (cl_mem), &in_mem));
+    UFO_RESOURCES_CHECK_CLERR (clSetKernelArg (priv->kernel, 1, sizeof (cl_mem), &out_mem));
+    ufo_profiler_call (ufo_task_node_get_profiler (UFO_TASK_NODE (task)),
+                       cmd_queue, priv->kernel, 1, &n_elements, NULL);
+
+    return TRUE;
+}
+
+static gboolean
+ufo_fused_task_process (UfoTask *task,
+                        UfoBuffer **inputs,
+                        UfoBuffer *output,
+                        UfoRequisition *requisition)
+{
+    UfoFusedTaskPrivate *priv;
+    UfoBuffer *current;
+    GList *it;
+    guint i = 0;
+
+    priv = UFO_FUSED_TASK_GET_PRIVATE (task);
+
+    if (priv->kernel != NULL)
+        return process_elementwise (task, inputs[0], output, requisition);
+
+    current = inputs[0];
+
+    g_list_for (priv->tasks, it) {
+        UfoBuffer *result;
+
+        if (it->next != NULL) {
+            /* intermediate results are overwritten on the device anyway */
+            result = priv->intermediates[i];
+            ufo_buffer_discard_location (result);
+            ufo_buffer_copy_metadata (current, result);
+        }
+        else {
+            result = output;
+        }
+
+        if (!ufo_task_process (UFO_TASK (it->data), &current, result, &priv->requisitions[i]))
+            return FALSE;
+
+        current = result;
+        i++;
+    }
+
+    return TRUE;
+}
+
+static UfoNode *
+ufo_fused_task_copy (UfoNode *node,
+                     GError **error)
+{
+    UfoNode *copy;
+    GList *it;
+    GError *tmp_error = NULL;
+
+    copy = UFO_NODE_CLASS (ufo_fused_task_parent_class)->copy (node, &tmp_error);
+
+    if (tmp_error != NULL) {
+        g_propagate_error (error, tmp_error);
+        return NULL;
+    }
+
+    g_list_for (UFO_FUSED_TASK (node)->priv->tasks, it) {
+        UfoNode *member;
+
+        member = ufo_node_copy (UFO_NODE (it->data), &tmp_error);
+
+        if (tmp_error != NULL) {
+            g_propagate_error (error, tmp_error);
+            g_object_unref (copy);
+            return NULL;
+        }
+
+        ufo_fused_task_add_task (UFO_FUSED_TASK (copy), UFO_TASK_NODE (member));
+        g_object_unref (member);
+    }
+
+    return copy;
+}
+
+static void
+ufo_fused_task_dispose (GObject *object)
+{
+    UfoFusedTaskPrivate *priv;
+
+    priv = UFO_FUSED_TASK_GET_PRIVATE (object);
+    free_intermediates (priv);
+    g_list_free_full (priv->tasks, g_object_unref);
+    priv->tasks = NULL;
+    priv->n_tasks = 0;
+
+    G_OBJECT_CLASS (ufo_fused_task_parent_class)->dispose (object);
+}
+
+static void
+ufo_task_interface_init (UfoTaskIface *iface)
+{
+    iface->setup = ufo_fused_task_setup;
+    iface->reset = ufo_fused_task_reset;
+    iface->get_num_inputs = ufo_fused_task_get_num_inputs;
+    iface->get_num_dimensions = ufo_fused_task_get_num_dimensions;
+    iface->get_mode = ufo_fused_task_get_mode;
+    iface->get_requisition = ufo_fused_task_get_requisition;
+    iface->process = ufo_fused_task_process;
+}
+
+static void
+ufo_fused_task_class_init (UfoFusedTaskClass *klass)
+{
+    GObjectClass *oclass = G_OBJECT_CLASS (klass);
+    UfoNodeClass *nclass = UFO_NODE_CLASS (klass);
+
+    oclass->dispose = ufo_fused_task_dispose;
+    nclass->copy = ufo_fused_task_copy;
+
+    g_type_class_add_private (klass, sizeof (UfoFusedTaskPrivate));
+}
+
+static void
+ufo_fused_task_init (UfoFusedTask *task)
+{
+    task->priv = UFO_FUSED_TASK_GET_PRIVATE (task);
+    task->priv->tasks = NULL;
+    task->priv->n_tasks = 0;
+    task->priv->intermediates = NULL;
+    task->priv->requisitions = NULL;
+    task->priv->resources = NULL;
+    task->priv->kernel = NULL;
+
+    ufo_task_node_set_plugin_name (UFO_TASK_NODE (task), "fused-task");
+}
@@ -39,26 +39,132 @@ G_DEFINE_TYPE (UfoGpuNode, ufo_gpu_node, UFO_TYPE_NODE)
 struct _UfoGpuNodePrivate {
     cl_context context;
     cl_device_id device;
-    cl_command_queue cmd_queue;
+    cl_command_queue cmd_queue;         /* first of cmd_queues */
+    cl_command_queue *cmd_queues;
+    guint n_cmd_queues;
+    cl_command_queue *transfer_queues;
+    guint n_transfer_queues;
+    gint next_cmd_queue;
 };
 
+#define DEFAULT_NUM_CMD_QUEUES      2
+#define DEFAULT_NUM_TRANSFER_QUEUES 1
+
+/*
+ * UFO_GPU_QUEUES=N[,M] overrides the number of compute and transfer queues of
+ * each device.
+ */
+static void
+get_num_queues (guint *n_cmd_queues,
+                guint *n_transfer_queues)
+{
+    const gchar *var;
+    gchar **set;
+
+    *n_cmd_queues = DEFAULT_NUM_CMD_QUEUES;
+    *n_transfer_queues = DEFAULT_NUM_TRANSFER_QUEUES;
+    var = g_getenv ("UFO_GPU_QUEUES");
+
+    if (var == NULL || g_strcmp0 (var, "") == 0)
+        return;
+
+    set = g_strsplit (var, ",", 2);
+
+    if (set[0] != NULL)
+        *n_cmd_queues = MAX (1, (guint) g_ascii_strtoull (set[0], NULL, 10));
+
+    if (set[0] != NULL && set[1] != NULL)
+        *n_transfer_queues = (guint) g_ascii_strtoull (set[1], NULL, 10);
+
+    g_strfreev (set);
+}
+
+static cl_command_queue *
+create_queues (cl_context context,
+               cl_device_id device,
+               guint n_queues)
+{
+    cl_command_queue *queues;
+    cl_int errcode;
+
+    queues = g_new0 (cl_command_queue, MAX (1, n_queues));
+
+    for (guint i = 0; i < n_queues; i++) {
+        queues[i] = clCreateCommandQueue (context, device, CL_QUEUE_PROFILING_ENABLE, &errcode);
+        UFO_RESOURCES_CHECK_CLERR (errcode);
+    }
+
+    return queues;
+}
+
+static void
+release_queues (cl_command_queue *queues,
+                guint n_queues)
+{
+    for (guint i = 0; i < n_queues; i++) {
+        g_debug ("FREE cmd_queue=%p", (gpointer) queues[i]);
+        UFO_RESOURCES_CHECK_CLERR (clReleaseCommandQueue (queues[i]));
+    }
+
+    g_free (queues);
+}
+
+/**
+ * ufo_gpu_node_new:
+ * @context: A cl_context
+ * @device: A cl_device_id of @context
+ *
+ * Create a new #UfoGpuNode for @device. The number of command queues can be
+ * set with the UFO_GPU_QUEUES environment variable, e.g. "2,1" for two compute
+ * queues and one transfer queue which is also the default.
+ *
+ * Returns: A new #UfoGpuNode.
+ */
 UfoNode *
 ufo_gpu_node_new (gpointer context, gpointer device)
 {
-    UfoGpuNode *node;
-    cl_int errcode;
-    cl_command_queue_properties queue_properties;
+    guint n_cmd_queues;
+    guint n_transfer_queues;
 
-    g_return_val_if_fail (context != NULL && device != NULL, NULL);
+    get_num_queues (&n_cmd_queues, &n_transfer_queues);
+    return ufo_gpu_node_new_full (context, device, n_cmd_queues, n_transfer_queues);
+}
+
+/**
+ * ufo_gpu_node_new_full:
+ * @context: A cl_context
+ * @device: A cl_device_id of @context
+ * @n_cmd_queues: Number of compute queues, at least one
+ * @n_transfer_queues: Number of queues dedicated to host transfers
+ *
+ * Create a new #UfoGpuNode for @device with @n_cmd_queues in-order queues for
+ * kernels and @n_transfer_queues in-order queues for uploads and downloads.
+ * Tasks placed on the same device are given different compute queues, so that
+ * the device can overlap their work.
+ *
+ * Returns: A new #UfoGpuNode.
+ */
+UfoNode *
+ufo_gpu_node_new_full (gpointer context,
+                       gpointer device,
+                       guint n_cmd_queues,
+                       guint n_transfer_queues)
+{
+    UfoGpuNode *node;
+    UfoGpuNodePrivate *priv;
 
-    queue_properties = CL_QUEUE_PROFILING_ENABLE;
+    g_return_val_if_fail (context != NULL && device != NULL && n_cmd_queues > 0, NULL);
 
     node = UFO_GPU_NODE (g_object_new (UFO_TYPE_GPU_NODE, NULL));
-    node->priv->context = context;
-    node->priv->device = device;
-    node->priv->cmd_queue = clCreateCommandQueue (context, device, queue_properties, &errcode);
+    priv = node->priv;
+    priv->context = context;
+    priv->device = device;
+    priv->n_cmd_queues = n_cmd_queues;
+    priv->cmd_queues = create_queues (context, device, n_cmd_queues);
+    priv->cmd_queue = priv->cmd_queues[0];
+    priv->n_transfer_queues = n_transfer_queues;
+    priv->transfer_queues = create_queues (context, device, n_transfer_queues);
 
-    UFO_RESOURCES_CHECK_CLERR (errcode);
     UFO_RESOURCES_CHECK_CLERR (clRetainContext (context));
 
     return UFO_NODE (node);
@@ -68,7 +174,8 @@ ufo_gpu_node_new (gpointer context, gpointer device)
  * ufo_gpu_node_get_cmd_queue:
  * @node: A #UfoGpuNode
  *
- * Get command queue associated with @node.
+ * Get the first compute queue associated with @node. Tasks should use
+ * ufo_task_node_get_cmd_queue() to get the queue they were assigned.
  *
  * Returns: (transfer none): A cl_command_queue object for @node.
  */
@@ -79,6 +186,80 @@ ufo_gpu_node_get_cmd_queue (UfoGpuNode *node)
     return node->priv->cmd_queue;
 }
 
+/**
+ * ufo_gpu_node_get_num_cmd_queues:
+ * @node: A #UfoGpuNode
+ *
+ * Get the number of compute queues of @node.
+ *
+ * Returns: Number of compute queues.
+ */
+guint
+ufo_gpu_node_get_num_cmd_queues (UfoGpuNode *node)
+{
+    g_return_val_if_fail (UFO_IS_GPU_NODE (node), 0);
+    return node->priv->n_cmd_queues;
+}
+
+/**
+ * ufo_gpu_node_get_nth_cmd_queue:
+ * @node: A #UfoGpuNode
+ * @index: Index of the queue, wrapped around the number of compute queues
+ *
+ * Get a compute queue of @node.
+ *
+ * Returns: (transfer none): A cl_command_queue object for @node.
+ */
+gpointer
+ufo_gpu_node_get_nth_cmd_queue (UfoGpuNode *node,
+                                guint index)
+{
+    g_return_val_if_fail (UFO_IS_GPU_NODE (node), NULL);
+    return node->priv->cmd_queues[index % node->priv->n_cmd_queues];
+}
+
+/**
+ * ufo_gpu_node_get_nth_transfer_queue:
+ * @node: A #UfoGpuNode
+ * @index: Index of the queue, wrapped around the number of transfer queues
+ *
+ * Get a queue of @node for host transfers. If @node has no dedicated transfer
+ * queues, the corresponding compute queue is returned.
+ *
+ * Returns: (transfer none): A cl_command_queue object for @node.
+ */
+gpointer
+ufo_gpu_node_get_nth_transfer_queue (UfoGpuNode *node,
+                                     guint index)
+{
+    UfoGpuNodePrivate *priv;
+
+    g_return_val_if_fail (UFO_IS_GPU_NODE (node), NULL);
+    priv = node->priv;
+
+    if (priv->n_transfer_queues == 0)
+        return priv->cmd_queues[index % priv->n_cmd_queues];
+
+    return priv->transfer_queues[index % priv->n_transfer_queues];
+}
+
+/**
+ * ufo_gpu_node_assign_queue:
+ * @node: A #UfoGpuNode
+ *
+ * Get the index of the compute and transfer queue for the next task placed on
+ * @node. Indices are handed out round-robin.
+ *
+ * Returns: An index for ufo_gpu_node_get_nth_cmd_queue() and
+ * ufo_gpu_node_get_nth_transfer_queue().
+ */
+guint
+ufo_gpu_node_assign_queue (UfoGpuNode *node)
+{
+    g_return_val_if_fail (UFO_IS_GPU_NODE (node), 0);
+    return (guint) g_atomic_int_add (&node->priv->next_cmd_queue, 1);
+}
+
 /**
  * ufo_gpu_node_get_info:
  * @node: A #UfoGpuNodeInfo
@@ -155,7 +336,8 @@ ufo_gpu_node_copy_real (UfoNode *node,
     UfoGpuNode *orig;
 
     orig = UFO_GPU_NODE (node);
-    return ufo_gpu_node_new (orig->priv->context, orig->priv->device);
+    return ufo_gpu_node_new_full (orig->priv->context, orig->priv->device,
+                                  orig->priv->n_cmd_queues, orig->priv->n_transfer_queues);
 }
 
 static gboolean
@@ -174,8 +356,10 @@ ufo_gpu_node_finalize (GObject *object)
     priv = UFO_GPU_NODE_GET_PRIVATE (object);
 
     if (priv->cmd_queue != NULL) {
-        g_debug ("FREE cmd_queue=%p", (gpointer) priv->cmd_queue);
-        UFO_RESOURCES_CHECK_CLERR (clReleaseCommandQueue (priv->cmd_queue));
+        release_queues (priv->cmd_queues, priv->n_cmd_queues);
+        release_queues (priv->transfer_queues, priv->n_transfer_queues);
+        priv->cmd_queues = NULL;
+        priv->transfer_queues = NULL;
         priv->cmd_queue = NULL;
 
         UFO_RESOURCES_CHECK_CLERR (clReleaseContext (priv->context));
@@ -203,4 +387,9 @@ ufo_gpu_node_init (UfoGpuNode *self)
     UfoGpuNodePrivate *priv;
     self->priv = priv = UFO_GPU_NODE_GET_PRIVATE (self);
     priv->cmd_queue = NULL;
+    priv->cmd_queues = NULL;
+    priv->n_cmd_queues = 0;
+    priv->transfer_queues = NULL;
+    priv->n_transfer_queues = 0;
+    priv->next_cmd_queue = 0;
 }
@@ -83,7 +83,20 @@ typedef enum {
 
 UfoNode  *ufo_gpu_node_new              (gpointer        context,
                                          gpointer        device);
+UfoNode  *ufo_gpu_node_new_full         (gpointer        context,
+                                         gpointer        device,
+                                         guint           n_cmd_queues,
+                                         guint           n_transfer_queues);
 gpointer  ufo_gpu_node_get_cmd_queue    (UfoGpuNode     *node);
+guint     ufo_gpu_node_get_num_cmd_queues
+                                        (UfoGpuNode     *node);
+gpointer  ufo_gpu_node_get_nth_cmd_queue
+                                        (UfoGpuNode     *node,
+                                         guint           index);
+gpointer  ufo_gpu_node_get_nth_transfer_queue
+                                        (UfoGpuNode     *node,
+                                         guint           index);
+guint     ufo_gpu_node_assign_queue     (UfoGpuNode     *node);
 GValue   *ufo_gpu_node_get_info         (UfoGpuNode     *node,
                                          UfoGpuNodeInfo  info);
 GType     ufo_gpu_node_get_type         (void);
@@ -61,6 +61,7 @@ typedef struct {
     GList *tasks;
     gboolean is_leaf;
     gpointer context;
+    UfoBufferMemoryMode memory_mode;
     UfoTwoWayQueue *queue;
     enum {
         TASK_GROUP_ROUND_ROBIN,
@@ -152,8 +153,10 @@ build_task_groups (UfoBaseScheduler *scheduler, UfoTaskGraph *graph, UfoResource
 {
     GHashTable *tasks_to_groups;
     GList *it;
+    UfoTwoWayQueueBackend backend;
 
     tasks_to_groups = g_hash_table_new (g_direct_hash, g_direct_equal);
+    g_object_get (scheduler, "queue-backend", &backend, NULL);
 
     /* Create a group with a single member for each node */
     g_list_for (nodes, it) {
@@ -164,9 +167,10 @@ build_task_groups (UfoBaseScheduler *scheduler, UfoTaskGraph *graph, UfoResource
         task = UFO_NODE (it->data);
         group = g_new0 (TaskGroup, 1);
         group->context = ufo_resources_get_context (resources);
+        g_object_get (resources, "buffer-memory-mode", &group->memory_mode, NULL);
         group->parents = NULL;
         group->tasks = g_list_append (NULL, it->data);
-        group->queue = ufo_two_way_queue_new (NULL);
+        group->queue = ufo_two_way_queue_new_full (NULL, backend, 2);
         group->is_leaf = ufo_graph_get_num_successors (UFO_GRAPH (graph), task) == 0;
 
         if (ufo_task_get_mode (UFO_TASK (task)) & UFO_TASK_MODE_SHARE_DATA) {
@@ -367,7 +371,7 @@ run_group (TaskGroup *group)
             if (ufo_two_way_queue_get_capacity (group->queue) < 2) {
                 UfoBuffer *buffer;
 
-                buffer = ufo_buffer_new (&requisition, group->context);
+                buffer = ufo_buffer_new_full (&requisition, group->context, ufo_buffer_pool_get_default (), group->memory_mode);
                 ufo_two_way_queue_insert (group->queue, buffer);
             }
 
@@ -26,8 +26,10 @@
 #endif
 
 #include "ufo-group.h"
+#include "ufo-task-iface.h"
 #include "ufo-task-node.h"
 #include "ufo-two-way-queue.h"
+#include "ufo-priv.h"
 
 G_DEFINE_TYPE (UfoGroup, ufo_group, G_TYPE_OBJECT)
 
@@ -43,9 +45,29 @@ struct _UfoGroupPrivate {
     UfoSendPattern   pattern;
     guint            current;
     cl_context       context;
+    UfoBufferMemoryMode memory_mode;
+    UfoBufferPool   *pool;
     GList           *buffers;
+    GHashTable      *owners;        /* buffer -> queue it was allocated for */
+    cl_command_queue transfer_queue;    /* downloads for host targets */
+    guint            batch_size;        /* output buffers held by the producer at once */
+
+    /* Broadcast buffers are shared read-only with all targets */
+    UfoTwoWayQueue  *shared_queue;
+    GHashTable      *sources;       /* target buffer -> broadcast buffer */
+    GHashTable      *n_readers;     /* broadcast buffer -> number of targets */
+    GMutex           shared_lock;
+
+    /* Input buffers of the producer that were passed on in place */
+    GHashTable      *forwarded;     /* buffer -> Origin */
+    GMutex           forwarded_lock;
 };
 
+typedef struct {
+    UfoGroup    *group;
+    UfoTask     *target;
+} Origin;
+
 enum {
     PROP_0,
     N_PROPERTIES
@@ -66,6 +88,26 @@ UfoGroup *
 ufo_group_new (GList *targets,
                gpointer context,
                UfoSendPattern pattern)
+{
+    return ufo_group_new_full (targets, context, pattern, UFO_TWO_WAY_QUEUE_BACKEND_ASYNC);
+}
+
+/**
+ * ufo_group_new_full:
+ * @targets: (element-type UfoNode): A list of #UfoNode targets
+ * @context: A cl_context on which the targets should operate on.
+ * @pattern: Pattern to distribute data among the @targets
+ * @backend: Queue implementation used to pass buffers to the @targets
+ *
+ * Create a new #UfoGroup whose queues use @backend.
+ *
+ * Returns: A new #UfoGroup.
+ */
+UfoGroup *
+ufo_group_new_full (GList *targets,
+                    gpointer context,
+                    UfoSendPattern pattern,
+                    UfoTwoWayQueueBackend backend)
 {
     UfoGroup *group;
     UfoGroupPrivate *priv;
@@ -81,9 +123,17 @@ ufo_group_new (GList *targets,
     priv->current = 0;
     priv->context = context;
     priv->n_received = 0;
+    priv->memory_mode = UFO_BUFFER_MEMORY_MODE_SEPARATE;
+    priv->pool = ufo_buffer_pool_get_default ();
 
     for (guint i = 0; i < priv->n_targets; i++)
-        priv->queues[i] = ufo_two_way_queue_new (NULL);
+        priv->queues[i] = ufo_two_way_queue_new_full (NULL, backend, priv->n_targets + 1);
+
+    if (pattern == UFO_SEND_BROADCAST && priv->n_targets > 1) {
+        priv->shared_queue = ufo_two_way_queue_new_full (NULL, backend, priv->n_targets + 1);
+        priv->sources = g_hash_table_new (g_direct_hash, g_direct_equal);
+        priv->n_readers = g_hash_table_new (g_direct_hash, g_direct_equal);
+    }
 
     return group;
 }
@@ -95,20 +145,132 @@ ufo_group_get_num_targets (UfoGroup *group)
     return group->priv->n_targets;
 }
 
+/**
+ * ufo_group_set_memory_mode:
+ * @group: A #UfoGroup
+ * @mode: Allocation strategy for host memory
+ *
+ * Set how host memory of output buffers allocated from now on is provided.
+ */
+void
+ufo_group_set_memory_mode (UfoGroup *group,
+                           UfoBufferMemoryMode mode)
+{
+    g_return_if_fail (UFO_IS_GROUP (group));
+    group->priv->memory_mode = mode;
+}
+
+/**
+ * ufo_group_set_buffer_pool:
+ * @group: A #UfoGroup
+ * @pool: (transfer none): A #UfoBufferPool
+ *
+ * Set the pool that output buffers allocated from now on take their memory
+ * from. By default, ufo_buffer_pool_get_default() is used.
+ */
+void
+ufo_group_set_buffer_pool (UfoGroup *group,
+                           UfoBufferPool *pool)
+{
+    g_return_if_fail (UFO_IS_GROUP (group) && UFO_IS_BUFFER_POOL (pool));
+    group->priv->pool = pool;
+}
+
+/**
+ * ufo_group_set_transfer_queue:
+ * @group: A #UfoGroup
+ * @queue: (allow-none): A cl_command_queue or %NULL
+ *
+ * If none of the targets of @group uses a GPU, download output buffers that
+ * are pushed from device memory asynchronously via @queue. The producer can
+ * then enqueue its next kernels while the previous result is transferred.
+ */
+void
+ufo_group_set_transfer_queue (UfoGroup *group,
+                              gpointer queue)
+{
+    UfoGroupPrivate *priv;
+    GList *it;
+
+    g_return_if_fail (UFO_IS_GROUP (group));
+    priv = group->priv;
+    priv->transfer_queue = NULL;
+
+    g_list_for (priv->targets, it) {
+        if (ufo_task_uses_gpu (UFO_TASK (it->data)))
+            return;
+    }
+
+    priv->transfer_queue = queue;
+}
+
+static void
+recreate_queue (UfoGroupPrivate *priv,
+                UfoTwoWayQueue **queue)
+{
+    UfoTwoWayQueueBackend backend;
+
+    g_return_if_fail (ufo_two_way_queue_get_capacity (*queue) == 0);
+    backend = ufo_two_way_queue_get_backend (*queue);
+    ufo_two_way_queue_free (*queue);
+    *queue = ufo_two_way_queue_new_full (NULL, backend, priv->n_targets + priv->batch_size);
+}
+
+/**
+ * ufo_group_set_batch_size:
+ * @group: A #UfoGroup
+ * @batch_size: Number of output buffers the producer pops at once
+ *
+ * Allocate enough buffers so that the producer of @group can hold
+ * @batch_size output buffers before pushing the first of them. This must be
+ * called before the first buffer is popped.
+ */
+void
+ufo_group_set_batch_size (UfoGroup *group,
+                          guint batch_size)
+{
+    UfoGroupPrivate *priv;
+
+    g_return_if_fail (UFO_IS_GROUP (group));
+    priv = group->priv;
+
+    if (MAX (batch_size, 1) == priv->batch_size)
+        return;
+
+    priv->batch_size = MAX (batch_size, 1);
+
+    /* The ring backend allocates its storage up-front */
+    for (guint i = 0; i < priv->n_targets; i++)
+        recreate_queue (priv, &priv->queues[i]);
+
+    if (priv->shared_queue != NULL)
+        recreate_queue (priv, &priv->shared_queue);
+}
+
+static void
+alloc_buffer (UfoGroupPrivate *priv,
+              UfoTwoWayQueue *queue,
+              UfoRequisition *requisition)
+{
+    UfoBuffer *buffer;
+
+    buffer = ufo_buffer_new_full (requisition, priv->context, priv->pool, priv->memory_mode);
+    priv->buffers = g_list_append (priv->buffers, buffer);
+    g_hash_table_insert (priv->owners, buffer, queue);
+    ufo_two_way_queue_insert (queue, buffer);
+}
+
 static UfoBuffer *
 pop_or_alloc_buffer (UfoGroupPrivate *priv,
-                     guint pos,
+                     UfoTwoWayQueue *queue,
                      UfoRequisition *requisition)
 {
     UfoBuffer *buffer;
 
-    if (ufo_two_way_queue_get_capacity (priv->queues[pos]) < (priv->n_targets + 1)) {
-        buffer = ufo_buffer_new (requisition, priv->context);
-        priv->buffers = g_list_append (priv->buffers, buffer);
-        ufo_two_way_queue_insert (priv->queues[pos], buffer);
-    }
+    if (ufo_two_way_queue_get_capacity (queue) < (priv->n_targets + priv->batch_size))
+        alloc_buffer (priv, queue, requisition);
 
-    buffer = ufo_two_way_queue_producer_pop (priv->queues[pos]);
+    buffer = ufo_two_way_queue_producer_pop (queue);
 
     if (ufo_buffer_cmp_dimensions (buffer, requisition))
         ufo_buffer_resize (buffer, requisition);
@@ -116,6 +278,86 @@ pop_or_alloc_buffer (UfoGroupPrivate *priv,
     return buffer;
 }
 
+static UfoBuffer *
+try_pop_or_alloc_buffer (UfoGroupPrivate *priv,
+                         UfoTwoWayQueue *queue,
+                         UfoRequisition *requisition)
+{
+    UfoBuffer *buffer;
+
+    if (ufo_two_way_queue_get_capacity (queue) < (priv->n_targets + priv->batch_size))
+        return pop_or_alloc_buffer (priv, queue, requisition);
+
+    buffer = ufo_two_way_queue_producer_try_pop (queue);
+
+    if (buffer != NULL && ufo_buffer_cmp_dimensions (buffer, requisition))
+        ufo_buffer_resize (buffer, requisition);
+
+    return buffer;
+}
+
+static UfoTwoWayQueue *
+get_output_queue (UfoGroupPrivate *priv)
+{
+    if (priv->shared_queue != NULL)
+        return priv->shared_queue;
+
+    if ((priv->pattern == UFO_SEND_SCATTER) || (priv->pattern == UFO_SEND_SEQUENTIAL))
+        return priv->queues[priv->current];
+
+    return priv->queues[0];
+}
+
+/*
+ * Scattered buffers go to the target whose queue they were popped from, so
+ * that a producer holding several buffers at once pops the next one from the
+ * next target.
+ */
+static gboolean
+is_scattering (UfoGroupPrivate *priv)
+{
+    return priv->pattern == UFO_SEND_SCATTER && priv->shared_queue == NULL && priv->n_targets > 0;
+}
+
+static void
+fill_queue (UfoGroupPrivate *priv,
+            UfoTwoWayQueue *queue,
+            UfoRequisition *requisition)
+{
+    while (ufo_two_way_queue_get_capacity (queue) < (priv->n_targets + priv->batch_size))
+        alloc_buffer (priv, queue, requisition);
+}
+
+/**
+ * ufo_group_preallocate:
+ * @group: A #UfoGroup
+ * @requisition: Size of the buffers.
+ *
+ * Allocate all output buffers that @group hands out with the size of
+ * @requisition at once instead of one by one while they are popped. Buffers
+ * that already exist are kept and resized when they are popped next.
+ */
+void
+ufo_group_preallocate (UfoGroup *group,
+                       UfoRequisition *requisition)
+{
+    UfoGroupPrivate *priv;
+
+    g_return_if_fail (UFO_IS_GROUP (group));
+    priv = group->priv;
+
+    if (priv->shared_queue != NULL) {
+        fill_queue (priv, priv->shared_queue, requisition);
+    }
+    else if ((priv->pattern == UFO_SEND_SCATTER) || (priv->pattern == UFO_SEND_SEQUENTIAL)) {
+        for (guint i = 0; i < priv->n_targets; i++)
+            fill_queue (priv, priv->queues[i], requisition);
+    }
+    else if (priv->n_targets > 0) {
+        fill_queue (priv, priv->queues[0], requisition);
+    }
+}
+
 /**
  * ufo_group_pop_output_buffer:
  * @group: A #UfoGroup
@@ -128,15 +370,65 @@ UfoBuffer *
 ufo_group_pop_output_buffer (UfoGroup *group,
                              UfoRequisition *requisition)
 {
-    UfoGroupPrivate *priv;
-    guint pos = 0;
+    UfoGroupPrivate *priv = group->priv;
+    UfoBuffer *buffer;
 
-    priv = group->priv;
+    buffer = pop_or_alloc_buffer (priv, get_output_queue (priv), requisition);
 
-    if ((priv->pattern == UFO_SEND_SCATTER) || (priv->pattern == UFO_SEND_SEQUENTIAL))
-        pos = priv->current;
+    if (is_scattering (priv))
+        priv->current = (priv->current + 1) % priv->n_targets;
 
-    return pop_or_alloc_buffer (priv, pos, requisition);
+    return buffer;
+}
+
+/**
+ * ufo_group_try_pop_output_buffer:
+ * @group: A #UfoGroup
+ * @requisition: Size of the buffer.
+ *
+ * Like ufo_group_pop_output_buffer() but return %NULL instead of waiting if
+ * all buffers are still in use by the targets.
+ *
+ * Return value: (transfer full) (allow-none): A buffer that must be released
+ * with ufo_group_push_output_buffer() or %NULL.
+ */
+UfoBuffer *
+ufo_group_try_pop_output_buffer (UfoGroup *group,
+                                 UfoRequisition *requisition)
+{
+    UfoGroupPrivate *priv = group->priv;
+    UfoBuffer *buffer;
+
+    buffer = try_pop_or_alloc_buffer (priv, get_output_queue (priv), requisition);
+
+    if (buffer != NULL && is_scattering (priv))
+        priv->current = (priv->current + 1) % priv->n_targets;
+
+    return buffer;
+}
+
+/**
+ * ufo_group_return_output_buffer:
+ * @group: A #UfoGroup
+ * @buffer: A buffer from ufo_group_pop_output_buffer() that was not filled
+ *
+ * Give @buffer back without sending it to the targets. Unused buffers must be
+ * returned before any other buffer is pushed.
+ */
+void
+ufo_group_return_output_buffer (UfoGroup *group,
+                                UfoBuffer *buffer)
+{
+    UfoGroupPrivate *priv = group->priv;
+    UfoTwoWayQueue *queue;
+
+    queue = g_hash_table_lookup (priv->owners, buffer);
+
+    /* Keep the round-robin order of scattered streams */
+    if (is_scattering (priv))
+        priv->current = (priv->current + priv->n_targets - 1) % priv->n_targets;
+
+    ufo_two_way_queue_consumer_push (queue != NULL ? queue : get_output_queue (priv), buffer);
 }
 
 void
@@ -148,24 +440,50 @@ ufo_group_push_output_buffer (UfoGroup *group,
     priv = group->priv;
     priv->n_received++;
 
+    if (priv->transfer_queue != NULL &&
+        (ufo_buffer_get_location (buffer) == UFO_BUFFER_LOCATION_DEVICE ||
+         ufo_buffer_get_location (buffer) == UFO_BUFFER_LOCATION_DEVICE_IMAGE))
+        ufo_buffer_get_host_array_async (buffer, priv->transfer_queue, 0, NULL, NULL);
+
     /* Copy or not depending on the send pattern */
     if (priv->pattern == UFO_SEND_SCATTER) {
-        ufo_two_way_queue_producer_push (priv->queues[priv->current], buffer);
-        priv->current = (priv->current + 1) % priv->n_targets;
+        UfoTwoWayQueue *queue = g_hash_table_lookup (priv->owners, buffer);
+
+        /* Forwarded buffers were not popped from this group */
+        if (queue == NULL) {
+            queue = priv->queues[priv->current];
+            priv->current = (priv->current + 1) % priv->n_targets;
+        }
+
+        ufo_two_way_queue_producer_push (queue, buffer);
     }
-    else if (priv->pattern == UFO_SEND_BROADCAST) {
+    else if (priv->pattern == UFO_SEND_BROADCAST && priv->shared_queue != NULL) {
         UfoRequisition requisition;
 
         ufo_buffer_get_requisition (buffer, &requisition);
 
-        for (guint pos = 1; pos < priv->n_targets; pos++) {
-            UfoBuffer *copy;
+        g_mutex_lock (&priv->shared_lock);
+        g_hash_table_insert (priv->n_readers, buffer, GUINT_TO_POINTER (priv->n_targets));
+        g_mutex_unlock (&priv->shared_lock);
 
-            copy = pop_or_alloc_buffer (priv, pos, &requisition);
-            ufo_buffer_copy (buffer, copy);
-            ufo_two_way_queue_producer_push (priv->queues[pos], copy);
-        }
+        /*
+         * Every target gets its own buffer that refers to the data of @buffer
+         * and copies it only if the target writes to it.
+         */
+        for (guint pos = 0; pos < priv->n_targets; pos++) {
+            UfoBuffer *view;
 
+            view = pop_or_alloc_buffer (priv, priv->queues[pos], &requisition);
+            ufo_buffer_share (buffer, view);
+
+            g_mutex_lock (&priv->shared_lock);
+            g_hash_table_insert (priv->sources, view, buffer);
+            g_mutex_unlock (&priv->shared_lock);
+
+            ufo_two_way_queue_producer_push (priv->queues[pos], view);
+        }
+    }
+    else if (priv->pattern == UFO_SEND_BROADCAST) {
         ufo_two_way_queue_producer_push (priv->queues[0], buffer);
     }
     else if (priv->pattern == UFO_SEND_SEQUENTIAL) {
@@ -181,6 +499,68 @@ ufo_group_push_output_buffer (UfoGroup *group,
     }
 }
 
+/**
+ * ufo_group_push_forwarded_buffer:
+ * @group: A #UfoGroup
+ * @buffer: An input buffer of the producer of @group
+ * @origin: The #UfoGroup @buffer was popped from
+ * @target: The producer of @group, which is a target in @origin
+ *
+ * Send @buffer that was popped with ufo_group_pop_input_buffer() from @origin
+ * to the targets of @group instead of an output buffer. Once the targets
+ * release @buffer, it is returned to @origin as if the producer had pushed it
+ * back with ufo_group_push_input_buffer().
+ */
+void
+ufo_group_push_forwarded_buffer (UfoGroup *group,
+                                 UfoBuffer *buffer,
+                                 UfoGroup *origin,
+                                 UfoTask *target)
+{
+    UfoGroupPrivate *priv;
+    Origin *entry;
+
+    g_return_if_fail (UFO_IS_GROUP (group) && UFO_IS_GROUP (origin));
+    priv = group->priv;
+
+    entry = g_new0 (Origin, 1);
+    entry->group = origin;
+    entry->target = target;
+
+    /* Must be known before any target can release it */
+    g_mutex_lock (&priv->forwarded_lock);
+    g_hash_table_insert (priv->forwarded, buffer, entry);
+    g_mutex_unlock (&priv->forwarded_lock);
+
+    ufo_group_push_output_buffer (group, buffer);
+}
+
+/*
+ * Hand @buffer back to the group it was forwarded from. Returns FALSE if
+ * @buffer belongs to @priv.
+ */
+static gboolean
+return_forwarded_buffer (UfoGroupPrivate *priv,
+                         UfoBuffer *buffer)
+{
+    Origin *entry;
+
+    g_mutex_lock (&priv->forwarded_lock);
+    entry = g_hash_table_lookup (priv->forwarded, buffer);
+
+    if (entry != NULL)
+        g_hash_table_steal (priv->forwarded, buffer);
+
+    g_mutex_unlock (&priv->forwarded_lock);
+
+    if (entry == NULL)
+        return FALSE;
+
+    ufo_group_push_input_buffer (entry->group, entry->target, buffer);
+    g_free (entry);
+    return TRUE;
+}
+
 void
 ufo_group_set_num_expected (UfoGroup *group,
                             UfoTask *target,
@@ -218,19 +598,93 @@ ufo_group_pop_input_buffer (UfoGroup *group,
     return input;
 }
 
+/*
+ * Return the broadcast buffer that must be given back to the producer because
+ * the last target that shares its data has released its buffer.
+ */
+static UfoBuffer *
+release_shared_buffer (UfoGroupPrivate *priv,
+                       UfoBuffer *view)
+{
+    UfoBuffer *source;
+    guint n_readers;
+
+    ufo_buffer_unshare (view);
+
+    g_mutex_lock (&priv->shared_lock);
+    source = g_hash_table_lookup (priv->sources, view);
+
+    if (source == NULL) {
+        g_mutex_unlock (&priv->shared_lock);
+        return NULL;
+    }
+
+    g_hash_table_remove (priv->sources, view);
+    n_readers = GPOINTER_TO_UINT (g_hash_table_lookup (priv->n_readers, source)) - 1;
+
+    if (n_readers > 0)
+        g_hash_table_insert (priv->n_readers, source, GUINT_TO_POINTER (n_readers));
+    else
+        g_hash_table_remove (priv->n_readers, source);
+
+    g_mutex_unlock (&priv->shared_lock);
+
+    return n_readers == 0 ? source : NULL;
+}
+
+/**
+ * ufo_group_try_pop_input_buffer:
+ * @group: A #UfoGroup
+ * @target: The #UfoTask that is a target in @group
+ *
+ * Like ufo_group_pop_input_buffer() but return %NULL instead of waiting if no
+ * data is available yet.
+ *
+ * Return value: (transfer full) (allow-none): A buffer that must be released
+ * with ufo_group_push_input_buffer(), %UFO_END_OF_STREAM or %NULL.
+ */
+UfoBuffer *
+ufo_group_try_pop_input_buffer (UfoGroup *group,
+                                UfoTask *target)
+{
+    UfoGroupPrivate *priv;
+    gint pos;
+
+    priv = group->priv;
+    pos = g_list_index (priv->targets, target);
+
+    return pos >= 0 ? ufo_two_way_queue_consumer_try_pop (priv->queues[pos]) : NULL;
+}
+
 void
 ufo_group_push_input_buffer (UfoGroup *group,
                              UfoTask *target,
                              UfoBuffer *input)
 {
     UfoGroupPrivate *priv;
+    UfoBuffer *source = NULL;
     gint pos;
 
     priv = group->priv;
     pos = g_list_index (priv->targets, target);
 
-    if (pos >= 0)
-        ufo_two_way_queue_consumer_push (priv->queues[pos], input);
+    if (pos < 0)
+        return;
+
+    if (priv->shared_queue == NULL && return_forwarded_buffer (priv, input))
+        return;
+
+    if (priv->shared_queue != NULL)
+        source = release_shared_buffer (priv, input);
+
+    ufo_two_way_queue_consumer_push (priv->queues[pos], input);
+
+    /*
+     * Return the source only after the view, so that a producer that got the
+     * source back always finds a free view for every target.
+     */
+    if (source != NULL && !return_forwarded_buffer (priv, source))
+        ufo_two_way_queue_consumer_push (priv->shared_queue, source);
 }
 
 void
@@ -244,6 +698,47 @@ ufo_group_finish (UfoGroup *group)
         ufo_two_way_queue_producer_push (priv->queues[i], UFO_END_OF_STREAM);
 }
 
+/**
+ * ufo_group_reset:
+ * @group: A #UfoGroup
+ *
+ * Return all buffers of @group to the producer and forget buffers and
+ * end-of-stream markers in flight, so that @group can pass another stream with
+ * the buffers it allocated before. Neither producer nor targets may use @group
+ * meanwhile.
+ */
+void
+ufo_group_reset (UfoGroup *group)
+{
+    UfoGroupPrivate *priv;
+
+    g_return_if_fail (UFO_IS_GROUP (group));
+    priv = group->priv;
+
+    for (guint i = 0; i < priv->n_targets; i++)
+        ufo_two_way_queue_reset (priv->queues[i]);
+
+    if (priv->shared_queue != NULL) {
+        GHashTableIter iter;
+        gpointer view;
+
+        g_hash_table_iter_init (&iter, priv->sources);
+
+        while (g_hash_table_iter_next (&iter, &view, NULL))
+            ufo_buffer_unshare (UFO_BUFFER (view));
+
+        g_hash_table_remove_all (priv->sources);
+        g_hash_table_remove_all (priv->n_readers);
+        ufo_two_way_queue_reset (priv->shared_queue);
+    }
+
+    /* Their origins are reset as well */
+    g_hash_table_remove_all (priv->forwarded);
+
+    priv->current = 0;
+    priv->n_received = 0;
+}
+
 static void
 ufo_group_dispose(GObject *object)
 {
@@ -275,6 +770,17 @@ ufo_group_finalize (GObject *object)
     g_free (priv->queues);
     priv->queues = NULL;
 
+    if (priv->shared_queue != NULL) {
+        ufo_two_way_queue_free (priv->shared_queue);
+        g_hash_table_destroy (priv->sources);
+        g_hash_table_destroy (priv->n_readers);
+    }
+
+    g_hash_table_destroy (priv->forwarded);
+    g_hash_table_destroy (priv->owners);
+    g_mutex_clear (&priv->shared_lock);
+    g_mutex_clear (&priv->forwarded_lock);
+
     G_OBJECT_CLASS (ufo_group_parent_class)->finalize (object);
 }
 
@@ -295,4 +801,13 @@ ufo_group_init (UfoGroup *self)
     UfoGroupPrivate *priv;
     self->priv = priv = UFO_GROUP_GET_PRIVATE (self);
     priv->buffers = NULL;
+    priv->transfer_queue = NULL;
+    priv->batch_size = 1;
+    priv->shared_queue = NULL;
+    priv->sources = NULL;
+    priv->n_readers = NULL;
+    priv->forwarded = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+    priv->owners = g_hash_table_new (g_direct_hash, g_direct_equal);
+    g_mutex_init (&priv->shared_lock);
+    g_mutex_init (&priv->forwarded_lock);
 }
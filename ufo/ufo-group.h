@@ -26,6 +26,8 @@
 
 #include <ufo/ufo-task-iface.h>
 #include <ufo/ufo-buffer.h>
+#include <ufo/ufo-buffer-pool.h>
+#include <ufo/ufo-two-way-queue.h>
 
 G_BEGIN_DECLS
 
@@ -83,16 +85,41 @@ struct _UfoGroupClass {
 UfoGroup  * ufo_group_new                   (GList          *targets,
                                              gpointer        context,
                                              UfoSendPattern  pattern);
+UfoGroup  * ufo_group_new_full              (GList          *targets,
+                                             gpointer        context,
+                                             UfoSendPattern  pattern,
+                                             UfoTwoWayQueueBackend backend);
 guint       ufo_group_get_num_targets       (UfoGroup       *group);
+void        ufo_group_set_memory_mode       (UfoGroup       *group,
+                                             UfoBufferMemoryMode mode);
+void        ufo_group_set_buffer_pool       (UfoGroup       *group,
+                                             UfoBufferPool  *pool);
+void        ufo_group_set_transfer_queue    (UfoGroup       *group,
+                                             gpointer        queue);
+void        ufo_group_set_batch_size        (UfoGroup       *group,
+                                             guint           batch_size);
+void        ufo_group_reset                 (UfoGroup       *group);
 void        ufo_group_set_num_expected      (UfoGroup       *group,
                                              UfoTask        *target,
                                              gint            n_expected);
+void        ufo_group_preallocate           (UfoGroup       *group,
+                                             UfoRequisition *requisition);
 UfoBuffer * ufo_group_pop_output_buffer     (UfoGroup       *group,
                                              UfoRequisition *requisition);
+UfoBuffer * ufo_group_try_pop_output_buffer (UfoGroup       *group,
+                                             UfoRequisition *requisition);
 void        ufo_group_push_output_buffer    (UfoGroup       *group,
                                              UfoBuffer      *buffer);
+void        ufo_group_return_output_buffer  (UfoGroup       *group,
+                                             UfoBuffer      *buffer);
+void        ufo_group_push_forwarded_buffer (UfoGroup       *group,
+                                             UfoBuffer      *buffer,
+                                             UfoGroup       *origin,
+                                             UfoTask        *target);
 UfoBuffer * ufo_group_pop_input_buffer      (UfoGroup       *group,
                                              UfoTask        *target);
+UfoBuffer * ufo_group_try_pop_input_buffer  (UfoGroup       *group,
+                                             UfoTask        *target);
 void        ufo_group_push_input_buffer     (UfoGroup       *group,
                                              UfoTask        *target,
                                              UfoBuffer      *input);
@@ -134,6 +134,12 @@ ufo_input_task_setup (UfoTask *task,
 {
 }
 
+static void
+ufo_input_task_reset (UfoTask *task)
+{
+    UFO_INPUT_TASK_GET_PRIVATE (task)->input = NULL;
+}
+
 static guint
 ufo_input_task_get_num_inputs (UfoTask *task)
 {
@@ -211,6 +217,7 @@ static void
 ufo_task_interface_init (UfoTaskIface *iface)
 {
     iface->setup = ufo_input_task_setup;
+    iface->reset = ufo_input_task_reset;
     iface->get_num_inputs = ufo_input_task_get_num_inputs;
     iface->get_num_dimensions = ufo_input_task_get_num_dimensions;
     iface->get_mode = ufo_input_task_get_mode;
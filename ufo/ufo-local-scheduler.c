@@ -63,6 +63,7 @@ typedef struct {
 
 typedef struct {
     gpointer context;
+    UfoBufferMemoryMode memory_mode;
     ProcessorPool *pp;
     UfoTask *task;
     UfoTwoWayQueue **inputs;
@@ -196,7 +197,7 @@ run_local (TaskLocal *local)
             if (ufo_two_way_queue_get_capacity (local->output) < 2) {
                 UfoBuffer *buffer;
 
-                buffer = ufo_buffer_new (&requisition, local->context);
+                buffer = ufo_buffer_new_full (&requisition, local->context, ufo_buffer_pool_get_default (), local->memory_mode);
                 ufo_two_way_queue_insert (local->output, buffer);
             }
 
@@ -265,6 +266,7 @@ static GHashTable *
 setup_tasks (UfoGraph *graph,
              UfoResources *resources,
              ProcessorPool *pp,
+             UfoTwoWayQueueBackend backend,
              GError **error)
 {
     GHashTable *local;
@@ -292,6 +294,7 @@ setup_tasks (UfoGraph *graph,
         data->pp = pp;
         data->n_inputs = ufo_task_get_num_inputs (task);
         data->context = ufo_resources_get_context (resources);
+        g_object_get (resources, "buffer-memory-mode", &data->memory_mode, NULL);
 
         g_hash_table_insert (local, node, data);
         successors = ufo_graph_get_successors (graph, UFO_NODE (task));
@@ -306,13 +309,13 @@ setup_tasks (UfoGraph *graph,
             succ = UFO_NODE (g_list_nth_data (successors, 0));
             succ_data = g_hash_table_lookup (local, succ);
 
-            port = GPOINTER_TO_INT (ufo_graph_get_edge_label (graph, node, succ));
+            port = UFO_EDGE_LABEL_INPUT (ufo_graph_get_edge_label (graph, node, succ));
 
             if (succ_data != NULL) {
                 data->output = succ_data->inputs[port];
             }
             else {
-                data->output = ufo_two_way_queue_new (NULL);
+                data->output = ufo_two_way_queue_new_full (NULL, backend, 2);
             }
         }
 
@@ -328,13 +331,13 @@ setup_tasks (UfoGraph *graph,
 
                 pred = UFO_NODE (jt->data);
                 pred_data = g_hash_table_lookup (local, pred);
-                port = GPOINTER_TO_INT (ufo_graph_get_edge_label (graph, pred, node));
+                port = UFO_EDGE_LABEL_INPUT (ufo_graph_get_edge_label (graph, pred, node));
 
                 if (pred_data != NULL) {
                     data->inputs[port] = pred_data->output;
                 }
                 else {
-                    data->inputs[port] = ufo_two_way_queue_new (NULL);
+                    data->inputs[port] = ufo_two_way_queue_new_full (NULL, backend, 2);
                 }
             }
         }
@@ -361,6 +364,7 @@ ufo_local_scheduler_run (UfoBaseScheduler *scheduler,
     GList *threads;
     GList *it;
     GList *gpu_nodes;
+    UfoTwoWayQueueBackend backend;
 
     g_return_if_fail (UFO_IS_LOCAL_SCHEDULER (scheduler));
 
@@ -373,7 +377,8 @@ ufo_local_scheduler_run (UfoBaseScheduler *scheduler,
     pp = ufo_pp_new (gpu_nodes);
     g_list_free (gpu_nodes);
 
-    task_data = setup_tasks (UFO_GRAPH (task_graph), resources, pp, error);
+    g_object_get (scheduler, "queue-backend", &backend, NULL);
+    task_data = setup_tasks (UFO_GRAPH (task_graph), resources, pp, backend, error);
     local_data = g_hash_table_get_values (task_data);
 
     threads = NULL;
@@ -152,6 +152,11 @@ ufo_output_task_setup (UfoTask *task,
 {
 }
 
+static void
+ufo_output_task_reset (UfoTask *task)
+{
+}
+
 static void
 ufo_output_task_get_requisition (UfoTask *task,
                                  UfoBuffer **inputs,
@@ -206,6 +211,7 @@ ufo_output_task_process (UfoTask *task,
     }
 
     ufo_buffer_copy (outputs[0], copy);
+    ufo_buffer_set_sequence (copy, ufo_buffer_get_sequence (outputs[0]));
     g_async_queue_push (priv->out_queue, copy);
     return TRUE;
 }
@@ -276,6 +282,7 @@ static void
 ufo_task_interface_init (UfoTaskIface *iface)
 {
     iface->setup = ufo_output_task_setup;
+    iface->reset = ufo_output_task_reset;
     iface->get_num_inputs = ufo_output_task_get_num_inputs;
     iface->get_num_dimensions = ufo_output_task_get_num_dimensions;
     iface->get_mode = ufo_output_task_get_mode;
@@ -3,7 +3,12 @@
 #include <stdio.h>
 
 #include "ufo-priv.h"
+#include "ufo-basic-ops.h"
+#include "ufo-buffer-pool.h"
+#include "ufo-cpu-node.h"
+#include "ufo-group.h"
 #include "ufo-profiler.h"
+#include "ufo-resources.h"
 #include "ufo-task-node.h"
 
 
@@ -186,3 +191,281 @@ ufo_escape_device_name (gchar *name)
 
     return name;
 }
+
+/*
+ * Fuse and expand @graph on the first run and distribute its nodes across
+ * @gpu_nodes and the CPU nodes of @scheduler.
+ */
+gboolean
+ufo_setup_task_graph (UfoBaseScheduler *scheduler,
+                      UfoTaskGraph *graph,
+                      UfoResources *resources,
+                      GList *gpu_nodes,
+                      gboolean first_run,
+                      GError **error)
+{
+    GList *nodes;
+    GList *cpu_nodes;
+    GList *it;
+    GError *tmp_error = NULL;
+    gboolean expand;
+    gboolean fuse;
+    guint idx;
+    guint total;
+
+    g_object_get (scheduler, "expand", &expand, "fuse", &fuse, NULL);
+
+    if (fuse && first_run)
+        ufo_task_graph_fuse (graph);
+
+    if (expand) {
+        if (first_run) {
+            ufo_task_graph_expand (graph, resources, g_list_length (gpu_nodes), &tmp_error);
+
+            if (tmp_error != NULL) {
+                g_propagate_error (error, tmp_error);
+                return FALSE;
+            }
+        }
+        else {
+            g_debug ("Task graph already expanded, skipping.");
+        }
+    }
+
+    ufo_task_graph_get_partition (graph, &idx, &total);
+    nodes = ufo_graph_get_nodes (UFO_GRAPH (graph));
+
+    g_list_for (nodes, it) {
+        ufo_task_node_set_partition (UFO_TASK_NODE (it->data), idx, total);
+    }
+
+    g_list_free (nodes);
+    ufo_task_graph_map (graph, gpu_nodes);
+
+    cpu_nodes = ufo_base_scheduler_get_cpu_nodes (scheduler);
+    ufo_task_graph_map_cpus (graph, cpu_nodes);
+    g_list_free (cpu_nodes);
+
+    return TRUE;
+}
+
+gboolean
+ufo_check_target_connections (UfoTaskGraph *graph,
+                              UfoNode *target,
+                              guint n_inputs,
+                              GError **error)
+{
+    GList *predecessors;
+    GList *it;
+    gboolean connected[UFO_MAX_INPUT_NODES] = { FALSE, };
+    gboolean result = TRUE;
+
+    if (n_inputs == 0)
+        return TRUE;
+
+    if (n_inputs > UFO_MAX_INPUT_NODES) {
+        g_set_error (error, UFO_BASE_SCHEDULER_ERROR, UFO_BASE_SCHEDULER_ERROR_SETUP,
+                     "Number of inputs exceeds %i (UFO_MAX_INPUT_NODES). This value can be defined in the build settings.",
+                     UFO_MAX_INPUT_NODES);
+        return FALSE;
+    }
+
+    predecessors = ufo_graph_get_predecessors (UFO_GRAPH (graph), target);
+
+    g_list_for (predecessors, it) {
+        guint input;
+
+        input = UFO_EDGE_LABEL_INPUT (ufo_graph_get_edge_label (UFO_GRAPH (graph), UFO_NODE (it->data), target));
+        g_assert (input < UFO_MAX_INPUT_NODES);
+        connected[input] = TRUE;
+    }
+
+    for (guint i = 0; i < n_inputs; i++) {
+        if (!connected[i]) {
+            g_set_error (error, UFO_BASE_SCHEDULER_ERROR, UFO_BASE_SCHEDULER_ERROR_SETUP,
+                         "Not all inputs of `%s' are connected",
+                         ufo_task_node_get_plugin_name (UFO_TASK_NODE (target)));
+            result = FALSE;
+            break;
+        }
+    }
+
+    g_list_free (predecessors);
+    return result;
+}
+
+/*
+ * Check that generators and reductors have successors and that only
+ * processors use more than one output port.
+ */
+gboolean
+ufo_check_connections (UfoTaskGraph *graph,
+                       GError **error)
+{
+    GList *nodes;
+    GList *it;
+    gboolean result = TRUE;
+
+    nodes = ufo_graph_get_nodes (UFO_GRAPH (graph));
+
+    g_list_for (nodes, it) {
+        UfoTaskNode *node;
+        UfoTaskMode mode;
+        UfoGroup *group;
+        GList *successors;
+        GList *jt;
+        guint n_outputs;
+
+        node = UFO_TASK_NODE (it->data);
+        mode = ufo_task_get_mode (UFO_TASK (node)) & UFO_TASK_MODE_TYPE_MASK;
+        group = ufo_task_node_get_out_group (node);
+        n_outputs = ufo_task_get_num_outputs (UFO_TASK (node));
+
+        if (((mode == UFO_TASK_MODE_GENERATOR) || (mode == UFO_TASK_MODE_REDUCTOR)) &&
+            ufo_group_get_num_targets (group) < 1) {
+            g_set_error (error, UFO_BASE_SCHEDULER_ERROR, UFO_BASE_SCHEDULER_ERROR_SETUP,
+                         "No outgoing node for `%s'",
+                         ufo_task_node_get_identifier (node));
+            result = FALSE;
+            break;
+        }
+
+        if (n_outputs > 1 && mode != UFO_TASK_MODE_PROCESSOR) {
+            g_set_error (error, UFO_BASE_SCHEDULER_ERROR, UFO_BASE_SCHEDULER_ERROR_SETUP,
+                         "`%s' has %i outputs but only processors can have more than one",
+                         ufo_task_node_get_identifier (node), n_outputs);
+            result = FALSE;
+            break;
+        }
+
+        successors = ufo_graph_get_successors (UFO_GRAPH (graph), UFO_NODE (node));
+
+        g_list_for (successors, jt) {
+            gpointer label = ufo_graph_get_edge_label (UFO_GRAPH (graph), UFO_NODE (node), UFO_NODE (jt->data));
+
+            if (UFO_EDGE_LABEL_OUTPUT (label) >= n_outputs) {
+                g_set_error (error, UFO_BASE_SCHEDULER_ERROR, UFO_BASE_SCHEDULER_ERROR_SETUP,
+                             "`%s' has no output %i",
+                             ufo_task_node_get_identifier (node), UFO_EDGE_LABEL_OUTPUT (label));
+                result = FALSE;
+                break;
+            }
+        }
+
+        g_list_free (successors);
+
+        if (!result)
+            break;
+    }
+
+    g_list_free (nodes);
+    return result;
+}
+
+/*
+ * Create one group per output port of every node in @graph with the
+ * successors at that port and register it as input group of the successors.
+ * Groups of tasks that support batches hand out @batch_size buffers at once.
+ */
+GList *
+ufo_setup_groups (UfoTaskGraph *graph,
+                  UfoResources *resources,
+                  UfoTwoWayQueueBackend backend,
+                  guint batch_size)
+{
+    GList *groups = NULL;
+    GList *nodes;
+    GList *it;
+    UfoBufferMemoryMode memory_mode;
+
+    nodes = ufo_graph_get_nodes (UFO_GRAPH (graph));
+    g_object_get (resources, "buffer-memory-mode", &memory_mode, NULL);
+
+    g_list_for (nodes, it) {
+        GList *successors;
+        UfoNode *node;
+        UfoNode *cpu_node;
+        UfoSendPattern pattern;
+        guint n_outputs;
+
+        node = UFO_NODE (it->data);
+        successors = ufo_graph_get_successors (UFO_GRAPH (graph), node);
+        pattern = ufo_task_node_get_send_pattern (UFO_TASK_NODE (node));
+        cpu_node = ufo_task_node_get_cpu_node (UFO_TASK_NODE (node));
+        n_outputs = ufo_task_get_num_outputs (UFO_TASK (node));
+
+        /* Every output port gets its own group with the successors at that port */
+        for (guint output = 0; output < n_outputs; output++) {
+            GList *targets = NULL;
+            GList *jt;
+            UfoGroup *group;
+
+            g_list_for (successors, jt) {
+                gpointer label = ufo_graph_get_edge_label (UFO_GRAPH (graph), node, UFO_NODE (jt->data));
+
+                if (UFO_EDGE_LABEL_OUTPUT (label) == output)
+                    targets = g_list_append (targets, jt->data);
+            }
+
+            group = ufo_group_new_full (targets, ufo_resources_get_context (resources), pattern, backend);
+            ufo_group_set_memory_mode (group, memory_mode);
+            ufo_group_set_transfer_queue (group, ufo_task_node_get_transfer_queue (UFO_TASK_NODE (node)));
+
+            if (batch_size > 1 && ufo_task_supports_batches (UFO_TASK (node)))
+                ufo_group_set_batch_size (group, batch_size);
+
+            /* Recycle output memory only on the NUMA node of the producer */
+            if (cpu_node != NULL) {
+                guint numa_node = ufo_cpu_node_get_numa_node (UFO_CPU_NODE (cpu_node));
+                ufo_group_set_buffer_pool (group, ufo_buffer_pool_get_for_numa_node (numa_node));
+            }
+
+            groups = g_list_append (groups, group);
+            ufo_task_node_set_output_group (UFO_TASK_NODE (node), output, group);
+
+            g_list_for (targets, jt) {
+                UfoNode *target;
+                guint input;
+
+                target = UFO_NODE (jt->data);
+                input = UFO_EDGE_LABEL_INPUT (ufo_graph_get_edge_label (UFO_GRAPH (graph), node, target));
+                ufo_task_node_add_in_group (UFO_TASK_NODE (target), input, group);
+                ufo_group_set_num_expected (group, UFO_TASK (target),
+                                            ufo_task_node_get_num_expected (UFO_TASK_NODE (target), input));
+            }
+
+            g_list_free (targets);
+        }
+
+        g_list_free (successors);
+    }
+
+    g_list_free (nodes);
+    return groups;
+}
+
+/*
+ * Raw integer inputs consumed by GPU tasks are uploaded in their compact form
+ * and widened on the device instead of on the host.
+ */
+void
+ufo_convert_input_on_device (UfoTask *task,
+                             UfoResources *resources,
+                             UfoBuffer *input)
+{
+    gpointer cmd_queue;
+
+    if (ufo_buffer_get_depth (input) == UFO_BUFFER_DEPTH_32F || !ufo_task_uses_gpu (task))
+        return;
+
+    cmd_queue = ufo_task_node_get_cmd_queue (UFO_TASK_NODE (task));
+
+    if (cmd_queue != NULL) {
+        UfoProfiler *profiler = ufo_task_node_get_profiler (UFO_TASK_NODE (task));
+
+        /* Count the upload of the raw data for @task */
+        ufo_profiler_start (profiler, UFO_PROFILER_TIMER_IO);
+        ufo_op_convert_depth (input, resources, cmd_queue);
+        ufo_profiler_stop (profiler, UFO_PROFILER_TIMER_IO);
+    }
+}
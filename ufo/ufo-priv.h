@@ -21,11 +21,50 @@
 #define UFO_PRIV_H
 
 #include <glib.h>
+#include <ufo/ufo-base-scheduler.h>
+#include <ufo/ufo-buffer.h>
+#include <ufo/ufo-resources.h>
+#include <ufo/ufo-two-way-queue.h>
 
 void    ufo_write_profile_events    (GList *nodes);
 void    ufo_write_opencl_events     (GList *nodes);
 gchar * ufo_escape_device_name      (gchar *name);
 
+gpointer ufo_resources_get_thread_mem   (UfoResources           *resources,
+                                         const gchar            *name,
+                                         gsize                   size);
+void     ufo_purge_buffer_pools         (gpointer                context);
+
+/* Setup shared by the schedulers */
+gboolean ufo_setup_task_graph           (UfoBaseScheduler       *scheduler,
+                                         UfoTaskGraph           *graph,
+                                         UfoResources           *resources,
+                                         GList                  *gpu_nodes,
+                                         gboolean                first_run,
+                                         GError                **error);
+gboolean ufo_check_target_connections   (UfoTaskGraph           *graph,
+                                         UfoNode                *target,
+                                         guint                   n_inputs,
+                                         GError                **error);
+gboolean ufo_check_connections          (UfoTaskGraph           *graph,
+                                         GError                **error);
+GList   *ufo_setup_groups               (UfoTaskGraph           *graph,
+                                         UfoResources           *resources,
+                                         UfoTwoWayQueueBackend   backend,
+                                         guint                   batch_size);
+void     ufo_convert_input_on_device    (UfoTask                *task,
+                                         UfoResources           *resources,
+                                         UfoBuffer              *input);
+
+
+/*
+ * Edge labels of a task graph hold the output port of the source in the upper
+ * and the input port of the target in the lower 16 bits. Edges from the first
+ * output thus carry the plain input port.
+ */
+#define UFO_EDGE_LABEL(output, input)   (GUINT_TO_POINTER (((output) << 16) | (input)))
+#define UFO_EDGE_LABEL_OUTPUT(label)    (GPOINTER_TO_UINT (label) >> 16)
+#define UFO_EDGE_LABEL_INPUT(label)     (GPOINTER_TO_UINT (label) & 0xFFFF)
 
 /* g_list_for() never existed, but it's nice to have anyway. */
 #define g_list_for(list, it) \
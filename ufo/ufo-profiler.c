@@ -60,6 +60,9 @@ struct _UfoProfilerPrivate {
     GTimer **timers;
     GList   *trace_events;
     gboolean trace;
+    GMutex   transfer_lock;
+    guint64  transfer_counts[UFO_PROFILER_TRANSFER_LAST];
+    guint64  transfer_bytes[UFO_PROFILER_TRANSFER_LAST];
 };
 
 enum {
@@ -69,6 +72,9 @@ enum {
 
 static GTimer *global_clock = NULL;
 
+/* Buffers are not associated with a task node, so transfers are counted by the
+ * profiler whose timer runs on the calling thread. */
+static GPrivate active_profiler;
 
 /**
  * UfoProfilerTimer:
@@ -85,6 +91,16 @@ static GTimer *global_clock = NULL;
  * ufo_profiler_start(), ufo_profiler_stop() and ufo_profiler_elapsed().
  */
 
+/**
+ * UfoProfilerTransfer:
+ * @UFO_PROFILER_TRANSFER_COPY: Data copied between host and device memory
+ * @UFO_PROFILER_TRANSFER_MAP: Device memory mapped to or unmapped from the
+ *  host without an explicit copy
+ * @UFO_PROFILER_TRANSFER_LAST: Auxiliary value, do not use.
+ *
+ * Kinds of host/device transfers counted with ufo_profiler_record_transfer().
+ */
+
 /**
  * ufo_profiler_new:
  *
@@ -229,7 +245,8 @@ ufo_profiler_register_event (UfoProfiler *profiler,
  * @timer: Which timer to start
  *
  * Start @timer. The timer is not reset but accumulates the time elapsed between
- * ufo_profiler_start() and ufo_profiler_stop() calls.
+ * ufo_profiler_start() and ufo_profiler_stop() calls. Until the timer is
+ * stopped, transfers made by the calling thread are counted by @profiler.
  */
 void
 ufo_profiler_start (UfoProfiler      *profiler,
@@ -237,6 +254,7 @@ ufo_profiler_start (UfoProfiler      *profiler,
 {
     g_return_if_fail (UFO_IS_PROFILER (profiler));
     g_timer_continue (profiler->priv->timers[timer]);
+    g_private_set (&active_profiler, profiler);
 }
 
 /**
@@ -253,6 +271,9 @@ ufo_profiler_stop (UfoProfiler       *profiler,
 {
     g_return_if_fail (UFO_IS_PROFILER (profiler));
     g_timer_stop (profiler->priv->timers[timer]);
+
+    if (g_private_get (&active_profiler) == profiler)
+        g_private_set (&active_profiler, NULL);
 }
 
 /**
@@ -281,6 +302,67 @@ ufo_profiler_trace_event (UfoProfiler *profiler,
     profiler->priv->trace_events = g_list_append (profiler->priv->trace_events, event);
 }
 
+/**
+ * ufo_profiler_record_transfer:
+ * @transfer: Kind of transfer
+ * @n_bytes: Number of bytes made accessible by the transfer
+ *
+ * Count a host/device transfer. This is called by #UfoBuffer and counted by the
+ * profiler that has a running timer on the calling thread. Transfers outside
+ * of any timer are not counted.
+ */
+void
+ufo_profiler_record_transfer (UfoProfilerTransfer transfer,
+                              gsize n_bytes)
+{
+    UfoProfiler *profiler;
+    UfoProfilerPrivate *priv;
+
+    g_return_if_fail (transfer < UFO_PROFILER_TRANSFER_LAST);
+
+    profiler = g_private_get (&active_profiler);
+
+    if (profiler == NULL)
+        return;
+
+    priv = profiler->priv;
+    g_mutex_lock (&priv->transfer_lock);
+    priv->transfer_counts[transfer]++;
+    priv->transfer_bytes[transfer] += n_bytes;
+    g_mutex_unlock (&priv->transfer_lock);
+}
+
+/**
+ * ufo_profiler_get_transfers:
+ * @profiler: A #UfoProfiler object
+ * @transfer: Kind of transfer
+ * @n_transfers: (out) (allow-none): Location for the number of transfers
+ * @n_bytes: (out) (allow-none): Location for the number of transferred bytes
+ *
+ * Get the number of transfers of kind @transfer counted by @profiler so far.
+ */
+void
+ufo_profiler_get_transfers (UfoProfiler *profiler,
+                            UfoProfilerTransfer transfer,
+                            guint64 *n_transfers,
+                            guint64 *n_bytes)
+{
+    UfoProfilerPrivate *priv;
+
+    g_return_if_fail (UFO_IS_PROFILER (profiler) && transfer < UFO_PROFILER_TRANSFER_LAST);
+
+    priv = profiler->priv;
+    g_mutex_lock (&priv->transfer_lock);
+
+    if (n_transfers != NULL)
+        *n_transfers = priv->transfer_counts[transfer];
+
+    if (n_bytes != NULL)
+        *n_bytes = priv->transfer_bytes[transfer];
+
+    g_mutex_unlock (&priv->transfer_lock);
+}
+
 /**
  * ufo_profiler_enable_tracing:
  * @profiler: A #UfoProfiler object
@@ -431,6 +513,9 @@ ufo_profiler_foreach (UfoProfiler    *profiler,
 static void
 ufo_profiler_dispose (GObject *object)
 {
+    if (g_private_get (&active_profiler) == object)
+        g_private_set (&active_profiler, NULL);
+
     G_OBJECT_CLASS (ufo_profiler_parent_class)->dispose (object);
 }
 
@@ -457,6 +542,7 @@ ufo_profiler_finalize (GObject *object)
         g_timer_destroy (priv->timers[i]);
 
     g_free (priv->timers);
+    g_mutex_clear (&priv->transfer_lock);
 }
 
 static void
@@ -481,6 +567,12 @@ ufo_profiler_init (UfoProfiler *manager)
     priv->event_array = g_array_sized_new (FALSE, TRUE, sizeof(struct EventRow), 2048);
     priv->trace_events = NULL;
     priv->trace = FALSE;
+    g_mutex_init (&priv->transfer_lock);
+
+    for (guint i = 0; i < UFO_PROFILER_TRANSFER_LAST; i++) {
+        priv->transfer_counts[i] = 0;
+        priv->transfer_bytes[i] = 0;
+    }
 
     /* Setup timers for all events */
     priv->timers = g_new0 (GTimer *, UFO_PROFILER_TIMER_LAST);
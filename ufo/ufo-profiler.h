@@ -120,6 +120,12 @@ typedef enum {
     UFO_PROFILER_TIMER_LAST
 } UfoProfilerTimer;
 
+typedef enum {
+    UFO_PROFILER_TRANSFER_COPY = 0,
+    UFO_PROFILER_TRANSFER_MAP,
+    UFO_PROFILER_TRANSFER_LAST
+} UfoProfilerTransfer;
+
 UfoProfiler *ufo_profiler_new           (void);
 gint         ufo_profiler_call          (UfoProfiler        *profiler,
                                          gpointer            command_queue,
@@ -154,6 +160,13 @@ GList       *ufo_profiler_get_trace_events
                                         (UfoProfiler        *profiler);
 gdouble      ufo_profiler_elapsed       (UfoProfiler        *profiler,
                                          UfoProfilerTimer    timer);
+void         ufo_profiler_record_transfer
+                                        (UfoProfilerTransfer transfer,
+                                         gsize               n_bytes);
+void         ufo_profiler_get_transfers (UfoProfiler        *profiler,
+                                         UfoProfilerTransfer transfer,
+                                         guint64            *n_transfers,
+                                         guint64            *n_bytes);
 GType        ufo_profiler_get_type      (void);
 
 G_END_DECLS
@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <stdio.h>
 #include <string.h>
@@ -31,6 +32,7 @@
 #endif
 
 #include "ufo-resources.h"
+#include "ufo-buffer-pool.h"
 #include "ufo-gpu-node.h"
 #include "ufo-enums.h"
 #include "ufo-priv.h"
@@ -44,6 +46,12 @@
  * from disk or directly as a string. By default the kernel search path is in
  * `$datadir/ufo` but can be extended by the `UFO_KERNEL_PATH` environment
  * variable.
+ *
+ * Built program binaries are cached in `$XDG_CACHE_HOME/ufo/programs` or the
+ * directory set with the `UFO_PROGRAM_CACHE` environment variable and loaded
+ * from there as long as source, included files, build options, device and
+ * driver match.
+ * Kernels can be requested from several threads at the same time.
  */
 
 static void ufo_resources_initable_iface_init (GInitableIface *iface);
@@ -77,6 +85,7 @@ struct _UfoResourcesPrivate {
 
     UfoDeviceType    device_type;
     gint             platform_index;
+    UfoBufferMemoryMode memory_mode;
 
     cl_platform_id   platform;
     cl_context       context;
@@ -90,13 +99,29 @@ struct _UfoResourcesPrivate {
     GHashTable  *kernel_cache;
     GHashTable  *programs;      /* Maps source to program */
     GList       *kernels;
+    GList       *thread_mems;   /* Scratch buffers of ufo_resources_get_thread_mem() */
     GString     *build_opts;
+    gchar       *cache_dir;     /* Directory of cached program binaries or NULL */
+    GMutex       lock;          /* Protects programs, kernels, thread_mems, kernel_cache and variants */
+
+    GHashTable  *variants;      /* Maps file and defines to link in variant_lru */
+    GQueue      *variant_lru;   /* Specialized programs, most recently used first */
+    GHashTable  *n_evictions;   /* Maps file name to number of evicted variants */
+    guint        max_variants;
 };
 
+typedef struct {
+    gchar       *key;
+    gchar       *filename;
+    cl_program   program;
+} Variant;
+
 enum {
     PROP_0,
     PROP_PLATFORM_INDEX,
     PROP_DEVICE_TYPE,
+    PROP_BUFFER_MEMORY_MODE,
+    PROP_MAX_KERNEL_VARIANTS,
     N_PROPERTIES
 };
 
@@ -221,6 +246,150 @@ release_kernel (cl_kernel kernel)
     UFO_RESOURCES_CHECK_CLERR (clReleaseKernel (kernel));
 }
 
+static void
+release_mem (cl_mem mem)
+{
+    g_debug ("FREE mem=%p", (gpointer) mem);
+    UFO_RESOURCES_CHECK_CLERR (clReleaseMemObject (mem));
+}
+
+/*
+ * Kernels and scratch buffers handed out by ufo_resources_get_thread_kernel()
+ * and ufo_resources_get_thread_mem() are tracked per thread and released when
+ * the thread exits or their resources are gone.
+ */
+typedef struct {
+    gpointer     owner;         /* Only compared, use resources to access */
+    GWeakRef     resources;
+    gchar       *key;
+    cl_kernel    kernel;
+    cl_mem       mem;
+    gsize        size;
+} ThreadObject;
+
+static void
+release_thread_object (UfoResourcesPrivate *priv,
+                       ThreadObject *entry)
+{
+    if (entry->kernel != NULL) {
+        g_mutex_lock (&priv->lock);
+        priv->kernels = g_list_remove (priv->kernels, entry->kernel);
+        g_mutex_unlock (&priv->lock);
+        release_kernel (entry->kernel);
+    }
+
+    if (entry->mem != NULL) {
+        g_mutex_lock (&priv->lock);
+        priv->thread_mems = g_list_remove (priv->thread_mems, entry->mem);
+        g_mutex_unlock (&priv->lock);
+        release_mem (entry->mem);
+    }
+}
+
+static void
+free_thread_object (ThreadObject *entry)
+{
+    UfoResources *resources;
+
+    resources = g_weak_ref_get (&entry->resources);
+
+    /* Otherwise the objects were released when the resources were finalized */
+    if (resources != NULL) {
+        release_thread_object (resources->priv, entry);
+        g_object_unref (resources);
+    }
+
+    g_weak_ref_clear (&entry->resources);
+    g_free (entry->key);
+    g_free (entry);
+}
+
+static void
+free_thread_objects (GList *objects)
+{
+    g_list_free_full (objects, (GDestroyNotify) free_thread_object);
+}
+
+static GPrivate thread_objects = G_PRIVATE_INIT ((GDestroyNotify) free_thread_objects);
+
+static GList *
+prune_thread_objects (GList *objects)
+{
+    GList *it = objects;
+
+    while (it != NULL) {
+        GList *next = g_list_next (it);
+        ThreadObject *entry = (ThreadObject *) it->data;
+        GObject *owner = g_weak_ref_get (&entry->resources);
+
+        if (owner == NULL) {
+            free_thread_object (entry);
+            objects = g_list_delete_link (objects, it);
+        }
+        else {
+            g_object_unref (owner);
+        }
+
+        it = next;
+    }
+
+    return objects;
+}
+
+/*
+ * Find the object of the calling thread stored under @key. The list belongs to
+ * the calling thread and needs no locking.
+ */
+static ThreadObject *
+lookup_thread_object (UfoResources *resources,
+                      const gchar *key)
+{
+    GList *it;
+
+    g_list_for ((GList *) g_private_get (&thread_objects), it) {
+        ThreadObject *entry = (ThreadObject *) it->data;
+
+        if (entry->owner == resources && !g_strcmp0 (entry->key, key)) {
+            GObject *owner = g_weak_ref_get (&entry->resources);
+
+            /* A new object may have been allocated at the address of a
+             * finalized one */
+            if (owner != NULL) {
+                g_object_unref (owner);
+                return entry;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static ThreadObject *
+add_thread_object (UfoResources *resources,
+                   gchar *key)
+{
+    ThreadObject *entry;
+    GList *objects;
+
+    entry = g_new0 (ThreadObject, 1);
+    entry->owner = resources;
+    entry->key = key;
+    g_weak_ref_init (&entry->resources, resources);
+
+    objects = prune_thread_objects (g_private_get (&thread_objects));
+    g_private_set (&thread_objects, g_list_prepend (objects, entry));
+    return entry;
+}
+
+static void
+free_variant (Variant *variant)
+{
+    UFO_RESOURCES_CHECK_CLERR (clReleaseProgram (variant->program));
+    g_free (variant->key);
+    g_free (variant->filename);
+    g_free (variant);
+}
+
 static void
 release_program (cl_program program)
 {
@@ -562,65 +731,421 @@ handle_build_error (cl_program program,
     g_free (log);
 }
 
+static gchar *
+get_build_options (UfoResourcesPrivate *priv,
+                   guint device_index,
+                   const gchar *options)
+{
+    GString *build_options;
+
+    build_options = g_string_new (priv->build_opts->str);
+    opt_append_device_options (build_options, priv, device_index);
+    opt_append_include_paths (build_options, priv);
+
+    if (options != NULL) {
+        gchar *stripped_opts = g_strstrip (g_strdup (options));
+        g_string_append (build_options, " ");
+        g_string_append (build_options, stripped_opts);
+        g_free (stripped_opts);
+    }
+
+    return g_string_free (build_options, FALSE);
+}
+
+static gchar *
+get_device_info_string (cl_device_id device,
+                        cl_device_info param)
+{
+    gchar *value;
+    size_t size;
+
+    UFO_RESOURCES_CHECK_CLERR (clGetDeviceInfo (device, param, 0, NULL, &size));
+    value = g_malloc0 (size + 1);
+    UFO_RESOURCES_CHECK_CLERR (clGetDeviceInfo (device, param, size, value, NULL));
+    return value;
+}
+
+/*
+ * Add the files included by @source to @checksum, so that a changed header
+ * invalidates the cached binaries. Returns FALSE if an include cannot be found
+ * in the kernel paths, e.g. because its name is a macro.
+ */
+static gboolean
+checksum_includes (UfoResourcesPrivate *priv,
+                   GChecksum *checksum,
+                   const gchar *source,
+                   GHashTable *visited)
+{
+    gchar **lines;
+    gboolean result = TRUE;
+
+    lines = g_strsplit (source, "\n", -1);
+
+    for (gchar **line = lines; *line != NULL && result; line++) {
+        gchar *directive;
+        gchar *end;
+        gchar *name;
+        gchar *path;
+        gchar *contents;
+
+        directive = g_strchug (*line);
+
+        if (*directive != '#')
+            continue;
+
+        directive = g_strchug (directive + 1);
+
+        if (!g_str_has_prefix (directive, "include"))
+            continue;
+
+        directive = g_strchug (directive + strlen ("include"));
+        end = NULL;
+
+        if (*directive == '"' || *directive == '<')
+            end = strchr (directive + 1, *directive == '"' ? '"' : '>');
+
+        if (end == NULL) {
+            result = FALSE;
+            break;
+        }
+
+        name = g_strndup (directive + 1, end - directive - 1);
+        path = lookup_kernel_path (priv, name);
+        g_free (name);
+
+        if (path == NULL) {
+            result = FALSE;
+            break;
+        }
+
+        if (g_hash_table_contains (visited, path)) {
+            g_free (path);
+            continue;
+        }
+
+        if (!g_file_get_contents (path, &contents, NULL, NULL)) {
+            g_free (path);
+            result = FALSE;
+            break;
+        }
+
+        g_checksum_update (checksum, (const guchar *) path, -1);
+        g_checksum_update (checksum, (const guchar *) "\n", 1);
+        g_checksum_update (checksum, (const guchar *) contents, -1);
+        g_checksum_update (checksum, (const guchar *) "\n", 1);
+        g_hash_table_add (visited, path);
+
+        result = checksum_includes (priv, checksum, contents, visited);
+        g_free (contents);
+    }
+
+    g_strfreev (lines);
+    return result;
+}
+
+/*
+ * Binaries are stored per device under a hash of everything that influences
+ * the compiler output, including the contents of included files. Returns NULL
+ * if caching is disabled or an include cannot be resolved.
+ */
+static gchar *
+get_binary_path (UfoResourcesPrivate *priv,
+                 const gchar *source,
+                 const gchar *build_options,
+                 guint device_index)
+{
+    GChecksum *checksum;
+    GHashTable *visited;
+    gchar *driver_version;
+    gchar *device_version;
+    gchar *filename;
+    gchar *path;
+    gboolean resolved;
+
+    if (priv->cache_dir == NULL)
+        return NULL;
+
+    checksum = g_checksum_new (G_CHECKSUM_SHA1);
+    visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    resolved = checksum_includes (priv, checksum, source, visited);
+    g_hash_table_destroy (visited);
+
+    if (!resolved) {
+        g_debug ("INFO Not caching program with unresolved includes");
+        g_checksum_free (checksum);
+        return NULL;
+    }
+
+    driver_version = get_device_info_string (priv->devices[device_index], CL_DRIVER_VERSION);
+    device_version = get_device_info_string (priv->devices[device_index], CL_DEVICE_VERSION);
+
+    g_checksum_update (checksum, (const guchar *) source, -1);
+    g_checksum_update (checksum, (const guchar *) "\n", 1);
+    g_checksum_update (checksum, (const guchar *) build_options, -1);
+    g_checksum_update (checksum, (const guchar *) "\n", 1);
+    g_checksum_update (checksum, (const guchar *) priv->device_names[device_index], -1);
+    g_checksum_update (checksum, (const guchar *) "\n", 1);
+    g_checksum_update (checksum, (const guchar *) device_version, -1);
+    g_checksum_update (checksum, (const guchar *) "\n", 1);
+    g_checksum_update (checksum, (const guchar *) driver_version, -1);
+
+    filename = g_strdup_printf ("%s.bin", g_checksum_get_string (checksum));
+    path = g_build_filename (priv->cache_dir, filename, NULL);
+
+    g_checksum_free (checksum);
+    g_free (filename);
+    g_free (device_version);
+    g_free (driver_version);
+    return path;
+}
+
 static cl_program
-add_program_from_source (UfoResourcesPrivate *priv,
-                         const gchar *source,
-                         const gchar *options,
-                         GError **error)
+create_program_from_cache (UfoResourcesPrivate *priv,
+                           gchar **paths)
 {
     cl_program program;
+    guchar **binaries;
+    size_t *lengths;
+    cl_int *status;
     cl_int errcode = CL_SUCCESS;
-    GTimer *timer;
+    gboolean complete = TRUE;
 
-    program = g_hash_table_lookup (priv->programs, source);
+    binaries = g_new0 (guchar *, priv->n_devices);
+    lengths = g_new0 (size_t, priv->n_devices);
+    status = g_new0 (cl_int, priv->n_devices);
+    program = NULL;
 
-    if (program != NULL)
-        return program;
+    for (guint i = 0; i < priv->n_devices && complete; i++) {
+        gsize length = 0;
 
-    program = clCreateProgramWithSource (priv->context, 1, &source, NULL, &errcode);
+        complete = paths[i] != NULL && g_file_get_contents (paths[i], (gchar **) &binaries[i], &length, NULL);
+        lengths[i] = length;
+    }
 
-    if (errcode != CL_SUCCESS) {
-        g_set_error (error, UFO_RESOURCES_ERROR, UFO_RESOURCES_ERROR_CREATE_PROGRAM,
-                     "Failed to create OpenCL program: %s", ufo_resources_clerr (errcode));
-        return NULL;
+    if (complete) {
+        program = clCreateProgramWithBinary (priv->context, priv->n_devices, priv->devices, lengths,
+                                             (const guchar **) binaries, status, &errcode);
+
+        if (errcode != CL_SUCCESS) {
+            g_debug ("WARN Could not load cached program binaries: %s", ufo_resources_clerr (errcode));
+            program = NULL;
+        }
     }
 
+    for (guint i = 0; i < priv->n_devices; i++)
+        g_free (binaries[i]);
+
+    g_free (binaries);
+    g_free (lengths);
+    g_free (status);
+    return program;
+}
+
+static void
+store_program_binaries (UfoResourcesPrivate *priv,
+                        cl_program program,
+                        gchar **paths)
+{
+    size_t *sizes;
+    guchar **binaries;
+
+    if (paths[0] == NULL)
+        return;
+
+    if (g_mkdir_with_parents (priv->cache_dir, 0755) != 0) {
+        g_debug ("WARN Could not create program cache `%s'", priv->cache_dir);
+        return;
+    }
+
+    /* Binaries are returned in the order of the context devices */
+    sizes = g_new0 (size_t, priv->n_devices);
+    binaries = g_new0 (guchar *, priv->n_devices);
+    UFO_RESOURCES_CHECK_CLERR (clGetProgramInfo (program, CL_PROGRAM_BINARY_SIZES,
+                                                 priv->n_devices * sizeof (size_t), sizes, NULL));
+
+    for (guint i = 0; i < priv->n_devices; i++)
+        binaries[i] = g_malloc0 (sizes[i]);
+
+    UFO_RESOURCES_CHECK_CLERR (clGetProgramInfo (program, CL_PROGRAM_BINARIES,
+                                                 priv->n_devices * sizeof (guchar *), binaries, NULL));
+
+    for (guint i = 0; i < priv->n_devices; i++) {
+        GError *error = NULL;
+
+        if (sizes[i] > 0 && !g_file_set_contents (paths[i], (const gchar *) binaries[i], sizes[i], &error)) {
+            g_debug ("WARN Could not cache program binary: %s", error->message);
+            g_error_free (error);
+        }
+
+        g_free (binaries[i]);
+    }
+
+    g_free (binaries);
+    g_free (sizes);
+}
+
+/*
+ * Devices with the same build options are built with a single call, so that
+ * the driver can compile for all of them concurrently.
+ */
+static gboolean
+build_program (UfoResourcesPrivate *priv,
+               cl_program program,
+               gchar **build_options,
+               GError **error)
+{
+    cl_device_id devices[priv->n_devices];
+    gboolean built[priv->n_devices];
+
+    memset (built, 0, sizeof (built));
+
+    for (guint i = 0; i < priv->n_devices; i++) {
+        cl_uint n_devices = 0;
+        cl_int errcode;
+
+        if (built[i])
+            continue;
+
+        for (guint j = i; j < priv->n_devices; j++) {
+            if (!built[j] && g_strcmp0 (build_options[i], build_options[j]) == 0) {
+                devices[n_devices++] = priv->devices[j];
+                built[j] = TRUE;
+            }
+        }
+
+        errcode = clBuildProgram (program, n_devices, devices, build_options[i], NULL, NULL);
+
+        if (errcode != CL_SUCCESS) {
+            handle_build_error (program, devices[0], errcode, error);
+            return FALSE;
+        }
+
+        g_debug ("INFO Built with `%s' for %i device(s) starting with device %i", build_options[i], n_devices, i);
+    }
+
+    return TRUE;
+}
+
+static cl_program
+build_program_from_source (UfoResourcesPrivate *priv,
+                           const gchar *source,
+                           const gchar *options,
+                           GError **error)
+{
+    cl_program program;
+    cl_int errcode = CL_SUCCESS;
+    gchar **build_options;
+    gchar **paths;
+    gboolean from_cache;
+    GTimer *timer;
+
     timer = g_timer_new ();
+    build_options = g_new0 (gchar *, priv->n_devices + 1);
+    paths = g_new0 (gchar *, priv->n_devices + 1);
 
     for (guint i = 0; i < priv->n_devices; i++) {
-        GString *build_options;
+        build_options[i] = get_build_options (priv, i, options);
+        paths[i] = get_binary_path (priv, source, build_options[i], i);
+    }
+
+    program = create_program_from_cache (priv, paths);
 
-        build_options = g_string_new (priv->build_opts->str);
-        opt_append_device_options (build_options, priv, i);
-        opt_append_include_paths (build_options, priv);
+    if (program != NULL) {
+        GError *tmp_error = NULL;
 
-        if (options != NULL) {
-            gchar *stripped_opts = g_strstrip (g_strdup (options));
-            g_string_append (build_options, " ");
-            g_string_append (build_options, stripped_opts);
-            g_free (stripped_opts);
+        if (!build_program (priv, program, build_options, &tmp_error)) {
+            g_debug ("WARN Could not build cached program: %s", tmp_error->message);
+            g_error_free (tmp_error);
+            UFO_RESOURCES_CHECK_CLERR (clReleaseProgram (program));
+            program = NULL;
         }
+    }
 
-        errcode = clBuildProgram (program, 1, &priv->devices[i], build_options->str, NULL, NULL);
+    from_cache = program != NULL;
+
+    if (!from_cache) {
+        if (priv->cache_dir != NULL)
+            g_debug ("INFO Program cache miss in `%s'", priv->cache_dir);
+
+        program = clCreateProgramWithSource (priv->context, 1, &source, NULL, &errcode);
 
         if (errcode != CL_SUCCESS) {
-            handle_build_error (program, priv->devices[0], errcode, error);
-            return NULL;
+            g_set_error (error, UFO_RESOURCES_ERROR, UFO_RESOURCES_ERROR_CREATE_PROGRAM,
+                         "Failed to create OpenCL program: %s", ufo_resources_clerr (errcode));
+            program = NULL;
+            goto exit;
         }
 
-        if (options)
-            g_debug ("INFO Built with `%s %s' for device %i", build_options->str, options, i);
-        else
-            g_debug ("INFO Built with `%s' for device %i", build_options->str, i);
+        if (!build_program (priv, program, build_options, error)) {
+            UFO_RESOURCES_CHECK_CLERR (clReleaseProgram (program));
+            program = NULL;
+            goto exit;
+        }
 
-        g_string_free (build_options, TRUE);
+        store_program_binaries (priv, program, paths);
+    }
+    else {
+        g_debug ("INFO Program cache hit in `%s'", priv->cache_dir);
     }
 
-    g_timer_stop (timer);
-    g_debug ("INFO Built program for %i devices in %3.5fs", priv->n_devices, g_timer_elapsed (timer, NULL));
+    g_debug ("INFO %s program for %i devices in %3.5fs", from_cache ? "Loaded" : "Built",
+             priv->n_devices, g_timer_elapsed (timer, NULL));
+
+exit:
+    g_strfreev (build_options);
+    g_strfreev (paths);
     g_timer_destroy (timer);
-    g_hash_table_insert (priv->programs, g_strdup (source), program);
+    return program;
+}
+
+static gchar *
+create_program_key (const gchar *source,
+                    const gchar *options)
+{
+    return g_strdup_printf ("%s\n%s", options != NULL ? options : "", source);
+}
+
+static cl_program
+add_program_from_source (UfoResourcesPrivate *priv,
+                         const gchar *source,
+                         const gchar *options,
+                         GError **error)
+{
+    cl_program program;
+    cl_program existing;
+    gchar *key;
+
+    key = create_program_key (source, options);
+    g_mutex_lock (&priv->lock);
+    program = g_hash_table_lookup (priv->programs, key);
+    g_mutex_unlock (&priv->lock);
+
+    if (program != NULL) {
+        g_free (key);
+        return program;
+    }
+
+    program = build_program_from_source (priv, source, options, error);
 
+    if (program == NULL) {
+        g_free (key);
+        return NULL;
+    }
+
+    /* Another thread may have built the same source in the meantime */
+    g_mutex_lock (&priv->lock);
+    existing = g_hash_table_lookup (priv->programs, key);
+
+    if (existing != NULL) {
+        UFO_RESOURCES_CHECK_CLERR (clReleaseProgram (program));
+        program = existing;
+        g_free (key);
+    }
+    else {
+        g_hash_table_insert (priv->programs, key, program);
+    }
+
+    g_mutex_unlock (&priv->lock);
     return program;
 }
 
@@ -650,28 +1175,20 @@ get_first_kernel_name (const gchar *source)
 }
 
 static cl_kernel
-create_kernel (UfoResourcesPrivate *priv,
-               cl_program program,
-               const gchar *kernel_name,
-               GError **error)
+create_untracked_kernel (cl_program program,
+                         const gchar *source,
+                         const gchar *kernel_name,
+                         GError **error)
 {
     cl_kernel kernel;
     gchar *name;
     cl_int errcode = CL_SUCCESS;
 
-    if (kernel_name == NULL) {
-        gchar *source;
-        gsize size;
-
-        UFO_RESOURCES_CHECK_CLERR (clGetProgramInfo (program, CL_PROGRAM_SOURCE, 0, NULL, &size));
-        source = g_malloc0 (size);
-        UFO_RESOURCES_CHECK_CLERR (clGetProgramInfo (program, CL_PROGRAM_SOURCE, size, source, NULL));
+    /* Programs loaded from binaries do not know their source */
+    if (kernel_name == NULL)
         name = get_first_kernel_name (source);
-        g_free (source);
-    }
-    else {
+    else
         name = g_strdup (kernel_name);
-    }
 
     kernel = clCreateKernel (program, name, &errcode);
     g_free (name);
@@ -682,7 +1199,27 @@ create_kernel (UfoResourcesPrivate *priv,
         return NULL;
     }
 
+    return kernel;
+}
+
+static cl_kernel
+create_kernel (UfoResourcesPrivate *priv,
+               cl_program program,
+               const gchar *source,
+               const gchar *kernel_name,
+               GError **error)
+{
+    cl_kernel kernel;
+
+    kernel = create_untracked_kernel (program, source, kernel_name, error);
+
+    if (kernel == NULL)
+        return NULL;
+
+    g_mutex_lock (&priv->lock);
     priv->kernels = g_list_append (priv->kernels, kernel);
+    g_mutex_unlock (&priv->lock);
+
     return kernel;
 }
 
@@ -749,7 +1286,7 @@ ufo_resources_get_kernel (UfoResources *resources,
         goto exit;
 
     g_debug ("INFO Compiled `%s' kernel from %s", kernel, path);
-    result = create_kernel (priv, program, kernel, error);
+    result = create_kernel (priv, program, buffer, kernel, error);
 
 exit:
     g_free (buffer);
@@ -790,7 +1327,7 @@ ufo_resources_get_kernel_from_source (UfoResources *resources,
         return NULL;
 
     g_debug ("INFO Added program %p from source", (gpointer) program);
-    return create_kernel (priv, program, kernel, error);
+    return create_kernel (priv, program, source, kernel, error);
 }
 
 /**
@@ -803,7 +1340,8 @@ ufo_resources_get_kernel_from_source (UfoResources *resources,
  * Loads a and builds a kernel from a file. The file is searched in the current
  * working directory and all paths added through ufo_resources_add_path (). If
  * @kernel is %NULL, the first encountered kernel is returned. The kernel object
- * is cached and should not be used by two threads concurrently.
+ * is cached and should not be used by two threads concurrently, use
+ * ufo_resources_get_thread_kernel() for kernels shared between tasks.
  *
  * Returns: (transfer none): a cl_kernel object that is load from @filename or
  *  %NULL on error
@@ -826,12 +1364,13 @@ ufo_resources_get_cached_kernel (UfoResources *resources,
         gchar *cache_key;
 
         cache_key = create_cache_key (filename, kernelname);
+        g_mutex_lock (&priv->lock);
         kernel = g_hash_table_lookup (priv->kernel_cache, cache_key);
+        g_mutex_unlock (&priv->lock);
+        g_free (cache_key);
 
-        if (kernel != NULL) {
-            g_free (cache_key);
+        if (kernel != NULL)
             return kernel;
-        }
     }
 
     kernel = ufo_resources_get_kernel (resources, filename, kernelname, NULL, error);
@@ -840,12 +1379,111 @@ ufo_resources_get_cached_kernel (UfoResources *resources,
         gchar *cache_key;
 
         cache_key = create_cache_key (filename, kernelname);
+        g_mutex_lock (&priv->lock);
         g_hash_table_insert (priv->kernel_cache, cache_key, kernel);
+        g_mutex_unlock (&priv->lock);
+    }
+
+    return kernel;
+}
+
+/**
+ * ufo_resources_get_thread_kernel:
+ * @resources: A #UfoResources object
+ * @filename: Name of the .cl kernel file
+ * @kernel: Name of a kernel, or %NULL
+ * @error: Return location for a GError from #UfoResourcesError, or %NULL
+ *
+ * Like ufo_resources_get_cached_kernel() but every thread gets its own
+ * instance of the kernel. Threads can thus set arguments and enqueue the kernel
+ * without locking. The program is built only once for all threads. The kernel
+ * is released when the calling thread exits or @resources is finalized,
+ * whichever comes first.
+ *
+ * Returns: (transfer none): a cl_kernel object that is only handed out to the
+ *  calling thread or %NULL on error
+ */
+gpointer
+ufo_resources_get_thread_kernel (UfoResources *resources,
+                                 const gchar *filename,
+                                 const gchar *kernelname,
+                                 GError **error)
+{
+    ThreadObject *entry;
+    cl_kernel kernel;
+    gchar *key;
+
+    g_return_val_if_fail (UFO_IS_RESOURCES (resources) &&
+                          (filename != NULL), NULL);
+
+    key = create_cache_key (filename, kernelname != NULL ? kernelname : "");
+    entry = lookup_thread_object (resources, key);
+
+    if (entry != NULL) {
+        g_free (key);
+        return entry->kernel;
+    }
+
+    kernel = ufo_resources_get_kernel (resources, filename, kernelname, NULL, error);
+
+    if (kernel == NULL) {
+        g_free (key);
+        return NULL;
     }
 
+    add_thread_object (resources, key)->kernel = kernel;
     return kernel;
 }
 
+/*
+ * ufo_resources_get_thread_mem:
+ * @resources: A #UfoResources object
+ * @name: Name that identifies the buffer
+ * @size: Minimum size in bytes
+ *
+ * Get a read-write scratch buffer of at least @size bytes that is only handed
+ * out to the calling thread. The buffer is kept for the next call with the
+ * same @name and grown if necessary. Its contents are undefined.
+ *
+ * Returns: a cl_mem object owned by @resources
+ */
+gpointer
+ufo_resources_get_thread_mem (UfoResources *resources,
+                              const gchar *name,
+                              gsize size)
+{
+    UfoResourcesPrivate *priv;
+    ThreadObject *entry;
+    gchar *key;
+    cl_int errcode;
+
+    g_return_val_if_fail (UFO_IS_RESOURCES (resources) && (name != NULL), NULL);
+
+    priv = resources->priv;
+    key = g_strdup_printf ("mem:%s", name);
+    entry = lookup_thread_object (resources, key);
+
+    if (entry == NULL)
+        entry = add_thread_object (resources, key);
+    else
+        g_free (key);
+
+    if (entry->mem != NULL && entry->size >= size)
+        return entry->mem;
+
+    release_thread_object (priv, entry);
+    entry->mem = clCreateBuffer (priv->context, CL_MEM_READ_WRITE, size, NULL, &errcode);
+    entry->size = size;
+    UFO_RESOURCES_CHECK_CLERR (errcode);
+    g_debug ("ALOC mem=%p [size=%zu, scratch]", (gpointer) entry->mem, size);
+
+    g_mutex_lock (&priv->lock);
+    priv->thread_mems = g_list_append (priv->thread_mems, entry->mem);
+    g_mutex_unlock (&priv->lock);
+
+    return entry->mem;
+}
+
 /**
  * ufo_resources_get_kernel_source:
  * @resources: A #UfoResources object
@@ -890,6 +1528,175 @@ ufo_resources_get_kernel_source (UfoResources   *resources,
     return buffer;
 }
 
+/*
+ * Look up a specialized program and move it to the front. The program is
+ * retained because another thread may evict it before the caller is done.
+ */
+static cl_program
+lookup_variant (UfoResourcesPrivate *priv,
+                const gchar *key)
+{
+    GList *link;
+    Variant *variant;
+
+    link = g_hash_table_lookup (priv->variants, key);
+
+    if (link == NULL)
+        return NULL;
+
+    g_queue_unlink (priv->variant_lru, link);
+    g_queue_push_head_link (priv->variant_lru, link);
+    variant = link->data;
+    UFO_RESOURCES_CHECK_CLERR (clRetainProgram (variant->program));
+    return variant->program;
+}
+
+static void
+insert_variant (UfoResourcesPrivate *priv,
+                const gchar *key,
+                const gchar *filename,
+                cl_program program)
+{
+    Variant *variant;
+
+    variant = g_new0 (Variant, 1);
+    variant->key = g_strdup (key);
+    variant->filename = g_strdup (filename);
+    variant->program = program;
+    UFO_RESOURCES_CHECK_CLERR (clRetainProgram (program));
+
+    g_queue_push_head (priv->variant_lru, variant);
+    g_hash_table_insert (priv->variants, variant->key, priv->variant_lru->head);
+
+    while (g_queue_get_length (priv->variant_lru) > priv->max_variants) {
+        guint n_evictions;
+
+        variant = g_queue_pop_tail (priv->variant_lru);
+        n_evictions = GPOINTER_TO_UINT (g_hash_table_lookup (priv->n_evictions, variant->filename)) + 1;
+        g_debug ("INFO Evicted kernel variant of `%s' with `%s'", variant->filename, strchr (variant->key, '\n') + 1);
+        g_hash_table_insert (priv->n_evictions, g_strdup (variant->filename), GUINT_TO_POINTER (n_evictions));
+        g_hash_table_remove (priv->variants, variant->key);
+        free_variant (variant);
+    }
+}
+
+/**
+ * ufo_resources_get_specialized_kernel:
+ * @resources: A #UfoResources object
+ * @filename: Name of the .cl kernel file
+ * @kernel: Name of a kernel, or %NULL
+ * @defines: Options such as `-DWIDTH=512` passed to the OpenCL compiler, or
+ *  %NULL
+ * @error: Return location for a GError from #UfoResourcesError, or %NULL
+ *
+ * Loads and builds a kernel from a file like ufo_resources_get_kernel() but
+ * with compile-time constants in @defines, for example from
+ * ufo_resources_get_requisition_defines(). Programs for the last
+ * #UfoResources:max-kernel-variants combinations of file and @defines are kept.
+ * If the variants of @filename had to be evicted that often, the defines keep
+ * changing and the kernel is built without @defines from then on, so the kernel
+ * must also work without them.
+ *
+ * Returns: (transfer full): a new cl_kernel object that is not shared with
+ *  other callers and must be released with clReleaseKernel(), or %NULL on error
+ */
+gpointer
+ufo_resources_get_specialized_kernel (UfoResources *resources,
+                                      const gchar *filename,
+                                      const gchar *kernel,
+                                      const gchar *defines,
+                                      GError **error)
+{
+    UfoResourcesPrivate *priv;
+    cl_program program;
+    cl_program existing;
+    cl_kernel result;
+    gchar *source;
+    gchar *key;
+    gboolean specialize;
+
+    g_return_val_if_fail (UFO_IS_RESOURCES (resources) && (filename != NULL), NULL);
+
+    priv = resources->priv;
+    source = ufo_resources_get_kernel_source (resources, filename, error);
+
+    if (source == NULL)
+        return NULL;
+
+    key = g_strdup_printf ("%s\n%s", filename, defines != NULL ? defines : "");
+
+    g_mutex_lock (&priv->lock);
+    specialize = defines != NULL && priv->max_variants > 0 &&
+        GPOINTER_TO_UINT (g_hash_table_lookup (priv->n_evictions, filename)) < priv->max_variants;
+    program = specialize ? lookup_variant (priv, key) : NULL;
+    g_mutex_unlock (&priv->lock);
+
+    if (!specialize) {
+        /* Generic programs are kept until @resources is destroyed */
+        program = add_program_from_source (priv, source, NULL, error);
+
+        if (program != NULL)
+            UFO_RESOURCES_CHECK_CLERR (clRetainProgram (program));
+    }
+    else if (program == NULL) {
+        program = build_program_from_source (priv, source, defines, error);
+
+        if (program != NULL) {
+            g_mutex_lock (&priv->lock);
+            existing = lookup_variant (priv, key);
+
+            if (existing != NULL) {
+                UFO_RESOURCES_CHECK_CLERR (clReleaseProgram (program));
+                program = existing;
+            }
+            else {
+                insert_variant (priv, key, filename, program);
+            }
+
+            g_mutex_unlock (&priv->lock);
+        }
+    }
+
+    result = NULL;
+
+    if (program != NULL) {
+        /* The kernel keeps the program alive after eviction */
+        result = create_untracked_kernel (program, source, kernel, error);
+        UFO_RESOURCES_CHECK_CLERR (clReleaseProgram (program));
+    }
+
+    g_free (key);
+    g_free (source);
+    return result;
+}
+
+/**
+ * ufo_resources_get_requisition_defines:
+ * @requisition: A #UfoRequisition
+ *
+ * Format the shape of @requisition as compiler options for
+ * ufo_resources_get_specialized_kernel(). `UFO_NUM_DIMS` is set to the number
+ * of dimensions and `UFO_WIDTH`, `UFO_HEIGHT` and `UFO_DEPTH` to the size of the
+ * first, second and third dimension if present.
+ *
+ * Returns: (transfer full): Compiler options, free with g_free().
+ */
+gchar *
+ufo_resources_get_requisition_defines (UfoRequisition *requisition)
+{
+    static const gchar *names[] = { "UFO_WIDTH", "UFO_HEIGHT", "UFO_DEPTH" };
+    GString *defines;
+
+    g_return_val_if_fail (requisition != NULL, NULL);
+
+    defines = g_string_new (NULL);
+    g_string_append_printf (defines, "-DUFO_NUM_DIMS=%u", requisition->n_dims);
+
+    for (guint i = 0; i < MIN (requisition->n_dims, G_N_ELEMENTS (names)); i++)
+        g_string_append_printf (defines, " -D%s=%" G_GSIZE_FORMAT, names[i], requisition->dims[i]);
+
+    return g_string_free (defines, FALSE);
+}
 
 /**
  * ufo_resources_get_context:
@@ -990,6 +1797,14 @@ ufo_resources_set_property (GObject *object,
             priv->device_type = g_value_get_flags (value);
             break;
 
+        case PROP_BUFFER_MEMORY_MODE:
+            priv->memory_mode = g_value_get_enum (value);
+            break;
+
+        case PROP_MAX_KERNEL_VARIANTS:
+            priv->max_variants = g_value_get_uint (value);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -1013,6 +1828,14 @@ ufo_resources_get_property (GObject *object,
             g_value_set_flags (value, priv->device_type);
             break;
 
+        case PROP_BUFFER_MEMORY_MODE:
+            g_value_set_enum (value, priv->memory_mode);
+            break;
+
+        case PROP_MAX_KERNEL_VARIANTS:
+            g_value_set_uint (value, priv->max_variants);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -1048,8 +1871,12 @@ ufo_resources_finalize (GObject *object)
 
     g_list_free_full (priv->paths, g_free);
     g_list_free_full (priv->kernels, (GDestroyNotify) release_kernel);
+    g_list_free_full (priv->thread_mems, (GDestroyNotify) release_mem);
 
     g_hash_table_destroy (priv->programs);
+    g_hash_table_destroy (priv->variants);
+    g_hash_table_destroy (priv->n_evictions);
+    g_queue_free_full (priv->variant_lru, (GDestroyNotify) free_variant);
 
     if (priv->device_names != NULL) {
         for (guint i = 0; i < priv->n_devices; i++)
@@ -1057,16 +1884,20 @@ ufo_resources_finalize (GObject *object)
     }
 
     if (priv->context) {
+        ufo_purge_buffer_pools (priv->context);
         g_debug ("FREE context=%p", (gpointer) priv->context);
         UFO_RESOURCES_CHECK_CLERR (clReleaseContext (priv->context));
     }
 
     g_string_free (priv->build_opts, TRUE);
+    g_free (priv->cache_dir);
+    g_mutex_clear (&priv->lock);
 
     g_free (priv->device_names);
     g_free (priv->devices);
 
     priv->kernels = NULL;
+    priv->thread_mems = NULL;
     priv->devices = NULL;
 
     G_OBJECT_CLASS (ufo_resources_parent_class)->finalize (object);
@@ -1148,6 +1979,36 @@ ufo_resources_class_init (UfoResourcesClass *klass)
                             UFO_TYPE_DEVICE_TYPE, UFO_DEVICE_GPU,
                             G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE);
 
+    /**
+     * UfoResources:buffer-memory-mode:
+     *
+     * How schedulers allocate host memory of buffers passed between tasks.
+     * %UFO_BUFFER_MEMORY_MODE_MAPPED avoids host/device copies on CPU and
+     * integrated devices.
+     *
+     * See: #UfoBufferMemoryMode for the allocation strategies.
+     */
+    properties[PROP_BUFFER_MEMORY_MODE] =
+        g_param_spec_enum ("buffer-memory-mode",
+                           "Host memory allocation of buffers",
+                           "Host memory allocation of buffers",
+                           UFO_TYPE_BUFFER_MEMORY_MODE, UFO_BUFFER_MEMORY_MODE_SEPARATE,
+                           G_PARAM_READWRITE);
+
+    /**
+     * UfoResources:max-kernel-variants:
+     *
+     * Number of programs built by ufo_resources_get_specialized_kernel() that
+     * are kept at the same time. The least recently used one is released
+     * first, 0 disables specialization.
+     */
+    properties[PROP_MAX_KERNEL_VARIANTS] =
+        g_param_spec_uint ("max-kernel-variants",
+                           "Number of specialized programs that are kept",
+                           "Number of specialized programs that are kept",
+                           0, G_MAXUINT, 16,
+                           G_PARAM_READWRITE);
+
     for (guint i = PROP_0 + 1; i < N_PROPERTIES; i++)
         g_object_class_install_property (oclass, i, properties[i]);
 
@@ -1159,6 +2020,7 @@ ufo_resources_init (UfoResources *self)
 {
     UfoResourcesPrivate *priv;
     const gchar *kernel_path;
+    const gchar *cache_dir;
     gchar **kernel_paths;
     gchar **path;
 
@@ -1167,12 +2029,26 @@ ufo_resources_init (UfoResources *self)
     priv->construct_error = NULL;
     priv->programs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) release_program);
     priv->kernels = NULL;
+    priv->thread_mems = NULL;
     priv->kernel_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    priv->variants = g_hash_table_new (g_str_hash, g_str_equal);
+    priv->variant_lru = g_queue_new ();
+    priv->n_evictions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    priv->max_variants = 16;
     priv->build_opts = g_string_new ("-cl-mad-enable ");
 
     priv->paths = g_list_append (NULL, g_strdup ("."));
     priv->paths = g_list_append (priv->paths, g_strdup (UFO_KERNEL_DIR));
     priv->gpu_nodes = NULL;
+    g_mutex_init (&priv->lock);
+
+    /* An empty UFO_PROGRAM_CACHE disables caching */
+    cache_dir = g_getenv ("UFO_PROGRAM_CACHE");
+
+    if (cache_dir == NULL)
+        priv->cache_dir = g_build_filename (g_get_user_cache_dir (), "ufo", "programs", NULL);
+    else
+        priv->cache_dir = *cache_dir != '\0' ? g_strdup (cache_dir) : NULL;
 
     kernel_path = g_getenv ("UFO_KERNEL_PATH");
 
@@ -1190,6 +2066,7 @@ ufo_resources_init (UfoResources *self)
 
     priv->device_type = UFO_DEVICE_GPU;
     priv->platform_index = -1;
+    priv->memory_mode = UFO_BUFFER_MEMORY_MODE_SEPARATE;
 
     initialize_opencl (priv);
 }
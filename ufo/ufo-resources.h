@@ -149,9 +149,19 @@ gpointer         ufo_resources_get_cached_kernel        (UfoResources   *resourc
                                                          const gchar    *filename,
                                                          const gchar    *kernel,
                                                          GError        **error);
+gpointer         ufo_resources_get_thread_kernel        (UfoResources   *resources,
+                                                         const gchar    *filename,
+                                                         const gchar    *kernel,
+                                                         GError        **error);
 gchar          * ufo_resources_get_kernel_source        (UfoResources   *resources,
                                                          const gchar    *filename,
                                                          GError        **error);
+gpointer         ufo_resources_get_specialized_kernel   (UfoResources   *resources,
+                                                         const gchar    *filename,
+                                                         const gchar    *kernel,
+                                                         const gchar    *defines,
+                                                         GError        **error);
+gchar          * ufo_resources_get_requisition_defines  (UfoRequisition *requisition);
 gpointer         ufo_resources_get_context              (UfoResources   *resources);
 GList          * ufo_resources_get_cmd_queues           (UfoResources   *resources);
 GList          * ufo_resources_get_devices              (UfoResources   *resources);
@@ -34,6 +34,8 @@
 #endif
 
 #include "ufo-buffer.h"
+#include "ufo-cpu-node.h"
+#include "ufo-gpu-node.h"
 #include "ufo-resources.h"
 #include "ufo-scheduler.h"
 #include "ufo-task-node.h"
@@ -54,21 +56,68 @@ G_DEFINE_TYPE (UfoScheduler, ufo_scheduler, UFO_TYPE_BASE_SCHEDULER)
 
 #define UFO_SCHEDULER_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), UFO_TYPE_SCHEDULER, UfoSchedulerPrivate))
 
+typedef struct _Session Session;
+
+/*
+ * Inputs fed by several groups, e.g. by the branches of an expanded graph,
+ * are merged by sequence number. Each group delivers its items in order, so
+ * holding back the next item of every group is enough to find the smallest.
+ */
+typedef struct {
+    UfoGroup       **groups;
+    UfoBuffer      **heads;             /* next item of each group or NULL */
+    guint            n_groups;
+    guint64          next;              /* sequence number expected next */
+} Reorder;
+
 typedef struct {
     UfoTask         *task;
     UfoTaskMode      mode;
     guint            n_inputs;
+    guint            n_outputs;
     guint           *dims;
     gboolean        *finished;
     gboolean         strict;
     gboolean         timestamps;
+    guint            batch_size;        /* 0 if items are processed one by one */
+    gboolean         inplace;           /* may pass its input on as output */
+    gboolean         fixed_shape;       /* requisition depends only on input shapes */
+    gboolean         have_requisition;
+    UfoRequisition   requisition;       /* cached requisition of a fixed-shape task */
+    UfoRequisition  *in_requisitions;   /* input shapes it was computed for */
+    guint64          sequence;          /* number of the next generated item */
+    Reorder        **reorders;          /* per input, NULL if fed by one group */
+    UfoGroup       **sources;           /* group of each current input */
+    UfoResources    *resources;
     UfoBaseScheduler    *scheduler;
+    Session         *session;
 } TaskLocalData;
 
+/*
+ * A session keeps the threads, groups and buffers of a prepared graph. Between
+ * runs the threads wait for n_runs to change.
+ */
+struct _Session {
+    UfoTaskGraph    *graph;
+    UfoResources    *resources;
+    TaskLocalData  **tlds;
+    GList           *groups;
+    GList           *gpu_nodes;
+    GThread        **threads;
+    guint            n_nodes;
+    guint            n_runs;
+    guint            n_running;
+    gboolean         released;
+    GError          *error;
+    GMutex           lock;
+    GCond            start_cond;
+    GCond            done_cond;
+};
 
 struct _UfoSchedulerPrivate {
     gboolean ran;
     gboolean aborted;
+    Session *session;
 };
 
 
@@ -95,22 +144,132 @@ ufo_scheduler_new (void)
     return UFO_BASE_SCHEDULER (g_object_new (UFO_TYPE_SCHEDULER, NULL));
 }
 
+static Reorder *
+reorder_new (GList *groups)
+{
+    Reorder *reorder;
+    GList *it;
+    guint i = 0;
+
+    reorder = g_new0 (Reorder, 1);
+    reorder->n_groups = g_list_length (groups);
+    reorder->groups = g_new0 (UfoGroup *, reorder->n_groups);
+    reorder->heads = g_new0 (UfoBuffer *, reorder->n_groups);
+
+    g_list_for (groups, it)
+        reorder->groups[i++] = UFO_GROUP (it->data);
+
+    return reorder;
+}
+
+static void
+reorder_free (Reorder *reorder)
+{
+    g_free (reorder->groups);
+    g_free (reorder->heads);
+    g_free (reorder);
+}
+
+static void
+reorder_reset (Reorder *reorder)
+{
+    memset (reorder->heads, 0, reorder->n_groups * sizeof (UfoBuffer *));
+    reorder->next = 0;
+}
+
+/*
+ * Return the expected item as soon as it arrives. Any other item is returned
+ * only when every group has shown its next one, so that gaps in the sequence
+ * do not stall the stream.
+ */
+static UfoBuffer *
+reorder_pop (Reorder *reorder,
+             UfoTask *task,
+             gboolean wait,
+             UfoGroup **source)
+{
+    while (TRUE) {
+        guint best = reorder->n_groups;
+        guint empty = reorder->n_groups;
+        UfoBuffer *buffer;
+
+        for (guint i = 0; i < reorder->n_groups; i++) {
+            UfoBuffer *head;
+
+            if (reorder->heads[i] == NULL)
+                reorder->heads[i] = ufo_group_try_pop_input_buffer (reorder->groups[i], task);
+
+            head = reorder->heads[i];
+
+            if (head == NULL) {
+                empty = MIN (empty, i);
+                continue;
+            }
+
+            if (head == UFO_END_OF_STREAM)
+                continue;
+
+            if (best == reorder->n_groups ||
+                ufo_buffer_get_sequence (head) < ufo_buffer_get_sequence (reorder->heads[best]))
+                best = i;
+        }
+
+        if (best < reorder->n_groups &&
+            (ufo_buffer_get_sequence (reorder->heads[best]) <= reorder->next || empty == reorder->n_groups)) {
+            buffer = reorder->heads[best];
+            reorder->heads[best] = NULL;
+            reorder->next = ufo_buffer_get_sequence (buffer) + 1;
+            *source = reorder->groups[best];
+            return buffer;
+        }
+
+        if (empty == reorder->n_groups)
+            return UFO_END_OF_STREAM;
+
+        if (!wait)
+            return NULL;
+
+        reorder->heads[empty] = ufo_group_pop_input_buffer (reorder->groups[empty], task);
+    }
+}
+
+/*
+ * Pop the next item of input @pos and remember the group it must be released
+ * to.
+ */
+static UfoBuffer *
+pop_input (TaskLocalData *tld,
+           guint pos,
+           gboolean wait)
+{
+    UfoTaskNode *node = UFO_TASK_NODE (tld->task);
+    UfoBuffer *input;
+
+    if (tld->reorders[pos] != NULL)
+        return reorder_pop (tld->reorders[pos], tld->task, wait, &tld->sources[pos]);
+
+    tld->sources[pos] = ufo_task_node_get_current_in_group (node, pos);
+    input = wait ? ufo_group_pop_input_buffer (tld->sources[pos], tld->task) :
+                   ufo_group_try_pop_input_buffer (tld->sources[pos], tld->task);
+
+    if (input != NULL && input != UFO_END_OF_STREAM)
+        ufo_task_node_switch_in_group (node, pos);
+
+    return input;
+}
+
 static gboolean
 get_inputs (TaskLocalData *tld,
             UfoBuffer **inputs)
 {
     UfoRequisition req;
-    UfoTaskNode *node = UFO_TASK_NODE (tld->task);
     guint n_finished = 0;
 
     for (guint i = 0; i < tld->n_inputs; i++) {
-        UfoGroup *group;
-
         if (!tld->finished[i]) {
             UfoBuffer *input;
 
-            group = ufo_task_node_get_current_in_group (node, i);
-            input = ufo_group_pop_input_buffer (group, tld->task);
+            input = pop_input (tld, i, TRUE);
 
             if (tld->strict && input != UFO_END_OF_STREAM) {
                 ufo_buffer_get_requisition (input, &req);
@@ -126,8 +285,10 @@ get_inputs (TaskLocalData *tld,
                 tld->finished[i] = TRUE;
                 n_finished++;
             }
-            else
+            else {
+                ufo_convert_input_on_device (tld->task, tld->resources, input);
                 inputs[i] = input;
+            }
         }
         else
             n_finished++;
@@ -140,15 +301,378 @@ static void
 release_inputs (TaskLocalData *tld,
                 UfoBuffer **inputs)
 {
-    UfoTaskNode *node = UFO_TASK_NODE (tld->task);
+    for (guint i = 0; i < tld->n_inputs; i++)
+        ufo_group_push_input_buffer (tld->sources[i], tld->task, inputs[i]);
+}
 
-    for (guint i = 0; i < tld->n_inputs; i++) {
+/*
+ * An in-place processor writes into its input buffer if it is the only reader
+ * and the output has the same size. The buffer is passed on instead of an
+ * output buffer and its owner gets it back when the successors release it.
+ */
+static gboolean
+can_process_inplace (TaskLocalData *tld,
+                     UfoGroup *in_group,
+                     UfoBuffer *input,
+                     UfoRequisition *requisition)
+{
+    return tld->inplace &&
+           ufo_group_get_num_targets (in_group) == 1 &&
+           !ufo_buffer_cmp_dimensions (input, requisition);
+}
+
+/*
+ * Fixed-shape tasks are asked for their requisition only for the first item
+ * and whenever the shape of an input changes. The first requisition is used
+ * to allocate all output buffers up-front.
+ */
+static void
+get_requisition (TaskLocalData *tld,
+                 UfoBuffer **inputs,
+                 UfoRequisition *requisition,
+                 GError **error)
+{
+    GError *tmp_error = NULL;
+    gboolean changed;
+
+    if (!tld->fixed_shape) {
+        ufo_task_get_requisition (tld->task, inputs, requisition, error);
+        return;
+    }
+
+    changed = !tld->have_requisition;
+
+    for (guint i = 0; !changed && i < tld->n_inputs; i++)
+        changed = ufo_buffer_cmp_dimensions (inputs[i], &tld->in_requisitions[i]) != 0;
+
+    if (changed) {
+        ufo_task_get_requisition (tld->task, inputs, &tld->requisition, &tmp_error);
+
+        if (tmp_error != NULL) {
+            tld->have_requisition = FALSE;
+            g_propagate_error (error, tmp_error);
+            return;
+        }
+
+        for (guint i = 0; i < tld->n_inputs; i++)
+            ufo_buffer_get_requisition (inputs[i], &tld->in_requisitions[i]);
+
+        if (tld->have_requisition)
+            g_debug ("%s-%p: input shape changed", G_OBJECT_TYPE_NAME (tld->task), (gpointer) tld->task);
+        else if (!tld->inplace && (tld->mode & UFO_TASK_MODE_TYPE_MASK) != UFO_TASK_MODE_SINK)
+            ufo_group_preallocate (ufo_task_node_get_out_group (UFO_TASK_NODE (tld->task)), &tld->requisition);
+
+        tld->have_requisition = TRUE;
+    }
+
+    *requisition = tld->requisition;
+}
+
+static void
+set_timestamp (UfoBuffer *output)
+{
+    GValue v = { 0, };
+
+    g_value_init (&v, G_TYPE_INT64);
+    g_value_set_int64 (&v, g_get_real_time ());
+    ufo_buffer_set_metadata (output, "ts", &v);
+}
+
+/*
+ * Collect up to batch_size inputs of equal size. Only the first one is waited
+ * for, the others are taken if they are already available. An input that
+ * differs in size is left in pending for the next batch.
+ */
+static guint
+gather_inputs (TaskLocalData *tld,
+               UfoBuffer **inputs,
+               UfoGroup **groups,
+               UfoBuffer **pending,
+               UfoGroup **pending_group)
+{
+    UfoRequisition requisition;
+    guint n = 0;
+
+    if (*pending != NULL) {
+        inputs[n] = *pending;
+        groups[n++] = *pending_group;
+        *pending = NULL;
+        ufo_buffer_get_requisition (inputs[0], &requisition);
+    }
+
+    while (n < tld->batch_size && !tld->finished[0]) {
         UfoGroup *group;
+        UfoBuffer *input;
+
+        input = pop_input (tld, 0, n == 0);
+        group = tld->sources[0];
+
+        if (input == NULL)
+            break;
+
+        if (input == UFO_END_OF_STREAM) {
+            tld->finished[0] = TRUE;
+            break;
+        }
+
+        ufo_convert_input_on_device (tld->task, tld->resources, input);
+
+        if (n == 0) {
+            ufo_buffer_get_requisition (input, &requisition);
+        }
+        else if (ufo_buffer_cmp_dimensions (input, &requisition)) {
+            *pending = input;
+            *pending_group = group;
+            break;
+        }
+
+        inputs[n] = input;
+        groups[n++] = group;
+    }
+
+    return n;
+}
+
+static GError *
+run_processor_batched (TaskLocalData *tld)
+{
+    UfoSchedulerPrivate *priv;
+    UfoBuffer *inputs[tld->batch_size];
+    UfoBuffer *outputs[tld->batch_size];
+    UfoGroup *in_groups[tld->batch_size];
+    gboolean inplace[tld->batch_size];
+    UfoBuffer *pending = NULL;
+    UfoGroup *pending_group = NULL;
+    UfoTaskNode *node;
+    UfoGroup *group;
+    UfoProfiler *profiler;
+    UfoRequisition requisition;
+    gboolean produces;
+    gboolean active = TRUE;
+    GError *error = NULL;
+
+    priv = UFO_SCHEDULER_GET_PRIVATE (tld->scheduler);
+    node = UFO_TASK_NODE (tld->task);
+    profiler = ufo_task_node_get_profiler (node);
+    group = ufo_task_node_get_out_group (node);
+    produces = (tld->mode & UFO_TASK_MODE_TYPE_MASK) != UFO_TASK_MODE_SINK;
+
+    while (active && !priv->aborted) {
+        guint n_items;
+
+        n_items = gather_inputs (tld, inputs, in_groups, &pending, &pending_group);
+
+        if (n_items == 0)
+            break;
+
+        get_requisition (tld, inputs, &requisition, &error);
+
+        if (error == NULL) {
+            for (guint i = 0; produces && i < n_items; i++) {
+                inplace[i] = can_process_inplace (tld, in_groups[i], inputs[i], &requisition);
+
+                if (inplace[i]) {
+                    outputs[i] = inputs[i];
+                    continue;
+                }
+
+                outputs[i] = ufo_group_pop_output_buffer (group, &requisition);
+                ufo_buffer_discard_location (outputs[i]);
+                ufo_buffer_copy_metadata (inputs[i], outputs[i]);
+                ufo_buffer_set_sequence (outputs[i], ufo_buffer_get_sequence (inputs[i]));
+                ufo_buffer_set_layout (outputs[i], ufo_buffer_get_layout (inputs[i]));
+            }
+
+            ufo_profiler_start (profiler, UFO_PROFILER_TIMER_CPU);
+            active = ufo_task_process_batch (tld->task, inputs, produces ? outputs : NULL, n_items, &requisition);
+            ufo_profiler_stop (profiler, UFO_PROFILER_TIMER_CPU);
+
+            for (guint i = 0; produces && i < n_items; i++) {
+                if (active && inplace[i])
+                    ufo_group_push_forwarded_buffer (group, outputs[i], in_groups[i], tld->task);
+                else if (active)
+                    ufo_group_push_output_buffer (group, outputs[i]);
+                else if (!inplace[i])
+                    ufo_group_return_output_buffer (group, outputs[i]);
+            }
+        }
+
+        /* Release buffers for further consumption */
+        for (guint i = 0; i < n_items; i++) {
+            if (error != NULL || !(active && produces && inplace[i]))
+                ufo_group_push_input_buffer (in_groups[i], tld->task, inputs[i]);
+        }
+
+        if (error != NULL)
+            break;
+    }
+
+    if (pending != NULL)
+        ufo_group_push_input_buffer (pending_group, tld->task, pending);
+
+    if (tld->finished[0])
+        ufo_task_inputs_stopped_callback (tld->task);
+
+    /* flush outstanding input data */
+    while (error != NULL && !tld->finished[0]) {
+        UfoBuffer *input = pop_input (tld, 0, TRUE);
+
+        if (input == UFO_END_OF_STREAM)
+            tld->finished[0] = TRUE;
+        else
+            ufo_group_push_input_buffer (tld->sources[0], tld->task, input);
+    }
+
+    ufo_group_finish (group);
+    return error;
+}
+
+static GError *
+run_generator_batched (TaskLocalData *tld)
+{
+    UfoSchedulerPrivate *priv;
+    UfoBuffer *outputs[tld->batch_size];
+    UfoTaskNode *node;
+    UfoGroup *group;
+    UfoProfiler *profiler;
+    UfoRequisition requisition;
+    guint n_generated = tld->batch_size;
+    GError *error = NULL;
+
+    priv = UFO_SCHEDULER_GET_PRIVATE (tld->scheduler);
+    node = UFO_TASK_NODE (tld->task);
+    profiler = ufo_task_node_get_profiler (node);
+    group = ufo_task_node_get_out_group (node);
+
+    while (n_generated == tld->batch_size && !priv->aborted) {
+        get_requisition (tld, NULL, &requisition, &error);
+
+        if (error != NULL)
+            break;
+
+        for (guint i = 0; i < tld->batch_size; i++) {
+            outputs[i] = ufo_group_pop_output_buffer (group, &requisition);
+            ufo_buffer_discard_location (outputs[i]);
+            ufo_buffer_set_sequence (outputs[i], tld->sequence + i);
+
+            if (tld->timestamps)
+                set_timestamp (outputs[i]);
+        }
+
+        ufo_profiler_start (profiler, UFO_PROFILER_TIMER_CPU);
+        n_generated = ufo_task_generate_batch (tld->task, outputs, tld->batch_size, &requisition);
+        ufo_profiler_stop (profiler, UFO_PROFILER_TIMER_CPU);
+        tld->sequence += n_generated;
+
+        /* Unused buffers go back before the next push changes the target */
+        for (guint i = n_generated; i < tld->batch_size; i++)
+            ufo_group_return_output_buffer (group, outputs[i]);
+
+        for (guint i = 0; i < n_generated; i++)
+            ufo_group_push_output_buffer (group, outputs[i]);
+    }
+
+    ufo_group_finish (group);
+    return error;
+}
+
+/*
+ * Processors with several outputs fill one buffer per output port at once.
+ * Ports without successors get a scratch buffer that is overwritten with each
+ * item.
+ */
+static GError *
+run_processor_outputs (TaskLocalData *tld)
+{
+    UfoSchedulerPrivate *priv;
+    UfoBuffer *inputs[tld->n_inputs];
+    UfoBuffer *outputs[tld->n_outputs];
+    UfoBuffer *scratch[tld->n_outputs];
+    UfoGroup *groups[tld->n_outputs];
+    UfoRequisition requisitions[tld->n_outputs];
+    UfoTaskNode *node;
+    UfoProfiler *profiler;
+    gboolean active = TRUE;
+    GError *error = NULL;
+
+    priv = UFO_SCHEDULER_GET_PRIVATE (tld->scheduler);
+    node = UFO_TASK_NODE (tld->task);
+    profiler = ufo_task_node_get_profiler (node);
+
+    for (guint i = 0; i < tld->n_outputs; i++) {
+        groups[i] = ufo_task_node_get_output_group (node, i);
+        scratch[i] = NULL;
+    }
+
+    while (active) {
+        active = get_inputs (tld, inputs) && !priv->aborted;
+
+        if (!active) {
+            ufo_task_inputs_stopped_callback (tld->task);
+            break;
+        }
+
+        for (guint i = 0; i < tld->n_outputs && error == NULL; i++)
+            ufo_task_get_output_requisition (tld->task, inputs, i, &requisitions[i], &error);
+
+        if (error != NULL)
+            break;
+
+        for (guint i = 0; i < tld->n_outputs; i++) {
+            if (ufo_group_get_num_targets (groups[i]) > 0) {
+                outputs[i] = ufo_group_pop_output_buffer (groups[i], &requisitions[i]);
+            }
+            else {
+                if (scratch[i] == NULL)
+                    scratch[i] = ufo_buffer_new (&requisitions[i], ufo_resources_get_context (tld->resources));
+                else if (ufo_buffer_cmp_dimensions (scratch[i], &requisitions[i]))
+                    ufo_buffer_resize (scratch[i], &requisitions[i]);
+
+                outputs[i] = scratch[i];
+            }
+
+            ufo_buffer_discard_location (outputs[i]);
+            ufo_buffer_set_layout (outputs[i], ufo_buffer_get_layout (inputs[0]));
+
+            for (guint j = 0; j < tld->n_inputs; j++)
+                ufo_buffer_copy_metadata (inputs[j], outputs[i]);
+
+            ufo_buffer_set_sequence (outputs[i], ufo_buffer_get_sequence (inputs[0]));
+        }
+
+        ufo_profiler_start (profiler, UFO_PROFILER_TIMER_CPU);
+        active = ufo_task_process_outputs (tld->task, inputs, outputs, requisitions);
+        ufo_profiler_stop (profiler, UFO_PROFILER_TIMER_CPU);
+
+        for (guint i = 0; i < tld->n_outputs; i++) {
+            if (outputs[i] == scratch[i])
+                continue;
+
+            if (active)
+                ufo_group_push_output_buffer (groups[i], outputs[i]);
+            else
+                ufo_group_return_output_buffer (groups[i], outputs[i]);
+        }
+
+        /* Release buffers for further consumption */
+        if (active)
+            release_inputs (tld, inputs);
+    }
+
+    /* flush outstanding input data */
+    if (error != NULL) {
+        while (get_inputs (tld, inputs))
+            release_inputs (tld, inputs);
+    }
 
-        group = ufo_task_node_get_current_in_group (node, i);
-        ufo_group_push_input_buffer (group, tld->task, inputs[i]);
-        ufo_task_node_switch_in_group (node, i);
+    for (guint i = 0; i < tld->n_outputs; i++) {
+        ufo_group_finish (groups[i]);
+
+        if (scratch[i] != NULL)
+            g_object_unref (scratch[i]);
     }
+
+    return error;
 }
 
 static gpointer
@@ -160,13 +684,19 @@ run_task (TaskLocalData *tld)
     UfoTaskNode *node;
     UfoTaskMode mode;
     UfoGroup *group;
+    UfoGroup *in_group;
+    UfoProfiler *profiler;
     UfoRequisition requisition;
     gboolean produces;
+    gboolean inplace;
     gboolean active;
     GError *error;
 
     priv = UFO_SCHEDULER_GET_PRIVATE (tld->scheduler);
     node = UFO_TASK_NODE (tld->task);
+    profiler = ufo_task_node_get_profiler (node);
+    in_group = NULL;
+    inplace = FALSE;
     active = TRUE;
     output = NULL;
     error = NULL;
@@ -176,6 +706,19 @@ run_task (TaskLocalData *tld)
     produces = mode != UFO_TASK_MODE_SINK;
     group = ufo_task_node_get_out_group (node);
 
+    if (ufo_task_node_get_cpu_node (node) != NULL)
+        ufo_cpu_node_bind (UFO_CPU_NODE (ufo_task_node_get_cpu_node (node)));
+
+    if (tld->n_outputs > 1)
+        return run_processor_outputs (tld);
+
+    if (tld->batch_size > 0) {
+        if (mode == UFO_TASK_MODE_GENERATOR)
+            return run_generator_batched (tld);
+
+        return run_processor_batched (tld);
+    }
+
     while (active) {
         /* Get input buffers */
         active = get_inputs (tld, inputs) && !priv->aborted;
@@ -187,21 +730,32 @@ run_task (TaskLocalData *tld)
         }
 
         /* Get output buffers */
-        ufo_task_get_requisition (tld->task, inputs, &requisition, &error);
+        get_requisition (tld, inputs, &requisition, &error);
 
         if (error != NULL)
             break;
 
-        if (produces) {
+        if (tld->inplace) {
+            in_group = tld->sources[0];
+            inplace = can_process_inplace (tld, in_group, inputs[0], &requisition);
+        }
+
+        if (inplace) {
+            output = inputs[0];
+        }
+        else if (produces) {
             output = ufo_group_pop_output_buffer (group, &requisition);
             g_assert (output != NULL);
         }
 
-        if (output != NULL) {
+        if (output != NULL && !inplace) {
             ufo_buffer_discard_location (output);
 
             for (guint i = 0; i < tld->n_inputs; i++)
                 ufo_buffer_copy_metadata (inputs[i], output);
+
+            if (tld->n_inputs > 0)
+                ufo_buffer_set_sequence (output, ufo_buffer_get_sequence (inputs[0]));
         }
 
         switch (mode) {
@@ -209,7 +763,9 @@ run_task (TaskLocalData *tld)
                 ufo_buffer_set_layout (output, ufo_buffer_get_layout (inputs[0]));
                 /* fall through */
             case UFO_TASK_MODE_SINK:
+                ufo_profiler_start (profiler, UFO_PROFILER_TIMER_CPU);
                 active = ufo_task_process (tld->task, inputs, output, &requisition);
+                ufo_profiler_stop (profiler, UFO_PROFILER_TIMER_CPU);
                 break;
 
             case UFO_TASK_MODE_REDUCTOR:
@@ -217,7 +773,9 @@ run_task (TaskLocalData *tld)
                     gboolean go_on = TRUE;
 
                     do {
+                        ufo_profiler_start (profiler, UFO_PROFILER_TIMER_CPU);
                         go_on = ufo_task_process (tld->task, inputs, output, &requisition);
+                        ufo_profiler_stop (profiler, UFO_PROFILER_TIMER_CPU);
 
                         release_inputs (tld, inputs);
                         active = get_inputs (tld, inputs);
@@ -228,6 +786,7 @@ run_task (TaskLocalData *tld)
                     } while (go_on);
 
                     do {
+                        ufo_buffer_set_sequence (output, tld->sequence++);
                         go_on = ufo_task_generate (tld->task, output, &requisition) && !priv->aborted;
 
                         if (go_on) {
@@ -241,15 +800,14 @@ run_task (TaskLocalData *tld)
 
             case UFO_TASK_MODE_GENERATOR:
                 {
-                    if (tld->timestamps) {
-                        GValue v = { 0, };
+                    if (tld->timestamps)
+                        set_timestamp (output);
 
-                        g_value_init (&v, G_TYPE_INT64);
-                        g_value_set_int64 (&v, g_get_real_time ());
-                        ufo_buffer_set_metadata (output, "ts", &v);
-                    }
+                    ufo_buffer_set_sequence (output, tld->sequence++);
 
+                    ufo_profiler_start (profiler, UFO_PROFILER_TIMER_CPU);
                     active = ufo_task_generate (tld->task, output, &requisition);
+                    ufo_profiler_stop (profiler, UFO_PROFILER_TIMER_CPU);
 
                 }
                 break;
@@ -258,12 +816,18 @@ run_task (TaskLocalData *tld)
                 g_warning ("Invalid task mode: %i\n", mode);
         }
 
-        if (active && produces && (mode != UFO_TASK_MODE_REDUCTOR))
-            ufo_group_push_output_buffer (group, output);
+        if (active && inplace) {
+            /* The input is released by the successors */
+            ufo_group_push_forwarded_buffer (group, output, in_group, tld->task);
+        }
+        else {
+            if (active && produces && (mode != UFO_TASK_MODE_REDUCTOR))
+                ufo_group_push_output_buffer (group, output);
 
-        /* Release buffers for further consumption */
-        if (active)
-            release_inputs (tld, inputs);
+            /* Release buffers for further consumption */
+            if (active)
+                release_inputs (tld, inputs);
+        }
 
         if (!active)
             ufo_group_finish (group);
@@ -291,63 +855,142 @@ cleanup_task_local_data (TaskLocalData **tlds,
 
         ufo_task_node_reset (UFO_TASK_NODE (tld->task));
 
+        for (guint j = 0; j < tld->n_inputs; j++) {
+            if (tld->reorders[j] != NULL)
+                reorder_free (tld->reorders[j]);
+        }
+
         g_free (tld->dims);
         g_free (tld->finished);
+        g_free (tld->in_requisitions);
+        g_free (tld->reorders);
+        g_free (tld->sources);
         g_free (tld);
     }
 
     g_free (tlds);
 }
 
-static gboolean
-check_target_connections (UfoTaskGraph *graph,
-                          UfoNode *target,
-                          guint n_inputs,
-                          GError **error)
+typedef void (*BlockingFunc) (gpointer data);
+
+/*
+ * Python tasks need the interpreter lock in their own threads, so the calling
+ * thread must not hold it while waiting for them.
+ */
+static void
+call_without_gil (BlockingFunc func,
+                  gpointer data)
 {
-    GList *predecessors;
-    GList *it;
-    gboolean connections[UFO_MAX_INPUT_NODES];
-    gboolean result = TRUE;
+#ifdef WITH_PYTHON
+    if (Py_IsInitialized ()) {
+        PyGILState_STATE state = PyGILState_Ensure ();
+        Py_BEGIN_ALLOW_THREADS
+
+        func (data);
 
-    if (n_inputs == 0)
-        return TRUE;
+        Py_END_ALLOW_THREADS
+        PyGILState_Release (state);
+    }
+    else {
+        func (data);
+    }
+#else
+    func (data);
+#endif
+}
+
+typedef struct {
+    UfoResources    *resources;
+    GError          *error;
+    GMutex           lock;
+} SetupData;
+
+static void
+setup_task_list (GList *tasks,
+                 SetupData *data)
+{
+    GList *it;
 
-    predecessors = ufo_graph_get_predecessors (UFO_GRAPH (graph), target);
+    g_list_for (tasks, it) {
+        GError *error = NULL;
 
-    gboolean all_inputs_connected = TRUE;
+        ufo_task_setup (UFO_TASK (it->data), data->resources, &error);
 
-    /* Check all edges and enable bit number for edge label */
-    g_list_for (predecessors, it) {
-        gpointer label;
-        gint input;
+        if (error != NULL) {
+            g_mutex_lock (&data->lock);
 
-        label = ufo_graph_get_edge_label (UFO_GRAPH (graph),
-                                          UFO_NODE (it->data), target);
-        input = GPOINTER_TO_INT (label);
+            if (data->error == NULL)
+                data->error = error;
+            else
+                g_error_free (error);
 
-        if (input > UFO_MAX_INPUT_NODES) {
-            g_set_error(error, UFO_SCHEDULER_ERROR, UFO_SCHEDULER_ERROR_SETUP,
-                        "Number of inputs exceeds %i (UFO_MAX_INPUT_NODES). This value can be defined in the build settings.",
-                        UFO_MAX_INPUT_NODES);
+            g_mutex_unlock (&data->lock);
+            return;
         }
+    }
+}
+
+static void
+wait_for_setup (GThreadPool *pool)
+{
+    g_thread_pool_free (pool, FALSE, TRUE);
+}
 
-        g_assert (input >= 0 && input < UFO_MAX_INPUT_NODES);
-        connections[input] = TRUE;
-        all_inputs_connected &= connections[input];
+/*
+ * Set up tasks concurrently, so that their OpenCL programs are built in
+ * parallel. Tasks of the same plugin are set up one after the other because
+ * they share cached kernels.
+ */
+static gboolean
+setup_tasks_parallel (GList *nodes,
+                      UfoResources *resources,
+                      GError **error)
+{
+    GHashTable *plugins;
+    GThreadPool *pool;
+    GHashTableIter iter;
+    GList *it;
+    gpointer tasks;
+    SetupData data;
+
+    data.resources = resources;
+    data.error = NULL;
+    g_mutex_init (&data.lock);
+    plugins = g_hash_table_new (g_str_hash, g_str_equal);
+
+    g_list_for (nodes, it) {
+        const gchar *name = ufo_task_node_get_plugin_name (UFO_TASK_NODE (it->data));
+
+        name = name != NULL ? name : "";
+        tasks = g_hash_table_lookup (plugins, name);
+        g_hash_table_insert (plugins, (gpointer) name, g_list_append (tasks, it->data));
     }
 
-    /* Check if mask matches what we have */
-    if (!all_inputs_connected) {
-        g_set_error (error, UFO_SCHEDULER_ERROR, UFO_SCHEDULER_ERROR_SETUP,
-                     "Not all inputs of `%s' are connected",
-                     ufo_task_node_get_plugin_name (UFO_TASK_NODE (target)));
+    pool = g_thread_pool_new ((GFunc) setup_task_list, &data,
+                              (gint) CLAMP (g_hash_table_size (plugins), 1, g_get_num_processors ()),
+                              FALSE, NULL);
+
+    g_hash_table_iter_init (&iter, plugins);
+
+    while (g_hash_table_iter_next (&iter, NULL, &tasks))
+        g_thread_pool_push (pool, tasks, NULL);
+
+    call_without_gil ((BlockingFunc) wait_for_setup, pool);
 
-        result = FALSE;
+    g_hash_table_iter_init (&iter, plugins);
+
+    while (g_hash_table_iter_next (&iter, NULL, &tasks))
+        g_list_free (tasks);
+
+    g_hash_table_destroy (plugins);
+    g_mutex_clear (&data.lock);
+
+    if (data.error != NULL) {
+        g_propagate_error (error, data.error);
+        return FALSE;
     }
 
-    g_list_free (predecessors);
-    return result;
+    return TRUE;
 }
 
 static TaskLocalData **
@@ -359,6 +1002,7 @@ setup_tasks (UfoBaseScheduler *scheduler,
     TaskLocalData **tlds;
     GList *nodes;
     guint n_nodes;
+    guint batch_size;
     gboolean timestamps;
     gboolean tracing_enabled;
 
@@ -370,11 +1014,17 @@ setup_tasks (UfoBaseScheduler *scheduler,
     g_object_get (scheduler,
                   "enable-tracing", &tracing_enabled,
                   "timestamps", &timestamps,
+                  "batch-size", &batch_size,
                   NULL);
 
     nodes = ufo_graph_get_nodes (UFO_GRAPH (task_graph));
     n_nodes = g_list_length (nodes);
 
+    if (!setup_tasks_parallel (nodes, resources, error)) {
+        g_list_free (nodes);
+        return NULL;
+    }
+
     tlds = g_new0 (TaskLocalData *, n_nodes);
 
     for (guint i = 0; i < n_nodes; i++) {
@@ -385,13 +1035,22 @@ setup_tasks (UfoBaseScheduler *scheduler,
         tld = g_new0 (TaskLocalData, 1);
         tld->task = UFO_TASK (node);
         tld->scheduler = scheduler;
+        tld->resources = resources;
         tlds[i] = tld;
 
-        ufo_task_setup (tld->task, resources, error);
         tld->mode = ufo_task_get_mode (tld->task);
         tld->n_inputs = ufo_task_get_num_inputs (tld->task);
+        tld->n_outputs = ufo_task_get_num_outputs (tld->task);
         tld->dims = g_new0 (guint, tld->n_inputs);
         tld->timestamps = timestamps;
+        tld->batch_size = batch_size > 1 && ufo_task_supports_batches (tld->task) ? batch_size : 0;
+        tld->inplace = (tld->mode & UFO_TASK_MODE_INPLACE) &&
+                       (tld->mode & UFO_TASK_MODE_TYPE_MASK) == UFO_TASK_MODE_PROCESSOR &&
+                       tld->n_inputs == 1 && tld->n_outputs == 1;
+        tld->fixed_shape = (tld->mode & UFO_TASK_MODE_FIXED_SHAPE) && tld->n_outputs == 1;
+        tld->in_requisitions = g_new0 (UfoRequisition, tld->n_inputs);
+        tld->reorders = g_new0 (Reorder *, tld->n_inputs);
+        tld->sources = g_new0 (UfoGroup *, tld->n_inputs);
 
         /* TODO: make this configurable from outside */
         tld->strict = FALSE;
@@ -399,7 +1058,7 @@ setup_tasks (UfoBaseScheduler *scheduler,
         for (guint j = 0; j < tld->n_inputs; j++)
             tld->dims[j] = ufo_task_get_num_dimensions (tld->task, j);
 
-        if (!check_target_connections (task_graph, node, tld->n_inputs, error)) {
+        if (!ufo_check_target_connections (task_graph, node, tld->n_inputs, error)) {
             return NULL;
         }
 
@@ -421,215 +1080,290 @@ setup_groups (UfoBaseScheduler *scheduler,
               GError **error)
 {
     UfoResources *resources;
-    GList *groups;
-    GList *nodes;
-    GList *it;
-    cl_context context;
+    UfoTwoWayQueueBackend backend;
+    guint batch_size;
 
-    groups = NULL;
-    nodes = ufo_graph_get_nodes (UFO_GRAPH (task_graph));
     resources = ufo_base_scheduler_get_resources (scheduler, error);
 
     if (resources == NULL)
         return NULL;
 
-    context = ufo_resources_get_context (resources);
+    g_object_get (scheduler, "queue-backend", &backend, "batch-size", &batch_size, NULL);
+    return ufo_setup_groups (task_graph, resources, backend, batch_size);
+}
 
-    g_list_for (nodes, it) {
-        GList *successors;
-        GList *jt;
-        UfoNode *node;
-        UfoGroup *group;
-        UfoSendPattern pattern;
-
-        node = UFO_NODE (it->data);
-        successors = ufo_graph_get_successors (UFO_GRAPH (task_graph), node);
-        pattern = ufo_task_node_get_send_pattern (UFO_TASK_NODE (node));
-
-        group = ufo_group_new (successors, context, pattern);
-        groups = g_list_append (groups, group);
-        ufo_task_node_set_out_group (UFO_TASK_NODE (node), group);
-
-        g_list_for (successors, jt) {
-            UfoNode *target;
-            gpointer label;
-            guint input;
-
-            target = UFO_NODE (jt->data);
-            label = ufo_graph_get_edge_label (UFO_GRAPH (task_graph), node, target);
-            input = (guint) GPOINTER_TO_INT (label);
-            ufo_task_node_add_in_group (UFO_TASK_NODE (target), input, group);
-            ufo_group_set_num_expected (group, UFO_TASK (target),
-                                        ufo_task_node_get_num_expected (UFO_TASK_NODE (target),
-                                                                        input));
-        }
+/*
+ * Inputs that are connected to several groups, e.g. where the branches of an
+ * expanded graph join, receive their items in order of their sequence numbers.
+ */
+static void
+setup_reorders (TaskLocalData **tlds,
+                guint n_nodes)
+{
+    for (guint i = 0; i < n_nodes; i++) {
+        TaskLocalData *tld = tlds[i];
 
-        g_list_free (successors);
-    }
+        for (guint j = 0; j < tld->n_inputs; j++) {
+            GList *groups = ufo_task_node_get_in_groups (UFO_TASK_NODE (tld->task), j);
 
-    g_list_free (nodes);
-    return groups;
+            if (g_list_length (groups) > 1)
+                tld->reorders[j] = reorder_new (groups);
+        }
+    }
 }
 
-static gboolean
-correct_connections (UfoTaskGraph *graph,
-                     GError **error)
+static gpointer
+run_session_task (TaskLocalData *tld)
 {
-    GList *nodes;
-    GList *it;
-    gboolean result = TRUE;
+    Session *session = tld->session;
+    guint n_runs = 0;
 
-    nodes = ufo_graph_get_nodes (UFO_GRAPH (graph));
+    while (TRUE) {
+        GError *error;
 
-    g_list_for (nodes, it) {
-        UfoTaskNode *node;
-        UfoTaskMode mode;
-        UfoGroup *group;
+        g_mutex_lock (&session->lock);
 
-        node = UFO_TASK_NODE (it->data);
-        mode = ufo_task_get_mode (UFO_TASK (node)) & UFO_TASK_MODE_TYPE_MASK;
-        group = ufo_task_node_get_out_group (node);
+        while (session->n_runs == n_runs && !session->released)
+            g_cond_wait (&session->start_cond, &session->lock);
 
-        if (((mode == UFO_TASK_MODE_GENERATOR) || (mode == UFO_TASK_MODE_REDUCTOR)) &&
-            ufo_group_get_num_targets (group) < 1) {
-            g_set_error (error, UFO_SCHEDULER_ERROR, UFO_SCHEDULER_ERROR_SETUP,
-                         "No outgoing node for `%s'",
-                         ufo_task_node_get_identifier (node));
-            result = FALSE;
+        n_runs = session->n_runs;
+
+        if (session->released) {
+            g_mutex_unlock (&session->lock);
             break;
         }
+
+        g_mutex_unlock (&session->lock);
+
+        error = run_task (tld);
+
+        g_mutex_lock (&session->lock);
+
+        if (error != NULL && session->error == NULL)
+            session->error = error;
+        else if (error != NULL)
+            g_error_free (error);
+
+        if (--session->n_running == 0)
+            g_cond_broadcast (&session->done_cond);
+
+        g_mutex_unlock (&session->lock);
     }
 
-    g_list_free (nodes);
-    return result;
+    return NULL;
 }
 
 static void
-propagate_partition (UfoTaskGraph *graph)
+session_free (Session *session)
 {
-    GList *nodes;
-    GList *it;
-    guint idx;
-    guint total;
+    g_mutex_lock (&session->lock);
+    session->released = TRUE;
+    g_cond_broadcast (&session->start_cond);
+    g_mutex_unlock (&session->lock);
+
+    if (session->threads != NULL) {
+        for (guint i = 0; i < session->n_nodes; i++)
+            g_thread_join (session->threads[i]);
+    }
 
-    ufo_task_graph_get_partition (graph, &idx, &total);
-    nodes = ufo_graph_get_nodes (UFO_GRAPH (graph));
+    if (session->tlds != NULL)
+        cleanup_task_local_data (session->tlds, session->n_nodes);
+
+    g_list_free_full (session->groups, g_object_unref);
+    g_list_free (session->gpu_nodes);
+    g_clear_error (&session->error);
+    g_free (session->threads);
+    g_mutex_clear (&session->lock);
+    g_cond_clear (&session->start_cond);
+    g_cond_clear (&session->done_cond);
+    g_free (session);
+}
 
-    g_list_for (nodes, it) {
-        ufo_task_node_set_partition (UFO_TASK_NODE (it->data), idx, total);
+static Session *
+session_new (UfoBaseScheduler *scheduler,
+             UfoTaskGraph *graph,
+             GError **error)
+{
+    UfoSchedulerPrivate *priv;
+    Session *session;
+
+    priv = UFO_SCHEDULER_GET_PRIVATE (scheduler);
+
+    session = g_new0 (Session, 1);
+    session->graph = graph;
+    g_mutex_init (&session->lock);
+    g_cond_init (&session->start_cond);
+    g_cond_init (&session->done_cond);
+
+    session->resources = ufo_base_scheduler_get_resources (scheduler, error);
+
+    if (session->resources == NULL)
+        goto session_new_error;
+
+    session->gpu_nodes = ufo_resources_get_gpu_nodes (session->resources);
+
+    if (!ufo_setup_task_graph (scheduler, graph, session->resources, session->gpu_nodes, !priv->ran, error))
+        goto session_new_error;
+
+    /* Prepare task structures */
+    session->n_nodes = ufo_graph_get_num_nodes (UFO_GRAPH (graph));
+    session->tlds = setup_tasks (scheduler, graph, error);
+
+    if (session->tlds == NULL)
+        goto session_new_error;
+
+    session->groups = setup_groups (scheduler, graph, error);
+
+    if (session->groups == NULL)
+        goto session_new_error;
+
+    setup_reorders (session->tlds, session->n_nodes);
+
+    if (!ufo_check_connections (graph, error))
+        goto session_new_error;
+
+    priv->ran = TRUE;
+
+    /* Spawn threads that wait for the first run */
+    session->threads = g_new0 (GThread *, session->n_nodes);
+
+    for (guint i = 0; i < session->n_nodes; i++) {
+        session->tlds[i]->session = session;
+        session->threads[i] = g_thread_new (NULL, (GThreadFunc) run_session_task, session->tlds[i]);
     }
 
-    g_list_free (nodes);
+    return session;
+
+session_new_error:
+    session_free (session);
+    return NULL;
 }
 
-static void
-join_threads (GThread **threads, guint n_threads, GError **error)
+/*
+ * Bring tasks, groups and input positions back to their initial state while
+ * all threads are waiting. The buffers allocated by the groups are kept.
+ */
+static gboolean
+session_reset (Session *session,
+               GError **error)
 {
-    GError *tmp_error = NULL;
+    GList *it;
+
+    for (guint i = 0; i < session->n_nodes; i++) {
+        TaskLocalData *tld = session->tlds[i];
+        GError *tmp_error = NULL;
 
-    for (guint i = 0; i < n_threads; i++) {
-        tmp_error = g_thread_join (threads[i]);
+        ufo_task_reset (tld->task, session->resources, &tmp_error);
 
-        if (tmp_error) {
-            g_clear_error (error);
+        if (tmp_error != NULL) {
             g_propagate_error (error, tmp_error);
+            return FALSE;
         }
+
+        memset (tld->finished, 0, tld->n_inputs * sizeof (gboolean));
+        tld->have_requisition = FALSE;
+        tld->sequence = 0;
+
+        for (guint j = 0; j < tld->n_inputs; j++) {
+            if (tld->reorders[j] != NULL)
+                reorder_reset (tld->reorders[j]);
+        }
+
+        ufo_task_node_rewind_in_groups (UFO_TASK_NODE (tld->task));
     }
+
+    g_list_for (session->groups, it) {
+        ufo_group_reset (UFO_GROUP (it->data));
+    }
+
+    return TRUE;
 }
 
 static void
-ufo_scheduler_run (UfoBaseScheduler *scheduler,
-                   UfoTaskGraph *task_graph,
-                   GError **error)
+wait_for_session (Session *session)
+{
+    g_mutex_lock (&session->lock);
+
+    while (session->n_running > 0)
+        g_cond_wait (&session->done_cond, &session->lock);
+
+    g_mutex_unlock (&session->lock);
+}
+
+static void
+session_run (UfoBaseScheduler *scheduler,
+             Session *session,
+             GError **error)
 {
     UfoSchedulerPrivate *priv;
-    UfoResources *resources;
-    UfoTaskGraph *graph;
-    GList *gpu_nodes;
-    GList *groups;
-    guint n_nodes;
-    GThread **threads;
-    TaskLocalData **tlds;
-    gboolean expand;
 
     priv = UFO_SCHEDULER_GET_PRIVATE (scheduler);
     priv->aborted = FALSE;
 
-    g_object_get (scheduler, "expand", &expand, NULL);
-
-    graph = task_graph;
-    resources = ufo_base_scheduler_get_resources (scheduler, error);
-
-    if (resources == NULL)
+    if (session->n_runs > 0 && !session_reset (session, error))
         return;
 
-    gpu_nodes = ufo_resources_get_gpu_nodes (resources);
+    g_mutex_lock (&session->lock);
+    session->n_running = session->n_nodes;
+    session->n_runs++;
+    g_cond_broadcast (&session->start_cond);
+    g_mutex_unlock (&session->lock);
 
-    if (expand) {
-        if (!priv->ran) {
-            ufo_task_graph_expand (graph, resources, g_list_length (gpu_nodes), error);
-            if (error && (*error != NULL)) {
-                return;
-            }
-        }
-        else {
-            g_debug ("Task graph already expanded, skipping.");
-        }
+    call_without_gil ((BlockingFunc) wait_for_session, session);
+
+    if (session->error != NULL) {
+        g_propagate_error (error, session->error);
+        session->error = NULL;
     }
+}
 
-    propagate_partition (graph);
-    ufo_task_graph_map (graph, gpu_nodes);
+static void
+ufo_scheduler_run (UfoBaseScheduler *scheduler,
+                   UfoTaskGraph *task_graph,
+                   GError **error)
+{
+    Session *session;
 
-    /* Prepare task structures */
-    tlds = setup_tasks (scheduler, graph, error);
+    session = session_new (scheduler, task_graph, error);
 
-    if (tlds == NULL)
+    if (session == NULL)
         return;
 
-    groups = setup_groups (scheduler, graph, error);
-
-    if (groups == NULL)
-        return;
+    session_run (scheduler, session, error);
+    session_free (session);
+}
 
-    if (!correct_connections (graph, error))
-        return;
+static gboolean
+ufo_scheduler_prepare (UfoBaseScheduler *scheduler,
+                       UfoTaskGraph *task_graph,
+                       GError **error)
+{
+    UfoSchedulerPrivate *priv;
 
-    n_nodes = ufo_graph_get_num_nodes (UFO_GRAPH (graph));
-    threads = g_new0 (GThread *, n_nodes);
+    priv = UFO_SCHEDULER_GET_PRIVATE (scheduler);
+    priv->session = session_new (scheduler, task_graph, error);
 
-    /* Spawn threads */
-    for (guint i = 0; i < n_nodes; i++) {
-        threads[i] = g_thread_new (NULL, (GThreadFunc) run_task, tlds[i]);
+    return priv->session != NULL;
+}
 
-        if (error && (*error != NULL))
-            return;
-    }
+static void
+ufo_scheduler_run_prepared (UfoBaseScheduler *scheduler,
+                            GError **error)
+{
+    session_run (scheduler, UFO_SCHEDULER_GET_PRIVATE (scheduler)->session, error);
+}
 
-#ifdef WITH_PYTHON
-    if (Py_IsInitialized ()) {
-        PyGILState_STATE state = PyGILState_Ensure ();
-        Py_BEGIN_ALLOW_THREADS
+static void
+ufo_scheduler_release (UfoBaseScheduler *scheduler)
+{
+    UfoSchedulerPrivate *priv;
 
-        join_threads (threads, n_nodes, error);
+    priv = UFO_SCHEDULER_GET_PRIVATE (scheduler);
 
-        Py_END_ALLOW_THREADS
-        PyGILState_Release (state);
+    if (priv->session != NULL) {
+        session_free (priv->session);
+        priv->session = NULL;
     }
-    else {
-        join_threads (threads, n_nodes, error);
-    }
-#else
-    join_threads (threads, n_nodes, error);
-#endif
-
-    /* Cleanup */
-    cleanup_task_local_data (tlds, n_nodes);
-    g_list_foreach (groups, (GFunc) g_object_unref, NULL);
-    g_list_free (groups);
-    g_list_free (gpu_nodes);
-    g_free (threads);
-
-    priv->ran = TRUE;
 }
 
 static void
@@ -648,6 +1382,9 @@ ufo_scheduler_class_init (UfoSchedulerClass *klass)
     sclass = UFO_BASE_SCHEDULER_CLASS (klass);
     sclass->run = ufo_scheduler_run;
     sclass->abort = ufo_scheduler_abort;
+    sclass->prepare = ufo_scheduler_prepare;
+    sclass->run_prepared = ufo_scheduler_run_prepared;
+    sclass->release = ufo_scheduler_release;
 
     g_type_class_add_private (klass, sizeof (UfoSchedulerPrivate));
 }
@@ -660,4 +1397,5 @@ ufo_scheduler_init (UfoScheduler *scheduler)
     scheduler->priv = priv = UFO_SCHEDULER_GET_PRIVATE (scheduler);
     priv->ran = FALSE;
     priv->aborted = FALSE;
+    priv->session = NULL;
 }
@@ -0,0 +1,1035 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#ifdef WITH_PYTHON
+#include <Python.h>
+#endif
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "ufo-buffer.h"
+#include "ufo-cpu-node.h"
+#include "ufo-gpu-node.h"
+#include "ufo-group.h"
+#include "ufo-input-task.h"
+#include "ufo-output-task.h"
+#include "ufo-resources.h"
+#include "ufo-stealing-scheduler.h"
+#include "ufo-task-node.h"
+#include "ufo-task-iface.h"
+#include "ufo-priv.h"
+
+/**
+ * SECTION:ufo-stealing-scheduler
+ * @Short_description: Thread pool scheduler with work stealing
+ * @Title: UfoStealingScheduler
+ *
+ * Like #UfoScheduler, this scheduler expands the task graph and maps it onto
+ * the available GPUs. Instead of running every task in its own thread, it runs
+ * single steps of a task, i.e. one call to ufo_task_process() or
+ * ufo_task_generate(), as soon as its inputs and an output buffer are
+ * available. The steps are run by a fixed number of worker threads, each with
+ * its own queue of runnable tasks. Workers that run out of tasks steal from
+ * the other workers.
+ */
+
+G_DEFINE_TYPE (UfoStealingScheduler, ufo_stealing_scheduler, UFO_TYPE_BASE_SCHEDULER)
+
+#define UFO_STEALING_SCHEDULER_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), UFO_TYPE_STEALING_SCHEDULER, UfoStealingSchedulerPrivate))
+
+typedef struct _Pool Pool;
+
+typedef enum {
+    TASK_IDLE,
+    TASK_QUEUED,
+    TASK_RUNNING,
+    TASK_RUNNING_NOTIFIED,  /* running and notified about new data meanwhile */
+    TASK_DONE
+} TaskState;
+
+typedef enum {
+    STEP_BLOCKED,
+    STEP_PROGRESS,
+    STEP_FINISHED
+} StepResult;
+
+typedef struct {
+    UfoTask         *task;
+    UfoTaskMode      mode;
+    UfoResources    *resources;
+    guint            n_inputs;
+    UfoBuffer      **inputs;
+    gboolean        *acquired;
+    gboolean        *finished;
+    UfoBuffer       *output;
+    UfoRequisition   requisition;
+    gboolean         have_requisition;
+    gboolean         timestamps;
+    gboolean         processed;     /* reductor got at least one input */
+    gboolean         generating;    /* reductor is in its generate phase */
+    gboolean         stopped;       /* reductor received all inputs */
+    gboolean         draining;      /* task finished, discard remaining inputs */
+    gint             state;
+    GList           *neighbors;
+    Pool            *pool;
+} Task;
+
+typedef struct {
+    GMutex       lock;
+    GQueue       tasks;
+    Pool        *pool;
+    UfoCpuNode  *cpu_node;
+} Worker;
+
+struct _Pool {
+    Worker      *workers;
+    GThread    **threads;
+    guint        n_workers;
+    gint         next_worker;
+    gint         n_queued;
+    gint         n_sleeping;
+    gint         n_running;     /* tasks that are not done yet */
+    GMutex       sleep_lock;
+    GCond        sleep_cond;
+    GError      *error;
+    gboolean    *aborted;
+};
+
+struct _UfoStealingSchedulerPrivate {
+    gboolean ran;
+    gboolean aborted;
+    guint    n_workers;
+    Task   **tasks;
+    guint    n_tasks;
+};
+
+enum {
+    PROP_0,
+    PROP_NUM_WORKERS,
+    N_PROPERTIES
+};
+
+static GParamSpec *properties[N_PROPERTIES] = { NULL, };
+
+static GPrivate current_worker = G_PRIVATE_INIT (NULL);
+
+/**
+ * UfoStealingSchedulerError:
+ * @UFO_STEALING_SCHEDULER_ERROR_SETUP: Could not start scheduler due to error
+ */
+GQuark
+ufo_stealing_scheduler_error_quark (void)
+{
+    return g_quark_from_static_string ("ufo-stealing-scheduler-error-quark");
+}
+
+/**
+ * ufo_stealing_scheduler_new:
+ *
+ * Creates a new #UfoStealingScheduler.
+ *
+ * Return value: A new #UfoBaseScheduler
+ */
+UfoBaseScheduler *
+ufo_stealing_scheduler_new (void)
+{
+    return UFO_BASE_SCHEDULER (g_object_new (UFO_TYPE_STEALING_SCHEDULER, NULL));
+}
+
+static void
+push_task (Pool *pool,
+           Task *task)
+{
+    Worker *worker;
+
+    /* Keep follow-up work local, it is likely to touch the same data */
+    worker = g_private_get (&current_worker);
+
+    if (worker == NULL || worker->pool != pool)
+        worker = &pool->workers[((guint) g_atomic_int_add (&pool->next_worker, 1)) % pool->n_workers];
+
+    g_mutex_lock (&worker->lock);
+    g_queue_push_tail (&worker->tasks, task);
+    g_mutex_unlock (&worker->lock);
+
+    g_atomic_int_inc (&pool->n_queued);
+
+    if (g_atomic_int_get (&pool->n_sleeping) > 0) {
+        g_mutex_lock (&pool->sleep_lock);
+        g_cond_signal (&pool->sleep_cond);
+        g_mutex_unlock (&pool->sleep_lock);
+    }
+}
+
+static Task *
+pop_task (Worker *worker)
+{
+    Pool *pool = worker->pool;
+    Task *task;
+    guint index;
+
+    /* Newest own work first ... */
+    g_mutex_lock (&worker->lock);
+    task = g_queue_pop_tail (&worker->tasks);
+    g_mutex_unlock (&worker->lock);
+
+    /* ... then the oldest work of the others */
+    index = (guint) (worker - pool->workers);
+
+    for (guint i = 1; task == NULL && i < pool->n_workers; i++) {
+        Worker *victim = &pool->workers[(index + i) % pool->n_workers];
+
+        g_mutex_lock (&victim->lock);
+        task = g_queue_pop_head (&victim->tasks);
+        g_mutex_unlock (&victim->lock);
+    }
+
+    if (task != NULL)
+        g_atomic_int_add (&pool->n_queued, -1);
+
+    return task;
+}
+
+/*
+ * Make sure that @task runs again, either because it is idle and is queued
+ * now or because its current step re-queues it when it is done.
+ */
+static void
+notify_task (Task *task)
+{
+    for (;;) {
+        gint state = g_atomic_int_get (&task->state);
+
+        if (state == TASK_IDLE) {
+            if (g_atomic_int_compare_and_exchange (&task->state, TASK_IDLE, TASK_QUEUED)) {
+                push_task (task->pool, task);
+                return;
+            }
+        }
+        else if (state == TASK_RUNNING) {
+            if (g_atomic_int_compare_and_exchange (&task->state, TASK_RUNNING, TASK_RUNNING_NOTIFIED))
+                return;
+        }
+        else
+            return;
+    }
+}
+
+static void
+set_error (Pool *pool,
+           GError *error)
+{
+    g_mutex_lock (&pool->sleep_lock);
+
+    if (pool->error == NULL)
+        pool->error = error;
+    else
+        g_error_free (error);
+
+    g_mutex_unlock (&pool->sleep_lock);
+}
+
+/*
+ * Take one buffer from every input that is still running. Buffers taken
+ * during an earlier, blocked attempt are kept.
+ */
+static gboolean
+acquire_inputs (Task *task)
+{
+    UfoTaskNode *node = UFO_TASK_NODE (task->task);
+
+    for (guint i = 0; i < task->n_inputs; i++) {
+        UfoBuffer *input;
+
+        if (task->finished[i] || task->acquired[i])
+            continue;
+
+        input = ufo_group_try_pop_input_buffer (ufo_task_node_get_current_in_group (node, i), task->task);
+
+        if (input == NULL)
+            return FALSE;
+
+        if (input == UFO_END_OF_STREAM) {
+            task->finished[i] = TRUE;
+        }
+        else {
+            ufo_convert_input_on_device (task->task, task->resources, input);
+            task->inputs[i] = input;
+            task->acquired[i] = TRUE;
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean
+inputs_finished (Task *task)
+{
+    for (guint i = 0; i < task->n_inputs; i++) {
+        if (!task->finished[i])
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+release_inputs (Task *task)
+{
+    UfoTaskNode *node = UFO_TASK_NODE (task->task);
+
+    for (guint i = 0; i < task->n_inputs; i++) {
+        if (task->acquired[i]) {
+            ufo_group_push_input_buffer (ufo_task_node_get_current_in_group (node, i), task->task, task->inputs[i]);
+            ufo_task_node_switch_in_group (node, i);
+            task->acquired[i] = FALSE;
+        }
+    }
+}
+
+static gboolean
+acquire_output (Task *task)
+{
+    GError *error = NULL;
+
+    if (task->output != NULL)
+        return TRUE;
+
+    if (!task->have_requisition) {
+        ufo_task_get_requisition (task->task, task->inputs, &task->requisition, &error);
+
+        if (error != NULL) {
+            set_error (task->pool, error);
+            task->draining = TRUE;
+            return FALSE;
+        }
+
+        task->have_requisition = TRUE;
+    }
+
+    task->output = ufo_group_try_pop_output_buffer (ufo_task_node_get_out_group (UFO_TASK_NODE (task->task)),
+                                                    &task->requisition);
+
+    return task->output != NULL;
+}
+
+static void
+push_output (Task *task)
+{
+    ufo_group_push_output_buffer (ufo_task_node_get_out_group (UFO_TASK_NODE (task->task)), task->output);
+    task->output = NULL;
+
+    if (task->mode != UFO_TASK_MODE_REDUCTOR)
+        task->have_requisition = FALSE;
+}
+
+/*
+ * Give back an output buffer that was acquired but will never be filled, so
+ * that it is not lost from the fixed set of buffers of the group.
+ */
+static void
+return_output (Task *task)
+{
+    ufo_group_return_output_buffer (ufo_task_node_get_out_group (UFO_TASK_NODE (task->task)), task->output);
+    task->output = NULL;
+}
+
+static gboolean
+run_process (Task *task)
+{
+    UfoProfiler *profiler;
+    gboolean result;
+
+    profiler = ufo_task_node_get_profiler (UFO_TASK_NODE (task->task));
+    ufo_profiler_start (profiler, UFO_PROFILER_TIMER_CPU);
+    result = ufo_task_process (task->task, task->inputs, task->output, &task->requisition);
+    ufo_profiler_stop (profiler, UFO_PROFILER_TIMER_CPU);
+    return result;
+}
+
+static gboolean
+run_generate (Task *task)
+{
+    UfoProfiler *profiler;
+    gboolean result;
+
+    profiler = ufo_task_node_get_profiler (UFO_TASK_NODE (task->task));
+    ufo_profiler_start (profiler, UFO_PROFILER_TIMER_CPU);
+    result = ufo_task_generate (task->task, task->output, &task->requisition);
+    ufo_profiler_stop (profiler, UFO_PROFILER_TIMER_CPU);
+    return result;
+}
+
+static StepResult
+generate_step (Task *task)
+{
+    if (!acquire_output (task))
+        return task->draining ? STEP_FINISHED : STEP_BLOCKED;
+
+    ufo_buffer_discard_location (task->output);
+
+    if (task->timestamps) {
+        GValue v = { 0, };
+
+        g_value_init (&v, G_TYPE_INT64);
+        g_value_set_int64 (&v, g_get_real_time ());
+        ufo_buffer_set_metadata (task->output, "ts", &v);
+    }
+
+    if (!run_generate (task))
+        return STEP_FINISHED;
+
+    push_output (task);
+    return STEP_PROGRESS;
+}
+
+static StepResult
+process_step (Task *task)
+{
+    if (!acquire_inputs (task))
+        return STEP_BLOCKED;
+
+    if (inputs_finished (task)) {
+        ufo_task_inputs_stopped_callback (task->task);
+        return STEP_FINISHED;
+    }
+
+    if (task->mode == UFO_TASK_MODE_PROCESSOR) {
+        if (!acquire_output (task))
+            return task->draining ? STEP_FINISHED : STEP_BLOCKED;
+
+        ufo_buffer_discard_location (task->output);
+
+        for (guint i = 0; i < task->n_inputs; i++) {
+            if (task->acquired[i])
+                ufo_buffer_copy_metadata (task->inputs[i], task->output);
+        }
+
+        ufo_buffer_set_layout (task->output, ufo_buffer_get_layout (task->inputs[0]));
+    }
+    else if (!task->have_requisition) {
+        GError *error = NULL;
+
+        ufo_task_get_requisition (task->task, task->inputs, &task->requisition, &error);
+
+        if (error != NULL) {
+            set_error (task->pool, error);
+            task->draining = TRUE;
+            return STEP_FINISHED;
+        }
+    }
+
+    if (!run_process (task))
+        return STEP_FINISHED;
+
+    if (task->output != NULL)
+        push_output (task);
+
+    task->have_requisition = FALSE;
+    release_inputs (task);
+    return STEP_PROGRESS;
+}
+
+static StepResult
+reduce_step (Task *task)
+{
+    if (!task->generating) {
+        if (!acquire_inputs (task))
+            return STEP_BLOCKED;
+
+        if (inputs_finished (task)) {
+            ufo_task_inputs_stopped_callback (task->task);
+
+            /* Nothing to generate from if no data ever arrived */
+            if (!task->processed)
+                return STEP_FINISHED;
+
+            task->stopped = TRUE;
+            task->generating = TRUE;
+            return STEP_PROGRESS;
+        }
+
+        /* The requisition of the first input applies to all outputs */
+        if (!acquire_output (task))
+            return task->draining ? STEP_FINISHED : STEP_BLOCKED;
+
+        task->processed = TRUE;
+        task->generating = !run_process (task);
+        release_inputs (task);
+        return STEP_PROGRESS;
+    }
+
+    if (!acquire_output (task))
+        return task->draining ? STEP_FINISHED : STEP_BLOCKED;
+
+    if (!run_generate (task)) {
+        if (task->stopped)
+            return STEP_FINISHED;
+
+        task->generating = FALSE;
+        return STEP_PROGRESS;
+    }
+
+    push_output (task);
+    return STEP_PROGRESS;
+}
+
+/*
+ * Return everything a finished task still receives, so that its predecessors
+ * are not stuck waiting for their buffers.
+ */
+static StepResult
+drain_step (Task *task)
+{
+    UfoTaskNode *node = UFO_TASK_NODE (task->task);
+    gboolean progress = FALSE;
+
+    release_inputs (task);
+
+    for (guint i = 0; i < task->n_inputs; i++) {
+        while (!task->finished[i]) {
+            UfoGroup *group;
+            UfoBuffer *input;
+
+            group = ufo_task_node_get_current_in_group (node, i);
+            input = ufo_group_try_pop_input_buffer (group, task->task);
+
+            if (input == NULL)
+                break;
+
+            progress = TRUE;
+
+            if (input == UFO_END_OF_STREAM) {
+                task->finished[i] = TRUE;
+            }
+            else {
+                ufo_group_push_input_buffer (group, task->task, input);
+                ufo_task_node_switch_in_group (node, i);
+            }
+        }
+    }
+
+    if (inputs_finished (task))
+        return STEP_FINISHED;
+
+    return progress ? STEP_PROGRESS : STEP_BLOCKED;
+}
+
+static void
+notify_neighbors (Task *task)
+{
+    GList *it;
+
+    g_list_for (task->neighbors, it) {
+        notify_task ((Task *) it->data);
+    }
+}
+
+static void
+finish_task (Task *task)
+{
+    Pool *pool = task->pool;
+
+    g_atomic_int_set (&task->state, TASK_DONE);
+    notify_neighbors (task);
+
+    if (g_atomic_int_dec_and_test (&pool->n_running)) {
+        g_mutex_lock (&pool->sleep_lock);
+        g_cond_broadcast (&pool->sleep_cond);
+        g_mutex_unlock (&pool->sleep_lock);
+    }
+}
+
+static void
+run_step (Task *task)
+{
+    StepResult result;
+
+    g_atomic_int_set (&task->state, TASK_RUNNING);
+
+    if (task->draining) {
+        result = drain_step (task);
+
+        if (result == STEP_FINISHED) {
+            finish_task (task);
+            return;
+        }
+    }
+    else if (*task->pool->aborted) {
+        result = STEP_FINISHED;
+    }
+    else {
+        switch (task->mode) {
+            case UFO_TASK_MODE_GENERATOR:
+                result = generate_step (task);
+                break;
+            case UFO_TASK_MODE_PROCESSOR:
+            case UFO_TASK_MODE_SINK:
+                result = process_step (task);
+                break;
+            case UFO_TASK_MODE_REDUCTOR:
+                result = reduce_step (task);
+                break;
+            default:
+                g_warning ("Invalid task mode: %i\n", task->mode);
+                result = STEP_FINISHED;
+        }
+    }
+
+    if (result == STEP_FINISHED) {
+        if (task->output != NULL)
+            return_output (task);
+
+        /* Successors see the end of the stream, inputs are given back */
+        ufo_group_finish (ufo_task_node_get_out_group (UFO_TASK_NODE (task->task)));
+        task->draining = TRUE;
+        result = STEP_PROGRESS;
+    }
+
+    if (result == STEP_PROGRESS) {
+        notify_neighbors (task);
+        g_atomic_int_set (&task->state, TASK_QUEUED);
+        push_task (task->pool, task);
+    }
+    else if (!g_atomic_int_compare_and_exchange (&task->state, TASK_RUNNING, TASK_IDLE)) {
+        /* Data arrived while we were looking, try again */
+        g_atomic_int_set (&task->state, TASK_QUEUED);
+        push_task (task->pool, task);
+    }
+}
+
+static gpointer
+run_worker (Worker *worker)
+{
+    Pool *pool = worker->pool;
+
+    g_private_set (&current_worker, worker);
+
+    if (worker->cpu_node != NULL)
+        ufo_cpu_node_bind (worker->cpu_node);
+
+    while (g_atomic_int_get (&pool->n_running) > 0) {
+        Task *task = pop_task (worker);
+
+        if (task != NULL) {
+            run_step (task);
+            continue;
+        }
+
+        g_mutex_lock (&pool->sleep_lock);
+        g_atomic_int_inc (&pool->n_sleeping);
+
+        while (g_atomic_int_get (&pool->n_queued) <= 0 && g_atomic_int_get (&pool->n_running) > 0)
+            g_cond_wait (&pool->sleep_cond, &pool->sleep_lock);
+
+        g_atomic_int_add (&pool->n_sleeping, -1);
+        g_mutex_unlock (&pool->sleep_lock);
+    }
+
+    g_private_set (&current_worker, NULL);
+    return NULL;
+}
+
+static void
+join_workers (Pool *pool)
+{
+    for (guint i = 0; i < pool->n_workers; i++)
+        g_thread_join (pool->threads[i]);
+}
+
+static void
+free_tasks (Task **tasks,
+            guint n_tasks)
+{
+    for (guint i = 0; i < n_tasks; i++) {
+        if (tasks[i] == NULL)
+            continue;
+
+        ufo_task_node_reset (UFO_TASK_NODE (tasks[i]->task));
+        g_list_free (tasks[i]->neighbors);
+        g_free (tasks[i]->inputs);
+        g_free (tasks[i]->acquired);
+        g_free (tasks[i]->finished);
+        g_free (tasks[i]);
+    }
+
+    g_free (tasks);
+}
+
+static Task **
+setup_tasks (UfoBaseScheduler *scheduler,
+             UfoTaskGraph *graph,
+             UfoResources *resources,
+             GList *nodes,
+             GError **error)
+{
+    Task **tasks;
+    GHashTable *lookup;
+    gboolean timestamps;
+    guint n_tasks;
+    guint i = 0;
+    gboolean success = TRUE;
+    GList *it;
+
+    g_object_get (scheduler, "timestamps", &timestamps, NULL);
+
+    n_tasks = g_list_length (nodes);
+    tasks = g_new0 (Task *, n_tasks);
+    lookup = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    g_list_for (nodes, it) {
+        Task *task;
+        GError *tmp_error = NULL;
+
+        task = g_new0 (Task, 1);
+        task->task = UFO_TASK (it->data);
+        task->resources = resources;
+        task->timestamps = timestamps;
+        task->state = TASK_IDLE;
+        tasks[i++] = task;
+        g_hash_table_insert (lookup, it->data, task);
+
+        ufo_task_setup (task->task, resources, &tmp_error);
+
+        if (tmp_error != NULL) {
+            g_propagate_error (error, tmp_error);
+            success = FALSE;
+            break;
+        }
+
+        task->mode = ufo_task_get_mode (task->task) & UFO_TASK_MODE_TYPE_MASK;
+        task->n_inputs = ufo_task_get_num_inputs (task->task);
+        task->inputs = g_new0 (UfoBuffer *, MAX (task->n_inputs, 1));
+        task->acquired = g_new0 (gboolean, MAX (task->n_inputs, 1));
+        task->finished = g_new0 (gboolean, MAX (task->n_inputs, 1));
+
+        if (!ufo_check_target_connections (graph, UFO_NODE (it->data), task->n_inputs, error)) {
+            success = FALSE;
+            break;
+        }
+    }
+
+    if (!success) {
+        g_hash_table_destroy (lookup);
+        free_tasks (tasks, n_tasks);
+        return NULL;
+    }
+
+    /* Tasks are woken up by their predecessors and successors */
+    for (i = 0; i < n_tasks; i++) {
+        GList *neighbors;
+
+        neighbors = g_list_concat (ufo_graph_get_predecessors (UFO_GRAPH (graph), UFO_NODE (tasks[i]->task)),
+                                   ufo_graph_get_successors (UFO_GRAPH (graph), UFO_NODE (tasks[i]->task)));
+
+        g_list_for (neighbors, it) {
+            tasks[i]->neighbors = g_list_prepend (tasks[i]->neighbors, g_hash_table_lookup (lookup, it->data));
+        }
+
+        g_list_free (neighbors);
+    }
+
+    g_hash_table_destroy (lookup);
+    return tasks;
+}
+
+/*
+ * A step produces exactly one output buffer, so tasks with several output
+ * ports are not supported.
+ */
+static gboolean
+check_outputs (GList *nodes,
+               GError **error)
+{
+    GList *it;
+
+    g_list_for (nodes, it) {
+        if (ufo_task_get_num_outputs (UFO_TASK (it->data)) > 1) {
+            g_set_error (error, UFO_STEALING_SCHEDULER_ERROR, UFO_STEALING_SCHEDULER_ERROR_SETUP,
+                         "`%s' uses more than one output which is not supported",
+                         ufo_task_node_get_identifier (UFO_TASK_NODE (it->data)));
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/*
+ * Tasks that wait for the user inside a step occupy a worker for an unbounded
+ * time. Make sure there is always one worker left for the other tasks.
+ */
+static guint
+get_num_workers (UfoStealingSchedulerPrivate *priv,
+                 Task **tasks,
+                 guint n_tasks)
+{
+    guint n_blocking = 0;
+    guint n_workers;
+
+    for (guint i = 0; i < n_tasks; i++) {
+        if (UFO_IS_INPUT_TASK (tasks[i]->task) || UFO_IS_OUTPUT_TASK (tasks[i]->task))
+            n_blocking++;
+    }
+
+    n_workers = priv->n_workers > 0 ? priv->n_workers : (guint) g_get_num_processors ();
+    return MIN (MAX (n_workers, n_blocking + 1), n_tasks);
+}
+
+static void
+run_pool (UfoStealingSchedulerPrivate *priv,
+          Task **tasks,
+          guint n_tasks,
+          GList *cpu_nodes,
+          GError **error)
+{
+    Pool pool;
+
+    pool.n_workers = get_num_workers (priv, tasks, n_tasks);
+    pool.workers = g_new0 (Worker, pool.n_workers);
+    pool.threads = g_new0 (GThread *, pool.n_workers);
+    pool.next_worker = 0;
+    pool.n_queued = 0;
+    pool.n_sleeping = 0;
+    pool.n_running = (gint) n_tasks;
+    pool.error = NULL;
+    pool.aborted = &priv->aborted;
+    g_mutex_init (&pool.sleep_lock);
+    g_cond_init (&pool.sleep_cond);
+
+    for (guint i = 0; i < pool.n_workers; i++) {
+        g_mutex_init (&pool.workers[i].lock);
+        g_queue_init (&pool.workers[i].tasks);
+        pool.workers[i].pool = &pool;
+
+        /* Tasks are not bound to workers, so spread the workers instead */
+        if (cpu_nodes != NULL)
+            pool.workers[i].cpu_node = g_list_nth_data (cpu_nodes, i % g_list_length (cpu_nodes));
+    }
+
+    /* Every task gets a first chance to run, afterwards data drives them */
+    for (guint i = 0; i < n_tasks; i++) {
+        tasks[i]->pool = &pool;
+        tasks[i]->state = TASK_QUEUED;
+        push_task (&pool, tasks[i]);
+    }
+
+    for (guint i = 0; i < pool.n_workers; i++)
+        pool.threads[i] = g_thread_new (NULL, (GThreadFunc) run_worker, &pool.workers[i]);
+
+#ifdef WITH_PYTHON
+    if (Py_IsInitialized ()) {
+        PyGILState_STATE state = PyGILState_Ensure ();
+        Py_BEGIN_ALLOW_THREADS
+
+        join_workers (&pool);
+
+        Py_END_ALLOW_THREADS
+        PyGILState_Release (state);
+    }
+    else {
+        join_workers (&pool);
+    }
+#else
+    join_workers (&pool);
+#endif
+
+    if (pool.error != NULL)
+        g_propagate_error (error, pool.error);
+
+    for (guint i = 0; i < pool.n_workers; i++)
+        g_mutex_clear (&pool.workers[i].lock);
+
+    g_mutex_clear (&pool.sleep_lock);
+    g_cond_clear (&pool.sleep_cond);
+    g_free (pool.workers);
+    g_free (pool.threads);
+}
+
+static void
+ufo_stealing_scheduler_run (UfoBaseScheduler *scheduler,
+                            UfoTaskGraph *graph,
+                            GError **error)
+{
+    UfoStealingSchedulerPrivate *priv;
+    UfoResources *resources;
+    GList *gpu_nodes;
+    GList *cpu_nodes;
+    GList *groups;
+    GList *nodes;
+    GError *tmp_error = NULL;
+    Task **tasks;
+    guint n_tasks;
+    UfoTwoWayQueueBackend backend;
+
+    priv = UFO_STEALING_SCHEDULER_GET_PRIVATE (scheduler);
+    priv->aborted = FALSE;
+
+    resources = ufo_base_scheduler_get_resources (scheduler, error);
+
+    if (resources == NULL)
+        return;
+
+    gpu_nodes = ufo_resources_get_gpu_nodes (resources);
+
+    if (!ufo_setup_task_graph (scheduler, graph, resources, gpu_nodes, !priv->ran, error)) {
+        g_list_free (gpu_nodes);
+        return;
+    }
+
+    nodes = ufo_graph_get_nodes (UFO_GRAPH (graph));
+    cpu_nodes = ufo_base_scheduler_get_cpu_nodes (scheduler);
+
+    if (!check_outputs (nodes, error)) {
+        g_list_free (nodes);
+        g_list_free (gpu_nodes);
+        g_list_free (cpu_nodes);
+        return;
+    }
+
+    tasks = setup_tasks (scheduler, graph, resources, nodes, error);
+    n_tasks = g_list_length (nodes);
+
+    if (tasks == NULL) {
+        g_list_free (nodes);
+        g_list_free (gpu_nodes);
+        g_list_free (cpu_nodes);
+        return;
+    }
+
+    g_object_get (scheduler, "queue-backend", &backend, NULL);
+    groups = ufo_setup_groups (graph, resources, backend, 0);
+
+    if (ufo_check_connections (graph, &tmp_error)) {
+        priv->tasks = tasks;
+        priv->n_tasks = n_tasks;
+        run_pool (priv, tasks, n_tasks, cpu_nodes, error);
+        priv->tasks = NULL;
+        priv->n_tasks = 0;
+    }
+    else {
+        g_propagate_error (error, tmp_error);
+    }
+
+    free_tasks (tasks, n_tasks);
+    g_list_foreach (groups, (GFunc) g_object_unref, NULL);
+    g_list_free (groups);
+    g_list_free (nodes);
+    g_list_free (gpu_nodes);
+    g_list_free (cpu_nodes);
+
+    priv->ran = TRUE;
+}
+
+static void
+ufo_stealing_scheduler_abort (UfoBaseScheduler *scheduler)
+{
+    UfoStealingSchedulerPrivate *priv;
+
+    priv = UFO_STEALING_SCHEDULER_GET_PRIVATE (scheduler);
+    priv->aborted = TRUE;
+
+    /* Wake up tasks that wait for data which may never come */
+    for (guint i = 0; i < priv->n_tasks; i++)
+        notify_task (priv->tasks[i]);
+}
+
+static void
+ufo_stealing_scheduler_set_property (GObject *object,
+                                     guint property_id,
+                                     const GValue *value,
+                                     GParamSpec *pspec)
+{
+    UfoStealingSchedulerPrivate *priv = UFO_STEALING_SCHEDULER_GET_PRIVATE (object);
+
+    switch (property_id) {
+        case PROP_NUM_WORKERS:
+            priv->n_workers = g_value_get_uint (value);
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+            break;
+    }
+}
+
+static void
+ufo_stealing_scheduler_get_property (GObject *object,
+                                     guint property_id,
+                                     GValue *value,
+                                     GParamSpec *pspec)
+{
+    UfoStealingSchedulerPrivate *priv = UFO_STEALING_SCHEDULER_GET_PRIVATE (object);
+
+    switch (property_id) {
+        case PROP_NUM_WORKERS:
+            g_value_set_uint (value, priv->n_workers);
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+            break;
+    }
+}
+
+static void
+ufo_stealing_scheduler_class_init (UfoStealingSchedulerClass *klass)
+{
+    GObjectClass *oclass;
+    UfoBaseSchedulerClass *sclass;
+
+    oclass = G_OBJECT_CLASS (klass);
+    oclass->set_property = ufo_stealing_scheduler_set_property;
+    oclass->get_property = ufo_stealing_scheduler_get_property;
+
+    sclass = UFO_BASE_SCHEDULER_CLASS (klass);
+    sclass->run = ufo_stealing_scheduler_run;
+    sclass->abort = ufo_stealing_scheduler_abort;
+
+    properties[PROP_NUM_WORKERS] =
+        g_param_spec_uint ("num-workers",
+                           "Number of worker threads, 0 uses one per processor",
+                           "Number of worker threads, 0 uses one per processor",
+                           0, G_MAXUINT, 0,
+                           G_PARAM_READWRITE);
+
+    for (guint i = PROP_0 + 1; i < N_PROPERTIES; i++)
+        g_object_class_install_property (oclass, i, properties[i]);
+
+    g_type_class_add_private (klass, sizeof (UfoStealingSchedulerPrivate));
+}
+
+static void
+ufo_stealing_scheduler_init (UfoStealingScheduler *scheduler)
+{
+    UfoStealingSchedulerPrivate *priv;
+
+    scheduler->priv = priv = UFO_STEALING_SCHEDULER_GET_PRIVATE (scheduler);
+    priv->ran = FALSE;
+    priv->aborted = FALSE;
+    priv->n_workers = 0;
+    priv->tasks = NULL;
+    priv->n_tasks = 0;
+}
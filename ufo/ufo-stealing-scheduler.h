@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2011-2013 Karlsruhe Institute of Technology
+ *
+ * This file is part of Ufo.
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UFO_STEALING_SCHEDULER_H
+#define __UFO_STEALING_SCHEDULER_H
+
+#if !defined (__UFO_H_INSIDE__) && !defined (UFO_COMPILATION)
+#error "Only <ufo/ufo.h> can be included directly."
+#endif
+
+#include <ufo/ufo-base-scheduler.h>
+
+G_BEGIN_DECLS
+
+#define UFO_TYPE_STEALING_SCHEDULER             (ufo_stealing_scheduler_get_type())
+#define UFO_STEALING_SCHEDULER(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), UFO_TYPE_STEALING_SCHEDULER, UfoStealingScheduler))
+#define UFO_IS_STEALING_SCHEDULER(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), UFO_TYPE_STEALING_SCHEDULER))
+#define UFO_STEALING_SCHEDULER_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), UFO_TYPE_STEALING_SCHEDULER, UfoStealingSchedulerClass))
+#define UFO_IS_STEALING_SCHEDULER_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), UFO_TYPE_STEALING_SCHEDULER))
+#define UFO_STEALING_SCHEDULER_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS((obj), UFO_TYPE_STEALING_SCHEDULER, UfoStealingSchedulerClass))
+
+#define UFO_STEALING_SCHEDULER_ERROR            ufo_stealing_scheduler_error_quark()
+
+typedef struct _UfoStealingScheduler           UfoStealingScheduler;
+typedef struct _UfoStealingSchedulerClass      UfoStealingSchedulerClass;
+typedef struct _UfoStealingSchedulerPrivate    UfoStealingSchedulerPrivate;
+
+typedef enum {
+    UFO_STEALING_SCHEDULER_ERROR_SETUP
+} UfoStealingSchedulerError;
+
+/**
+ * UfoStealingScheduler:
+ *
+ * A scheduler that runs the steps of all tasks on a fixed pool of worker
+ * threads. The contents of the #UfoStealingScheduler structure are private
+ * and should only be accessed via the provided API.
+ */
+struct _UfoStealingScheduler {
+    /*< private >*/
+    UfoBaseScheduler parent_instance;
+
+    UfoStealingSchedulerPrivate *priv;
+};
+
+/**
+ * UfoStealingSchedulerClass:
+ *
+ * #UfoStealingScheduler class
+ */
+struct _UfoStealingSchedulerClass {
+    /*< private >*/
+    UfoBaseSchedulerClass parent_class;
+};
+
+UfoBaseScheduler
+        *ufo_stealing_scheduler_new          (void);
+GType    ufo_stealing_scheduler_get_type     (void);
+GQuark   ufo_stealing_scheduler_error_quark  (void);
+
+G_END_DECLS
+
+#endif
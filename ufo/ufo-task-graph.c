@@ -24,9 +24,11 @@
 #include <json-glib/json-glib.h>
 
 #include "ufo-task-graph.h"
+#include "ufo-cpu-node.h"
 #include "ufo-task-node.h"
 #include "ufo-input-task.h"
 #include "ufo-dummy-task.h"
+#include "ufo-fused-task.h"
 #include "ufo-priv.h"
 
 /**
@@ -46,6 +48,9 @@ G_DEFINE_TYPE (UfoTaskGraph, ufo_task_graph, UFO_TYPE_GRAPH)
 struct _UfoTaskGraphPrivate {
     UfoPluginManager *manager;
     GHashTable *json_nodes;
+    GHashTable *costs;      /* plugin name -> gdouble seconds per item */
+    GHashTable *mapping;    /* task node -> index of GPU + 1 */
+    GHashTable *elapsed;    /* task node -> gdouble time measured so far */
     guint index;
     guint total;
 };
@@ -66,14 +71,21 @@ static void handle_json_task_edge   (JsonArray *, guint, JsonNode *, gpointer);
 static void add_task_node_to_json_array (UfoTaskNode *, JsonArray *);
 static JsonObject *json_object_from_ufo_node (UfoNode *node);
 static JsonNode *get_json_representation (UfoTaskGraph *, GError **);
+static gdouble get_node_cost (UfoTaskGraph *graph, UfoNode *node);
 static UfoTaskNode *create_node_from_json (JsonNode *json_node,UfoPluginManager *manager, GError **error);
 
 /*
  * ChangeLog:
  * - 1.1: Add "index" and "total" keys to the root object
  * - 2.0: Add "index" and "total" keys to the root object
+ * - 2.1: Add optional "mapping" array with device and cost of mapped tasks
  */
-static const gchar *JSON_API_VERSION = "2.0";
+static const gchar *JSON_API_VERSION = "2.1";
+
+/* Cost of a task whose cost was never measured */
+#define UFO_DEFAULT_COST    1.0
+
+static const gchar *COST_GROUP = "costs";
 
 /**
  * UfoTaskGraphError:
@@ -213,18 +225,21 @@ get_json_representation (UfoTaskGraph *graph,
 
         g_list_for (successors, jt) {
             UfoNode *to;
-            gint port;
+            gpointer label;
             JsonObject *to_object;
             JsonObject *from_object;
             JsonObject *edge_object;
 
             to = UFO_NODE (jt->data);
-            port = GPOINTER_TO_INT (ufo_graph_get_edge_label (UFO_GRAPH (graph), from, to));
+            label = ufo_graph_get_edge_label (UFO_GRAPH (graph), from, to);
             to_object  = json_object_from_ufo_node (to);
             from_object = json_object_from_ufo_node (from);
             edge_object = json_object_new ();
 
-            json_object_set_int_member (to_object, "input", port);
+            if (UFO_EDGE_LABEL_OUTPUT (label) > 0)
+                json_object_set_int_member (from_object, "output", UFO_EDGE_LABEL_OUTPUT (label));
+
+            json_object_set_int_member (to_object, "input", UFO_EDGE_LABEL_INPUT (label));
             json_object_set_object_member (edge_object, "to", to_object);
             json_object_set_object_member (edge_object, "from", from_object);
             json_array_add_object_element (edges, edge_object);
@@ -233,6 +248,27 @@ get_json_representation (UfoTaskGraph *graph,
         g_list_free (successors);
     }
 
+    if (g_hash_table_size (graph->priv->mapping) > 0) {
+        JsonArray *mapping = json_array_new ();
+
+        g_list_for (task_nodes, it) {
+            gpointer device;
+            JsonObject *map_object;
+
+            device = g_hash_table_lookup (graph->priv->mapping, it->data);
+
+            if (device == NULL)
+                continue;
+
+            map_object = json_object_from_ufo_node (UFO_NODE (it->data));
+            json_object_set_int_member (map_object, "device", GPOINTER_TO_INT (device) - 1);
+            json_object_set_double_member (map_object, "cost", get_node_cost (graph, UFO_NODE (it->data)));
+            json_array_add_object_element (mapping, map_object);
+        }
+
+        json_object_set_array_member (root_object, "mapping", mapping);
+    }
+
     json_object_set_string_member (root_object, "version", JSON_API_VERSION);
     json_object_set_array_member (root_object, "nodes", nodes);
     json_object_set_array_member (root_object, "edges", edges);
@@ -314,25 +350,315 @@ ufo_task_graph_get_json_data (UfoTaskGraph *graph,
 }
 
 static gboolean
-is_gpu_task (UfoTask *task, gpointer user_data)
+is_data_parallel (UfoNode *node)
 {
-    return ufo_task_uses_gpu (task);
+    UfoTaskMode mode;
+
+    mode = ufo_task_get_mode (UFO_TASK (node));
+    return (mode & UFO_TASK_MODE_TYPE_MASK) == UFO_TASK_MODE_PROCESSOR;
 }
 
+static gboolean
+is_expandable (UfoNode *node)
+{
+    return is_data_parallel (node) && ufo_task_uses_gpu (UFO_TASK (node));
+}
+
+/*
+ * Collect all expandable nodes that are connected to @seed through other
+ * expandable nodes, in the order in which they appear in @nodes.
+ */
 static GList *
-nodes_with_common_ancestries (UfoTaskGraph *graph, GList *path)
+collect_region (UfoGraph *graph,
+                GList *nodes,
+                UfoNode *seed,
+                GHashTable *region)
+{
+    GQueue queue = G_QUEUE_INIT;
+    GList *members = NULL;
+    GList *it;
+
+    g_hash_table_add (region, seed);
+    g_queue_push_tail (&queue, seed);
+
+    while (!g_queue_is_empty (&queue)) {
+        UfoNode *node;
+        GList *neighbors;
+
+        node = UFO_NODE (g_queue_pop_head (&queue));
+        neighbors = g_list_concat (ufo_graph_get_predecessors (graph, node),
+                                   ufo_graph_get_successors (graph, node));
+
+        g_list_for (neighbors, it) {
+            if (!g_hash_table_contains (region, it->data) && is_expandable (UFO_NODE (it->data))) {
+                g_hash_table_add (region, it->data);
+                g_queue_push_tail (&queue, it->data);
+            }
+        }
+
+        g_list_free (neighbors);
+    }
+
+    g_list_for (nodes, it) {
+        if (g_hash_table_contains (region, it->data))
+            members = g_list_append (members, it->data);
+    }
+
+    return members;
+}
+
+static GHashTable *
+get_reachable (UfoGraph *graph,
+               GHashTable *region,
+               gboolean forward)
 {
-    GList *result = NULL;
+    GHashTable *reachable;
+    GHashTableIter iter;
+    GQueue queue = G_QUEUE_INIT;
+    gpointer node;
+
+    reachable = g_hash_table_new (g_direct_hash, g_direct_equal);
+    g_hash_table_iter_init (&iter, region);
+
+    while (g_hash_table_iter_next (&iter, &node, NULL))
+        g_queue_push_tail (&queue, node);
+
+    while (!g_queue_is_empty (&queue)) {
+        GList *next;
+        GList *it;
+
+        node = g_queue_pop_head (&queue);
+        next = forward ? ufo_graph_get_successors (graph, UFO_NODE (node)) :
+                         ufo_graph_get_predecessors (graph, UFO_NODE (node));
+
+        g_list_for (next, it) {
+            if (!g_hash_table_contains (reachable, it->data)) {
+                g_hash_table_add (reachable, it->data);
+                g_queue_push_tail (&queue, it->data);
+            }
+        }
+
+        g_list_free (next);
+    }
+
+    return reachable;
+}
+
+/*
+ * Add nodes that leave and re-enter the region, so that no stream crosses the
+ * boundary of a replica twice. Fails if one of them must see the whole stream.
+ */
+static gboolean
+close_region (UfoGraph *graph,
+              GList *nodes,
+              GHashTable *region,
+              GList **members)
+{
+    GHashTable *descendants;
+    GHashTable *ancestors;
+    GList *between = NULL;
     GList *it;
+    gboolean result = TRUE;
 
-    g_list_for (path, it) {
-        if (ufo_graph_get_num_predecessors (UFO_GRAPH (graph), UFO_NODE (it->data)) > 1)
-            result = g_list_append (result, it->data);
+    descendants = get_reachable (graph, region, TRUE);
+    ancestors = get_reachable (graph, region, FALSE);
+
+    g_list_for (nodes, it) {
+        if (g_hash_table_contains (descendants, it->data) &&
+            g_hash_table_contains (ancestors, it->data) &&
+            !g_hash_table_contains (region, it->data)) {
+            if (!is_data_parallel (UFO_NODE (it->data))) {
+                g_debug ("WARN `%s' lies between GPU tasks but is not a processor, not going to expand",
+                         ufo_task_node_get_plugin_name (UFO_TASK_NODE (it->data)));
+                result = FALSE;
+                break;
+            }
+
+            between = g_list_append (between, it->data);
+        }
     }
 
+    if (result) {
+        g_list_for (between, it)
+            g_hash_table_add (region, it->data);
+
+        g_list_free (*members);
+        *members = NULL;
+
+        g_list_for (nodes, it) {
+            if (g_hash_table_contains (region, it->data))
+                *members = g_list_append (*members, it->data);
+        }
+    }
+
+    g_list_free (between);
+    g_hash_table_destroy (descendants);
+    g_hash_table_destroy (ancestors);
     return result;
 }
 
+/*
+ * A stream that passed a reductor, such as an averaged flat field, consists of
+ * a few items that every replica needs.
+ */
+static gboolean
+is_reduced_stream (UfoGraph *graph,
+                   UfoNode *node)
+{
+    GHashTable *start;
+    GHashTable *ancestors;
+    GHashTableIter iter;
+    gpointer ancestor;
+    gboolean reduced;
+
+    reduced = (ufo_task_get_mode (UFO_TASK (node)) & UFO_TASK_MODE_TYPE_MASK) == UFO_TASK_MODE_REDUCTOR;
+
+    start = g_hash_table_new (g_direct_hash, g_direct_equal);
+    g_hash_table_add (start, node);
+    ancestors = get_reachable (graph, start, FALSE);
+    g_hash_table_iter_init (&iter, ancestors);
+
+    while (!reduced && g_hash_table_iter_next (&iter, &ancestor, NULL))
+        reduced = (ufo_task_get_mode (UFO_TASK (ancestor)) & UFO_TASK_MODE_TYPE_MASK) == UFO_TASK_MODE_REDUCTOR;
+
+    g_hash_table_destroy (ancestors);
+    g_hash_table_destroy (start);
+    return reduced;
+}
+
+/*
+ * A companion stream enters the region only at secondary inputs of nodes that
+ * join several streams. The primary stream is never broadcast, even if it
+ * comes out of a reductor that emits a whole stream, such as a stack.
+ */
+static gboolean
+is_companion (UfoGraph *graph,
+              GHashTable *region,
+              GList *edges,
+              UfoNode *source)
+{
+    GList *it;
+
+    g_list_for (edges, it) {
+        UfoEdge *edge = (UfoEdge *) it->data;
+
+        if (edge->source != source || !g_hash_table_contains (region, edge->target))
+            continue;
+
+        if (UFO_EDGE_LABEL_INPUT (edge->label) == 0 ||
+            ufo_task_get_num_inputs (UFO_TASK (edge->target)) < 2)
+            return FALSE;
+    }
+
+    return is_reduced_stream (graph, source);
+}
+
+/*
+ * Decide how each node feeding the region distributes its output among the
+ * replicas. Companion streams are broadcast, all other streams are scattered
+ * in the order in which the replicas are created. Because every scattered
+ * stream uses the same order, items with the same position in joined streams
+ * meet in the same replica.
+ */
+static gboolean
+prepare_entries (UfoGraph *graph,
+                 GHashTable *region,
+                 GList *edges)
+{
+    GList *sources = NULL;
+    GList *broadcast = NULL;
+    GList *it;
+    gboolean result = TRUE;
+
+    g_list_for (edges, it) {
+        UfoEdge *edge = (UfoEdge *) it->data;
+
+        if (!g_hash_table_contains (region, edge->source) &&
+            g_hash_table_contains (region, edge->target) &&
+            g_list_find (sources, edge->source) == NULL)
+            sources = g_list_append (sources, edge->source);
+    }
+
+    g_list_for (sources, it) {
+        UfoTaskNode *source = UFO_TASK_NODE (it->data);
+
+        if (is_companion (graph, region, edges, UFO_NODE (source))) {
+            broadcast = g_list_append (broadcast, source);
+        }
+        else if (ufo_task_node_get_send_pattern (source) == UFO_SEND_BROADCAST &&
+                 ufo_graph_get_num_successors (graph, UFO_NODE (source)) > 1) {
+            g_debug ("WARN `%s' broadcasts a stream into the GPU tasks, not going to expand",
+                     ufo_task_node_get_plugin_name (source));
+            result = FALSE;
+            break;
+        }
+    }
+
+    if (result) {
+        g_list_for (sources, it) {
+            UfoTaskNode *source = UFO_TASK_NODE (it->data);
+
+            if (g_list_find (broadcast, source) != NULL)
+                ufo_task_node_set_send_pattern (source, UFO_SEND_BROADCAST);
+            else if (ufo_task_node_get_send_pattern (source) == UFO_SEND_BROADCAST)
+                ufo_task_node_set_send_pattern (source, UFO_SEND_SCATTER);
+        }
+    }
+
+    g_list_free (broadcast);
+    g_list_free (sources);
+    return result;
+}
+
+static gboolean
+replicate_region (UfoGraph *graph,
+                  GList *members,
+                  GList *edges,
+                  GError **error)
+{
+    GHashTable *copies;
+    GList *it;
+    GError *tmp_error = NULL;
+
+    copies = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_object_unref);
+
+    g_list_for (members, it) {
+        UfoNode *copy;
+
+        copy = ufo_node_copy (UFO_NODE (it->data), &tmp_error);
+
+        if (tmp_error != NULL) {
+            g_propagate_prefixed_error (error, tmp_error, "%s: ",
+                                        ufo_task_node_get_plugin_name (UFO_TASK_NODE (it->data)));
+            g_hash_table_destroy (copies);
+            return FALSE;
+        }
+
+        g_hash_table_insert (copies, it->data, copy);
+    }
+
+    g_list_for (edges, it) {
+        UfoEdge *edge = (UfoEdge *) it->data;
+        UfoNode *source;
+        UfoNode *target;
+
+        source = g_hash_table_lookup (copies, edge->source);
+        target = g_hash_table_lookup (copies, edge->target);
+
+        if (source == NULL && target == NULL)
+            continue;
+
+        ufo_graph_connect_nodes (graph,
+                                 source != NULL ? source : edge->source,
+                                 target != NULL ? target : edge->target,
+                                 edge->label);
+    }
+
+    /* The graph holds its own references on the connected copies */
+    g_hash_table_destroy (copies);
+    return TRUE;
+}
+
 /**
  * ufo_task_graph_expand:
  * @graph: A #UfoTaskGraph
@@ -341,8 +667,12 @@ nodes_with_common_ancestries (UfoTaskGraph *graph, GList *path)
  * @error: error to pass on
  *
  * Expands @graph in a way that most of the resources in @graph can be occupied.
- * In the simple pipeline case, the longest possible GPU paths are duplicated as
- * much as there are GPUs in @arch_graph.
+ * Every connected subgraph of GPU processors, including nodes with multiple
+ * inputs, is replicated @n_gpus times. Inputs that stem from a reductor, for
+ * example averaged dark and flat fields, are broadcast to all replicas. All
+ * other input streams are scattered among the replicas in the same order, so
+ * that joined streams stay aligned, and the outputs of the replicas are
+ * collected in their original order.
  */
 void
 ufo_task_graph_expand (UfoTaskGraph *graph,
@@ -350,118 +680,235 @@ ufo_task_graph_expand (UfoTaskGraph *graph,
                        guint n_gpus,
                        GError **error)
 {
-    GList *path;
-    GList *common;
+    UfoGraph *ugraph;
+    GList *nodes;
+    GList *it;
+    GHashTable *visited;
     GError *tmp_error = NULL;
 
     g_return_if_fail (UFO_IS_TASK_GRAPH (graph));
 
-    path = ufo_graph_find_longest_path (UFO_GRAPH (graph), (UfoFilterPredicate) is_gpu_task, NULL);
-    common = nodes_with_common_ancestries (graph, path);
-
-    if (g_list_length (common) > 1) {
-        g_debug ("WARN More than one nodes have multiple inputs, not going to expand");
-        g_list_free (common);
-        g_list_free (path);
+    if (n_gpus < 2)
         return;
-    }
 
-    if (g_list_length (common) == 1) {
-        GList *it;
+    ugraph = UFO_GRAPH (graph);
+    nodes = ufo_graph_get_nodes (ugraph);
+    visited = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    g_list_for (nodes, it) {
+        GHashTable *region;
+        GList *members;
+        GList *edges;
+        GList *all_nodes;
+
+        if (g_hash_table_contains (visited, it->data) || !is_expandable (UFO_NODE (it->data)))
+            continue;
 
-        g_debug ("INFO Found node with multiple inputs, going to prune it");
-        it = g_list_first (path);
+        region = g_hash_table_new (g_direct_hash, g_direct_equal);
+        all_nodes = ufo_graph_get_nodes (ugraph);
+        members = collect_region (ugraph, all_nodes, UFO_NODE (it->data), region);
 
-        while (it->data != common->data) {
-            GList *jt = g_list_next (it);
+        for (GList *jt = members; jt != NULL; jt = g_list_next (jt))
+            g_hash_table_add (visited, jt->data);
 
-            path = g_list_remove_link (path, it);
-            it = jt;
+        edges = ufo_graph_get_edges (ugraph);
+
+        if (close_region (ugraph, all_nodes, region, &members) &&
+            prepare_entries (ugraph, region, edges)) {
+            g_debug ("INFO Expand %i tasks for %i GPU nodes", g_list_length (members), n_gpus);
+
+            for (guint i = 1; i < n_gpus; i++) {
+                if (!replicate_region (ugraph, members, edges, &tmp_error))
+                    break;
+            }
         }
 
-        /* remove the common node as well */
-        path = g_list_remove_link (path, it);
-        g_list_free (common);
+        g_list_free (edges);
+        g_list_free (members);
+        g_list_free (all_nodes);
+        g_hash_table_destroy (region);
+
+        if (tmp_error != NULL) {
+            g_propagate_error (error, tmp_error);
+            break;
+        }
     }
 
-    if (path != NULL && g_list_length (path) > 0) {
-        GList *predecessors;
-        GList *successors;
+    g_hash_table_destroy (visited);
+    g_list_free (nodes);
+}
 
-        /* Add predecessor and successor nodes to path */
-        predecessors = ufo_graph_get_predecessors (UFO_GRAPH (graph),
-                                                   UFO_NODE (g_list_first (path)->data));
+static gboolean
+is_fusable (UfoGraph *graph,
+            UfoNode *node)
+{
+    UfoTaskMode mode;
 
-        successors = ufo_graph_get_successors (UFO_GRAPH (graph),
-                                               UFO_NODE (g_list_last (path)->data));
+    if (!UFO_IS_TASK_NODE (node) || UFO_IS_FUSED_TASK (node) ||
+        UFO_IS_INPUT_TASK (node) || UFO_IS_DUMMY_TASK (node))
+        return FALSE;
 
-        if (predecessors != NULL)
-            path = g_list_prepend (path, g_list_first (predecessors)->data);
+    mode = ufo_task_get_mode (UFO_TASK (node));
 
-        if (successors != NULL)
-            path = g_list_append (path, g_list_first (successors)->data);
+    return (mode & UFO_TASK_MODE_TYPE_MASK) == UFO_TASK_MODE_PROCESSOR &&
+           (mode & UFO_TASK_MODE_GPU) &&
+           ufo_task_get_num_inputs (UFO_TASK (node)) == 1 &&
+           ufo_task_get_num_outputs (UFO_TASK (node)) == 1 &&
+           ufo_graph_get_num_predecessors (graph, node) == 1;
+}
 
-        g_list_free (predecessors);
+/*
+ * Return the longest chain starting at @first in which every node is fusable
+ * and the only consumer of its predecessor's output.
+ */
+static GList *
+find_chain (UfoGraph *graph,
+            UfoNode *first)
+{
+    GList *chain;
+    UfoNode *current;
+
+    chain = g_list_append (NULL, first);
+    current = first;
+
+    while (ufo_graph_get_num_successors (graph, current) == 1) {
+        GList *successors;
+        UfoNode *next;
+
+        successors = ufo_graph_get_successors (graph, current);
+        next = UFO_NODE (successors->data);
         g_list_free (successors);
 
-        g_debug ("INFO Expand for %i GPU nodes", n_gpus);
+        if (!is_fusable (graph, next) || g_list_find (chain, next) != NULL)
+            break;
 
-        for (guint i = 1; i < n_gpus; i++) {
-            ufo_graph_expand (UFO_GRAPH (graph), path, &tmp_error);
-            if (tmp_error != NULL) {
-                g_propagate_error (error, tmp_error);
-                break;
-            }
-        }
+        chain = g_list_append (chain, next);
+        current = next;
+    }
+
+    return chain;
+}
+
+static void
+fuse_chain (UfoGraph *graph,
+            GList *chain)
+{
+    UfoNode *fused;
+    UfoNode *first;
+    UfoNode *last;
+    UfoNode *predecessor;
+    GList *predecessors;
+    GList *successors;
+    GList *labels = NULL;
+    GList *it;
+    GList *jt;
+    guint output;
+
+    fused = ufo_fused_task_new ();
+    first = UFO_NODE (g_list_first (chain)->data);
+    last = UFO_NODE (g_list_last (chain)->data);
+
+    predecessors = ufo_graph_get_predecessors (graph, first);
+    predecessor = UFO_NODE (g_object_ref (predecessors->data));
+    output = UFO_EDGE_LABEL_OUTPUT (ufo_graph_get_edge_label (graph, predecessor, first));
+    g_list_free (predecessors);
+
+    successors = ufo_graph_get_successors (graph, last);
+
+    g_list_for (successors, it) {
+        g_object_ref (it->data);
+        labels = g_list_append (labels, ufo_graph_get_edge_label (graph, last, UFO_NODE (it->data)));
     }
 
-    g_list_free (path);
+    /* Removing edges drops the graph's references on the chain */
+    g_list_for (chain, it)
+        ufo_fused_task_add_task (UFO_FUSED_TASK (fused), UFO_TASK_NODE (it->data));
+
+    ufo_graph_remove_edge (graph, predecessor, first);
+
+    for (it = g_list_first (chain); it->next != NULL; it = g_list_next (it))
+        ufo_graph_remove_edge (graph, UFO_NODE (it->data), UFO_NODE (it->next->data));
+
+    g_list_for (successors, it)
+        ufo_graph_remove_edge (graph, last, UFO_NODE (it->data));
+
+    ufo_graph_connect_nodes (graph, predecessor, fused, UFO_EDGE_LABEL (output, 0));
+
+    for (it = g_list_first (successors), jt = g_list_first (labels); it != NULL; it = g_list_next (it), jt = g_list_next (jt))
+        ufo_graph_connect_nodes (graph, fused, UFO_NODE (it->data), jt->data);
+
+    ufo_task_node_set_num_expected (UFO_TASK_NODE (fused), 0,
+                                    ufo_task_node_get_num_expected (UFO_TASK_NODE (first), 0));
+    ufo_task_node_set_send_pattern (UFO_TASK_NODE (fused),
+                                    ufo_task_node_get_send_pattern (UFO_TASK_NODE (last)));
+
+    g_debug ("FUSE %i tasks into %s-%p", g_list_length (chain), G_OBJECT_TYPE_NAME (fused), (gpointer) fused);
+
+    g_object_unref (predecessor);
+    g_list_free_full (successors, g_object_unref);
+    g_list_free (labels);
+    g_object_unref (fused);
 }
 
 /**
  * ufo_task_graph_fuse:
  * @graph: A #UfoTaskGraph
  *
- * Fuses task nodes to increase data locality.
- *
- * Note: This is not implemented and a no-op right now.
+ * Fuses task nodes to increase data locality. Every linear chain of at least
+ * two GPU processors with a single input, in which each task is the only
+ * consumer of its predecessor, is replaced by a #UfoFusedTask. The tasks of the
+ * chain then run on one thread with one command queue and pass their results
+ * through device buffers instead of queues.
  */
 void
 ufo_task_graph_fuse (UfoTaskGraph *graph)
 {
-}
+    UfoGraph *ugraph;
+    gboolean fused = TRUE;
 
-static void
-map_proc_node (UfoGraph *graph,
-               UfoNode *node,
-               guint proc_index,
-               GList *gpu_nodes)
-{
-    UfoNode *proc_node;
-    GList *successors;
-    GList *it;
-    guint n_gpus;
+    g_return_if_fail (UFO_IS_TASK_GRAPH (graph));
+    ugraph = UFO_GRAPH (graph);
 
-    proc_node = UFO_NODE (g_list_nth_data (gpu_nodes, proc_index));
+    /* Restart after each fusion because the node list changes */
+    while (fused) {
+        GList *nodes;
+        GList *it;
 
-    if ((ufo_task_uses_gpu (UFO_TASK (node)) || UFO_IS_INPUT_TASK (node)) &&
-        (!ufo_task_node_get_proc_node (UFO_TASK_NODE (node)))) {
+        fused = FALSE;
+        nodes = ufo_graph_get_nodes (ugraph);
 
-        g_debug ("MAP  UfoGpuNode-%p -> %s",
-                 (gpointer) proc_node, ufo_task_node_get_identifier (UFO_TASK_NODE (node)));
+        g_list_for (nodes, it) {
+            GList *predecessors;
+            GList *chain;
+            UfoNode *predecessor;
 
-        ufo_task_node_set_proc_node (UFO_TASK_NODE (node), proc_node);
-    }
+            if (!is_fusable (ugraph, UFO_NODE (it->data)))
+                continue;
 
-    n_gpus = g_list_length (gpu_nodes);
-    successors = ufo_graph_get_successors (graph, node);
+            /* Only start chains at their head */
+            predecessors = ufo_graph_get_predecessors (ugraph, UFO_NODE (it->data));
+            predecessor = UFO_NODE (predecessors->data);
+            g_list_free (predecessors);
 
-    g_list_for (successors, it) {
-        map_proc_node (graph, UFO_NODE (it->data), proc_index, gpu_nodes);
-        proc_index = n_gpus > 0 ? (proc_index + 1) % n_gpus : 0;
-    }
+            if (is_fusable (ugraph, predecessor) &&
+                ufo_graph_get_num_successors (ugraph, predecessor) == 1)
+                continue;
 
-    g_list_free (successors);
+            chain = find_chain (ugraph, UFO_NODE (it->data));
+
+            if (g_list_length (chain) > 1) {
+                fuse_chain (ugraph, chain);
+                fused = TRUE;
+            }
+
+            g_list_free (chain);
+
+            if (fused)
+                break;
+        }
+
+        g_list_free (nodes);
+    }
 }
 
 /**
@@ -525,27 +972,582 @@ ufo_task_graph_is_alright (UfoTaskGraph *graph,
     return alright;
 }
 
+/**
+ * ufo_task_graph_set_cost:
+ * @graph: A #UfoTaskGraph
+ * @plugin: Plugin name of a task
+ * @cost: Time in seconds that the task needs per item
+ *
+ * Set the cost estimate that ufo_task_graph_map() uses for all tasks of
+ * @plugin.
+ */
+void
+ufo_task_graph_set_cost (UfoTaskGraph *graph,
+                         const gchar *plugin,
+                         gdouble cost)
+{
+    gdouble *value;
+
+    g_return_if_fail (UFO_IS_TASK_GRAPH (graph) && plugin != NULL);
+
+    value = g_new (gdouble, 1);
+    *value = cost;
+    g_hash_table_insert (graph->priv->costs, g_strdup (plugin), value);
+}
+
+/**
+ * ufo_task_graph_get_cost:
+ * @graph: A #UfoTaskGraph
+ * @plugin: Plugin name of a task
+ * @cost: (out): Location for the time in seconds per item
+ *
+ * Get the cost estimate of tasks of @plugin.
+ *
+ * Returns: %TRUE if a cost is known for @plugin.
+ */
+gboolean
+ufo_task_graph_get_cost (UfoTaskGraph *graph,
+                         const gchar *plugin,
+                         gdouble *cost)
+{
+    gdouble *value;
+
+    g_return_val_if_fail (UFO_IS_TASK_GRAPH (graph) && plugin != NULL, FALSE);
+    value = g_hash_table_lookup (graph->priv->costs, plugin);
+
+    if (value == NULL)
+        return FALSE;
+
+    if (cost != NULL)
+        *cost = *value;
+
+    return TRUE;
+}
+
+/*
+ * Unknown tasks are assumed to be as expensive as the average known task, so
+ * that a partially filled cache does not skew the balance.
+ */
+static gdouble
+get_default_cost (UfoTaskGraph *graph)
+{
+    GHashTableIter iter;
+    gpointer value;
+    gdouble sum = 0.0;
+    guint n = 0;
+
+    g_hash_table_iter_init (&iter, graph->priv->costs);
+
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        sum += *((gdouble *) value);
+        n++;
+    }
+
+    return n > 0 ? sum / n : UFO_DEFAULT_COST;
+}
+
+static gdouble
+get_node_cost (UfoTaskGraph *graph,
+               UfoNode *node)
+{
+    const gchar *plugin;
+    gdouble cost;
+
+    plugin = ufo_task_node_get_plugin_name (UFO_TASK_NODE (node));
+
+    if (plugin != NULL && ufo_task_graph_get_cost (graph, plugin, &cost))
+        return cost;
+
+    return get_default_cost (graph);
+}
+
+/**
+ * ufo_task_graph_update_costs:
+ * @graph: A #UfoTaskGraph
+ *
+ * Update the cost estimates of @graph with the time its tasks spent processing
+ * during the last run. GPU tasks are measured by the device times of their
+ * kernel events if the run was traced, all others by the CPU timer of their
+ * profiler. Call this once after each run. Measurements of tasks with the same
+ * plugin are averaged and blended with the previous estimate.
+ */
+void
+ufo_task_graph_update_costs (UfoTaskGraph *graph)
+{
+    GHashTable *sums;
+    GHashTable *counts;
+    GHashTable *elapsed_total;
+    GHashTableIter iter;
+    GList *nodes;
+    GList *it;
+    gpointer key;
+    gpointer value;
+
+    g_return_if_fail (UFO_IS_TASK_GRAPH (graph));
+
+    sums = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+    counts = g_hash_table_new (g_str_hash, g_str_equal);
+    elapsed_total = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+    nodes = ufo_graph_get_nodes (UFO_GRAPH (graph));
+
+    g_list_for (nodes, it) {
+        UfoTaskNode *node;
+        UfoProfiler *profiler;
+        const gchar *plugin;
+        gdouble *sum;
+        gdouble *total;
+        gdouble *previous;
+        gdouble elapsed;
+        guint n_processed;
+
+        node = UFO_TASK_NODE (it->data);
+        plugin = ufo_task_node_get_plugin_name (node);
+        profiler = ufo_task_node_get_profiler (node);
+        elapsed = 0.0;
+
+        /* Kernel event times are only recorded when tracing and do not
+         * include the time the host spent waiting for the queue */
+        if (ufo_task_uses_gpu (UFO_TASK (node)))
+            elapsed = ufo_profiler_elapsed (profiler, UFO_PROFILER_TIMER_GPU);
+
+        if (elapsed <= 0.0)
+            elapsed = ufo_profiler_elapsed (profiler, UFO_PROFILER_TIMER_CPU);
+
+        /* Profiler timers accumulate over all runs */
+        total = g_new (gdouble, 1);
+        *total = elapsed;
+        g_hash_table_insert (elapsed_total, node, total);
+        previous = g_hash_table_lookup (graph->priv->elapsed, node);
+
+        if (previous != NULL)
+            elapsed -= *previous;
+
+        g_object_get (node, "num-processed", &n_processed, NULL);
+
+        if (plugin == NULL || n_processed == 0)
+            continue;
+
+        sum = g_hash_table_lookup (sums, plugin);
+
+        if (sum == NULL) {
+            sum = g_new0 (gdouble, 1);
+            g_hash_table_insert (sums, (gpointer) plugin, sum);
+        }
+
+        *sum += elapsed / n_processed;
+        g_hash_table_insert (counts, (gpointer) plugin,
+                             GUINT_TO_POINTER (GPOINTER_TO_UINT (g_hash_table_lookup (counts, plugin)) + 1));
+    }
+
+    g_hash_table_iter_init (&iter, sums);
+
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        gdouble measured;
+        gdouble previous;
+
+        measured = *((gdouble *) value) / GPOINTER_TO_UINT (g_hash_table_lookup (counts, key));
+
+        if (ufo_task_graph_get_cost (graph, key, &previous))
+            measured = 0.5 * (previous + measured);
+
+        ufo_task_graph_set_cost (graph, key, measured);
+    }
+
+    g_hash_table_destroy (graph->priv->elapsed);
+    graph->priv->elapsed = elapsed_total;
+
+    g_list_free (nodes);
+    g_hash_table_destroy (counts);
+    g_hash_table_destroy (sums);
+}
+
+/**
+ * ufo_task_graph_load_costs:
+ * @graph: A #UfoTaskGraph
+ * @filename: Path to a cost cache written by ufo_task_graph_save_costs()
+ * @error: Location for a #GError or %NULL
+ *
+ * Read the cost estimates stored in @filename.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+ufo_task_graph_load_costs (UfoTaskGraph *graph,
+                           const gchar *filename,
+                           GError **error)
+{
+    GKeyFile *file;
+    gchar **keys;
+    gboolean result = TRUE;
+    GError *tmp_error = NULL;
+
+    g_return_val_if_fail (UFO_IS_TASK_GRAPH (graph) && filename != NULL, FALSE);
+
+    file = g_key_file_new ();
+
+    if (!g_key_file_load_from_file (file, filename, G_KEY_FILE_NONE, error)) {
+        g_key_file_free (file);
+        return FALSE;
+    }
+
+    keys = g_key_file_get_keys (file, COST_GROUP, NULL, NULL);
+
+    for (guint i = 0; keys != NULL && keys[i] != NULL; i++) {
+        gdouble cost;
+
+        cost = g_key_file_get_double (file, COST_GROUP, keys[i], &tmp_error);
+
+        if (tmp_error != NULL) {
+            g_propagate_prefixed_error (error, tmp_error, "%s: ", filename);
+            result = FALSE;
+            break;
+        }
+
+        ufo_task_graph_set_cost (graph, keys[i], cost);
+    }
+
+    g_strfreev (keys);
+    g_key_file_free (file);
+    return result;
+}
+
+/**
+ * ufo_task_graph_save_costs:
+ * @graph: A #UfoTaskGraph
+ * @filename: Path of the cost cache
+ * @error: Location for a #GError or %NULL
+ *
+ * Store the cost estimates of @graph in @filename. Estimates of plugins that
+ * are not known to @graph are kept.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+ufo_task_graph_save_costs (UfoTaskGraph *graph,
+                           const gchar *filename,
+                           GError **error)
+{
+    GKeyFile *file;
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+    gchar *data;
+    gsize length;
+    gboolean result;
+
+    g_return_val_if_fail (UFO_IS_TASK_GRAPH (graph) && filename != NULL, FALSE);
+
+    file = g_key_file_new ();
+    g_key_file_load_from_file (file, filename, G_KEY_FILE_KEEP_COMMENTS, NULL);
+    g_hash_table_iter_init (&iter, graph->priv->costs);
+
+    while (g_hash_table_iter_next (&iter, &key, &value))
+        g_key_file_set_double (file, COST_GROUP, key, *((gdouble *) value));
+
+    data = g_key_file_to_data (file, &length, NULL);
+    result = g_file_set_contents (filename, data, (gssize) length, error);
+
+    g_free (data);
+    g_key_file_free (file);
+    return result;
+}
+
+static GList *
+get_topological_order (UfoGraph *graph)
+{
+    GHashTable *n_missing;
+    GQueue ready = G_QUEUE_INIT;
+    GList *nodes;
+    GList *order = NULL;
+    GList *it;
+
+    n_missing = g_hash_table_new (g_direct_hash, g_direct_equal);
+    nodes = ufo_graph_get_nodes (graph);
+
+    g_list_for (nodes, it) {
+        guint n_predecessors = ufo_graph_get_num_predecessors (graph, UFO_NODE (it->data));
+
+        if (n_predecessors == 0)
+            g_queue_push_tail (&ready, it->data);
+        else
+            g_hash_table_insert (n_missing, it->data, GUINT_TO_POINTER (n_predecessors));
+    }
+
+    while (!g_queue_is_empty (&ready)) {
+        UfoNode *node;
+        GList *successors;
+
+        node = UFO_NODE (g_queue_pop_head (&ready));
+        order = g_list_append (order, node);
+        successors = ufo_graph_get_successors (graph, node);
+
+        g_list_for (successors, it) {
+            guint n = GPOINTER_TO_UINT (g_hash_table_lookup (n_missing, it->data)) - 1;
+
+            if (n == 0) {
+                g_hash_table_remove (n_missing, it->data);
+                g_queue_push_tail (&ready, it->data);
+            }
+            else {
+                g_hash_table_insert (n_missing, it->data, GUINT_TO_POINTER (n));
+            }
+        }
+
+        g_list_free (successors);
+    }
+
+    g_list_free (nodes);
+    g_hash_table_destroy (n_missing);
+    return order;
+}
+
+static gboolean
+needs_proc_node (UfoNode *node)
+{
+    return ufo_task_uses_gpu (UFO_TASK (node)) || UFO_IS_INPUT_TASK (node);
+}
+
+/*
+ * Estimated load of placing @node on @gpu: the load that @gpu already carries,
+ * the cost of @node and a transfer for every input that another GPU produces.
+ */
+static gdouble
+get_placement_cost (UfoGraph *graph,
+                    UfoNode *node,
+                    UfoNode *gpu,
+                    gdouble load,
+                    gdouble cost,
+                    gdouble transfer)
+{
+    GList *predecessors;
+    GList *it;
+
+    predecessors = ufo_graph_get_predecessors (graph, node);
+
+    g_list_for (predecessors, it) {
+        UfoNode *source_gpu;
+
+        if (!needs_proc_node (UFO_NODE (it->data)))
+            continue;
+
+        source_gpu = ufo_task_node_get_proc_node (UFO_TASK_NODE (it->data));
+
+        if (source_gpu != NULL && source_gpu != gpu)
+            load += transfer;
+    }
+
+    g_list_free (predecessors);
+    return load + cost;
+}
+
 /**
  * ufo_task_graph_map:
  * @graph: A #UfoTaskGraph
  * @gpu_nodes: (transfer none) (element-type Ufo.GpuNode): List of #UfoGpuNode objects
  *
- * Map task nodes of @graph to the list of @gpu_nodes.
+ * Map task nodes of @graph to the list of @gpu_nodes. Tasks are visited in
+ * topological order and placed on the GPU that minimizes its estimated load
+ * including the transfers of inputs produced on other GPUs. Loads are based on
+ * the costs set with ufo_task_graph_set_cost() or loaded with
+ * ufo_task_graph_load_costs(); without any, all tasks cost the same and every
+ * cross-device transfer costs as much as a task.
  */
 void
 ufo_task_graph_map (UfoTaskGraph *graph,
                     GList *gpu_nodes)
 {
+    GList *order;
+    GList *it;
+    gdouble *loads;
+    gdouble transfer;
+    guint n_gpus;
+
+    g_return_if_fail (UFO_IS_TASK_GRAPH (graph));
+
+    n_gpus = g_list_length (gpu_nodes);
+
+    if (n_gpus == 0)
+        return;
+
+    loads = g_new0 (gdouble, n_gpus);
+    transfer = get_default_cost (graph);
+    order = get_topological_order (UFO_GRAPH (graph));
+    g_hash_table_remove_all (graph->priv->mapping);
+
+    g_list_for (order, it) {
+        UfoNode *node;
+        UfoNode *proc_node;
+        gdouble cost;
+        gint best = -1;
+        gdouble best_load = G_MAXDOUBLE;
+
+        node = UFO_NODE (it->data);
+
+        if (!needs_proc_node (node))
+            continue;
+
+        cost = get_node_cost (graph, node);
+        proc_node = ufo_task_node_get_proc_node (UFO_TASK_NODE (node));
+
+        if (proc_node != NULL) {
+            best = g_list_index (gpu_nodes, proc_node);
+        }
+        else {
+            guint i = 0;
+
+            /* Ties go to the lower index, which keeps chains on one GPU */
+            for (GList *jt = gpu_nodes; jt != NULL; jt = g_list_next (jt), i++) {
+                gdouble load;
+
+                load = get_placement_cost (UFO_GRAPH (graph), node, UFO_NODE (jt->data),
+                                           loads[i], cost, transfer);
+
+                if (load < best_load) {
+                    best_load = load;
+                    best = (gint) i;
+                }
+            }
+
+            proc_node = UFO_NODE (g_list_nth_data (gpu_nodes, (guint) best));
+            ufo_task_node_set_proc_node (UFO_TASK_NODE (node), proc_node);
+
+            g_debug ("MAP  UfoGpuNode-%p [cost=%.3e] -> %s",
+                     (gpointer) proc_node, cost, ufo_task_node_get_identifier (UFO_TASK_NODE (node)));
+        }
+
+        if (best >= 0) {
+            loads[best] += cost;
+            g_hash_table_insert (graph->priv->mapping, node, GINT_TO_POINTER (best + 1));
+        }
+    }
+
+    g_list_free (order);
+    g_free (loads);
+}
+
+typedef struct {
+    guint   n_domains;
+    guint  *numa_nodes;     /* NUMA node index of each domain */
+    GList **members;        /* CPU nodes of each domain */
+    guint  *next;           /* next member of each domain to use */
+    guint   next_root;
+} CpuMap;
+
+static guint
+find_domain (CpuMap *map,
+             guint numa_node)
+{
+    for (guint i = 0; i < map->n_domains; i++) {
+        if (map->numa_nodes[i] == numa_node)
+            return i;
+    }
+
+    return map->n_domains;
+}
+
+static void
+map_cpu_node (UfoGraph *graph,
+              UfoTaskNode *node,
+              guint domain,
+              CpuMap *map)
+{
+    UfoCpuNode *cpu_node;
+    GList *successors;
+    GList *it;
+    gint requested;
+    gchar *cpus;
+
+    if (ufo_task_node_get_cpu_node (node) != NULL)
+        return;
+
+    requested = ufo_task_node_get_numa_node (node);
+
+    if (requested >= 0) {
+        guint index = find_domain (map, (guint) requested);
+
+        if (index < map->n_domains)
+            domain = index;
+        else
+            g_warning ("NUMA node %i requested by `%s' is not available",
+                       requested, ufo_task_node_get_plugin_name (node));
+    }
+
+    cpu_node = g_list_nth_data (map->members[domain],
+                                map->next[domain]++ % g_list_length (map->members[domain]));
+    ufo_task_node_set_cpu_node (node, UFO_NODE (cpu_node));
+
+    cpus = ufo_cpu_node_get_cpu_list (cpu_node);
+    g_debug ("MAP  UfoCpuNode-%p [cpus=%s numa=%u] -> %s", (gpointer) cpu_node,
+             cpus, ufo_cpu_node_get_numa_node (cpu_node), ufo_task_node_get_identifier (node));
+    g_free (cpus);
+
+    /* Successors stay on the same NUMA node to keep their inputs local */
+    successors = ufo_graph_get_successors (graph, UFO_NODE (node));
+
+    g_list_for (successors, it) {
+        map_cpu_node (graph, UFO_TASK_NODE (it->data), domain, map);
+    }
+
+    g_list_free (successors);
+}
+
+/**
+ * ufo_task_graph_map_cpus:
+ * @graph: A #UfoTaskGraph
+ * @cpu_nodes: (transfer none) (element-type Ufo.CpuNode): List of #UfoCpuNode objects
+ *
+ * Map task nodes of @graph to the list of @cpu_nodes. Independent pipelines
+ * are distributed across NUMA nodes, while the successors of a task run on
+ * the same NUMA node as the task itself, unless the #UfoTaskNode:numa-node
+ * property of a task says otherwise.
+ */
+void
+ufo_task_graph_map_cpus (UfoTaskGraph *graph,
+                         GList *cpu_nodes)
+{
+    CpuMap map;
     GList *roots;
     GList *it;
+    guint n_nodes;
+
+    n_nodes = g_list_length (cpu_nodes);
+
+    if (n_nodes == 0)
+        return;
+
+    map.n_domains = 0;
+    map.numa_nodes = g_new0 (guint, n_nodes);
+    map.members = g_new0 (GList *, n_nodes);
+    map.next = g_new0 (guint, n_nodes);
+    map.next_root = 0;
+
+    g_list_for (cpu_nodes, it) {
+        guint numa_node;
+        guint domain;
+
+        numa_node = ufo_cpu_node_get_numa_node (UFO_CPU_NODE (it->data));
+        domain = find_domain (&map, numa_node);
+
+        if (domain == map.n_domains)
+            map.numa_nodes[map.n_domains++] = numa_node;
+
+        map.members[domain] = g_list_append (map.members[domain], it->data);
+    }
 
     roots = ufo_graph_get_roots (UFO_GRAPH (graph));
 
     g_list_for (roots, it) {
-        map_proc_node (UFO_GRAPH (graph), UFO_NODE (it->data), 0, gpu_nodes);
+        map_cpu_node (UFO_GRAPH (graph), UFO_TASK_NODE (it->data), map.next_root++ % map.n_domains, &map);
     }
 
     g_list_free (roots);
+
+    for (guint i = 0; i < map.n_domains; i++)
+        g_list_free (map.members[i]);
+
+    g_free (map.numa_nodes);
+    g_free (map.members);
+    g_free (map.next);
 }
 
 /**
@@ -580,8 +1582,60 @@ ufo_task_graph_connect_nodes_full (UfoTaskGraph *graph,
                                    UfoTaskNode *n2,
                                    guint input)
 {
-    g_debug ("CONN %s -> %s [input=%i]", ufo_task_node_get_identifier (n1), ufo_task_node_get_identifier (n2), input);
-    ufo_graph_connect_nodes (UFO_GRAPH (graph), UFO_NODE (n1), UFO_NODE (n2), GINT_TO_POINTER (input));
+    ufo_task_graph_connect_ports (graph, n1, 0, n2, input);
+}
+
+/**
+ * ufo_task_graph_connect_ports:
+ * @graph: A #UfoTaskGraph
+ * @n1: A source node
+ * @output: Output port of @n1
+ * @n2: A destination node
+ * @input: Input port of @n2
+ *
+ * Connect @output of @n1 with the @input port of @n2. Each output of a task
+ * with several outputs (see ufo_task_get_num_outputs()) can feed any number of
+ * successors.
+ */
+void
+ufo_task_graph_connect_ports (UfoTaskGraph *graph,
+                              UfoTaskNode *n1,
+                              guint output,
+                              UfoTaskNode *n2,
+                              guint input)
+{
+    g_return_if_fail (output <= 0xFFFF && input <= 0xFFFF);
+    g_debug ("CONN %s -> %s [output=%i, input=%i]",
+             ufo_task_node_get_identifier (n1), ufo_task_node_get_identifier (n2), output, input);
+    ufo_graph_connect_nodes (UFO_GRAPH (graph), UFO_NODE (n1), UFO_NODE (n2), UFO_EDGE_LABEL (output, input));
+}
+
+/**
+ * ufo_task_graph_get_ports:
+ * @graph: A #UfoTaskGraph
+ * @n1: A source node
+ * @n2: A destination node connected to @n1
+ * @output: (out) (allow-none): Location for the output port of @n1
+ * @input: (out) (allow-none): Location for the input port of @n2
+ *
+ * Get the ports that connect @n1 with @n2.
+ */
+void
+ufo_task_graph_get_ports (UfoTaskGraph *graph,
+                          UfoTaskNode *n1,
+                          UfoTaskNode *n2,
+                          guint *output,
+                          guint *input)
+{
+    gpointer label;
+
+    label = ufo_graph_get_edge_label (UFO_GRAPH (graph), UFO_NODE (n1), UFO_NODE (n2));
+
+    if (output != NULL)
+        *output = UFO_EDGE_LABEL_OUTPUT (label);
+
+    if (input != NULL)
+        *input = UFO_EDGE_LABEL_INPUT (label);
 }
 
 /**
@@ -815,6 +1869,7 @@ handle_json_task_edge (JsonArray *array,
     JsonObject *edge;
     UfoTaskNode *from_node, *to_node;
     JsonObject *from_object, *to_object;
+    guint from_port;
     guint to_port;
     const gchar *from_name;
     const gchar *to_name;
@@ -837,6 +1892,10 @@ handle_json_task_edge (JsonArray *array,
     }
 
     from_name = json_object_get_string_member (from_object, "name");
+    from_port = 0;
+
+    if (json_object_has_member (from_object, "output"))
+        from_port = (guint) json_object_get_int_member (from_object, "output");
 
     /* Get to details */
     to_object = json_object_get_object_member (edge, "to");
@@ -862,7 +1921,7 @@ handle_json_task_edge (JsonArray *array,
     if (to_node == NULL)
         g_error ("No filter `%s' defined", to_name);
 
-    ufo_task_graph_connect_nodes_full (graph, from_node, to_node, to_port);
+    ufo_task_graph_connect_ports (graph, from_node, from_port, to_node, to_port);
 
     if (error != NULL)
         g_warning ("%s", error->message);
@@ -980,6 +2039,9 @@ ufo_task_graph_finalize (GObject *object)
     priv = UFO_TASK_GRAPH_GET_PRIVATE (object);
 
     g_hash_table_destroy (priv->json_nodes);
+    g_hash_table_destroy (priv->costs);
+    g_hash_table_destroy (priv->mapping);
+    g_hash_table_destroy (priv->elapsed);
 
     G_OBJECT_CLASS (ufo_task_graph_parent_class)->finalize (object);
 }
@@ -1004,6 +2066,9 @@ ufo_task_graph_init (UfoTaskGraph *self)
 
     priv->manager = NULL;
     priv->json_nodes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    priv->costs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    priv->mapping = g_hash_table_new (g_direct_hash, g_direct_equal);
+    priv->elapsed = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
     priv->index = 0;
     priv->total = 1;
 }
@@ -90,6 +90,21 @@ gboolean     ufo_task_graph_is_alright          (UfoTaskGraph       *graph,
                                                  GError            **error);
 void         ufo_task_graph_map                 (UfoTaskGraph       *graph,
                                                  GList              *gpu_nodes);
+void         ufo_task_graph_set_cost            (UfoTaskGraph       *graph,
+                                                 const gchar        *plugin,
+                                                 gdouble             cost);
+gboolean     ufo_task_graph_get_cost            (UfoTaskGraph       *graph,
+                                                 const gchar        *plugin,
+                                                 gdouble            *cost);
+void         ufo_task_graph_update_costs        (UfoTaskGraph       *graph);
+gboolean     ufo_task_graph_load_costs          (UfoTaskGraph       *graph,
+                                                 const gchar        *filename,
+                                                 GError            **error);
+gboolean     ufo_task_graph_save_costs          (UfoTaskGraph       *graph,
+                                                 const gchar        *filename,
+                                                 GError            **error);
+void         ufo_task_graph_map_cpus            (UfoTaskGraph       *graph,
+                                                 GList              *cpu_nodes);
 void         ufo_task_graph_expand              (UfoTaskGraph       *graph,
                                                  UfoResources       *resources,
                                                  guint               n_gpus,
@@ -101,6 +116,16 @@ void         ufo_task_graph_connect_nodes_full  (UfoTaskGraph       *graph,
                                                  UfoTaskNode        *n1,
                                                  UfoTaskNode        *n2,
                                                  guint               input);
+void         ufo_task_graph_connect_ports       (UfoTaskGraph       *graph,
+                                                 UfoTaskNode        *n1,
+                                                 guint               output,
+                                                 UfoTaskNode        *n2,
+                                                 guint               input);
+void         ufo_task_graph_get_ports           (UfoTaskGraph       *graph,
+                                                 UfoTaskNode        *n1,
+                                                 UfoTaskNode        *n2,
+                                                 guint              *output,
+                                                 guint              *input);
 void         ufo_task_graph_fuse                (UfoTaskGraph       *graph);
 void         ufo_task_graph_set_partition       (UfoTaskGraph       *graph,
                                                  guint               index,
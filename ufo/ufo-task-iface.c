@@ -81,6 +81,34 @@ ufo_task_setup (UfoTask *task,
     }
 }
 
+/**
+ * ufo_task_reset:
+ * @task: A #UfoTask that was set up before
+ * @resources: The #UfoResources @task was set up with
+ * @error: Location for a #GError or %NULL
+ *
+ * Prepare @task for another stream of data without setting it up again. Tasks
+ * that do not implement the reset method may keep state of the previous
+ * stream and are set up again with ufo_task_setup().
+ */
+void
+ufo_task_reset (UfoTask *task,
+                UfoResources *resources,
+                GError **error)
+{
+    UfoTaskIface *iface;
+
+    iface = UFO_TASK_GET_IFACE (task);
+
+    if (iface->reset == NULL) {
+        ufo_task_setup (task, resources, error);
+        return;
+    }
+
+    ufo_task_node_setup (UFO_TASK_NODE (task));
+    iface->reset (task);
+}
+
 void
 ufo_task_get_requisition (UfoTask *task,
                           UfoBuffer **inputs,
@@ -103,6 +131,54 @@ ufo_task_get_num_dimensions (UfoTask *task,
     return UFO_TASK_GET_IFACE (task)->get_num_dimensions (task, input);
 }
 
+/**
+ * ufo_task_get_num_outputs:
+ * @task: A #UfoTask
+ *
+ * Get the number of output ports of @task. Tasks that do not implement the
+ * get_num_outputs method have a single output.
+ *
+ * Returns: Number of output ports.
+ */
+guint
+ufo_task_get_num_outputs (UfoTask *task)
+{
+    UfoTaskIface *iface;
+
+    iface = UFO_TASK_GET_IFACE (task);
+    return iface->get_num_outputs != NULL ? iface->get_num_outputs (task) : 1;
+}
+
+/**
+ * ufo_task_get_output_requisition:
+ * @task: A #UfoTask
+ * @inputs: (array): Input buffers
+ * @output: Output port of @task
+ * @requisition: (out): Size of the buffer at @output
+ * @error: Location for a #GError or %NULL
+ *
+ * Get the size of the buffer produced at @output. This is called after
+ * ufo_task_get_requisition() for every output but the first, whose size is
+ * the one returned by ufo_task_get_requisition(). Tasks that do not implement
+ * the get_output_requisition method produce equally sized outputs.
+ */
+void
+ufo_task_get_output_requisition (UfoTask *task,
+                                 UfoBuffer **inputs,
+                                 guint output,
+                                 UfoRequisition *requisition,
+                                 GError **error)
+{
+    UfoTaskIface *iface;
+
+    iface = UFO_TASK_GET_IFACE (task);
+
+    if (output == 0 || iface->get_output_requisition == NULL)
+        iface->get_requisition (task, inputs, requisition, error);
+    else
+        iface->get_output_requisition (task, inputs, output, requisition, error);
+}
+
 UfoTaskMode
 ufo_task_get_mode (UfoTask *task)
 {
@@ -156,6 +232,54 @@ ufo_task_process (UfoTask *task,
     return result;
 }
 
+/**
+ * ufo_task_process_outputs:
+ * @task: A #UfoTask
+ * @inputs: (array): Input buffers
+ * @outputs: (array): One buffer per output port
+ * @requisitions: (array): Size of each buffer in @outputs
+ *
+ * Process one item of a processor with several outputs and fill all @outputs
+ * at once, so that work shared by the outputs is done only once. Tasks with a
+ * single output that do not implement the process_outputs method fill it with
+ * ufo_task_process(). Tasks with several outputs must implement it, otherwise
+ * a warning is emitted and no data is processed.
+ *
+ * Returns: %FALSE if @task does not want to process any more data.
+ */
+gboolean
+ufo_task_process_outputs (UfoTask *task,
+                          UfoBuffer **inputs,
+                          UfoBuffer **outputs,
+                          UfoRequisition *requisitions)
+{
+    UfoTaskIface *iface;
+    UfoProfiler *profiler;
+    gboolean result;
+
+    iface = UFO_TASK_GET_IFACE (task);
+
+    if (iface->process_outputs == NULL) {
+        if (ufo_task_get_num_outputs (task) > 1) {
+            g_warning ("%s: `process_outputs' not implemented but %u outputs requested",
+                       G_OBJECT_TYPE_NAME (task), ufo_task_get_num_outputs (task));
+            return FALSE;
+        }
+
+        return ufo_task_process (task, inputs, outputs[0], &requisitions[0]);
+    }
+
+    profiler = ufo_task_node_get_profiler (UFO_TASK_NODE (task));
+    ufo_profiler_trace_event (profiler, UFO_TRACE_EVENT_PROCESS | UFO_TRACE_EVENT_BEGIN);
+    result = iface->process_outputs (task, inputs, outputs, requisitions);
+    ufo_profiler_trace_event (profiler, UFO_TRACE_EVENT_PROCESS | UFO_TRACE_EVENT_END);
+
+    emit_signal (task, signals[PROCESSED], 0);
+    ufo_task_node_increase_processed (UFO_TASK_NODE (task));
+
+    return result;
+}
+
 gboolean
 ufo_task_generate (UfoTask *task,
                    UfoBuffer *output,
@@ -174,6 +298,128 @@ ufo_task_generate (UfoTask *task,
     return result;
 }
 
+/**
+ * ufo_task_process_batch:
+ * @task: A #UfoTask
+ * @inputs: (array length=n_items): One input buffer per item
+ * @outputs: (array length=n_items) (allow-none): One output buffer per item
+ *  or %NULL for sinks
+ * @n_items: Number of items
+ * @requisition: Size of all outputs
+ *
+ * Process @n_items items of a task with a single input at once. All inputs
+ * have the same size. Tasks that do not implement the process_batch method
+ * process the items one after the other.
+ *
+ * Returns: %FALSE if @task does not want to process any more data.
+ */
+gboolean
+ufo_task_process_batch (UfoTask *task,
+                        UfoBuffer **inputs,
+                        UfoBuffer **outputs,
+                        guint n_items,
+                        UfoRequisition *requisition)
+{
+    UfoTaskIface *iface;
+    UfoProfiler *profiler;
+    gboolean result;
+
+    iface = UFO_TASK_GET_IFACE (task);
+
+    if (iface->process_batch == NULL) {
+        for (guint i = 0; i < n_items; i++) {
+            if (!ufo_task_process (task, &inputs[i], outputs != NULL ? outputs[i] : NULL, requisition))
+                return FALSE;
+        }
+
+        return TRUE;
+    }
+
+    profiler = ufo_task_node_get_profiler (UFO_TASK_NODE (task));
+    ufo_profiler_trace_event (profiler, UFO_TRACE_EVENT_PROCESS | UFO_TRACE_EVENT_BEGIN);
+    result = iface->process_batch (task, inputs, outputs, n_items, requisition);
+    ufo_profiler_trace_event (profiler, UFO_TRACE_EVENT_PROCESS | UFO_TRACE_EVENT_END);
+
+    for (guint i = 0; i < n_items; i++) {
+        emit_signal (task, signals[PROCESSED], 0);
+        ufo_task_node_increase_processed (UFO_TASK_NODE (task));
+    }
+
+    return result;
+}
+
+/**
+ * ufo_task_generate_batch:
+ * @task: A #UfoTask
+ * @outputs: (array length=n_items): Output buffers
+ * @n_items: Maximum number of items to generate
+ * @requisition: Size of all outputs
+ *
+ * Generate up to @n_items items at once. Tasks that do not implement the
+ * generate_batch method generate the items one after the other.
+ *
+ * Returns: Number of generated items, the first ones in @outputs. Less than
+ * @n_items means that @task is done.
+ */
+guint
+ufo_task_generate_batch (UfoTask *task,
+                         UfoBuffer **outputs,
+                         guint n_items,
+                         UfoRequisition *requisition)
+{
+    UfoTaskIface *iface;
+    UfoProfiler *profiler;
+    guint n_generated;
+
+    iface = UFO_TASK_GET_IFACE (task);
+
+    if (iface->generate_batch == NULL) {
+        for (n_generated = 0; n_generated < n_items; n_generated++) {
+            if (!ufo_task_generate (task, outputs[n_generated], requisition))
+                break;
+        }
+
+        return n_generated;
+    }
+
+    profiler = ufo_task_node_get_profiler (UFO_TASK_NODE (task));
+    ufo_profiler_trace_event (profiler, UFO_TRACE_EVENT_GENERATE | UFO_TRACE_EVENT_BEGIN);
+    n_generated = iface->generate_batch (task, outputs, n_items, requisition);
+    ufo_profiler_trace_event (profiler, UFO_TRACE_EVENT_GENERATE | UFO_TRACE_EVENT_END);
+
+    for (guint i = 0; i < n_generated; i++)
+        emit_signal (task, signals[GENERATED], 0);
+
+    return n_generated;
+}
+
+/**
+ * ufo_task_supports_batches:
+ * @task: A #UfoTask
+ *
+ * Returns: %TRUE if @task implements the batch method matching its mode.
+ * Batches of processors and sinks are only supported with a single input and
+ * a single output.
+ */
+gboolean
+ufo_task_supports_batches (UfoTask *task)
+{
+    UfoTaskIface *iface;
+    UfoTaskMode mode;
+
+    iface = UFO_TASK_GET_IFACE (task);
+    mode = ufo_task_get_mode (task) & UFO_TASK_MODE_TYPE_MASK;
+
+    if (mode == UFO_TASK_MODE_GENERATOR)
+        return iface->generate_batch != NULL;
+
+    if (mode == UFO_TASK_MODE_PROCESSOR || mode == UFO_TASK_MODE_SINK)
+        return iface->process_batch != NULL && ufo_task_get_num_inputs (task) == 1 &&
+               ufo_task_get_num_outputs (task) == 1;
+
+    return FALSE;
+}
+
 void
 ufo_task_inputs_stopped_callback (UfoTask *task)
 {
@@ -276,6 +522,12 @@ ufo_task_default_init (UfoTaskInterface *iface)
     iface->set_json_object_property = ufo_task_set_json_object_property_real;
     iface->process = ufo_task_process_real;
     iface->generate = ufo_task_generate_real;
+    iface->reset = NULL;
+    iface->process_batch = NULL;
+    iface->generate_batch = NULL;
+    iface->get_num_outputs = NULL;
+    iface->get_output_requisition = NULL;
+    iface->process_outputs = NULL;
 
     signals[PROCESSED] =
         g_signal_new ("processed",
@@ -58,6 +58,10 @@ typedef enum {
  * @UFO_TASK_MODE_GPU: runs on GPU
  * @UFO_TASK_MODE_CPU: runs on CPU
  * @UFO_TASK_MODE_SHARE_DATA: sibling tasks share the same input data
+ * @UFO_TASK_MODE_INPLACE: processor that can write its output into its input
+ *  buffer if both have the same size
+ * @UFO_TASK_MODE_FIXED_SHAPE: requisition only changes if the shape of an
+ *  input changes
  * @UFO_TASK_MODE_TYPE_MASK: mask to get type from UfoTaskMode
  * @UFO_TASK_MODE_PROCESSOR_MASK: mask to get processor from UfoTaskMode
  *
@@ -72,6 +76,8 @@ typedef enum {
     UFO_TASK_MODE_CPU           = 1 << 4,
     UFO_TASK_MODE_GPU           = 1 << 5,
     UFO_TASK_MODE_SHARE_DATA    = 1 << 6,
+    UFO_TASK_MODE_INPLACE       = 1 << 7,
+    UFO_TASK_MODE_FIXED_SHAPE   = 1 << 8,
 
     UFO_TASK_MODE_TYPE_MASK     = UFO_TASK_MODE_PROCESSOR | UFO_TASK_MODE_GENERATOR | UFO_TASK_MODE_REDUCTOR  | UFO_TASK_MODE_SINK,
 
@@ -113,20 +119,50 @@ struct _UfoTaskIface {
     gboolean (*generate)                (UfoTask        *task,
                                          UfoBuffer      *output,
                                          UfoRequisition *requisition);
+    void    (*reset)                    (UfoTask        *task);
+    gboolean (*process_batch)           (UfoTask        *task,
+                                         UfoBuffer     **inputs,
+                                         UfoBuffer     **outputs,
+                                         guint           n_items,
+                                         UfoRequisition *requisition);
+    guint   (*generate_batch)           (UfoTask        *task,
+                                         UfoBuffer     **outputs,
+                                         guint           n_items,
+                                         UfoRequisition *requisition);
+    guint   (*get_num_outputs)          (UfoTask        *task);
+    void    (*get_output_requisition)   (UfoTask        *task,
+                                         UfoBuffer     **inputs,
+                                         guint           output,
+                                         UfoRequisition *requisition,
+                                         GError        **error);
+    gboolean (*process_outputs)         (UfoTask        *task,
+                                         UfoBuffer     **inputs,
+                                         UfoBuffer     **outputs,
+                                         UfoRequisition *requisitions);
 };
 
 void    ufo_task_setup              (UfoTask        *task,
                                      UfoResources   *resources,
                                      GError        **error);
+void    ufo_task_reset              (UfoTask        *task,
+                                     UfoResources   *resources,
+                                     GError        **error);
 guint   ufo_task_get_num_inputs     (UfoTask        *task);
 guint   ufo_task_get_num_dimensions (UfoTask        *task,
                                      guint           input);
+guint   ufo_task_get_num_outputs    (UfoTask        *task);
 UfoTaskMode
         ufo_task_get_mode           (UfoTask        *task);
 void    ufo_task_get_requisition    (UfoTask        *task,
                                      UfoBuffer     **inputs,
                                      UfoRequisition *requisition,
                                      GError        **error);
+void    ufo_task_get_output_requisition
+                                    (UfoTask        *task,
+                                     UfoBuffer     **inputs,
+                                     guint           output,
+                                     UfoRequisition *requisition,
+                                     GError        **error);
 void    ufo_task_set_json_object_property
                                     (UfoTask        *task,
                                      const gchar    *prop_name,
@@ -135,6 +171,20 @@ gboolean ufo_task_process           (UfoTask        *task,
                                      UfoBuffer     **inputs,
                                      UfoBuffer      *output,
                                      UfoRequisition *requisition);
+gboolean ufo_task_process_outputs   (UfoTask        *task,
+                                     UfoBuffer     **inputs,
+                                     UfoBuffer     **outputs,
+                                     UfoRequisition *requisitions);
+gboolean ufo_task_process_batch     (UfoTask        *task,
+                                     UfoBuffer     **inputs,
+                                     UfoBuffer     **outputs,
+                                     guint           n_items,
+                                     UfoRequisition *requisition);
+guint   ufo_task_generate_batch     (UfoTask        *task,
+                                     UfoBuffer     **outputs,
+                                     guint           n_items,
+                                     UfoRequisition *requisition);
+gboolean ufo_task_supports_batches  (UfoTask        *task);
 gboolean ufo_task_generate          (UfoTask        *task,
                                      UfoBuffer      *output,
                                      UfoRequisition *requisition);
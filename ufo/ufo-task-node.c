@@ -23,6 +23,7 @@
 #include <sched.h>
 
 #include "ufo-task-node.h"
+#include "ufo-gpu-node.h"
 
 /**
  * SECTION:ufo-task-node
@@ -39,6 +40,7 @@ G_DEFINE_TYPE (UfoTaskNode, ufo_task_node, UFO_TYPE_NODE)
 enum {
     PROP_0,
     PROP_NUM_PROCESSED,
+    PROP_NUMA_NODE,
     N_PROPERTIES
 };
 
@@ -47,7 +49,10 @@ struct _UfoTaskNodePrivate {
     gchar           *identifier;
     UfoSendPattern   pattern;
     UfoNode         *proc_node;
-    UfoGroup        *out_group;
+    guint            queue_index;
+    UfoNode         *cpu_node;
+    gint             numa_node;
+    GPtrArray       *out_groups;        /* one group per output port */
     UfoProfiler     *profiler;
     GList           *in_groups[UFO_MAX_INPUT_NODES];
     GList           *current[UFO_MAX_INPUT_NODES];
@@ -150,8 +155,7 @@ void
 ufo_task_node_set_out_group (UfoTaskNode *node,
                              UfoGroup *group)
 {
-    g_return_if_fail (UFO_IS_TASK_NODE (node));
-    node->priv->out_group = group;
+    ufo_task_node_set_output_group (node, 0, group);
 }
 
 /**
@@ -166,8 +170,53 @@ ufo_task_node_set_out_group (UfoTaskNode *node,
 UfoGroup *
 ufo_task_node_get_out_group (UfoTaskNode *node)
 {
+    return ufo_task_node_get_output_group (node, 0);
+}
+
+/**
+ * ufo_task_node_set_output_group:
+ * @node: A #UfoTaskNode
+ * @output: Output port of @node
+ * @group: (allow-none): A #UfoGroup
+ *
+ * Set the group that passes the buffers produced at @output to the successors
+ * connected to that port.
+ */
+void
+ufo_task_node_set_output_group (UfoTaskNode *node,
+                                guint output,
+                                UfoGroup *group)
+{
+    UfoTaskNodePrivate *priv;
+
+    g_return_if_fail (UFO_IS_TASK_NODE (node));
+    priv = node->priv;
+
+    if (output >= priv->out_groups->len)
+        g_ptr_array_set_size (priv->out_groups, output + 1);
+
+    g_ptr_array_index (priv->out_groups, output) = group;
+}
+
+/**
+ * ufo_task_node_get_output_group:
+ * @node: A #UfoTaskNode
+ * @output: Output port of @node
+ *
+ * Get the group of @output set with ufo_task_node_set_output_group().
+ *
+ * Return value: (transfer none): The out group of @output or %NULL.
+ */
+UfoGroup *
+ufo_task_node_get_output_group (UfoTaskNode *node,
+                                guint output)
+{
+    UfoTaskNodePrivate *priv;
+
     g_return_val_if_fail (UFO_IS_TASK_NODE (node), NULL);
-    return node->priv->out_group;
+    priv = node->priv;
+
+    return output < priv->out_groups->len ? g_ptr_array_index (priv->out_groups, output) : NULL;
 }
 
 void
@@ -181,6 +230,23 @@ ufo_task_node_add_in_group (UfoTaskNode *node,
     node->priv->current[pos] = node->priv->in_groups[pos];
 }
 
+/**
+ * ufo_task_node_get_in_groups:
+ * @node: A #UfoTaskNode
+ * @pos: Input position of @node
+ *
+ * Return value: (transfer none) (element-type UfoGroup): All groups connected
+ * to input @pos of @node.
+ */
+GList *
+ufo_task_node_get_in_groups (UfoTaskNode *node,
+                             guint pos)
+{
+    g_return_val_if_fail (UFO_IS_TASK_NODE (node), NULL);
+    g_assert (pos < UFO_MAX_INPUT_NODES);
+    return node->priv->in_groups[pos];
+}
+
 /**
  * ufo_task_node_reset:
  * @node: A #UfoTaskNode
@@ -194,8 +260,9 @@ ufo_task_node_reset (UfoTaskNode *node)
 
     g_return_if_fail (UFO_IS_TASK_NODE (node));
     priv = UFO_TASK_NODE_GET_PRIVATE (node);
-    priv->out_group = NULL;
+    g_ptr_array_set_size (priv->out_groups, 0);
     priv->proc_node = NULL;
+    priv->cpu_node = NULL;
 
     for (guint i = 0; i < UFO_MAX_INPUT_NODES; i++) {
         g_list_free (priv->in_groups[i]);
@@ -203,6 +270,25 @@ ufo_task_node_reset (UfoTaskNode *node)
     }
 }
 
+/**
+ * ufo_task_node_rewind_in_groups:
+ * @node: A #UfoTaskNode
+ *
+ * Select the first input group of each input again, so that another stream is
+ * fetched from the input groups in the same order as the previous one.
+ */
+void
+ufo_task_node_rewind_in_groups (UfoTaskNode *node)
+{
+    UfoTaskNodePrivate *priv;
+
+    g_return_if_fail (UFO_IS_TASK_NODE (node));
+    priv = node->priv;
+
+    for (guint i = 0; i < UFO_MAX_INPUT_NODES; i++)
+        priv->current[i] = priv->in_groups[i];
+}
+
 /**
  * ufo_task_node_get_current_in_group:
  * @node: A #UfoTaskNode
@@ -243,6 +329,11 @@ ufo_task_node_set_proc_node (UfoTaskNode *task_node,
                              UfoNode *proc_node)
 {
     g_return_if_fail (UFO_IS_TASK_NODE (task_node) && UFO_IS_NODE (proc_node));
+
+    /* Tasks sharing a GPU get different queues to overlap their work */
+    if (task_node->priv->proc_node != proc_node && UFO_IS_GPU_NODE (proc_node))
+        task_node->priv->queue_index = ufo_gpu_node_assign_queue (UFO_GPU_NODE (proc_node));
+
     task_node->priv->proc_node = proc_node;
 }
 
@@ -289,6 +380,97 @@ ufo_task_node_get_proc_node (UfoTaskNode *node)
     return node->priv->proc_node;
 }
 
+/**
+ * ufo_task_node_get_cmd_queue:
+ * @node: A #UfoTaskNode
+ *
+ * Get the compute queue assigned to @node on its #UfoGpuNode. Buffers
+ * synchronize with work enqueued by other tasks on other queues, so tasks
+ * should use this queue instead of ufo_gpu_node_get_cmd_queue().
+ *
+ * Return value: (transfer none): A cl_command_queue object or %NULL if @node
+ * is not mapped to a #UfoGpuNode.
+ */
+gpointer
+ufo_task_node_get_cmd_queue (UfoTaskNode *node)
+{
+    g_return_val_if_fail (UFO_IS_TASK_NODE (node), NULL);
+
+    if (!UFO_IS_GPU_NODE (node->priv->proc_node))
+        return NULL;
+
+    return ufo_gpu_node_get_nth_cmd_queue (UFO_GPU_NODE (node->priv->proc_node),
+                                           node->priv->queue_index);
+}
+
+/**
+ * ufo_task_node_get_transfer_queue:
+ * @node: A #UfoTaskNode
+ *
+ * Get the queue assigned to @node for transfers between host and its
+ * #UfoGpuNode.
+ *
+ * Return value: (transfer none): A cl_command_queue object or %NULL if @node
+ * is not mapped to a #UfoGpuNode.
+ */
+gpointer
+ufo_task_node_get_transfer_queue (UfoTaskNode *node)
+{
+    g_return_val_if_fail (UFO_IS_TASK_NODE (node), NULL);
+
+    if (!UFO_IS_GPU_NODE (node->priv->proc_node))
+        return NULL;
+
+    return ufo_gpu_node_get_nth_transfer_queue (UFO_GPU_NODE (node->priv->proc_node),
+                                                node->priv->queue_index);
+}
+
+/**
+ * ufo_task_node_set_cpu_node:
+ * @node: A #UfoTaskNode
+ * @cpu_node: (allow-none): A #UfoCpuNode or %NULL
+ *
+ * Set the processors that the thread running @node is pinned to.
+ */
+void
+ufo_task_node_set_cpu_node (UfoTaskNode *node,
+                            UfoNode *cpu_node)
+{
+    g_return_if_fail (UFO_IS_TASK_NODE (node));
+    node->priv->cpu_node = cpu_node;
+}
+
+/**
+ * ufo_task_node_get_cpu_node:
+ * @node: A #UfoTaskNode
+ *
+ * Get the processors that the thread running @node is pinned to.
+ *
+ * Return value: (transfer none) (allow-none): A #UfoCpuNode or %NULL if the
+ * thread is not pinned.
+ */
+UfoNode *
+ufo_task_node_get_cpu_node (UfoTaskNode *node)
+{
+    g_return_val_if_fail (UFO_IS_TASK_NODE (node), NULL);
+    return node->priv->cpu_node;
+}
+
+/**
+ * ufo_task_node_get_numa_node:
+ * @node: A #UfoTaskNode
+ *
+ * Get the NUMA node requested with the #UfoTaskNode:numa-node property.
+ *
+ * Return value: Index of the NUMA node or -1 if the scheduler decides.
+ */
+gint
+ufo_task_node_get_numa_node (UfoTaskNode *node)
+{
+    g_return_val_if_fail (UFO_IS_TASK_NODE (node), -1);
+    return node->priv->numa_node;
+}
+
 void
 ufo_task_node_set_partition (UfoTaskNode *node,
                              guint index,
@@ -328,6 +510,7 @@ ufo_task_node_copy (UfoNode *node,
     orig = UFO_TASK_NODE (node);
 
     copy->priv->pattern = orig->priv->pattern;
+    copy->priv->numa_node = orig->priv->numa_node;
 
     for (guint i = 0; i < UFO_MAX_INPUT_NODES; i++)
         copy->priv->n_expected[i] = orig->priv->n_expected[i];
@@ -337,6 +520,25 @@ ufo_task_node_copy (UfoNode *node,
     return UFO_NODE (copy);
 }
 
+static void
+ufo_task_node_set_property (GObject *object,
+                            guint property_id,
+                            const GValue *value,
+                            GParamSpec *pspec)
+{
+    UfoTaskNodePrivate *priv = UFO_TASK_NODE_GET_PRIVATE (object);
+
+    switch (property_id) {
+        case PROP_NUMA_NODE:
+            priv->numa_node = g_value_get_int (value);
+            break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+            break;
+    }
+}
+
 static void
 ufo_task_node_get_property (GObject *object,
                             guint property_id,
@@ -350,6 +552,10 @@ ufo_task_node_get_property (GObject *object,
             g_value_set_uint (value, priv->num_processed);
             break;
 
+        case PROP_NUMA_NODE:
+            g_value_set_int (value, priv->numa_node);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
             break;
@@ -378,6 +584,7 @@ ufo_task_node_finalize (GObject *object)
 
     priv = UFO_TASK_NODE_GET_PRIVATE (object);
     ufo_task_node_reset (UFO_TASK_NODE (object));
+    g_ptr_array_free (priv->out_groups, TRUE);
     g_free (priv->plugin);
     g_free (priv->identifier);
 
@@ -398,6 +605,7 @@ ufo_task_node_class_init (UfoTaskNodeClass *klass)
     UfoNodeClass *nclass;
 
     oclass = G_OBJECT_CLASS (klass);
+    oclass->set_property = ufo_task_node_set_property;
     oclass->get_property = ufo_task_node_get_property;
     oclass->dispose = ufo_task_node_dispose;
     oclass->finalize = ufo_task_node_finalize;
@@ -414,7 +622,15 @@ ufo_task_node_class_init (UfoTaskNodeClass *klass)
                            0, G_MAXUINT, 0,
                            G_PARAM_READABLE);
 
+    properties[PROP_NUMA_NODE] =
+        g_param_spec_int ("numa-node",
+                          "NUMA node to run on, -1 lets the scheduler decide",
+                          "NUMA node to run on, -1 lets the scheduler decide",
+                          -1, G_MAXINT, -1,
+                          G_PARAM_READWRITE);
+
     g_object_class_install_property (oclass, PROP_NUM_PROCESSED, properties[PROP_NUM_PROCESSED]);
+    g_object_class_install_property (oclass, PROP_NUMA_NODE, properties[PROP_NUMA_NODE]);
 
     g_type_class_add_private (klass, sizeof(UfoTaskNodePrivate));
 }
@@ -427,7 +643,10 @@ ufo_task_node_init (UfoTaskNode *self)
     self->priv->identifier = NULL;
     self->priv->pattern = UFO_SEND_SCATTER;
     self->priv->proc_node = NULL;
-    self->priv->out_group = NULL;
+    self->priv->queue_index = 0;
+    self->priv->cpu_node = NULL;
+    self->priv->numa_node = -1;
+    self->priv->out_groups = g_ptr_array_new ();
     self->priv->index = 0;
     self->priv->total = 1;
     self->priv->num_processed = 0;
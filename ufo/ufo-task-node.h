@@ -88,16 +88,30 @@ gint            ufo_task_node_get_num_expected      (UfoTaskNode    *node,
 void            ufo_task_node_set_out_group         (UfoTaskNode    *node,
                                                      UfoGroup       *group);
 UfoGroup       *ufo_task_node_get_out_group         (UfoTaskNode    *node);
+void            ufo_task_node_set_output_group      (UfoTaskNode    *node,
+                                                     guint           output,
+                                                     UfoGroup       *group);
+UfoGroup       *ufo_task_node_get_output_group      (UfoTaskNode    *node,
+                                                     guint           output);
 void            ufo_task_node_add_in_group          (UfoTaskNode    *node,
                                                      guint           pos,
                                                      UfoGroup       *group);
+GList          *ufo_task_node_get_in_groups         (UfoTaskNode    *node,
+                                                     guint           pos);
 UfoGroup       *ufo_task_node_get_current_in_group  (UfoTaskNode    *node,
                                                      guint           pos);
 void            ufo_task_node_switch_in_group       (UfoTaskNode    *node,
                                                      guint           pos);
+void            ufo_task_node_rewind_in_groups      (UfoTaskNode    *node);
 void            ufo_task_node_set_proc_node         (UfoTaskNode    *task_node,
                                                      UfoNode        *proc_node);
 UfoNode        *ufo_task_node_get_proc_node         (UfoTaskNode    *node);
+gpointer        ufo_task_node_get_cmd_queue         (UfoTaskNode    *node);
+gpointer        ufo_task_node_get_transfer_queue    (UfoTaskNode    *node);
+void            ufo_task_node_set_cpu_node          (UfoTaskNode    *node,
+                                                     UfoNode        *cpu_node);
+UfoNode        *ufo_task_node_get_cpu_node          (UfoTaskNode    *node);
+gint            ufo_task_node_get_numa_node         (UfoTaskNode    *node);
 void            ufo_task_node_set_partition         (UfoTaskNode    *node,
                                                      guint           index,
                                                      guint           total);
@@ -19,17 +19,283 @@
 
 #include "config.h"
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <limits.h>
+#endif
+
 #include "ufo-two-way-queue.h"
 #include "ufo-priv.h"
 
+/*
+ * The ring backend is a bounded multi-producer/multi-consumer queue after
+ * Vyukov: every cell carries a sequence number that tells producers and
+ * consumers whether it is ready for them. Head and tail live on separate cache
+ * lines so that producer and consumer do not invalidate each other. A thread
+ * that finds the ring empty, or full when pushing, spins for a while and then
+ * sleeps on a futex word (or a condition variable on systems without futexes).
+ */
+
+#define UFO_CACHE_LINE_SIZE     64
+#define RING_SPIN_COUNT         1024
+#define RING_MIN_SIZE           4
+
+typedef struct {
+    guint       sequence;
+    gpointer    data;
+} RingCell;
+
+typedef struct {
+    gint        enqueue_pos;
+    gchar       pad0[UFO_CACHE_LINE_SIZE - sizeof (gint)];
+    gint        dequeue_pos;
+    gchar       pad1[UFO_CACHE_LINE_SIZE - sizeof (gint)];
+    gint        wakeup;
+    gint        n_waiters;
+    gchar       pad2[UFO_CACHE_LINE_SIZE - 2 * sizeof (gint)];
+#ifndef __linux__
+    GMutex      lock;
+    GCond       cond;
+#endif
+    guint       mask;
+    RingCell   *cells;
+} Ring;
 
 struct _UfoTwoWayQueue {
+    UfoTwoWayQueueBackend backend;
     GAsyncQueue *producer_queue;
     GAsyncQueue *consumer_queue;
+    Ring *producer_ring;
+    Ring *consumer_ring;
     GList *inserted;
     guint capacity;
+    guint max_capacity;
 };
 
+static Ring *
+ring_new (guint size)
+{
+    Ring *ring;
+    guint n_cells = RING_MIN_SIZE;
+
+    while (n_cells < size)
+        n_cells <<= 1;
+
+    ring = g_new0 (Ring, 1);
+    ring->cells = g_new0 (RingCell, n_cells);
+    ring->mask = n_cells - 1;
+
+    for (guint i = 0; i < n_cells; i++)
+        ring->cells[i].sequence = i;
+
+#ifndef __linux__
+    g_mutex_init (&ring->lock);
+    g_cond_init (&ring->cond);
+#endif
+
+    return ring;
+}
+
+static void
+ring_free (Ring *ring)
+{
+#ifndef __linux__
+    g_mutex_clear (&ring->lock);
+    g_cond_clear (&ring->cond);
+#endif
+    g_free (ring->cells);
+    g_free (ring);
+}
+
+static gboolean
+ring_try_push (Ring *ring, gpointer data)
+{
+    RingCell *cell;
+    guint pos;
+
+    pos = (guint) g_atomic_int_get (&ring->enqueue_pos);
+
+    for (;;) {
+        gint diff;
+
+        cell = &ring->cells[pos & ring->mask];
+        diff = (gint) ((guint) g_atomic_int_get ((gint *) &cell->sequence) - pos);
+
+        if (diff == 0) {
+            if (g_atomic_int_compare_and_exchange (&ring->enqueue_pos, (gint) pos, (gint) (pos + 1)))
+                break;
+        }
+        else if (diff < 0) {
+            return FALSE;
+        }
+
+        pos = (guint) g_atomic_int_get (&ring->enqueue_pos);
+    }
+
+    cell->data = data;
+    g_atomic_int_set ((gint *) &cell->sequence, (gint) (pos + 1));
+    return TRUE;
+}
+
+static gboolean
+ring_try_pop (Ring *ring, gpointer *data)
+{
+    RingCell *cell;
+    guint pos;
+
+    pos = (guint) g_atomic_int_get (&ring->dequeue_pos);
+
+    for (;;) {
+        gint diff;
+
+        cell = &ring->cells[pos & ring->mask];
+        diff = (gint) ((guint) g_atomic_int_get ((gint *) &cell->sequence) - (pos + 1));
+
+        if (diff == 0) {
+            if (g_atomic_int_compare_and_exchange (&ring->dequeue_pos, (gint) pos, (gint) (pos + 1)))
+                break;
+        }
+        else if (diff < 0) {
+            return FALSE;
+        }
+
+        pos = (guint) g_atomic_int_get (&ring->dequeue_pos);
+    }
+
+    *data = cell->data;
+    g_atomic_int_set ((gint *) &cell->sequence, (gint) (pos + ring->mask + 1));
+    return TRUE;
+}
+
+static void
+ring_sleep (Ring *ring, gint wakeup)
+{
+#ifdef __linux__
+    syscall (SYS_futex, &ring->wakeup, FUTEX_WAIT_PRIVATE, wakeup, NULL, NULL, 0);
+#else
+    g_mutex_lock (&ring->lock);
+
+    while (g_atomic_int_get (&ring->wakeup) == wakeup)
+        g_cond_wait (&ring->cond, &ring->lock);
+
+    g_mutex_unlock (&ring->lock);
+#endif
+}
+
+static void
+ring_wake (Ring *ring)
+{
+    if (g_atomic_int_get (&ring->n_waiters) == 0)
+        return;
+
+#ifdef __linux__
+    g_atomic_int_inc (&ring->wakeup);
+    syscall (SYS_futex, &ring->wakeup, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+    g_mutex_lock (&ring->lock);
+    g_atomic_int_inc (&ring->wakeup);
+    g_cond_broadcast (&ring->cond);
+    g_mutex_unlock (&ring->lock);
+#endif
+}
+
+static guint
+ring_get_spin_count (void)
+{
+    static gsize spin_count = 0;
+
+    /* Spinning only helps if the other side can make progress meanwhile */
+    if (g_once_init_enter (&spin_count)) {
+        gsize count = g_get_num_processors () > 1 ? RING_SPIN_COUNT : 1;
+        g_once_init_leave (&spin_count, count);
+    }
+
+    return (guint) spin_count;
+}
+
+static void
+ring_push (Ring *ring, gpointer data)
+{
+    guint spin_count;
+
+    spin_count = ring_get_spin_count ();
+
+    /*
+     * The ring is sized to hold everything ever inserted plus end-of-stream
+     * markers, but buffers forwarded from other groups come on top of that. If
+     * it is full, wait for a consumer to make room.
+     */
+    for (;;) {
+        gint wakeup;
+
+        for (guint i = 0; i < spin_count; i++) {
+            if (ring_try_push (ring, data)) {
+                ring_wake (ring);
+                return;
+            }
+        }
+
+        wakeup = g_atomic_int_get (&ring->wakeup);
+        g_atomic_int_inc (&ring->n_waiters);
+
+        /* Re-check after announcing ourselves, a pop may have just missed us */
+        if (ring_try_push (ring, data)) {
+            g_atomic_int_add (&ring->n_waiters, -1);
+            ring_wake (ring);
+            return;
+        }
+
+        ring_sleep (ring, wakeup);
+        g_atomic_int_add (&ring->n_waiters, -1);
+    }
+}
+
+/*
+ * Pop without waiting and wake producers that may wait for room.
+ */
+static gboolean
+ring_take (Ring *ring, gpointer *data)
+{
+    if (!ring_try_pop (ring, data))
+        return FALSE;
+
+    ring_wake (ring);
+    return TRUE;
+}
+
+static gpointer
+ring_pop (Ring *ring)
+{
+    gpointer data;
+    guint spin_count;
+
+    spin_count = ring_get_spin_count ();
+
+    for (;;) {
+        gint wakeup;
+
+        for (guint i = 0; i < spin_count; i++) {
+            if (ring_take (ring, &data))
+                return data;
+        }
+
+        wakeup = g_atomic_int_get (&ring->wakeup);
+        g_atomic_int_inc (&ring->n_waiters);
+
+        /* Re-check after announcing ourselves, a push may have just missed us */
+        if (ring_try_pop (ring, &data)) {
+            g_atomic_int_add (&ring->n_waiters, -1);
+            ring_wake (ring);
+            return data;
+        }
+
+        ring_sleep (ring, wakeup);
+        g_atomic_int_add (&ring->n_waiters, -1);
+    }
+}
+
 /**
  * ufo_two_way_queue_new: (skip)
  * @init: (element-type gpointer): List with elements inserted into
@@ -42,14 +308,46 @@ struct _UfoTwoWayQueue {
  */
 UfoTwoWayQueue *
 ufo_two_way_queue_new (GList *init)
+{
+    return ufo_two_way_queue_new_full (init, UFO_TWO_WAY_QUEUE_BACKEND_ASYNC, 0);
+}
+
+/**
+ * ufo_two_way_queue_new_full: (skip)
+ * @init: (element-type gpointer): List with elements inserted into
+ *  consumer queue
+ * @backend: Storage backend
+ * @max_capacity: Maximum number of items that will ever be inserted with
+ *  ufo_two_way_queue_insert(). Only used by %UFO_TWO_WAY_QUEUE_BACKEND_RING.
+ *
+ * Create a new two-way queue using @backend. The ring backend allocates its
+ * storage up-front, hence @max_capacity should cover all items inserted
+ * during the lifetime of the queue.
+ *
+ * Returns: A new #UfoTwoWayQueue.
+ */
+UfoTwoWayQueue *
+ufo_two_way_queue_new_full (GList *init,
+                            UfoTwoWayQueueBackend backend,
+                            guint max_capacity)
 {
     GList *it;
     UfoTwoWayQueue *queue = g_new0 (UfoTwoWayQueue, 1);
 
-    queue->producer_queue = g_async_queue_new ();
-    queue->consumer_queue = g_async_queue_new ();
+    queue->backend = backend;
     queue->inserted = NULL;
     queue->capacity = 0;
+    queue->max_capacity = MAX (max_capacity, g_list_length (init));
+
+    if (backend == UFO_TWO_WAY_QUEUE_BACKEND_RING) {
+        /* Leave room for end-of-stream markers pushed on top of the items */
+        queue->producer_ring = ring_new (queue->max_capacity + 2);
+        queue->consumer_ring = ring_new (queue->max_capacity + 2);
+    }
+    else {
+        queue->producer_queue = g_async_queue_new ();
+        queue->consumer_queue = g_async_queue_new ();
+    }
 
     g_list_for (init, it) {
         ufo_two_way_queue_insert (queue, it->data);
@@ -61,8 +359,15 @@ ufo_two_way_queue_new (GList *init)
 void
 ufo_two_way_queue_free (UfoTwoWayQueue *queue)
 {
-    g_async_queue_unref (queue->producer_queue);
-    g_async_queue_unref (queue->consumer_queue);
+    if (queue->backend == UFO_TWO_WAY_QUEUE_BACKEND_RING) {
+        ring_free (queue->producer_ring);
+        ring_free (queue->consumer_ring);
+    }
+    else {
+        g_async_queue_unref (queue->producer_queue);
+        g_async_queue_unref (queue->consumer_queue);
+    }
+
     g_list_free (queue->inserted);
     g_free (queue);
 }
@@ -78,13 +383,38 @@ ufo_two_way_queue_free (UfoTwoWayQueue *queue)
 gpointer
 ufo_two_way_queue_consumer_pop (UfoTwoWayQueue *queue)
 {
+    if (queue->backend == UFO_TWO_WAY_QUEUE_BACKEND_RING)
+        return ring_pop (queue->consumer_ring);
+
     return g_async_queue_pop (queue->consumer_queue);
 }
 
+/**
+ * ufo_two_way_queue_consumer_try_pop:
+ * @queue: A #UfoTwoWayQueue
+ *
+ * Fetch an item for consumption without waiting.
+ *
+ * Returns: (transfer none): A consumable item or %NULL if none is available.
+ */
+gpointer
+ufo_two_way_queue_consumer_try_pop (UfoTwoWayQueue *queue)
+{
+    gpointer data = NULL;
+
+    if (queue->backend == UFO_TWO_WAY_QUEUE_BACKEND_RING)
+        return ring_take (queue->consumer_ring, &data) ? data : NULL;
+
+    return g_async_queue_try_pop (queue->consumer_queue);
+}
+
 void
 ufo_two_way_queue_consumer_push (UfoTwoWayQueue *queue, gpointer data)
 {
-    g_async_queue_push (queue->producer_queue, data);
+    if (queue->backend == UFO_TWO_WAY_QUEUE_BACKEND_RING)
+        ring_push (queue->producer_ring, data);
+    else
+        g_async_queue_push (queue->producer_queue, data);
 }
 
 /**
@@ -98,13 +428,38 @@ ufo_two_way_queue_consumer_push (UfoTwoWayQueue *queue, gpointer data)
 gpointer
 ufo_two_way_queue_producer_pop (UfoTwoWayQueue *queue)
 {
+    if (queue->backend == UFO_TWO_WAY_QUEUE_BACKEND_RING)
+        return ring_pop (queue->producer_ring);
+
     return g_async_queue_pop (queue->producer_queue);
 }
 
+/**
+ * ufo_two_way_queue_producer_try_pop:
+ * @queue: A #UfoTwoWayQueue
+ *
+ * Fetch an item for production without waiting.
+ *
+ * Returns: (transfer none): A producable item or %NULL if none is available.
+ */
+gpointer
+ufo_two_way_queue_producer_try_pop (UfoTwoWayQueue *queue)
+{
+    gpointer data = NULL;
+
+    if (queue->backend == UFO_TWO_WAY_QUEUE_BACKEND_RING)
+        return ring_take (queue->producer_ring, &data) ? data : NULL;
+
+    return g_async_queue_try_pop (queue->producer_queue);
+}
+
 void
 ufo_two_way_queue_producer_push (UfoTwoWayQueue *queue, gpointer data)
 {
-    g_async_queue_push (queue->consumer_queue, data);
+    if (queue->backend == UFO_TWO_WAY_QUEUE_BACKEND_RING)
+        ring_push (queue->consumer_ring, data);
+    else
+        g_async_queue_push (queue->consumer_queue, data);
 }
 
 /**
@@ -124,13 +479,52 @@ ufo_two_way_queue_get_inserted (UfoTwoWayQueue *queue)
 void
 ufo_two_way_queue_insert (UfoTwoWayQueue *queue, gpointer data)
 {
-    g_async_queue_push (queue->producer_queue, data);
+    if (queue->backend == UFO_TWO_WAY_QUEUE_BACKEND_RING) {
+        if (queue->capacity >= queue->max_capacity)
+            g_warning ("Inserting more items than the announced capacity of %u", queue->max_capacity);
+
+        ring_push (queue->producer_ring, data);
+    }
+    else {
+        g_async_queue_push (queue->producer_queue, data);
+    }
+
     queue->inserted = g_list_append (queue->inserted, data);
     queue->capacity++;
 }
 
+/**
+ * ufo_two_way_queue_reset: (skip)
+ * @queue: A #UfoTwoWayQueue
+ *
+ * Discard all items and end-of-stream markers in flight and put every inserted
+ * item back into the producer queue. Neither producer nor consumer may access
+ * @queue meanwhile.
+ */
+void
+ufo_two_way_queue_reset (UfoTwoWayQueue *queue)
+{
+    GList *it;
+
+    while (ufo_two_way_queue_producer_try_pop (queue) != NULL)
+        ;
+
+    while (ufo_two_way_queue_consumer_try_pop (queue) != NULL)
+        ;
+
+    g_list_for (queue->inserted, it) {
+        ufo_two_way_queue_consumer_push (queue, it->data);
+    }
+}
+
 guint
 ufo_two_way_queue_get_capacity (UfoTwoWayQueue *queue)
 {
     return queue->capacity;
 }
+
+UfoTwoWayQueueBackend
+ufo_two_way_queue_get_backend (UfoTwoWayQueue *queue)
+{
+    return queue->backend;
+}
@@ -30,18 +30,42 @@ G_BEGIN_DECLS
 
 typedef struct _UfoTwoWayQueue          UfoTwoWayQueue;
 
+/**
+ * UfoTwoWayQueueBackend:
+ * @UFO_TWO_WAY_QUEUE_BACKEND_ASYNC: Use a pair of mutex-protected
+ *  #GAsyncQueue objects.
+ * @UFO_TWO_WAY_QUEUE_BACKEND_RING: Use a pair of lock-free bounded ring
+ *  buffers and spin before putting waiting threads to sleep.
+ *
+ * Storage used to pass items between producer and consumer.
+ */
+typedef enum {
+    UFO_TWO_WAY_QUEUE_BACKEND_ASYNC,
+    UFO_TWO_WAY_QUEUE_BACKEND_RING
+} UfoTwoWayQueueBackend;
+
 UfoTwoWayQueue  * ufo_two_way_queue_new             (GList *init);
+UfoTwoWayQueue  * ufo_two_way_queue_new_full        (GList *init,
+                                                     UfoTwoWayQueueBackend backend,
+                                                     guint max_capacity);
 void              ufo_two_way_queue_free            (UfoTwoWayQueue *queue);
 gpointer          ufo_two_way_queue_consumer_pop    (UfoTwoWayQueue *queue);
+gpointer          ufo_two_way_queue_consumer_try_pop
+                                                    (UfoTwoWayQueue *queue);
 void              ufo_two_way_queue_consumer_push   (UfoTwoWayQueue *queue,
                                                      gpointer data);
 gpointer          ufo_two_way_queue_producer_pop    (UfoTwoWayQueue *queue);
+gpointer          ufo_two_way_queue_producer_try_pop
+                                                    (UfoTwoWayQueue *queue);
 void              ufo_two_way_queue_producer_push   (UfoTwoWayQueue *queue,
                                                      gpointer data);
 void              ufo_two_way_queue_insert          (UfoTwoWayQueue *queue,
                                                      gpointer data);
+void              ufo_two_way_queue_reset           (UfoTwoWayQueue *queue);
 guint             ufo_two_way_queue_get_capacity    (UfoTwoWayQueue *queue);
 GList           * ufo_two_way_queue_get_inserted    (UfoTwoWayQueue *queue);
+UfoTwoWayQueueBackend
+                  ufo_two_way_queue_get_backend     (UfoTwoWayQueue *queue);
 
 G_END_DECLS
 
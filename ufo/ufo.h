@@ -24,12 +24,15 @@
 
 #include <ufo/ufo-basic-ops.h>
 #include <ufo/ufo-buffer.h>
+#include <ufo/ufo-buffer-pool.h>
 #include <ufo/ufo-copyable-iface.h>
 #include <ufo/ufo-copy-task.h>
 #include <ufo/ufo-cpu-node.h>
 #include <ufo/ufo-dummy-task.h>
+#include <ufo/ufo-elementwise-iface.h>
 #include <ufo/ufo-enums.h>
 #include <ufo/ufo-fixed-scheduler.h>
+#include <ufo/ufo-fused-task.h>
 #include <ufo/ufo-gpu-node.h>
 #include <ufo/ufo-graph.h>
 #include <ufo/ufo-group.h>
@@ -42,6 +45,7 @@
 #include <ufo/ufo-profiler.h>
 #include <ufo/ufo-resources.h>
 #include <ufo/ufo-scheduler.h>
+#include <ufo/ufo-stealing-scheduler.h>
 #include <ufo/ufo-task-graph.h>
 #include <ufo/ufo-task-iface.h>
 #include <ufo/ufo-task-node.h>